@@ -7,7 +7,7 @@
  * 	displays for testing. Only deals with IMU, Force, and CyGl Sensors.
  *
  * Usage:
- * 	Compile with: gcc -o mobileTest mobileTest.c IMU.c CyGl.c Force.c -lwiringPi -pthread -std=gnu99 -Wall -Wextra
+ * 	Compile with: gcc -o mobileTest mobileTest.c IMU.c CyGl.c Force.c Serial.c -lwiringPi -pthread -std=gnu99 -Wall -Wextra
  *
  * 	Starts and stops recording data when a switch is flipped.
  *
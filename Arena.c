@@ -0,0 +1,177 @@
+/*
+ * Name: Arena.c
+ * Author: Elijah Pivo
+ *
+ * Startup time memory arena for the real time path.
+ */
+
+#include "Arena.h"
+
+int initializeArena(Arena* Arena, size_t size) {
+
+	Arena->pageSize = sysconf(_SC_PAGESIZE);
+	Arena->size = (size + Arena->pageSize - 1) / Arena->pageSize * Arena->pageSize;
+	Arena->used = 0;
+	Arena->locked = 0;
+	Arena->startMinorFaults = 0;
+	Arena->startMajorFaults = 0;
+	Arena->stopMinorFaults = 0;
+	Arena->stopMajorFaults = 0;
+	Arena->stopped = 0;
+
+	Arena->base = mmap(NULL, Arena->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if (Arena->base == MAP_FAILED) {
+		fprintf(stderr, "Arena ERROR: Couldn't map %zu bytes.\n", Arena->size);
+		Arena->base = NULL;
+		return -1;
+	}
+
+	//MAP_POPULATE is only a hint, write every page so none are shared zero pages
+	for (size_t i = 0; i < Arena->size; i += Arena->pageSize) {
+		Arena->base[i] = 0;
+	}
+
+	if (mlock(Arena->base, Arena->size) != 0) {
+		fprintf(stderr, "Arena WARNING: Couldn't lock %zu bytes, pages may be swapped.\n", Arena->size);
+		fprintf(stderr, "*Remember to run as root.*\n");
+	} else {
+		Arena->locked = 1;
+	}
+
+	return 1;
+}
+
+void* arenaAlloc(Arena* Arena, size_t size, size_t align) {
+
+	if (align == 0) {
+		align = ARENA_ALIGN;
+	}
+
+	size_t start = (Arena->used + align - 1) & ~(align - 1);
+	if (Arena->base == NULL || start + size > Arena->size) {
+		fprintf(stderr, "Arena ERROR: Out of space, %zu bytes asked for, %zu of %zu used.\n",
+				size, Arena->used, Arena->size);
+		return NULL;
+	}
+
+	Arena->used = start + size;
+	memset(Arena->base + start, 0, size);
+
+	return Arena->base + start;
+}
+
+int arenaThreadAttributes(Arena* Arena, pthread_attr_t* attributes, size_t stackSize) {
+
+	stackSize = (stackSize + Arena->pageSize - 1) / Arena->pageSize * Arena->pageSize;
+
+	uint8_t* guard = arenaAlloc(Arena, Arena->pageSize + stackSize, Arena->pageSize);
+	if (guard == NULL) {
+		return -1;
+	}
+
+	//stacks grow down, an overflow hits the guard page instead of the next allocation
+	if (mprotect(guard, Arena->pageSize, PROT_NONE) != 0) {
+		fprintf(stderr, "Arena WARNING: Couldn't protect stack guard page.\n");
+	}
+
+	if (pthread_attr_init(attributes) != 0
+			|| pthread_attr_setstack(attributes, guard + Arena->pageSize, stackSize) != 0) {
+		fprintf(stderr, "Arena ERROR: Couldn't set thread stack.\n");
+		return -1;
+	}
+
+	return 1;
+}
+
+FILE* arenaOpenFile(Arena* Arena, const char* file, const char* mode, size_t bufferSize) {
+
+	FILE* opened = fopen(file, mode);
+	if (opened == NULL) {
+		return NULL;
+	}
+
+	char* buffer = arenaAlloc(Arena, bufferSize, 0);
+	if (buffer == NULL || setvbuf(opened, buffer, _IOFBF, bufferSize) != 0) {
+		fprintf(stderr, "Arena WARNING: %s keeps its default stdio buffer.\n", file);
+	}
+
+	return opened;
+}
+
+int lockRegion(void* start, size_t size) {
+
+	volatile uint8_t* bytes = start;
+	long pageSize = sysconf(_SC_PAGESIZE);
+
+	//read then write back so the contents don't change
+	for (size_t i = 0; i < size; i += pageSize) {
+		bytes[i] = bytes[i];
+	}
+
+	if (mlock(start, size) != 0) {
+		fprintf(stderr, "Arena WARNING: Couldn't lock %zu bytes.\n", size);
+		return -1;
+	}
+	return 1;
+}
+
+void prefaultStack(size_t size) {
+
+	uint8_t stack[size];
+	volatile uint8_t* touch = stack; //keeps the writes from being optimized out
+	long pageSize = sysconf(_SC_PAGESIZE);
+
+	for (size_t i = 0; i < size; i += pageSize) {
+		touch[i] = 0;
+	}
+}
+
+void markArenaStart(Arena* Arena) {
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	Arena->startMinorFaults = usage.ru_minflt;
+	Arena->startMajorFaults = usage.ru_majflt;
+	Arena->stopped = 0;
+}
+
+void markArenaStop(Arena* Arena) {
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	Arena->stopMinorFaults = usage.ru_minflt;
+	Arena->stopMajorFaults = usage.ru_majflt;
+	Arena->stopped = 1;
+}
+
+void printArenaReport(const Arena* Arena, FILE* file) {
+
+	long minorFaults = Arena->stopMinorFaults;
+	long majorFaults = Arena->stopMajorFaults;
+	if (!Arena->stopped) {
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		minorFaults = usage.ru_minflt;
+		majorFaults = usage.ru_majflt;
+	}
+
+	fprintf(file, "Arena: %zu of %zu bytes used, %s\n", Arena->used, Arena->size,
+			Arena->locked ? "locked" : "NOT locked");
+	fprintf(file, "Page faults while recording: %ld minor, %ld major\n",
+			minorFaults - Arena->startMinorFaults, majorFaults - Arena->startMajorFaults);
+}
+
+void closeArena(Arena* Arena) {
+
+	if (Arena->base != NULL) {
+		munlock(Arena->base, Arena->size);
+		munmap(Arena->base, Arena->size);
+	}
+
+	Arena->base = NULL;
+	Arena->size = 0;
+	Arena->used = 0;
+	Arena->locked = 0;
+}
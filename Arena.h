@@ -0,0 +1,110 @@
+/*
+ * Name: Arena.h
+ * Author: Elijah Pivo
+ *
+ * Startup time memory arena for the real time path.
+ *
+ * One anonymous mapping is reserved, every page is touched and the whole
+ * thing is locked before recording starts. Sample rings, record and file
+ * buffers and thread stacks are carved out of it with a bump allocator,
+ * so once recording starts nothing on the real time path allocates or
+ * takes a page fault. Nothing is ever freed on its own, the arena is
+ * released in one piece at the end of the session.
+ *
+ * getrusage() fault counts are taken when recording starts (markArenaStart)
+ * so the session report can show any faults taken while recording.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "CacheLine.h"
+
+#define ARENA_ALIGN CACHE_LINE_SZ
+#define ARENA_STACK_SZ (256 * 1024)
+#define ARENA_FILE_BUFFER_SZ (1024 * 1024)
+
+typedef struct {
+	uint8_t* base;
+	size_t size;
+	size_t used;
+	size_t pageSize;
+	int locked;
+
+	//fault counts when recording started and stopped
+	long startMinorFaults;
+	long startMajorFaults;
+	long stopMinorFaults;
+	long stopMajorFaults;
+	int stopped;
+} Arena;
+
+/*
+ * Maps, prefaults and locks size bytes. Returns 1 if succeeded, -1 if the
+ * memory couldn't be mapped. If it couldn't be locked (not root) the arena
+ * is still usable, locked is 0 and a warning is printed.
+ */
+int initializeArena(Arena* Arena, size_t size);
+
+/*
+ * Returns size bytes aligned to align (a power of two, 0 for ARENA_ALIGN),
+ * zeroed. Returns NULL (with a message on stderr) if the arena is full.
+ */
+void* arenaAlloc(Arena* Arena, size_t size, size_t align);
+
+/*
+ * Sets up thread attributes whose stack comes from the arena, with a guard
+ * page below it. Returns 1 if succeeded, -1 otherwise.
+ */
+int arenaThreadAttributes(Arena* Arena, pthread_attr_t* attributes, size_t stackSize);
+
+/*
+ * fopen() with a fully buffered stdio buffer from the arena, so the first
+ * write doesn't allocate. Returns the file, NULL if it couldn't be opened.
+ */
+FILE* arenaOpenFile(Arena* Arena, const char* file, const char* mode, size_t bufferSize);
+
+/*
+ * Touches and locks memory that lives outside the arena (e.g. global data).
+ * Returns 1 if locked, -1 otherwise.
+ */
+int lockRegion(void* start, size_t size);
+
+/*
+ * Touches size bytes of the calling thread's stack so its pages are
+ * mapped (and locked, under mlockall) before they're needed.
+ */
+void prefaultStack(size_t size);
+
+/*
+ * Records the fault counts at the start of recording.
+ */
+void markArenaStart(Arena* Arena);
+
+/*
+ * Records the fault counts when recording stops, call before tearing the
+ * session down so closing files and threads isn't counted.
+ */
+void markArenaStop(Arena* Arena);
+
+/*
+ * Prints arena use and the page faults taken between markArenaStart and
+ * markArenaStop (or now, if recording hasn't been marked stopped).
+ */
+void printArenaReport(const Arena* Arena, FILE* file);
+
+/*
+ * Unmaps the arena. Everything allocated from it is gone.
+ */
+void closeArena(Arena* Arena);
+
+#endif
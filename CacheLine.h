@@ -0,0 +1,31 @@
+/*
+ * Name: CacheLine.h
+ * Author: Elijah Pivo
+ *
+ * Cache line layout helpers for data shared between threads.
+ *
+ * Fields written by different threads are kept on different cache lines
+ * so a write on one core doesn't invalidate the line another core is
+ * working on (false sharing). Compile with -DCACHE_PACKED to get the old
+ * packed layout back, sharingTest uses this to compare the two.
+ */
+
+#ifndef CACHELINE_H
+#define CACHELINE_H
+
+#define CACHE_LINE_SZ 64 //Cortex-A53 and A72, Pi 3 and Pi 4
+
+#ifdef CACHE_PACKED
+#define CACHE_ALIGNED
+#else
+#define CACHE_ALIGNED __attribute__((aligned(CACHE_LINE_SZ)))
+#endif
+
+/*
+ * One thread hand-off flag on its own cache line.
+ */
+typedef struct {
+	volatile int value;
+} CACHE_ALIGNED ControlSlot;
+
+#endif
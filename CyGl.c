@@ -7,6 +7,7 @@
 
 
 #include "CyGl.h"
+#include "Trace.h"
 
 int initializeCyGl(CyGl* CyGl) {
 
@@ -23,6 +24,7 @@ int initializeCyGl(CyGl* CyGl) {
 int initializeWirelessCyGl(CyGl* CyGl) {
 
 	CyGl->id = -1;
+	CyGl->cancelled = NULL;
 	CyGl->hasNewRead1 = 0;
 	CyGl->hasNewRead2 = 0;
 	CyGl->bufferToUse = 2;
@@ -37,29 +39,15 @@ int initializeWirelessCyGl(CyGl* CyGl) {
 
 	const char device[] = "/dev/rfcomm0";
 	int tempID;
+	SerialOptions options;
+	defaultSerialOptions(&options, CYGL_BAUD);
 
-	if ((tempID = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK)) == -1) {
+	//rfcomm ignores the rate and low latency flag but wants the same raw mode
+	if ((tempID = openSerialPort(device, &options)) == -1) {
 		fprintf(stderr, "Wireless CyGl ERROR: Couldn't open device.\n");
 		return -1;
 	}
 
-	// Set BAUD rate
-	struct termios options;
-	tcgetattr(tempID, &options);
-	cfmakeraw(&options);
-	cfsetispeed(&options, CYGL_BAUD);
-	cfsetospeed(&options, CYGL_BAUD);
-
-	options.c_cflag |= (CLOCAL | CREAD) ;
-	options.c_cflag &= ~PARENB ;
-	options.c_cflag &= ~CSTOPB ;
-	options.c_cflag &= ~CSIZE ;
-	options.c_cflag |= CS8 ;
-	options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG) ;
-	options.c_oflag &= ~OPOST ;
-
-	tcsetattr(tempID, TCSANOW, &options);
-
 	usleep(10000) ;	// 10mS
 
 	if (write(tempID, "?g", 2) != 2) {
@@ -71,6 +59,7 @@ int initializeWirelessCyGl(CyGl* CyGl) {
 		sleep(1);
 		if (i == 7) {
 			fprintf(stderr, "Wireless CyGl ERROR: No response received.\n");
+			close(tempID);
 			return -1;
 		}
 	}
@@ -97,12 +86,13 @@ int initializeWirelessCyGl(CyGl* CyGl) {
 	}
 
 	if (correctResponse == 1) {
-//		set it to blocking
-		fcntl (tempID, F_SETFL, O_RDWR | O_NOCTTY);
+		//stays non-blocking, readings are waited for with readSerialFrame
 		CyGl->id = tempID;
 		CyGl->WiredCyGl = 0;
+		CyGl->baud = options.baud;
 		return CyGl->id;
 	} else {
+		close(tempID);
 		return -1;
 	}
 
@@ -111,6 +101,7 @@ int initializeWirelessCyGl(CyGl* CyGl) {
 int initializeWiredCyGl(CyGl* CyGl) {
 
 	CyGl->id = -1;
+	CyGl->cancelled = NULL;
 	CyGl->hasNewRead1 = 0;
 	CyGl->hasNewRead2 = 0;
 	CyGl->bufferToUse = 2;
@@ -125,45 +116,30 @@ int initializeWiredCyGl(CyGl* CyGl) {
 
 	const char device[] = "/dev/ttyUSB0";
 	int tempID;
+	SerialOptions options;
+	defaultSerialOptions(&options, CYGL_BAUD);
 
-	if ((tempID = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK)) == -1) {
+	//low latency takes the FTDI adapter's latency timer from 16ms to 1ms
+	if ((tempID = openSerialPort(device, &options)) == -1) {
 		fprintf(stderr, "Wired CyGl ERROR: Couldn't open device.\n");
 		return -1;
 	}
 
-	// Set BAUD rate
-	struct termios options;
-	tcgetattr(tempID, &options);
-	cfmakeraw(&options);
-	cfsetispeed(&options, CYGL_BAUD);
-	cfsetospeed(&options, CYGL_BAUD);
-	tcsetattr(tempID, TCSANOW, &options);
-
 	usleep(10000) ;	// 10mS
 
-	//request reading
-	if (write(tempID, "G", 1) != 1) {
-		fprintf(stderr, "Wired CyGl ERROR: Couldn't request state.\n");
+	//request a reading at each rate until the glove answers, the reading is dropped
+	const speed_t bauds[] = CYGL_BAUDS;
+	if (probeSerialBaud(tempID, &options, bauds, sizeof(bauds) / sizeof(bauds[0]),
+			"G", 1, NULL, WIRED_CYGL_READ_SZ, CYGL_PROBE_TIMEOUT) == -1) {
+		fprintf(stderr, "Wired CyGl ERROR: No response received.\n");
+		close(tempID);
 		return -1;
 	}
 
-	//wait at most 2 seconds for a response
-	for (int i = 0; CyGlDataAvail(tempID) <= 0; i++) {
-		sleep(1);
-		if (i == 2) {
-			fprintf(stderr, "Wired CyGl ERROR: No response received.\n");
-			return -1;
-		}
-	}
-
-	//get the reading
-	read(CyGl->id, NULL, WIRED_CYGL_READ_SZ * sizeof(uint8_t));
-
-	//set it to blocking
-	fcntl (tempID, F_SETFL, O_RDWR | O_NOCTTY);
-
+	//stays non-blocking, readings are waited for with readSerialFrame
 	CyGl->id = tempID;
 	CyGl->WiredCyGl = 1;
+	CyGl->baud = options.baud;
 
 	return CyGl->id;
 
@@ -297,20 +273,18 @@ int restartWiredCyGl(CyGl* CyGl) {
 
 int getCyGlData(CyGl* CyGl, double time) {
 
+	TRACE_SCOPE("getCyGlData");
+
 	CyGl->reads++;
 
-	fd_set set;
-	struct timeval timeout;
-	timeout.tv_sec = 0;
-	timeout.tv_usec = 24000; //wait 24 ms
-	int retval = 1;
-	FD_ZERO(&set);
-	FD_SET(CyGl->id, &set);
+	//wired and wireless gloves send different length readings
+	int readSize = CyGl->WiredCyGl == 1 ? WIRED_CYGL_READ_SZ : WIRELESS_CYGL_READ_SZ;
 
 	switch (CyGl->reads % 2) {
 	case 0:
 		//read into readBuffer1 on even reads
 		CyGl->readBuffer1Time = time;
+		CyGl->hasNewRead1 = 0; //not new until this read finishes
 
 		//request reading with G
 		if (write(CyGl->id, "G", 1) != 1) {
@@ -318,39 +292,21 @@ int getCyGlData(CyGl* CyGl, double time) {
 			return -1;
 		}
 
-		//get the reading, ensures its the most up to date
-		if (CyGl->WiredCyGl == 1) {
-
-			retval = select(CyGl->id + 1, &set, NULL, NULL, &timeout);
-			if (retval <= 0) {
+		//get the reading, ensures its the most up to date unless the read was given up on
+		do {
+			//whole reading, even if it arrives in pieces
+			if (readSerialFrame(CyGl->id, CyGl->readBuffer1, readSize * sizeof(uint8_t), CYGL_READ_TIMEOUT) == -1) {
 				//either error or timeout was reached
 				return -1;
-			} else {
-				do {
-					//read ready
-					read(CyGl->id, CyGl->readBuffer1, WIRED_CYGL_READ_SZ * sizeof(uint8_t));
-				} while (CyGlDataAvail(CyGl->id) != 0);
 			}
-
-		} else {
-
-			retval = select(CyGl->id + 1, &set, NULL, NULL, &timeout);
-			if (retval <= 0) {
-				//either error or timeout was reached
-				return -1;
-			} else {
-				do {
-					//read ready
-					read(CyGl->id, CyGl->readBuffer1, WIRELESS_CYGL_READ_SZ * sizeof(uint8_t));
-				} while (CyGlDataAvail(CyGl->id) != 0);
-			}
-		}
+		} while (CyGlDataAvail(CyGl->id) != 0 && !(CyGl->cancelled != NULL && *CyGl->cancelled));
 
 		CyGl->hasNewRead1 = 1;
 		break;
 	case 1:
 		//read into readBuffer2 on odd reads
 		CyGl->readBuffer2Time = time;
+		CyGl->hasNewRead2 = 0;
 
 		//request reading with G
 		if (write(CyGl->id, "G", 1) != 1) {
@@ -358,31 +314,13 @@ int getCyGlData(CyGl* CyGl, double time) {
 			return -1;
 		}
 
-		if (CyGl->WiredCyGl == 1) {
-			//wait 30000 for a first read
-			retval = select(CyGl->id + 1, &set, NULL, NULL, &timeout);
-			if (retval <= 0) {
-				//either error or timeout was reached
-				return -1;
-			} else {
-				do {
-					//read ready
-					read(CyGl->id, CyGl->readBuffer2, WIRED_CYGL_READ_SZ * sizeof(uint8_t));
-				} while (CyGlDataAvail(CyGl->id) != 0);
-			}
-		} else {
-			//wait 30000 for a first read
-			retval = select(CyGl->id + 1, &set, NULL, NULL, &timeout);
-			if (retval <= 0) {
+		do {
+			//whole reading, even if it arrives in pieces
+			if (readSerialFrame(CyGl->id, CyGl->readBuffer2, readSize * sizeof(uint8_t), CYGL_READ_TIMEOUT) == -1) {
 				//either error or timeout was reached
 				return -1;
-			} else {
-				do {
-					//read ready
-					read(CyGl->id, CyGl->readBuffer2, WIRELESS_CYGL_READ_SZ * sizeof(uint8_t));
-				} while (CyGlDataAvail(CyGl->id) != 0);
 			}
-		}
+		} while (CyGlDataAvail(CyGl->id) != 0 && !(CyGl->cancelled != NULL && *CyGl->cancelled));
 		CyGl->hasNewRead2 = 1;
 		break;
 	}
@@ -392,6 +330,8 @@ int getCyGlData(CyGl* CyGl, double time) {
 
 int updateCyGlRead(CyGl* CyGl) {
 
+	TRACE_SCOPE("updateCyGlRead");
+
 	switch(CyGl->bufferToUse) {
 	case 1:
 		CyGl->bufferToUse = 2;
@@ -445,11 +385,5 @@ void closeCyGl(CyGl* CyGl) {
 }
 
 int CyGlDataAvail(const int fd) {
-	int result;
-
-	if (ioctl(fd, FIONREAD, &result) == -1) {
-		return -1;
-	}
-
-	return result;
+	return serialBytesWaiting(fd);
 }
@@ -19,30 +19,42 @@
 #include <stdint.h>
 #include <sys/select.h>
 
+#include "CacheLine.h"
+#include "Serial.h"
 
 #define WIRED_CYGL_READ_SZ 24
 #define WIRELESS_CYGL_READ_SZ 20
+#define CYGL_FIRST_SENSOR 1 //reads echo the 'G' command byte before the sensor values
+#define CYGL_SENSORS 22 //sensors on a wired CyberGlove II
 #define CYGL_BAUD B115200
+#define CYGL_BAUDS {CYGL_BAUD} //wired glove rates to try, fastest first, once the glove is set faster add them here
+#define CYGL_PROBE_TIMEOUT 2000000 //us for the wired glove to answer at each rate
+#define CYGL_READ_TIMEOUT 24000 //us for a whole reading
 
 typedef struct {
 	int id;
+	const volatile int* cancelled; //set by a caller that gives up on reads, checked between a read's steps, NULL if none
 
-	int bufferToUse;
-	int hasNewRead1;
+	//each read buffer is filled by the collection thread on its own cache lines
+	int hasNewRead1 CACHE_ALIGNED;
 	uint8_t readBuffer1[WIRED_CYGL_READ_SZ];
 	double readBuffer1Time;
-	int hasNewRead2;
+	int hasNewRead2 CACHE_ALIGNED;
 	uint8_t readBuffer2[WIRED_CYGL_READ_SZ];
 	double readBuffer2Time;
 
+	//written by the thread calling updateCyGlRead
+	int bufferToUse CACHE_ALIGNED;
 	uint8_t read[WIRED_CYGL_READ_SZ];
 	double readTime;
 
 	int WiredCyGl; //1 if wired, 0 if wireless
+	speed_t baud; //rate the glove answered at
 
-	int reads;
 	int errors;
 	int consecutiveErrors;
+
+	int reads CACHE_ALIGNED; //counted by the collection thread
 } CyGl;
 
 /*
@@ -0,0 +1,261 @@
+/*
+ * Name: CyGlCalibration.c
+ * Author: Elijah Pivo
+ *
+ * Per subject CyberGlove II calibration.
+ */
+
+#include "CyGlCalibration.h"
+
+#define DEG (M_PI / 180)
+#define NOMINAL_GAIN (M_PI / 2 / 255) //0 to 90 degrees
+#define MIN_SPAN 4 //counts a sensor has to move between poses to be fit
+
+static const char* poseNames[CYGL_CALIBRATION_POSES] = {
+		"Lay your hand flat with the fingers and thumb together",
+		"Make a fist with the thumb wrapped over the fingers",
+		"Lay your hand flat and spread the fingers and thumb as far as they go",
+		"Hold your hand flat and bend the wrist down as far as it goes",
+		"Hold your hand flat and bend the wrist toward the thumb as far as it goes"
+};
+
+/*
+ * Known joint angles for each calibration pose, NAN where the pose
+ * doesn't pin a sensor down.
+ */
+static void poseAngles(int pose, float angles[CYGL_SENSORS]) {
+
+	const int mcp[4] = {KIN_INDEX_MCP, KIN_MIDDLE_MCP, KIN_RING_MCP, KIN_PINKY_MCP};
+
+	for (int i = 0; i < CYGL_SENSORS; i++) {
+		angles[i] = pose == 0 ? 0 : NAN;
+	}
+
+	switch (pose) {
+	case 1: //fist
+		angles[KIN_THUMB_ROLL] = 45;
+		angles[KIN_THUMB_MCP] = 40;
+		angles[KIN_THUMB_IP] = 60;
+		for (int f = 0; f < 4; f++) {
+			angles[mcp[f]] = 90;
+			angles[mcp[f] + 1] = 100;
+			angles[mcp[f] + 2] = 60;
+		}
+		angles[KIN_MIDDLE_INDEX_ABDUCTION] = 0;
+		angles[KIN_RING_MIDDLE_ABDUCTION] = 0;
+		angles[KIN_PINKY_RING_ABDUCTION] = 0;
+		angles[KIN_WRIST_PITCH] = 0;
+		angles[KIN_WRIST_YAW] = 0;
+		break;
+	case 2: //spread
+		angles[KIN_THUMB_ROLL] = 0;
+		angles[KIN_THUMB_ABDUCTION] = 60;
+		angles[KIN_MIDDLE_INDEX_ABDUCTION] = 15;
+		angles[KIN_RING_MIDDLE_ABDUCTION] = 15;
+		angles[KIN_PINKY_RING_ABDUCTION] = 20;
+		angles[KIN_WRIST_PITCH] = 0;
+		angles[KIN_WRIST_YAW] = 0;
+		break;
+	case 3: //wrist down
+		angles[KIN_WRIST_PITCH] = 70;
+		angles[KIN_WRIST_YAW] = 0;
+		break;
+	case 4: //wrist toward thumb
+		angles[KIN_WRIST_PITCH] = 0;
+		angles[KIN_WRIST_YAW] = 20;
+		break;
+	}
+
+	for (int i = 0; i < CYGL_SENSORS; i++) {
+		angles[i] *= DEG;
+	}
+}
+
+void defaultCyGlCalibration(CyGlCalibration* cal) {
+
+	for (int i = 0; i < CYGL_SENSORS; i++) {
+		cal->gain[i] = NOMINAL_GAIN;
+		cal->offset[i] = 0;
+	}
+	cal->couplings = 0;
+
+	buildCyGlTables(cal);
+}
+
+int loadCyGlCalibration(CyGlCalibration* cal, const char* file) {
+
+	defaultCyGlCalibration(cal);
+
+	FILE* inFile = fopen(file, "r");
+	if (inFile == NULL) {
+		fprintf(stderr, "CyGl Calibration ERROR: Couldn't open %s, using nominal calibration.\n", file);
+		return -1;
+	}
+
+	char line[128];
+	int target, source;
+	float gain, offset;
+
+	while (fgets(line, sizeof(line), inFile) != NULL) {
+		if (sscanf(line, "sensor %i %f %f", &target, &gain, &offset) == 3
+				&& target >= 0 && target < CYGL_SENSORS) {
+			cal->gain[target] = gain;
+			cal->offset[target] = offset;
+		} else if (sscanf(line, "couple %i %i %f", &target, &source, &gain) == 3
+				&& target >= 0 && target < CYGL_SENSORS && source >= 0 && source < CYGL_SENSORS
+				&& cal->couplings < CYGL_MAX_COUPLINGS) {
+			cal->coupleTarget[cal->couplings] = target;
+			cal->coupleSource[cal->couplings] = source;
+			cal->coupleGain[cal->couplings] = gain;
+			cal->couplings++;
+		}
+	}
+
+	fclose(inFile);
+	buildCyGlTables(cal);
+
+	return 1;
+}
+
+int saveCyGlCalibration(const CyGlCalibration* cal, const char* file) {
+
+	FILE* outFile = fopen(file, "w");
+	if (outFile == NULL) {
+		fprintf(stderr, "CyGl Calibration ERROR: Couldn't write %s.\n", file);
+		return -1;
+	}
+
+	fprintf(outFile, "# sensor <index> <gain rad/count> <offset counts>\n");
+	for (int i = 0; i < CYGL_SENSORS; i++) {
+		fprintf(outFile, "sensor %i %.9g %.9g\n", i, cal->gain[i], cal->offset[i]);
+	}
+	fprintf(outFile, "# couple <target> <source> <gain>\n");
+	for (int i = 0; i < cal->couplings; i++) {
+		fprintf(outFile, "couple %i %i %.9g\n", cal->coupleTarget[i], cal->coupleSource[i], cal->coupleGain[i]);
+	}
+
+	fclose(outFile);
+	return 1;
+}
+
+void buildCyGlTables(CyGlCalibration* cal) {
+
+	for (int i = 0; i < CYGL_SENSORS; i++) {
+		for (int raw = 0; raw < 256; raw++) {
+			cal->table[i][raw] = cal->gain[i] * (raw - cal->offset[i]);
+		}
+	}
+
+	//couplings work on the source sensor's calibrated angle
+	for (int c = 0; c < cal->couplings; c++) {
+		for (int raw = 0; raw < 256; raw++) {
+			cal->coupleTable[c][raw] = cal->coupleGain[c] * cal->table[cal->coupleSource[c]][raw];
+		}
+	}
+}
+
+int fitCyGlCalibration(CyGlCalibration* cal, const float poses[CYGL_CALIBRATION_POSES][CYGL_SENSORS]) {
+
+	float angles[CYGL_CALIBRATION_POSES][CYGL_SENSORS];
+	for (int p = 0; p < CYGL_CALIBRATION_POSES; p++) {
+		poseAngles(p, angles[p]);
+	}
+
+	int fit = 0;
+
+	for (int i = 0; i < CYGL_SENSORS; i++) {
+		//least squares line through the poses that pin this sensor down
+		double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+		float low = 256, high = -1;
+
+		for (int p = 0; p < CYGL_CALIBRATION_POSES; p++) {
+			if (isnan(angles[p][i])) {
+				continue;
+			}
+			n++;
+			sx += poses[p][i];
+			sy += angles[p][i];
+			sxx += poses[p][i] * poses[p][i];
+			sxy += poses[p][i] * angles[p][i];
+			low = poses[p][i] < low ? poses[p][i] : low;
+			high = poses[p][i] > high ? poses[p][i] : high;
+		}
+
+		if (n < 2 || high - low < MIN_SPAN) {
+			continue; //keep what it had
+		}
+
+		double gain = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+		double intercept = (sy - gain * sx) / n;
+
+		cal->gain[i] = gain;
+		cal->offset[i] = -intercept / gain;
+		fit++;
+	}
+
+	//thumb roll should read zero in the spread pose, whatever is left comes from abduction
+	float abduction = cal->gain[KIN_THUMB_ABDUCTION] * (poses[2][KIN_THUMB_ABDUCTION] - cal->offset[KIN_THUMB_ABDUCTION]);
+	float roll = cal->gain[KIN_THUMB_ROLL] * (poses[2][KIN_THUMB_ROLL] - cal->offset[KIN_THUMB_ROLL]);
+
+	if (fabsf(abduction) > 10 * DEG) {
+		int c;
+		for (c = 0; c < cal->couplings; c++) {
+			if (cal->coupleTarget[c] == KIN_THUMB_ROLL && cal->coupleSource[c] == KIN_THUMB_ABDUCTION) {
+				break;
+			}
+		}
+		if (c < CYGL_MAX_COUPLINGS) {
+			cal->coupleTarget[c] = KIN_THUMB_ROLL;
+			cal->coupleSource[c] = KIN_THUMB_ABDUCTION;
+			cal->coupleGain[c] = -roll / abduction;
+			if (c == cal->couplings) {
+				cal->couplings++;
+			}
+		}
+	}
+
+	buildCyGlTables(cal);
+
+	return fit;
+}
+
+int runCyGlCalibration(CyGl* CyGl, CyGlCalibration* cal) {
+
+	float poses[CYGL_CALIBRATION_POSES][CYGL_SENSORS];
+
+	for (int p = 0; p < CYGL_CALIBRATION_POSES; p++) {
+
+		fprintf(stderr, "Pose %i of %i: %s, then press enter.\n", p + 1, CYGL_CALIBRATION_POSES, poseNames[p]);
+		for (int c = getchar(); c != '\n' && c != EOF; c = getchar()) {}
+
+		for (int i = 0; i < CYGL_SENSORS; i++) {
+			poses[p][i] = 0;
+		}
+
+		int good = 0;
+		for (int r = 0; r < CYGL_CALIBRATION_READS; r++) {
+			getCyGlData(CyGl, r * .025);
+			if (updateCyGlRead(CyGl) == 1) {
+				for (int i = 0; i < CYGL_SENSORS; i++) {
+					poses[p][i] += CyGl->read[CYGL_FIRST_SENSOR + i];
+				}
+				good++;
+			}
+			usleep(25000);
+		}
+
+		if (good < CYGL_CALIBRATION_READS / 2) {
+			fprintf(stderr, "CyGl Calibration ERROR: Glove stopped responding.\n");
+			return -1;
+		}
+
+		for (int i = 0; i < CYGL_SENSORS; i++) {
+			poses[p][i] /= good;
+		}
+	}
+
+	int fit = fitCyGlCalibration(cal, poses);
+	fprintf(stderr, "Calibrated %i of %i sensors.\n", fit, CYGL_SENSORS);
+
+	return fit;
+}
@@ -0,0 +1,104 @@
+/*
+ * Name: CyGlCalibration.h
+ * Author: Elijah Pivo
+ *
+ * Per subject CyberGlove II calibration.
+ *
+ * Each sensor has a gain (radians per count) and an offset (counts),
+ * and a few sensors are corrected by a neighbouring sensor's angle
+ * (cross-coupling, e.g. thumb roll picks up thumb abduction). Loading a
+ * calibration builds a 256 entry table per sensor and per coupling so
+ * converting a read is only table lookups and adds.
+ *
+ * Calibration file format, one entry per line, '#' starts a comment:
+ * 	sensor <index> <gain> <offset>
+ * 	couple <target index> <source index> <gain>
+ */
+
+#ifndef CYGLCALIBRATION_H
+#define CYGLCALIBRATION_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "CyGl.h"
+#include "Kinematics.h"
+
+#define CYGL_MAX_COUPLINGS 8
+#define CYGL_CALIBRATION_POSES 5
+#define CYGL_CALIBRATION_READS 40 //reads averaged per pose, 1 second at 25ms
+
+typedef struct {
+	float gain[CYGL_SENSORS];
+	float offset[CYGL_SENSORS];
+
+	int couplings;
+	int coupleTarget[CYGL_MAX_COUPLINGS];
+	int coupleSource[CYGL_MAX_COUPLINGS];
+	float coupleGain[CYGL_MAX_COUPLINGS];
+
+	//built from the parameters above by buildCyGlTables()
+	float table[CYGL_SENSORS][256];
+	float coupleTable[CYGL_MAX_COUPLINGS][256];
+} CyGlCalibration;
+
+/*
+ * Nominal calibration: every sensor spread over 0 to 90 degrees,
+ * no cross-coupling. Builds the tables.
+ */
+void defaultCyGlCalibration(CyGlCalibration* cal);
+
+/*
+ * Loads a calibration file on top of the nominal calibration and
+ * builds the tables. Returns 1 if the file was read, -1 otherwise
+ * (the nominal calibration is left in place).
+ */
+int loadCyGlCalibration(CyGlCalibration* cal, const char* file);
+
+/*
+ * Writes a calibration file. Returns 1 if it was written, -1 otherwise.
+ */
+int saveCyGlCalibration(const CyGlCalibration* cal, const char* file);
+
+/*
+ * Rebuilds the lookup tables after the parameters have changed.
+ */
+void buildCyGlTables(CyGlCalibration* cal);
+
+/*
+ * Converts a CyGl read into joint angles in radians. Only table lookups.
+ */
+static inline void calibrateCyGlRead(const CyGlCalibration* cal,
+		const uint8_t read[WIRED_CYGL_READ_SZ], float angles[CYGL_SENSORS]) {
+
+	const uint8_t* sensor = &read[CYGL_FIRST_SENSOR];
+
+	for (int i = 0; i < CYGL_SENSORS; i++) {
+		angles[i] = cal->table[i][sensor[i]];
+	}
+	for (int i = 0; i < cal->couplings; i++) {
+		angles[cal->coupleTarget[i]] += cal->coupleTable[i][sensor[cal->coupleSource[i]]];
+	}
+}
+
+/*
+ * Fits gains and offsets from the average sensor values of the
+ * calibration poses (flat hand, fist, spread hand, wrist bent down,
+ * wrist bent toward the thumb, in that order). Sensors whose values
+ * barely changed between poses keep their current calibration. Also fits
+ * the thumb roll / thumb abduction coupling. Builds the tables. Returns
+ * the number of sensors fit.
+ */
+int fitCyGlCalibration(CyGlCalibration* cal, const float poses[CYGL_CALIBRATION_POSES][CYGL_SENSORS]);
+
+/*
+ * Walks the subject through the calibration poses on the terminal,
+ * averaging CYGL_CALIBRATION_READS reads per pose, then fits the
+ * calibration. Returns the number of sensors fit, -1 if the glove
+ * stopped responding.
+ */
+int runCyGlCalibration(CyGl* CyGl, CyGlCalibration* cal);
+
+#endif
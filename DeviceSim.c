@@ -0,0 +1,305 @@
+/*
+ * Name: DeviceSim.c
+ * Author: Elijah Pivo
+ *
+ * Simulated device timing and faults for the test devices.
+ */
+
+#include <errno.h>
+
+#include "DeviceSim.h"
+
+static const char* const SimDistributions[] = {"fixed", "normal", "tail", "bimodal"};
+#define SIM_DISTRIBUTIONS ((int) (sizeof(SimDistributions) / sizeof(SimDistributions[0])))
+
+static uint64_t splitMix(uint64_t* x);
+static double uniform(uint64_t* state);
+static double gaussian(uint64_t* state);
+static double drawLatency(DeviceSim* sim);
+static void waitUntil(const DeviceSim* sim, const struct timespec* start, double latency);
+static double elapsed(const struct timespec* start, const struct timespec* end);
+
+void defaultSimConfig(SimConfig* config, double latency, int spin) {
+
+	config->distribution = SIM_FIXED;
+	config->latency = latency;
+	config->jitter = 0;
+	config->shape = 1.5;
+	config->slow = latency;
+	config->slowProbability = 0;
+	config->failProbability = 0;
+	config->timeout = 0;
+	config->disconnectProbability = 0;
+	config->downTime = 0;
+	config->refuseProbability = 0;
+	config->seed = 1;
+	config->spin = spin;
+}
+
+int parseSimConfig(SimConfig* config, const char* spec) {
+
+	char copy[SIM_SPEC_SZ];
+
+	if (strlen(spec) >= SIM_SPEC_SZ) {
+		fprintf(stderr, "DeviceSim.c ERROR: Device spec is too long.\n");
+		return -1;
+	}
+	strcpy(copy, spec);
+
+	char* save;
+	for (char* token = strtok_r(copy, " \t", &save); token != NULL; token = strtok_r(NULL, " \t", &save)) {
+		char* value = strchr(token, '=');
+		if (value == NULL) {
+			fprintf(stderr, "DeviceSim.c ERROR: Expected key=value in device spec, got \"%s\".\n", token);
+			return -1;
+		}
+		*value++ = '\0';
+
+		if (strcmp(token, "dist") == 0) {
+			int d = 0;
+			while (d < SIM_DISTRIBUTIONS && strcmp(SimDistributions[d], value) != 0) {
+				d++;
+			}
+			if (d == SIM_DISTRIBUTIONS) {
+				fprintf(stderr, "DeviceSim.c ERROR: Unknown latency distribution \"%s\".\n", value);
+				return -1;
+			}
+			config->distribution = d;
+			continue;
+		}
+		if (strcmp(token, "wait") == 0) {
+			if (strcmp(value, "sleep") != 0 && strcmp(value, "spin") != 0) {
+				fprintf(stderr, "DeviceSim.c ERROR: Unknown wait \"%s\", use sleep or spin.\n", value);
+				return -1;
+			}
+			config->spin = strcmp(value, "spin") == 0;
+			continue;
+		}
+		if (strcmp(token, "seed") == 0) {
+			char* end;
+			config->seed = strtoul(value, &end, 10);
+			if (end == value || *end != '\0') {
+				fprintf(stderr, "DeviceSim.c ERROR: Bad seed \"%s\".\n", value);
+				return -1;
+			}
+			continue;
+		}
+
+		//the rest are numbers, times in s and probabilities
+		double* field;
+		int probability = 0;
+		if (strcmp(token, "latency") == 0) {
+			field = &config->latency;
+		} else if (strcmp(token, "jitter") == 0) {
+			field = &config->jitter;
+		} else if (strcmp(token, "shape") == 0) {
+			field = &config->shape;
+		} else if (strcmp(token, "slow") == 0) {
+			field = &config->slow;
+		} else if (strcmp(token, "timeout") == 0) {
+			field = &config->timeout;
+		} else if (strcmp(token, "down") == 0) {
+			field = &config->downTime;
+		} else if (strcmp(token, "slowp") == 0) {
+			field = &config->slowProbability;
+			probability = 1;
+		} else if (strcmp(token, "fail") == 0) {
+			field = &config->failProbability;
+			probability = 1;
+		} else if (strcmp(token, "disconnect") == 0) {
+			field = &config->disconnectProbability;
+			probability = 1;
+		} else if (strcmp(token, "refuse") == 0) {
+			field = &config->refuseProbability;
+			probability = 1;
+		} else {
+			fprintf(stderr, "DeviceSim.c ERROR: Unknown device spec key \"%s\".\n", token);
+			return -1;
+		}
+
+		char* end;
+		double number = strtod(value, &end);
+		if (end == value || *end != '\0' || !(number >= 0) || (probability && number > 1)) {
+			fprintf(stderr, "DeviceSim.c ERROR: Bad %s \"%s\".\n", token, value);
+			return -1;
+		}
+		*field = number;
+	}
+
+	if (config->distribution == SIM_TAIL && !(config->shape > 0)) {
+		fprintf(stderr, "DeviceSim.c ERROR: The tail shape has to be above 0.\n");
+		return -1;
+	}
+
+	return 1;
+}
+
+void initializeDeviceSim(DeviceSim* sim, const SimConfig* config, int instance) {
+
+	memset(sim, 0, sizeof(*sim));
+	sim->config = *config;
+	sim->configured = 1;
+	sim->connected = 1;
+
+	//splitmix spreads neighbouring seeds over the whole state
+	uint64_t x = config->seed + (uint64_t) instance * 0x9e3779b97f4a7c15ULL;
+	sim->state = splitMix(&x);
+	sim->reconnectState = splitMix(&x);
+}
+
+int simulateRead(DeviceSim* sim) {
+
+	const SimConfig* config = &sim->config;
+	sim->reads++;
+
+	//instant reads that can't fail (memory effect benchmarks) don't touch the clock
+	if (config->distribution == SIM_FIXED && config->latency == 0 && config->failProbability == 0
+			&& config->disconnectProbability == 0) {
+		return 1;
+	}
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	//decided in the same order every read, so a seed always gives the same run
+	int result = 1;
+	if (sim->connected && config->disconnectProbability > 0 && uniform(&sim->state) < config->disconnectProbability) {
+		sim->connected = 0;
+		sim->disconnects++;
+		sim->disconnectTime = start;
+	}
+	if (!sim->connected || (config->failProbability > 0 && uniform(&sim->state) < config->failProbability)) {
+		result = -1;
+	}
+	double latency = drawLatency(sim);
+	if (config->timeout > 0 && latency > config->timeout) {
+		result = -1; //timed out
+	}
+	if (result == -1) {
+		sim->failures++;
+		if (config->timeout > 0) {
+			latency = config->timeout;
+		}
+	}
+
+	if (latency > 0) {
+		waitUntil(sim, &start, latency);
+	}
+	sim->latencySum += latency;
+	sim->maxLatency = latency > sim->maxLatency ? latency : sim->maxLatency;
+
+	return result;
+}
+
+int simulateReconnect(DeviceSim* sim) {
+
+	if (sim->connected) {
+		return 1;
+	}
+
+	//refusals come from their own generator, reads don't depend on how often reconnecting was tried
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (elapsed(&sim->disconnectTime, &now) < sim->config.downTime
+			|| (sim->config.refuseProbability > 0 && uniform(&sim->reconnectState) < sim->config.refuseProbability)) {
+		sim->refused++;
+		return -1;
+	}
+
+	sim->connected = 1;
+	return 1;
+}
+
+void printDeviceSim(const DeviceSim* sim, const char* name, FILE* file) {
+
+	fprintf(file, "%s: %li reads, %li failed (%.2f%%), %li disconnects, %li reconnects refused, "
+			"latency %.2f ms mean, %.2f ms max\n", name, sim->reads, sim->failures,
+			sim->reads > 0 ? 100.0 * sim->failures / sim->reads : 0, sim->disconnects, sim->refused,
+			sim->reads > 0 ? sim->latencySum / sim->reads * 1000 : 0, sim->maxLatency * 1000);
+}
+
+static uint64_t splitMix(uint64_t* x) {
+
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/*
+ * Uniform in (0, 1], xorshift64*.
+ */
+static double uniform(uint64_t* state) {
+
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return ((x * 0x2545f4914f6cdd1dULL >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * Standard normal, Box-Muller (one of the pair is thrown away, draws stay in step).
+ */
+static double gaussian(uint64_t* state) {
+
+	double u = uniform(state);
+	double v = uniform(state);
+	return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static double drawLatency(DeviceSim* sim) {
+
+	const SimConfig* config = &sim->config;
+	double latency = config->latency;
+
+	switch (config->distribution) {
+	case SIM_FIXED:
+		return latency;
+	case SIM_NORMAL:
+		latency += config->jitter * gaussian(&sim->state);
+		break;
+	case SIM_TAIL:
+		//Pareto above 0, median jitter * (2^(1/shape) - 1), no upper bound
+		latency += config->jitter * (pow(uniform(&sim->state), -1 / config->shape) - 1);
+		break;
+	case SIM_BIMODAL:
+		if (uniform(&sim->state) < config->slowProbability) {
+			latency = config->slow;
+		}
+		latency += config->jitter * gaussian(&sim->state);
+		break;
+	}
+
+	if (latency > SIM_MAX_LATENCY) {
+		return SIM_MAX_LATENCY;
+	}
+	return latency > 0 ? latency : 0;
+}
+
+static void waitUntil(const DeviceSim* sim, const struct timespec* start, double latency) {
+
+	struct timespec target = *start;
+	long long nanoseconds = llround(latency * 1e9); //past 2.1 s for a 32 bit long
+	target.tv_sec += nanoseconds / 1000000000;
+	target.tv_nsec += nanoseconds % 1000000000;
+	if (target.tv_nsec >= 1000000000) {
+		target.tv_sec++;
+		target.tv_nsec -= 1000000000;
+	}
+
+	if (sim->config.spin) {
+		struct timespec now;
+		do {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+		} while (elapsed(&now, &target) > 0);
+	} else {
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL) == EINTR) {}
+	}
+}
+
+static double elapsed(const struct timespec* start, const struct timespec* end) {
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) * .000000001;
+}
@@ -0,0 +1,121 @@
+/*
+ * Name: DeviceSim.h
+ * Author: Elijah Pivo
+ *
+ * Simulated device timing and faults for the test devices (quickDevice,
+ * slowDevice), so the harnesses see the delays and failures real sensors
+ * have and the error recovery paths get exercised off the Pi.
+ *
+ * Each read takes a latency drawn from a distribution:
+ * 	fixed	latency every read
+ * 	normal	latency + jitter * N(0, 1), never below 0
+ * 	tail	latency + jitter * a Pareto (shape) delay, mostly near latency
+ * 		with rare reads many times longer
+ * 	bimodal	normal around latency, or around slow with probability slowp
+ * A read fails (no new data) with probability fail, and the device drops
+ * off with probability disconnect. A disconnected device fails every read
+ * until it's reconnected, which is refused until it has been down for
+ * down seconds and then with probability refuse. When timeout is set a
+ * read drawn longer than it times out (fails), and failed reads take
+ * timeout rather than the drawn latency; set it with a tail, whose
+ * longest reads otherwise only stop at SIM_MAX_LATENCY.
+ *
+ * Draws come from a generator seeded by seed, so a run with the same spec
+ * (and the same devices started in the same order) sees the same delays
+ * and faults, e.g. to reproduce a failure seen in the field.
+ *
+ * Spec, space separated key=value pairs:
+ * 	dist=fixed|normal|tail|bimodal latency=.024 jitter=.002 shape=1.5
+ * 	slow=.1 slowp=.05 fail=.01 timeout=.1 disconnect=.0001 down=2
+ * 	refuse=.5 seed=1 wait=sleep|spin
+ */
+
+#ifndef DEVICESIM_H
+#define DEVICESIM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define SIM_SPEC_SZ 256
+#define SIM_MAX_LATENCY 3600 //s, longest a read is drawn, a tail draw can be far past any time a clock holds
+
+typedef enum {
+	SIM_FIXED,
+	SIM_NORMAL,
+	SIM_TAIL,
+	SIM_BIMODAL
+} SimDistribution;
+
+typedef struct {
+	SimDistribution distribution;
+	double latency; //s, a read's usual time
+	double jitter; //s, spread around latency (and slow)
+	double shape; //tail's Pareto shape, smaller is a longer tail
+	double slow; //s, bimodal's second mode
+	double slowProbability;
+	double failProbability; //per read
+	double timeout; //s before a read fails and how long a failed read takes, 0 for none
+	double disconnectProbability; //per read
+	double downTime; //s a disconnected device refuses to reconnect
+	double refuseProbability; //per reconnect after downTime
+	unsigned long seed;
+	int spin; //1 to busy wait out a read, 0 to sleep
+} SimConfig;
+
+typedef struct {
+	SimConfig config;
+	int configured;
+	uint64_t state; //random generator for reads
+	uint64_t reconnectState; //and for reconnects
+
+	int connected;
+	struct timespec disconnectTime;
+
+	long reads;
+	long failures; //failed reads, disconnected ones included
+	long disconnects;
+	long refused; //reconnects refused
+	double latencySum; //s
+	double maxLatency; //s
+} DeviceSim;
+
+/*
+ * Fills config with fixed reads of latency s that never fail, waited out
+ * by sleeping or, if spin is 1, busy waiting. Seed 1.
+ */
+void defaultSimConfig(SimConfig* config, double latency, int spin);
+
+/*
+ * Changes config by a spec (see above), keys left out keep their value.
+ * Returns 1 if the spec was understood, -1 (with a message on stderr) if not.
+ */
+int parseSimConfig(SimConfig* config, const char* spec);
+
+/*
+ * Sets up a simulated device from config, connected, its generator seeded
+ * with config->seed + instance (so devices sharing a spec differ).
+ */
+void initializeDeviceSim(DeviceSim* sim, const SimConfig* config, int instance);
+
+/*
+ * Simulates a read: waits out its latency and returns 1 if it succeeded,
+ * -1 if it failed or the device is disconnected.
+ */
+int simulateRead(DeviceSim* sim);
+
+/*
+ * Simulates reconnecting. Returns 1 if the device is connected again,
+ * -1 if it refused. The generator and counts carry on.
+ */
+int simulateReconnect(DeviceSim* sim);
+
+/*
+ * Prints reads, failures, disconnects and latencies of a simulated device.
+ */
+void printDeviceSim(const DeviceSim* sim, const char* name, FILE* file);
+
+#endif
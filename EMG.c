@@ -6,22 +6,228 @@
  */
 
 #include "EMG.h"
+#include "Trace.h"
+
+#define EMG_SPEC_SZ 256
+
+typedef struct {
+	const char* name;
+	uint8_t range;
+	float fullScale; //V
+} EMGRange;
+
+static const EMGRange EMGRanges[] = {
+		{"SE", SE_10_00V, 10},
+		{"BP20", BP_20_00V, 20}, {"BP10", BP_10_00V, 10}, {"BP5", BP_5_00V, 5}, {"BP4", BP_4_00V, 4},
+		{"BP2.5", BP_2_50V, 2.5}, {"BP2", BP_2_00V, 2}, {"BP1.25", BP_1_25V, 1.25}, {"BP1", BP_1_00V, 1}
+};
+#define EMG_RANGES ((int) (sizeof(EMGRanges) / sizeof(EMGRanges[0])))
+
+static int scanEMG(EMG* EMG, signed short* buffer);
+static int findEMGRange(const char* name);
+static int checkEMGConfig(const EMGConfig* config, int* differential, int* samplesPerRead);
+
+void defaultEMGConfig(EMGConfig* config) {
+
+	config->channels = EMG_DEFAULT_CHANNELS;
+	for (int i = 0; i < EMG_MAX_CHANNELS; i++) {
+		config->channel[i] = i;
+		config->range[i] = SE_10_00V;
+	}
+	config->scanRate = EMG_DEFAULT_SCAN_RATE;
+	config->blockTime = EMG_DEFAULT_BLOCK_TIME;
+}
+
+int parseEMGConfig(EMGConfig* config, const char* spec) {
+
+	char copy[EMG_SPEC_SZ];
+	int ranges = 0;
+
+	if (strlen(spec) >= EMG_SPEC_SZ) {
+		fprintf(stderr, "EMG.c ERROR: EMG spec is too long.\n");
+		return -1;
+	}
+	strcpy(copy, spec);
+
+	char* save;
+	for (char* token = strtok_r(copy, " \t", &save); token != NULL; token = strtok_r(NULL, " \t", &save)) {
+		char* value = strchr(token, '=');
+		if (value == NULL) {
+			fprintf(stderr, "EMG.c ERROR: Expected key=value in EMG spec, got \"%s\".\n", token);
+			return -1;
+		}
+		*value++ = '\0';
+
+		char* end;
+		if (strcmp(token, "channels") == 0) {
+			config->channels = 0;
+			for (char* p = value; *p != '\0'; p = *end == ',' ? end + 1 : end) {
+				long channel = strtol(p, &end, 10);
+				if (end == p || channel < 0 || channel >= EMG_MAX_CHANNELS || config->channels == EMG_MAX_CHANNELS) {
+					fprintf(stderr, "EMG.c ERROR: Bad EMG channel list \"%s\".\n", value);
+					return -1;
+				}
+				config->channel[config->channels++] = channel;
+			}
+		} else if (strcmp(token, "ranges") == 0) {
+			char* next;
+			for (char* p = strtok_r(value, ",", &next); p != NULL; p = strtok_r(NULL, ",", &next)) {
+				int range = findEMGRange(p);
+				if (range == -1 || ranges == EMG_MAX_CHANNELS) {
+					fprintf(stderr, "EMG.c ERROR: Unknown EMG range \"%s\".\n", p);
+					return -1;
+				}
+				config->range[ranges++] = EMGRanges[range].range;
+			}
+		} else if (strcmp(token, "rate") == 0) {
+			config->scanRate = strtof(value, &end);
+			if (end == value || *end != '\0') {
+				fprintf(stderr, "EMG.c ERROR: Bad EMG scan rate \"%s\".\n", value);
+				return -1;
+			}
+		} else if (strcmp(token, "block") == 0) {
+			config->blockTime = strtod(value, &end);
+			if (end == value || *end != '\0') {
+				fprintf(stderr, "EMG.c ERROR: Bad EMG block time \"%s\".\n", value);
+				return -1;
+			}
+		} else {
+			fprintf(stderr, "EMG.c ERROR: Unknown EMG spec key \"%s\".\n", token);
+			return -1;
+		}
+	}
+
+	//one range is for every channel
+	if (ranges == 1) {
+		for (int i = 1; i < EMG_MAX_CHANNELS; i++) {
+			config->range[i] = config->range[0];
+		}
+	} else if (ranges > 1 && ranges != config->channels) {
+		fprintf(stderr, "EMG.c ERROR: %i EMG ranges for %i channels.\n", ranges, config->channels);
+		return -1;
+	}
+
+	return 1;
+}
+
+size_t EMGBufferSize(const EMGConfig* config) {
+
+	//configureEMG checks the config, this only has to size it
+	if (config->channels < 1 || config->channels > EMG_MAX_CHANNELS
+			|| !(config->scanRate > 0 && config->scanRate <= EMG_MAX_SCAN_RATE)
+			|| !(config->blockTime > 0 && config->blockTime <= EMG_MAX_BLOCK_TIME)) {
+		return 0;
+	}
+
+	size_t values = (size_t) lround(config->blockTime * config->scanRate / config->channels) * config->channels;
+	size_t counts = (values * sizeof(signed short) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+	size_t volts = (values * sizeof(float) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+	return 3 * counts + volts;
+}
+
+int configureEMG(EMG* EMG, const EMGConfig* config, Arena* Arena) {
+
+	int differential, samplesPerRead;
+	if (checkEMGConfig(config, &differential, &samplesPerRead) != 1) {
+		return -1;
+	}
+
+	EMG->config = *config;
+	EMG->differential = differential;
+	EMG->samplesPerRead = samplesPerRead;
+	EMG->readSize = samplesPerRead * config->channels;
+	EMG->sampleTime = config->channels / config->scanRate;
+
+	//the driver's conversion is linear, two points give each channel's gain and offset
+	EMGCalibration* cal = &EMG->calibration;
+	cal->channels = config->channels;
+	cal->sampleTime = EMG->sampleTime;
+	for (int i = 0; i < config->channels; i++) {
+		float zero = differential ? volts_1408FS(config->range[i], 0) : volts_1408FS_SE(0);
+		float top = differential ? volts_1408FS(config->range[i], 0x1fff) : volts_1408FS_SE(0x1fff);
+		cal->channel[i] = config->channel[i];
+		cal->range[i] = config->range[i];
+		cal->fullScale[i] = EMGFullScale(EMG, i);
+		cal->gain[i] = (top - zero) / 0x1fff;
+		cal->offset[i] = zero;
+	}
+
+	//sized once, the buffers live for the whole session
+	if (Arena != NULL) {
+		EMG->readBuffer1 = arenaAlloc(Arena, EMG->readSize * sizeof(signed short), 0);
+		EMG->readBuffer2 = arenaAlloc(Arena, EMG->readSize * sizeof(signed short), 0);
+		EMG->read = arenaAlloc(Arena, EMG->readSize * sizeof(signed short), 0);
+		EMG->volts = arenaAlloc(Arena, EMG->readSize * sizeof(float), 0);
+	} else {
+		EMG->readBuffer1 = calloc(EMG->readSize, sizeof(signed short));
+		EMG->readBuffer2 = calloc(EMG->readSize, sizeof(signed short));
+		EMG->read = calloc(EMG->readSize, sizeof(signed short));
+		EMG->volts = calloc(EMG->readSize, sizeof(float));
+	}
+	if (EMG->readBuffer1 == NULL || EMG->readBuffer2 == NULL || EMG->read == NULL || EMG->volts == NULL) {
+		fprintf(stderr, "EMG.c ERROR: Couldn't allocate read buffers.\n");
+		EMG->read = NULL;
+		return -1;
+	}
+
+	return 1;
+}
+
+void printEMGConfig(const EMG* EMG, FILE* file) {
+
+	fprintf(file, "EMG: %.0f S/s over %i %s channels (%.0f Hz each), %.0f ms blocks of %i scans\n",
+			EMG->config.scanRate, EMG->config.channels, EMG->differential ? "differential" : "single ended",
+			1 / EMG->sampleTime, EMG->samplesPerRead * EMG->sampleTime * 1000, EMG->samplesPerRead);
+	for (int i = 0; i < EMG->config.channels; i++) {
+		fprintf(file, "\tchannel %i: +-%g V\n", EMG->config.channel[i], EMGFullScale(EMG, i));
+	}
+}
+
+float EMGVolts(const EMG* EMG, int index, signed short value) {
+	return EMG->calibration.offset[index] + EMG->calibration.gain[index] * value;
+}
+
+const float* readEMGVolts(EMG* EMG) {
+
+	if (!EMG->hasVolts) {
+		countsToVolts(&EMG->calibration, EMG->read, EMG->samplesPerRead, EMG->volts);
+		EMG->hasVolts = 1;
+	}
+	return EMG->volts;
+}
+
+float EMGFullScale(const EMG* EMG, int index) {
+
+	for (int r = 0; r < EMG_RANGES; r++) {
+		if (EMGRanges[r].range == EMG->config.range[index]) {
+			return EMGRanges[r].fullScale;
+		}
+	}
+	return 0;
+}
 
 int initializeEMG(EMG* EMG) {
 
 	EMG->id = -1;
 	EMG->udev = NULL;
+	EMG->cancelled = NULL;
 	EMG->hasNewRead1 = 0;
 	EMG->hasNewRead2 = 0;
 	EMG->bufferToUse = 2;
-	for (int i = 0; i < EMG_READ_SZ; i++) {
+	EMG->reads = 0;
+	EMG->errors = 0;
+	EMG->consecutiveErrors = 0;
+
+	if (EMG->read == NULL) {
+		fprintf(stderr, "EMG.c ERROR: EMG isn't configured.\n");
+		return -1;
+	}
+	for (int i = 0; i < EMG->readSize; i++) {
 		EMG->readBuffer1[i] = 0;
 		EMG->readBuffer2[i] = 0;
 		EMG->read[i] = 0;
 	}
-	EMG->reads = 0;
-	EMG->errors = 0;
-	EMG->consecutiveErrors = 0;
+	EMG->hasVolts = 0;
 
 	if (libusb_init(NULL) < 0) {
 		fprintf(stderr, "EMG.c ERROR: Failed to initialize libusb.\n");
@@ -53,6 +259,14 @@ int initializeEMG(EMG* EMG) {
 	usbDOut_USB1408FS(EMG->udev, DIO_PORTA, 0);
 	usbDOut_USB1408FS(EMG->udev, DIO_PORTA, 0);
 
+	//scans follow the queue, a channel and range pair per entry
+	uint8_t queue[2 * EMG_MAX_CHANNELS];
+	for (int i = 0; i < EMG->config.channels; i++) {
+		queue[2 * i] = EMG->config.channel[i];
+		queue[2 * i + 1] = EMG->config.range[i];
+	}
+	usbALoadQueue_USB1408FS(EMG->udev, EMG->config.channels, queue);
+
 	EMG->id = 1;
 
 	return EMG->id;
@@ -98,28 +312,32 @@ int restartEMG(EMG* EMG) {
 }
 
 int getEMGData(EMG* EMG, double time) {
+	TRACE_SCOPE("getEMGData");
+
 	struct timeval start, end;
 	gettimeofday(&start, NULL);
 
-	float freq = 8000;
-	int count = EMG_READS_PER_CYCLE * EMG_READ_SZ;
-	uint8_t options = AIN_EXECUTION | AIN_GAIN_QUEUE;
-
 	EMG->reads++;
 
 	switch (EMG->reads % 2) {
 	case 0:
 		//read into readBuffer1 on even reads
 		EMG->readBuffer1Time = time;
+		EMG->hasNewRead1 = 0; //not new until this read finishes
 
 		usbAInStop_USB1408FS(EMG->udev);
 
-		if (usbAInScan_USB1408FS_SE(EMG->udev, 0, 0, count, &freq, options, EMG->readBuffer1)
-				!= 0) {
+		//a block can't be cut short once it's started, don't start one that's been given up on
+		if (EMG->cancelled != NULL && *EMG->cancelled) {
+			return -1;
+		}
+
+		if (scanEMG(EMG, EMG->readBuffer1) != 0) {
 
 			//ensure method takes precisely 25ms even if error occurs
 			gettimeofday(&end, NULL);
-			while ((end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) * .000001 <= CYCLE_TIME) {
+			while ((end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) * .000001 <= EMG->config.blockTime
+					&& !(EMG->cancelled != NULL && *EMG->cancelled)) {
 				gettimeofday(&end, NULL);
 			}
 
@@ -131,15 +349,20 @@ int getEMGData(EMG* EMG, double time) {
 	case 1:
 		//read into readBuffer2 on odd reads
 		EMG->readBuffer2Time = time;
+		EMG->hasNewRead2 = 0;
 
 		usbAInStop_USB1408FS(EMG->udev);
 
-		if (usbAInScan_USB1408FS_SE(EMG->udev, 0, 0, count, &freq, options, EMG->readBuffer2)
-				!= 0) { //need to check error handling here
+		if (EMG->cancelled != NULL && *EMG->cancelled) {
+			return -1;
+		}
+
+		if (scanEMG(EMG, EMG->readBuffer2) != 0) { //need to check error handling here
 
 			//ensure method takes precisely 25ms even if error occurs
 			gettimeofday(&end, NULL);
-			while ((end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) * .000001 <= CYCLE_TIME) {
+			while ((end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) * .000001 <= EMG->config.blockTime
+					&& !(EMG->cancelled != NULL && *EMG->cancelled)) {
 				gettimeofday(&end, NULL);
 			}
 
@@ -156,16 +379,16 @@ int getEMGData(EMG* EMG, double time) {
 
 int updateEMGRead(EMG* EMG) {
 
+	TRACE_SCOPE("updateEMGRead");
+
 	switch(EMG->bufferToUse) {
 	case 1:
 		EMG->bufferToUse = 2;
 		EMG->readTime = EMG->readBuffer1Time;
 		if (EMG->hasNewRead1 == 1) {
-			//New data available
-			//convert to voltage (float) for read data
-			for (int i = 0; i < EMG_READ_SZ * EMG_READS_PER_CYCLE; i++) {
-				EMG->read[i] = volts_1408FS_SE(EMG->readBuffer1[i]);
-			}
+			//New data available, counts are converted only if they're asked for in volts
+			memcpy(EMG->read, EMG->readBuffer1, EMG->readSize * sizeof(signed short));
+			EMG->hasVolts = 0;
 			EMG->consecutiveErrors = 0;
 			EMG->hasNewRead1 = 0;
 			return 1;
@@ -176,10 +399,8 @@ int updateEMGRead(EMG* EMG) {
 		EMG->readTime = EMG->readBuffer2Time;
 		if (EMG->hasNewRead2 == 1) {
 			//new data available
-			//convert to voltage (float) for read data
-			for (int i = 0; i < EMG_READ_SZ * EMG_READS_PER_CYCLE; i++) {
-				EMG->read[i] = volts_1408FS_SE(EMG->readBuffer2[i]);
-			}
+			memcpy(EMG->read, EMG->readBuffer2, EMG->readSize * sizeof(signed short));
+			EMG->hasVolts = 0;
 			EMG->consecutiveErrors = 0;
 			EMG->hasNewRead2 = 0;
 			return 1;
@@ -211,13 +432,85 @@ void closeEMG(EMG* EMG) {
 	EMG->hasNewRead1 = 0;
 	EMG->hasNewRead2 = 0;
 	EMG->bufferToUse = 2;
-	for (int i = 0; i < EMG_READ_SZ * EMG_READS_PER_CYCLE; i++) {
-		EMG->readBuffer1[i] = 0;
-		EMG->readBuffer2[i] = 0;
-		EMG->read[i] = 0;
+	if (EMG->read != NULL) {
+		for (int i = 0; i < EMG->readSize; i++) {
+			EMG->readBuffer1[i] = 0;
+			EMG->readBuffer2[i] = 0;
+			EMG->read[i] = 0;
+		}
+		EMG->hasVolts = 0;
 	}
 	EMG->reads = 0;
 	EMG->errors = 0;
 	EMG->consecutiveErrors = 0;
 
 }
+
+/*
+ * Reads a block into buffer, channels and ranges come from the queue loaded
+ * by initializeEMG. Returns 0 if succeeded, the driver's error otherwise.
+ */
+static int scanEMG(EMG* EMG, signed short* buffer) {
+
+	float freq = EMG->config.scanRate;
+	uint8_t options = AIN_EXECUTION | AIN_GAIN_QUEUE;
+
+	if (EMG->differential) {
+		return usbAInScan_USB1408FS(EMG->udev, 0, 0, EMG->readSize, &freq, options, buffer);
+	}
+	return usbAInScan_USB1408FS_SE(EMG->udev, 0, 0, EMG->readSize, &freq, options, buffer);
+}
+
+static int findEMGRange(const char* name) {
+
+	for (int r = 0; r < EMG_RANGES; r++) {
+		if (strcmp(EMGRanges[r].name, name) == 0) {
+			return r;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Checks config can be run. Sets whether its channels are differential
+ * pairs and the scans in a block. Returns 1 if it can, -1 (with a message
+ * on stderr) if not.
+ */
+static int checkEMGConfig(const EMGConfig* config, int* differential, int* samplesPerRead) {
+
+	if (config->channels < 1 || config->channels > EMG_MAX_CHANNELS) {
+		fprintf(stderr, "EMG.c ERROR: %i EMG channels, the device has 1 to %i.\n", config->channels, EMG_MAX_CHANNELS);
+		return -1;
+	}
+
+	//the whole queue is single ended or differential, single ended only has the one range
+	*differential = config->range[0] != SE_10_00V;
+	for (int i = 0; i < config->channels; i++) {
+		if ((config->range[i] != SE_10_00V) != *differential) {
+			fprintf(stderr, "EMG.c ERROR: EMG channels can't mix single ended and differential ranges.\n");
+			return -1;
+		}
+		if (config->channel[i] >= (*differential ? EMG_MAX_DIFFERENTIAL_CHANNELS : EMG_MAX_CHANNELS)) {
+			fprintf(stderr, "EMG.c ERROR: No EMG channel %i in %s mode.\n", config->channel[i],
+					*differential ? "differential" : "single ended");
+			return -1;
+		}
+	}
+
+	if (!(config->scanRate > 0 && config->scanRate <= EMG_MAX_SCAN_RATE)) {
+		fprintf(stderr, "EMG.c ERROR: EMG scan rate %.0f S/s, the device does up to %i.\n", config->scanRate, EMG_MAX_SCAN_RATE);
+		return -1;
+	}
+	if (!(config->blockTime > 0 && config->blockTime <= EMG_MAX_BLOCK_TIME)) {
+		fprintf(stderr, "EMG.c ERROR: EMG block time %f s, has to be up to %f s.\n", config->blockTime, EMG_MAX_BLOCK_TIME);
+		return -1;
+	}
+
+	*samplesPerRead = lround(config->blockTime * config->scanRate / config->channels);
+	if (*samplesPerRead < 1) {
+		fprintf(stderr, "EMG.c ERROR: EMG blocks of %f s at %.0f S/s hold no scans.\n", config->blockTime, config->scanRate);
+		return -1;
+	}
+
+	return 1;
+}
@@ -3,6 +3,22 @@
  * Author: Elijah Pivo
  *
  * EMG MCC-DAQ USB1408FS interface
+ *
+ * The channels, their ranges, the aggregate scan rate and the length of a
+ * block are chosen when the session starts (EMGConfig). configureEMG sizes
+ * the read buffers from them once, so a session can trade channels for
+ * rate or block length for latency without recompiling:
+ * 	8 channels, 8000 S/s, 200ms blocks: 1kHz a channel, 1600 values a read
+ * 	4 channels, 16000 S/s, 200ms blocks: 4kHz a channel
+ * 	8 channels, 8000 S/s, 50ms blocks: feedback every 50ms
+ *
+ * The channel list and ranges are loaded into the device's gain queue, a
+ * block holds samplesPerRead scans of config.channels values, in queue order.
+ *
+ * Blocks stay in counts (signed shorts, as the device gives them) through
+ * read, the files and the session store. configureEMG works out each
+ * channel's calibration (see EMGCalibration.h) from the driver, and
+ * readEMGVolts converts the newest read only when something asks for volts.
  */
 
 #ifndef EMG_H
@@ -10,40 +26,128 @@
 
 #include <pthread.h>
 #include <string.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <math.h>
 #include <sys/time.h>
 #include <stdio.h>
 
+#include "CacheLine.h"
+#include "Arena.h"
+#include "EMGCalibration.h"
+
 //mcc-daq driver includes
 #include "/home/pi/mcc-libusb/pmd.h"
 #include "/home/pi/mcc-libusb/usb-1408FS.h"
 
-#define EMG_READS_PER_CYCLE 200 //number of reads we need in 200ms
-#define EMG_READ_SZ 8    //number of channels we read from
-#define CYCLE_TIME .2 //in seconds
+#define EMG_MAX_CHANNELS 8 //single ended, differential pairs are channels 0-3
+#define EMG_MAX_DIFFERENTIAL_CHANNELS 4
+#define EMG_MAX_SCAN_RATE 48000 //S/s over all channels
+#define EMG_MAX_BLOCK_TIME 1.0 //s
+
+//default session, 8 single ended channels at 1kHz in 200ms blocks
+#define EMG_DEFAULT_CHANNELS 8
+#define EMG_DEFAULT_SCAN_RATE 8000
+#define EMG_DEFAULT_BLOCK_TIME .2
+
+typedef struct {
+	int channels; //entries in the gain queue
+	uint8_t channel[EMG_MAX_CHANNELS]; //in the order they're scanned
+	uint8_t range[EMG_MAX_CHANNELS]; //SE_10_00V, or a BP_ range for a differential pair
+	float scanRate; //S/s over all channels
+	double blockTime; //s of samples in a read
+} EMGConfig;
 
 typedef struct  {
 	int id;
 	libusb_device_handle *udev;
-
-	int bufferToUse;
-	int hasNewRead1;
-	signed short readBuffer1[EMG_READ_SZ * EMG_READS_PER_CYCLE];
+	const volatile int* cancelled; //set by a caller that gives up on reads, checked between a read's steps, NULL if none
+
+	//session layout, set once by configureEMG
+	EMGConfig config;
+	int differential; //1 if the channels are differential pairs, all channels share the mode
+	int samplesPerRead; //scans in a block
+	int readSize; //values in a block, samplesPerRead * config.channels
+	double sampleTime; //s between the scans of a block
+	EMGCalibration calibration; //counts to volts, per channel
+
+	//each read buffer is filled by the collection thread on its own cache lines
+	int hasNewRead1 CACHE_ALIGNED;
+	signed short* readBuffer1;
 	double readBuffer1Time;
-	int hasNewRead2;
-	signed short readBuffer2[EMG_READ_SZ * EMG_READS_PER_CYCLE];
+	int hasNewRead2 CACHE_ALIGNED;
+	signed short* readBuffer2;
 	double readBuffer2Time;
 
-	float read[EMG_READ_SZ * EMG_READS_PER_CYCLE];
+	//written by the thread calling updateEMGRead
+	int bufferToUse CACHE_ALIGNED;
+	signed short* read; //counts
 	double readTime;
+	float* volts; //read in volts, filled by readEMGVolts
+	int hasVolts;
 
-	int reads;
 	int errors;
 	int consecutiveErrors;
+
+	int reads CACHE_ALIGNED; //counted by the collection thread
 } EMG;
 
 /*
- * Sets up an EMG.
+ * Fills config with the default session, 8 single ended channels at
+ * EMG_DEFAULT_SCAN_RATE in EMG_DEFAULT_BLOCK_TIME blocks.
+ */
+void defaultEMGConfig(EMGConfig* config);
+
+/*
+ * Changes config by a spec of space separated key=value pairs, keys left
+ * out keep their value:
+ * 	channels=0,1,2,3 (scanned in this order)
+ * 	ranges=SE or BP20, BP10, BP5, BP4, BP2.5, BP2, BP1.25, BP1 (one for
+ * 		all channels, or one per channel)
+ * 	rate=16000 (S/s over all channels)
+ * 	block=.05 (s)
+ * Returns 1 if the spec was understood, -1 (with a message on stderr) if not.
+ */
+int parseEMGConfig(EMGConfig* config, const char* spec);
+
+/*
+ * Returns the bytes configureEMG takes from an arena for config.
+ */
+size_t EMGBufferSize(const EMGConfig* config);
+
+/*
+ * Checks config against the device and sizes the read buffers from it.
+ * Buffers come from Arena, or the heap if Arena is NULL. Called once
+ * before the EMG is first initialized, the layout then holds through
+ * reconnects. Returns 1 if succeeded, -1 if config can't be run or the
+ * buffers couldn't be allocated.
+ */
+int configureEMG(EMG* EMG, const EMGConfig* config, Arena* Arena);
+
+/*
+ * Prints the channels, ranges and rates in use.
+ */
+void printEMGConfig(const EMG* EMG, FILE* file);
+
+/*
+ * Converts a count read from the index-th channel of the queue to volts.
+ */
+float EMGVolts(const EMG* EMG, int index, signed short value);
+
+/*
+ * Returns the newest read in volts. It's converted (countsToVolts) the
+ * first time it's asked for after updateEMGRead, so only the thread
+ * calling updateEMGRead may call this.
+ */
+const float* readEMGVolts(EMG* EMG);
+
+/*
+ * Returns the full scale (V, +-) of the index-th channel of the queue.
+ */
+float EMGFullScale(const EMG* EMG, int index);
+
+/*
+ * Sets up an EMG and loads its gain queue.
  * Ensures its ready to collect data from.
  * Returns 1 if initialization succeeded, -1 if it failed
  */
@@ -69,15 +173,15 @@ int startEMG(EMG* EMG);
 int restartEMG(EMG* EMG);
 
 /*
- * Reads data from an EMG. Alternates between
+ * Reads a block from an EMG. Alternates between
  * putting data in readBuffer1 and readBuffer2.
  * Returns 1 if the read succeeded, -1 if it failed.
  */
 int getEMGData(EMG* EMG, double time);
 
 /*
- * Updates the most recent read. Alternates between
- * updating read from readBuffer1 and readBuffer2.
+ * Updates the most recent read (counts, copied as they are). Alternates
+ * between updating read from readBuffer1 and readBuffer2.
  * Needs to be called before accessing an EMG read
  * information. Also updates the error
  * and consecutiveError fields. Returns 1 if update
@@ -86,7 +190,7 @@ int getEMGData(EMG* EMG, double time);
 int updateEMGRead(EMG* EMG);
 
 /*
- * Ends a session with an EMG.
+ * Ends a session with an EMG. The layout and buffers are kept.
  */
 void closeEMG(EMG* EMG);
 
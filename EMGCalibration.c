@@ -0,0 +1,114 @@
+/*
+ * Name: EMGCalibration.c
+ * Author: Elijah Pivo
+ *
+ * Count to volt calibration of the EMG channels.
+ */
+
+#include <math.h>
+
+#include "EMGCalibration.h"
+
+#define EMG_CALIBRATION_ROW (EMG_CALIBRATION_ROW_SCANS * EMG_CALIBRATION_MAX_CHANNELS)
+
+void countsToVolts(const EMGCalibration* cal, const signed short* restrict counts, int scans, float* restrict volts) {
+
+	//the channel pattern repeats every scan, spread over a row of scans it lines up with the block
+	int channels = cal->channels;
+	int rowLength = EMG_CALIBRATION_ROW_SCANS * channels;
+	float gain[EMG_CALIBRATION_ROW], offset[EMG_CALIBRATION_ROW];
+	for (int i = 0; i < rowLength; i++) {
+		gain[i] = cal->gain[i % channels];
+		offset[i] = cal->offset[i % channels];
+	}
+
+	int length = scans * channels;
+	for (int start = 0; start < length; start += rowLength) {
+		int rowEnd = length - start < rowLength ? length - start : rowLength;
+		const signed short* in = counts + start;
+		float* out = volts + start;
+		for (int i = 0; i < rowEnd; i++) {
+			out[i] = offset[i] + gain[i] * in[i];
+		}
+	}
+}
+
+signed short voltsToCount(const EMGCalibration* cal, int index, float volts) {
+
+	long count = lrintf((volts - cal->offset[index]) / cal->gain[index]);
+	if (count > 32767) {
+		return 32767;
+	}
+	if (count < -32768) {
+		return -32768;
+	}
+	return (signed short) count;
+}
+
+int saveEMGCalibration(const EMGCalibration* cal, const char* file) {
+
+	FILE* outFile = fopen(file, "w");
+	if (outFile == NULL) {
+		fprintf(stderr, "EMG Calibration ERROR: Couldn't write %s.\n", file);
+		return -1;
+	}
+
+	fprintf(outFile, "# EMG data is in counts, volts = offset + gain * count\n");
+	fprintf(outFile, "sampleTime %.9g\n", cal->sampleTime);
+	fprintf(outFile, "# channel <index> <device channel> <range code> <full scale V> <gain V/count> <offset V>\n");
+	for (int i = 0; i < cal->channels; i++) {
+		fprintf(outFile, "channel %i %i %i %.9g %.9g %.9g\n", i, cal->channel[i], cal->range[i],
+				cal->fullScale[i], cal->gain[i], cal->offset[i]);
+	}
+
+	if (fclose(outFile) != 0) {
+		fprintf(stderr, "EMG Calibration ERROR: Couldn't write %s.\n", file);
+		return -1;
+	}
+	return 1;
+}
+
+int loadEMGCalibration(EMGCalibration* cal, const char* file) {
+
+	memset(cal, 0, sizeof(*cal));
+
+	FILE* inFile = fopen(file, "r");
+	if (inFile == NULL) {
+		fprintf(stderr, "EMG Calibration ERROR: Couldn't open %s.\n", file);
+		return -1;
+	}
+
+	char line[128];
+	int index, channel, range;
+	float fullScale, gain, offset;
+	double sampleTime;
+
+	while (fgets(line, sizeof(line), inFile) != NULL) {
+		if (sscanf(line, "sampleTime %lf", &sampleTime) == 1) {
+			cal->sampleTime = sampleTime;
+		} else if (sscanf(line, "channel %i %i %i %f %f %f", &index, &channel, &range, &fullScale, &gain, &offset) == 6
+				&& index >= 0 && index < EMG_CALIBRATION_MAX_CHANNELS && gain != 0) {
+			cal->channel[index] = channel;
+			cal->range[index] = range;
+			cal->fullScale[index] = fullScale;
+			cal->gain[index] = gain;
+			cal->offset[index] = offset;
+			cal->channels = index + 1 > cal->channels ? index + 1 : cal->channels;
+		}
+	}
+	fclose(inFile);
+
+	//every channel up to the last one has to be there
+	for (int i = 0; i < cal->channels; i++) {
+		if (cal->gain[i] == 0) {
+			fprintf(stderr, "EMG Calibration ERROR: %s has no channel %i.\n", file, i);
+			return -1;
+		}
+	}
+	if (cal->channels == 0) {
+		fprintf(stderr, "EMG Calibration ERROR: %s has no channels.\n", file);
+		return -1;
+	}
+
+	return 1;
+}
@@ -0,0 +1,68 @@
+/*
+ * Name: EMGCalibration.h
+ * Author: Elijah Pivo
+ *
+ * Count to volt calibration of the EMG channels.
+ *
+ * EMG blocks stay in the device's counts from the read buffers through
+ * the quality stats and session store to the files (half the bytes of
+ * volts as floats, and no conversion for every sample). Each channel's
+ * conversion is linear, volts = offset + gain * count, and is written next
+ * to the recording, and into the session store's column file, so any
+ * reader can get volts back. While recording only the feature stage needs
+ * volts, it converts each value as it takes it in (addEMGCounts); offline
+ * tools convert whole blocks with countsToVolts.
+ *
+ * Calibration file format (ArmTrackEMGCalibration.txt), '#' starts a comment:
+ * 	sampleTime <s between scans>
+ * 	channel <index in the scan> <device channel> <range code> <full scale V> <gain V/count> <offset V>
+ *
+ * Doesn't need the driver headers, so offline tools can read a calibration.
+ */
+
+#ifndef EMGCALIBRATION_H
+#define EMGCALIBRATION_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define EMG_CALIBRATION_MAX_CHANNELS 8 //EMG_MAX_CHANNELS
+#define EMG_CALIBRATION_ROW_SCANS 4 //scans converted per pass, so a pass is a whole number of vectors
+
+typedef struct {
+	int channels;
+	double sampleTime; //s between scans
+	uint8_t channel[EMG_CALIBRATION_MAX_CHANNELS]; //device channel, in scan order
+	uint8_t range[EMG_CALIBRATION_MAX_CHANNELS]; //the driver's range code
+	float fullScale[EMG_CALIBRATION_MAX_CHANNELS]; //V, +-
+	float gain[EMG_CALIBRATION_MAX_CHANNELS]; //V per count
+	float offset[EMG_CALIBRATION_MAX_CHANNELS]; //V at count 0
+} EMGCalibration;
+
+/*
+ * Converts scans scans (interleaved, channels counts each) to volts.
+ * counts and volts can't overlap. The inner loop runs over
+ * EMG_CALIBRATION_ROW_SCANS scans with a gain and offset per value, so
+ * GCC vectorizes it (-O3 or -ftree-vectorize, add -mfpu=neon on the Pi).
+ */
+void countsToVolts(const EMGCalibration* cal, const signed short* restrict counts, int scans, float* restrict volts);
+
+/*
+ * Returns the count a value of volts on the index-th channel reads as,
+ * rounded and limited to a signed short.
+ */
+signed short voltsToCount(const EMGCalibration* cal, int index, float volts);
+
+/*
+ * Writes a calibration file. Returns 1 if it was written, -1 otherwise.
+ */
+int saveEMGCalibration(const EMGCalibration* cal, const char* file);
+
+/*
+ * Loads a calibration file. Returns 1 if it was read and describes at
+ * least one channel, -1 (with a message on stderr) otherwise.
+ */
+int loadEMGCalibration(EMGCalibration* cal, const char* file);
+
+#endif
@@ -0,0 +1,446 @@
+/*
+ * Name: EMGFeatures.c
+ * Author: Elijah Pivo
+ *
+ * Streaming EMG time domain features and a linear gesture classifier.
+ */
+
+#include "EMGFeatures.h"
+
+#define FEATURE_SPEC_SZ 256
+#define CLASSIFIER_LINE_SZ 4096
+#define CARRIED 2 //samples of the step before that a step's first terms reach back to
+
+//four lanes at a time, NEON or SSE where the compiler has them
+typedef float FeatureVector __attribute__((vector_size(16)));
+typedef int32_t FeatureMask __attribute__((vector_size(16)));
+
+static FeatureVector loadVector(const float* p) {
+	FeatureVector v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static FeatureVector absVector(FeatureVector v) {
+	return (FeatureVector) ((FeatureMask) v & 0x7fffffff);
+}
+
+static float sumLanes(FeatureVector v) {
+	return (v[0] + v[1]) + (v[2] + v[3]);
+}
+
+static float countLanes(FeatureMask mask) {
+	return -(mask[0] + mask[1] + mask[2] + mask[3]); //true lanes are -1
+}
+
+/*
+ * The ZC, WL and SSC terms ending at x[i], x[i - 1] and x[i - 2] have to exist.
+ */
+static void addTerms(const float* x, int i, float threshold, FeatureSums* sums) {
+
+	float difference = x[i] - x[i - 1];
+	sums->length += fabsf(difference);
+	sums->crossings += x[i] * x[i - 1] < 0 && fabsf(difference) >= threshold;
+	sums->slopeChanges += (x[i - 1] - x[i - 2]) * (x[i - 1] - x[i]) > threshold * threshold;
+}
+
+/*
+ * Sums a step of one channel, x[0] to x[n - 1] with the two samples
+ * before it at x[-2] and x[-1]. heads gets the terms reaching before
+ * x[0]: WL and ZC at x[0] and SSC at x[0] and x[1].
+ */
+static void sumStep(const float* x, int n, float threshold, FeatureSums* sums, FeatureSums* heads) {
+
+	FeatureVector absolute = {0, 0, 0, 0};
+	FeatureVector squares = {0, 0, 0, 0};
+	FeatureVector length = {0, 0, 0, 0};
+	FeatureMask crossings = {0, 0, 0, 0};
+	FeatureMask slopeChanges = {0, 0, 0, 0};
+	FeatureVector deadband = {threshold, threshold, threshold, threshold};
+	FeatureVector deadband2 = deadband * deadband;
+	FeatureVector zero = {0, 0, 0, 0};
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		FeatureVector value = loadVector(x + i);
+		FeatureVector previous = loadVector(x + i - 1);
+		FeatureVector before = loadVector(x + i - 2);
+		FeatureVector difference = value - previous;
+
+		absolute += absVector(value);
+		squares += value * value;
+		length += absVector(difference);
+		crossings += (value * previous < zero) & (absVector(difference) >= deadband);
+		slopeChanges += (previous - before) * (previous - value) > deadband2;
+	}
+
+	sums->absolute = sumLanes(absolute);
+	sums->squares = sumLanes(squares);
+	sums->length = sumLanes(length);
+	sums->crossings = countLanes(crossings);
+	sums->slopeChanges = countLanes(slopeChanges);
+	for (; i < n; i++) {
+		sums->absolute += fabsf(x[i]);
+		sums->squares += x[i] * x[i];
+		addTerms(x, i, threshold, sums);
+	}
+
+	memset(heads, 0, sizeof(FeatureSums));
+	addTerms(x, 0, threshold, heads);
+	if (n > 1) {
+		heads->slopeChanges += (x[0] - x[-1]) * (x[0] - x[1]) > threshold * threshold;
+	}
+}
+
+/*
+ * Works out a window's features from the sums of its steps.
+ */
+static void closeWindow(const EMGFeatures* features, double time, FeatureWindow* window) {
+
+	int oldest = (features->steps - features->stepsPerWindow) % features->stepsPerWindow;
+	window->time = time;
+
+	for (int c = 0; c < features->channels; c++) {
+
+		FeatureSums total = {0, 0, 0, 0, 0};
+		for (int s = 0; s < features->stepsPerWindow; s++) {
+			const FeatureSums* sums = &features->sums[s * features->channels + c];
+			total.absolute += sums->absolute;
+			total.squares += sums->squares;
+			total.length += sums->length;
+			total.crossings += sums->crossings;
+			total.slopeChanges += sums->slopeChanges;
+		}
+
+		//pairs reaching before the window don't count
+		const FeatureSums* head = &features->heads[oldest * features->channels + c];
+		float* out = &window->features[c * FEATURES_PER_CHANNEL];
+		out[FEATURE_MAV] = total.absolute / features->windowSamples;
+		out[FEATURE_RMS] = sqrtf(total.squares / features->windowSamples);
+		out[FEATURE_WL] = total.length - head->length;
+		out[FEATURE_ZC] = total.crossings - head->crossings;
+		out[FEATURE_SSC] = total.slopeChanges - head->slopeChanges;
+	}
+}
+
+void defaultFeatureConfig(FeatureConfig* config) {
+	config->windowTime = FEATURE_DEFAULT_WINDOW;
+	config->stepTime = FEATURE_DEFAULT_STEP;
+	config->threshold = FEATURE_DEFAULT_THRESHOLD;
+}
+
+int parseFeatureConfig(FeatureConfig* config, const char* spec) {
+
+	char copy[FEATURE_SPEC_SZ];
+
+	if (strlen(spec) >= FEATURE_SPEC_SZ) {
+		fprintf(stderr, "EMGFeatures.c ERROR: Feature spec is too long.\n");
+		return -1;
+	}
+	strcpy(copy, spec);
+
+	char* save;
+	for (char* token = strtok_r(copy, " \t", &save); token != NULL; token = strtok_r(NULL, " \t", &save)) {
+		char* value = strchr(token, '=');
+		if (value == NULL) {
+			fprintf(stderr, "EMGFeatures.c ERROR: Expected key=value in feature spec, got \"%s\".\n", token);
+			return -1;
+		}
+		*value++ = '\0';
+
+		char* end;
+		double number = strtod(value, &end);
+		if (end == value || *end != '\0' || !(number >= 0)) {
+			fprintf(stderr, "EMGFeatures.c ERROR: Bad feature %s \"%s\".\n", token, value);
+			return -1;
+		}
+		if (strcmp(token, "window") == 0) {
+			config->windowTime = number;
+		} else if (strcmp(token, "step") == 0) {
+			config->stepTime = number;
+		} else if (strcmp(token, "threshold") == 0) {
+			config->threshold = number;
+		} else {
+			fprintf(stderr, "EMGFeatures.c ERROR: Unknown feature spec key \"%s\".\n", token);
+			return -1;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Sizes windows and steps in samples. Returns 1 if config fits, 0 if it
+ * doesn't.
+ */
+static int featureLayout(const FeatureConfig* config, int channels, double sampleTime, int* windowSamples, int* stepSamples) {
+
+	if (channels < 1 || channels > FEATURE_MAX_CHANNELS || !(sampleTime > 0)) {
+		return 0;
+	}
+
+	*stepSamples = lround(config->stepTime / sampleTime);
+	*windowSamples = lround(config->windowTime / sampleTime);
+	return *stepSamples >= CARRIED && *windowSamples % *stepSamples == 0
+			&& *windowSamples / *stepSamples >= 1 && *windowSamples / *stepSamples <= FEATURE_MAX_STEPS;
+}
+
+size_t EMGFeaturesSize(const FeatureConfig* config, int channels, double sampleTime) {
+
+	int windowSamples, stepSamples;
+	if (!featureLayout(config, channels, sampleTime, &windowSamples, &stepSamples)) {
+		return 0;
+	}
+
+	size_t step = ((size_t) channels * (CARRIED + stepSamples) * sizeof(float) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+	size_t sums = ((size_t) windowSamples / stepSamples * channels * sizeof(FeatureSums) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+	return step + 2 * sums;
+}
+
+int initializeEMGFeatures(EMGFeatures* features, const FeatureConfig* config, int channels, double sampleTime, Arena* Arena) {
+
+	int windowSamples, stepSamples;
+	if (channels < 1 || channels > FEATURE_MAX_CHANNELS) {
+		fprintf(stderr, "EMGFeatures.c ERROR: Features take 1 to %i channels, not %i.\n", FEATURE_MAX_CHANNELS, channels);
+		return -1;
+	}
+	if (!featureLayout(config, channels, sampleTime, &windowSamples, &stepSamples)) {
+		fprintf(stderr, "EMGFeatures.c ERROR: %f s windows have to be 1 to %i steps of %f s, each at least %i samples.\n",
+				config->windowTime, FEATURE_MAX_STEPS, config->stepTime, CARRIED);
+		return -1;
+	}
+
+	features->config = *config;
+	features->channels = channels;
+	features->sampleTime = sampleTime;
+	features->windowSamples = windowSamples;
+	features->stepSamples = stepSamples;
+	features->stepsPerWindow = windowSamples / stepSamples;
+
+	size_t stepSize = (size_t) channels * (CARRIED + stepSamples);
+	size_t sumsSize = (size_t) features->stepsPerWindow * channels;
+	if (Arena != NULL) {
+		features->step = arenaAlloc(Arena, stepSize * sizeof(float), 0);
+		features->sums = arenaAlloc(Arena, sumsSize * sizeof(FeatureSums), 0);
+		features->heads = arenaAlloc(Arena, sumsSize * sizeof(FeatureSums), 0);
+	} else {
+		features->step = calloc(stepSize, sizeof(float));
+		features->sums = calloc(sumsSize, sizeof(FeatureSums));
+		features->heads = calloc(sumsSize, sizeof(FeatureSums));
+	}
+	if (features->step == NULL || features->sums == NULL || features->heads == NULL) {
+		fprintf(stderr, "EMGFeatures.c ERROR: Couldn't allocate feature buffers.\n");
+		return -1;
+	}
+
+	resetEMGFeatures(features);
+	return 1;
+}
+
+void resetEMGFeatures(EMGFeatures* features) {
+
+	memset(features->step, 0, (size_t) features->channels * (CARRIED + features->stepSamples) * sizeof(float));
+	features->filled = 0;
+	features->steps = 0;
+	features->nextTime = NAN;
+}
+
+/*
+ * addEMGScans, or addEMGCounts if counts isn't NULL.
+ */
+static int addScans(EMGFeatures* features, const float* scans, const EMGCalibration* cal, const signed short* counts,
+		int numScans, double firstTime, FeatureWindow* windows, int maxWindows) {
+
+	int channels = features->channels;
+	int stride = CARRIED + features->stepSamples;
+	int closed = 0;
+
+	//lost scans would slide the windows over a hole
+	if (fabs(firstTime - features->nextTime) > features->config.stepTime / 2) {
+		resetEMGFeatures(features);
+	}
+	features->nextTime = firstTime + numScans * features->sampleTime;
+
+	int scan = 0;
+	while (scan < numScans) {
+
+		//scans go into the step channel major, so each channel is summed over contiguous samples
+		int take = features->stepSamples - features->filled;
+		if (take > numScans - scan) {
+			take = numScans - scan;
+		}
+		for (int c = 0; c < channels; c++) {
+			float* step = features->step + c * stride + CARRIED + features->filled;
+			if (counts != NULL) {
+				const signed short* in = counts + (size_t) scan * channels + c;
+				float gain = cal->gain[c], offset = cal->offset[c];
+				for (int i = 0; i < take; i++) {
+					step[i] = offset + gain * in[i * channels];
+				}
+			} else {
+				const float* in = scans + (size_t) scan * channels + c;
+				for (int i = 0; i < take; i++) {
+					step[i] = in[i * channels];
+				}
+			}
+		}
+		features->filled += take;
+		scan += take;
+		if (features->filled < features->stepSamples) {
+			break;
+		}
+
+		int slot = features->steps % features->stepsPerWindow;
+		for (int c = 0; c < channels; c++) {
+			float* step = features->step + c * stride;
+			sumStep(step + CARRIED, features->stepSamples, features->config.threshold,
+					&features->sums[slot * channels + c], &features->heads[slot * channels + c]);
+			memcpy(step, step + features->stepSamples, CARRIED * sizeof(float));
+		}
+		features->steps++;
+		features->filled = 0;
+
+		if (features->steps >= features->stepsPerWindow && closed < maxWindows) {
+			closeWindow(features, firstTime + (scan - 1) * features->sampleTime, &windows[closed++]);
+		}
+	}
+
+	return closed;
+}
+
+int addEMGScans(EMGFeatures* features, const float* scans, int numScans, double firstTime,
+		FeatureWindow* windows, int maxWindows) {
+	return addScans(features, scans, NULL, NULL, numScans, firstTime, windows, maxWindows);
+}
+
+int addEMGCounts(EMGFeatures* features, const EMGCalibration* cal, const signed short* counts, int numScans,
+		double firstTime, FeatureWindow* windows, int maxWindows) {
+	return addScans(features, NULL, cal, counts, numScans, firstTime, windows, maxWindows);
+}
+
+/*
+ * Reads count floats after a line's keyword. Returns 1 if there were
+ * exactly count, -1 otherwise.
+ */
+static int readValues(char* p, float* values, int count) {
+
+	char* end;
+	for (int i = 0; i < count; i++) {
+		values[i] = strtof(p, &end);
+		if (end == p) {
+			return -1;
+		}
+		p = end;
+	}
+	while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+		p++;
+	}
+	return *p == '\0' ? 1 : -1;
+}
+
+int loadClassifier(Classifier* Classifier, const char* file) {
+
+	FILE* in = fopen(file, "r");
+	if (in == NULL) {
+		fprintf(stderr, "EMGFeatures.c ERROR: Couldn't open classifier %s.\n", file);
+		return -1;
+	}
+
+	Classifier->numFeatures = 0;
+	Classifier->numClasses = 0;
+	for (int i = 0; i < FEATURE_MAX_LENGTH; i++) {
+		Classifier->mean[i] = 0;
+		Classifier->scale[i] = 1;
+	}
+
+	char line[CLASSIFIER_LINE_SZ];
+	int lineNumber = 0;
+	int result = 1;
+	while (result == 1 && fgets(line, sizeof(line), in) != NULL) {
+
+		lineNumber++;
+		char keyword[16];
+		int consumed;
+		if (line[0] == '#' || sscanf(line, "%15s%n", keyword, &consumed) != 1) {
+			continue;
+		}
+		char* rest = line + consumed;
+		int features = Classifier->numFeatures;
+
+		if (strcmp(keyword, "features") == 0) {
+			features = strtol(rest, NULL, 10);
+			if (features < 1 || features > FEATURE_MAX_LENGTH || Classifier->numClasses > 0) {
+				result = -1;
+			}
+			Classifier->numFeatures = features;
+		} else if (features == 0) {
+			result = -1; //the feature count comes first
+		} else if (strcmp(keyword, "mean") == 0) {
+			result = readValues(rest, Classifier->mean, features);
+		} else if (strcmp(keyword, "scale") == 0) {
+			result = readValues(rest, Classifier->scale, features);
+		} else if (strcmp(keyword, "class") == 0 && Classifier->numClasses < CLASSIFIER_MAX_CLASSES) {
+			int k = Classifier->numClasses;
+			char format[16];
+			snprintf(format, sizeof(format), "%%%is%%n", CLASSIFIER_NAME_SZ - 1);
+			if (sscanf(rest, format, Classifier->names[k], &consumed) != 1) {
+				result = -1;
+			} else {
+				rest += consumed;
+				char* end;
+				Classifier->bias[k] = strtof(rest, &end);
+				result = end != rest ? readValues(end, Classifier->weights[k], features) : -1;
+				Classifier->numClasses++;
+			}
+		} else {
+			result = -1;
+		}
+	}
+	fclose(in);
+
+	if (result != 1) {
+		fprintf(stderr, "EMGFeatures.c ERROR: Bad classifier line %i in %s.\n", lineNumber, file);
+		return -1;
+	}
+	if (Classifier->numClasses < 2) {
+		fprintf(stderr, "EMGFeatures.c ERROR: Classifier %s has fewer than 2 classes.\n", file);
+		return -1;
+	}
+
+	//standardizing is folded into the weights and bias, a window is then one dot product a class
+	for (int k = 0; k < Classifier->numClasses; k++) {
+		for (int i = 0; i < Classifier->numFeatures; i++) {
+			Classifier->weights[k][i] *= Classifier->scale[i];
+			Classifier->bias[k] -= Classifier->weights[k][i] * Classifier->mean[i];
+		}
+	}
+
+	return 1;
+}
+
+int classifyGesture(const Classifier* Classifier, const float* features, float* score) {
+
+	int best = 0;
+	float bestScore = -INFINITY;
+
+	for (int k = 0; k < Classifier->numClasses; k++) {
+		FeatureVector dot = {0, 0, 0, 0};
+		int i = 0;
+		for (; i + 4 <= Classifier->numFeatures; i += 4) {
+			dot += loadVector(&Classifier->weights[k][i]) * loadVector(&features[i]);
+		}
+		float classScore = Classifier->bias[k] + sumLanes(dot);
+		for (; i < Classifier->numFeatures; i++) {
+			classScore += Classifier->weights[k][i] * features[i];
+		}
+		if (classScore > bestScore) {
+			bestScore = classScore;
+			best = k;
+		}
+	}
+
+	if (score != NULL) {
+		*score = bestScore;
+	}
+	return best;
+}
@@ -0,0 +1,176 @@
+/*
+ * Name: EMGFeatures.h
+ * Author: Elijah Pivo
+ *
+ * Streaming EMG time domain features and a linear gesture classifier.
+ *
+ * Scans go in as they come off the EMG (interleaved, a value per channel,
+ * in volts, or in counts with their calibration, converted as they're
+ * taken in) and each channel gets five features over a sliding window:
+ * 	MAV	mean absolute value
+ * 	RMS	root mean square
+ * 	WL	waveform length, the sum of |x[i] - x[i-1]|
+ * 	ZC	zero crossings, sign changes with a step of at least threshold
+ * 	SSC	slope sign changes, (x[i] - x[i-1]) * (x[i] - x[i+1]) > threshold^2
+ * A window is a whole number of steps and closes every step, so the
+ * overlap is window - step. Each step's samples are summed once (four at
+ * a time, GCC vector extensions, NEON on the Pi with -mfpu=neon) and kept;
+ * a window's features are the sums of its steps, so nothing is summed
+ * twice and nothing drifts. Terms that pair a step's first samples with
+ * the step before are kept apart so a window only counts pairs inside it.
+ *
+ * The feature vector is channel major: MAV, RMS, WL, ZC, SSC of the first
+ * channel, then the second, ...
+ *
+ * A classifier scores each class as bias + weights . features (after the
+ * features are standardized) and picks the best. Linear discriminant
+ * analysis trained offline reduces to this: weights = inverse(covariance)
+ * * class mean, bias = -weights . class mean / 2 + log(prior).
+ * Classifier file, lines starting with # are ignored:
+ * 	features 40
+ * 	mean <features values>     optional, subtracted from each feature
+ * 	scale <features values>    optional, then multiplied
+ * 	class <name> <bias> <features weights>
+ * 	class ...
+ */
+
+#ifndef EMGFEATURES_H
+#define EMGFEATURES_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Arena.h"
+#include "EMGCalibration.h"
+
+#define FEATURE_MAX_CHANNELS 8
+#define FEATURES_PER_CHANNEL 5
+#define FEATURE_MAX_LENGTH (FEATURE_MAX_CHANNELS * FEATURES_PER_CHANNEL)
+#define FEATURE_MAX_STEPS 32 //steps in a window
+#define CLASSIFIER_MAX_CLASSES 16
+#define CLASSIFIER_NAME_SZ 32
+
+//default windows, 200ms every 50ms (150ms overlap), 10mV deadband
+#define FEATURE_DEFAULT_WINDOW .2
+#define FEATURE_DEFAULT_STEP .05
+#define FEATURE_DEFAULT_THRESHOLD .01f
+
+typedef enum {
+	FEATURE_MAV,
+	FEATURE_RMS,
+	FEATURE_WL,
+	FEATURE_ZC,
+	FEATURE_SSC
+} FeatureIndex;
+
+typedef struct {
+	double windowTime; //s
+	double stepTime; //s between windows, the window has to be a whole number of them
+	float threshold; //V, deadband for ZC and SSC
+} FeatureConfig;
+
+typedef struct {
+	float absolute;
+	float squares;
+	float length;
+	float crossings;
+	float slopeChanges;
+} FeatureSums;
+
+typedef struct {
+	double time; //s, the window's last sample
+	float features[FEATURE_MAX_LENGTH];
+} FeatureWindow;
+
+typedef struct {
+	FeatureConfig config;
+	int channels;
+	double sampleTime;
+	int windowSamples;
+	int stepSamples;
+	int stepsPerWindow;
+
+	//the step being filled, per channel the last two samples of the step before then this one's
+	float* step;
+	int filled;
+	double nextTime; //s, when the next scan is expected
+
+	//sums of the last stepsPerWindow steps, step s at (s % stepsPerWindow) * channels
+	FeatureSums* sums; //every term of the step
+	FeatureSums* heads; //terms that reach into the step before
+	long steps; //steps completed since the last reset
+} EMGFeatures;
+
+typedef struct {
+	int numFeatures;
+	int numClasses;
+	char names[CLASSIFIER_MAX_CLASSES][CLASSIFIER_NAME_SZ];
+	float mean[FEATURE_MAX_LENGTH];
+	float scale[FEATURE_MAX_LENGTH];
+	float weights[CLASSIFIER_MAX_CLASSES][FEATURE_MAX_LENGTH];
+	float bias[CLASSIFIER_MAX_CLASSES];
+} Classifier;
+
+/*
+ * Fills config with FEATURE_DEFAULT_WINDOW windows every
+ * FEATURE_DEFAULT_STEP, with a FEATURE_DEFAULT_THRESHOLD deadband.
+ */
+void defaultFeatureConfig(FeatureConfig* config);
+
+/*
+ * Changes config by a spec of space separated key=value pairs, keys left
+ * out keep their value: window=.2 step=.05 (s) threshold=.01 (V).
+ * Returns 1 if the spec was understood, -1 (with a message on stderr) if not.
+ */
+int parseFeatureConfig(FeatureConfig* config, const char* spec);
+
+/*
+ * Returns the bytes initializeEMGFeatures takes from an arena, 0 if config
+ * doesn't fit the sample rate.
+ */
+size_t EMGFeaturesSize(const FeatureConfig* config, int channels, double sampleTime);
+
+/*
+ * Sets up the feature stage for channels channels sampled every
+ * sampleTime s. Buffers come from Arena, or the heap if Arena is NULL.
+ * Returns 1 if succeeded, -1 (with a message on stderr) if config doesn't
+ * fit the sample rate or the buffers couldn't be allocated.
+ */
+int initializeEMGFeatures(EMGFeatures* features, const FeatureConfig* config, int channels, double sampleTime, Arena* Arena);
+
+/*
+ * Forgets every sample, the next window closes a whole window from now.
+ */
+void resetEMGFeatures(EMGFeatures* features);
+
+/*
+ * Adds numScans scans (interleaved, channels values each), the first taken
+ * at firstTime. A gap of more than half a step since the last scans
+ * starts the windows over. Every window that closes is put in windows,
+ * up to maxWindows. Returns the number of windows that closed.
+ */
+int addEMGScans(EMGFeatures* features, const float* scans, int numScans, double firstTime,
+		FeatureWindow* windows, int maxWindows);
+
+/*
+ * Same as addEMGScans for scans of counts, each converted to volts by cal
+ * as it goes into its step, so the block is never converted as a whole.
+ */
+int addEMGCounts(EMGFeatures* features, const EMGCalibration* cal, const signed short* counts, int numScans,
+		double firstTime, FeatureWindow* windows, int maxWindows);
+
+/*
+ * Loads a classifier (see above). Returns 1 if succeeded, -1 (with a
+ * message on stderr) otherwise.
+ */
+int loadClassifier(Classifier* Classifier, const char* file);
+
+/*
+ * Returns the class features score best in, and its score if score isn't NULL.
+ */
+int classifyGesture(const Classifier* Classifier, const float* features, float* score);
+
+#endif
@@ -0,0 +1,326 @@
+/*
+ * Name: Engine.c
+ * Author: Elijah Pivo
+ *
+ * Acquisition engine with a selectable timing strategy.
+ */
+
+#include <math.h>
+
+#include "Engine.h"
+
+//in TimingStrategies.c
+extern const TimingStrategy SpawnStrategy;
+extern const TimingStrategy PoolStrategy;
+extern const TimingStrategy HandshakeStrategy;
+extern const TimingStrategy PrintStrategy;
+extern const TimingStrategy FreeStrategy;
+
+static const TimingStrategy* const TimingStrategies[] = {
+	&SpawnStrategy, &PoolStrategy, &HandshakeStrategy, &PrintStrategy, &FreeStrategy
+};
+#define TIMING_STRATEGIES ((int) (sizeof(TimingStrategies) / sizeof(TimingStrategies[0])))
+
+static void stopFreeRunning(Engine* engine);
+static void recordMeasure(EngineMeasure* measure, double value);
+static double elapsed(const struct timespec* start, const struct timespec* end);
+
+int initializeEngine(Engine* engine, long period) {
+
+	if (period <= 0) {
+		fprintf(stderr, "Engine.c ERROR: The cycle period has to be positive.\n");
+		return -1;
+	}
+
+	memset(engine, 0, sizeof(*engine));
+	engine->period = period;
+	engine->blockCycles = 8; //200ms EMG blocks at 25ms cycles
+	engine->cycle = -1;
+
+	return 1;
+}
+
+int addEngineDevice(Engine* engine, const char* name, void* device, EngineRead read, EngineUpdate update, int freeRunning) {
+
+	if (engine->numDevices == ENGINE_MAX_DEVICES) {
+		return -1;
+	}
+
+	EngineDevice* engineDevice = &engine->devices[engine->numDevices];
+	engineDevice->engine = engine;
+	engineDevice->index = engine->numDevices;
+	engineDevice->name = name;
+	engineDevice->device = device;
+	engineDevice->read = read;
+	engineDevice->update = update;
+	engineDevice->freeRunning = freeRunning;
+
+	return engine->numDevices++;
+}
+
+const TimingStrategy* findTimingStrategy(const char* name) {
+
+	for (int i = 0; i < TIMING_STRATEGIES; i++) {
+		if (strcmp(TimingStrategies[i]->name, name) == 0) {
+			return TimingStrategies[i];
+		}
+	}
+	return NULL;
+}
+
+const TimingStrategy* timingStrategy(int index) {
+	return index >= 0 && index < TIMING_STRATEGIES ? TimingStrategies[index] : NULL;
+}
+
+int runEngine(Engine* engine, const TimingStrategy* strategy, double seconds, EngineSave save, void* saveArg) {
+
+	engine->strategy = strategy;
+	engine->save = save;
+	engine->saveArg = saveArg;
+	engine->cycle = -1;
+	engine->time = 0;
+	engine->cycles = 0;
+	engine->missed = 0;
+	engine->held = 0;
+	memset(&engine->jitter, 0, sizeof(engine->jitter));
+	memset(&engine->latency, 0, sizeof(engine->latency));
+	for (int i = 0; i < engine->numDevices; i++) {
+		engine->devices[i].completed = 0;
+		engine->devices[i].consumed = 0;
+		engine->devices[i].overwritten = 0;
+		engine->devices[i].dropped = 0;
+		engine->devices[i].fresh = 0;
+	}
+
+	//cycle 0 is released a period from now, the strategy gets that long to start up
+	clock_gettime(CLOCK_MONOTONIC, &engine->start);
+	engine->start.tv_nsec += engine->period * 1000;
+	engine->start.tv_sec += engine->start.tv_nsec / 1000000000;
+	engine->start.tv_nsec %= 1000000000;
+
+	engine->running = 1;
+	for (int i = 0; i < engine->numDevices; i++) {
+		if (engine->devices[i].freeRunning
+				&& pthread_create(&engine->devices[i].thread, NULL, readFreeRunning, &engine->devices[i]) != 0) {
+			fprintf(stderr, "Engine.c ERROR: Couldn't start the %s read thread.\n", engine->devices[i].name);
+			engine->running = 0;
+			for (int j = 0; j < i; j++) {
+				if (engine->devices[j].freeRunning) {
+					pthread_join(engine->devices[j].thread, NULL);
+				}
+			}
+			return -1;
+		}
+	}
+	if (strategy->start(engine) != 1) {
+		fprintf(stderr, "Engine.c ERROR: Couldn't start the %s strategy.\n", strategy->name);
+		stopFreeRunning(engine);
+		return -1;
+	}
+
+	struct timespec cpuStart, cpuEnd, wallEnd;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuStart);
+
+	long cycles = lround(seconds * 1000000 / engine->period);
+	while (engine->running && engine->cycle + 1 < cycles) {
+		if (strategy->cycle(engine) != 1) {
+			break;
+		}
+	}
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuEnd);
+	clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+	engine->cpu = elapsed(&cpuStart, &cpuEnd);
+	engine->wall = elapsed(&engine->start, &wallEnd);
+
+	strategy->stop(engine);
+	stopFreeRunning(engine);
+
+	//reads that finished after the last cycle are swapped in too, so the
+	//drivers' buffers are in step for the next run
+	for (int i = 0; i < engine->numDevices; i++) {
+		EngineDevice* device = &engine->devices[i];
+		for (; device->consumed < device->completed; device->consumed++) {
+			device->update(device->device);
+		}
+	}
+
+	return 1;
+}
+
+void printEngineHeader(FILE* file) {
+
+	fprintf(file, "%-10s %7s %8s | %-23s | %6s | %-23s\n", "", "", "", "    jitter (ms)", "", "    latency (ms)");
+	fprintf(file, "%-10s %7s %8s | %7s %7s %7s | %6s | %7s %7s %7s\n", "strategy", "cycles", "missed",
+			"mean", "p99", "max", "CPU", "mean", "p99", "max");
+}
+
+void printEngineResults(const Engine* engine, FILE* file) {
+
+	const EngineMeasure* jitter = &engine->jitter;
+	const EngineMeasure* latency = &engine->latency;
+
+	fprintf(file, "%-10s %7li %7.2f%% | %7.3f %7.3f %7.3f | %5.1f%% | %7.3f %7.3f %7.3f\n",
+			engine->strategy->name, engine->cycles,
+			engine->cycles > 0 ? 100.0 * engine->missed / engine->cycles : 0,
+			jitter->count > 0 ? jitter->sum / jitter->count * 1000 : 0,
+			measurePercentile(jitter, .99) * 1000, jitter->max * 1000,
+			engine->wall > 0 ? 100 * engine->cpu / engine->wall : 0,
+			latency->count > 0 ? latency->sum / latency->count * 1000 : 0,
+			measurePercentile(latency, .99) * 1000, latency->max * 1000);
+}
+
+double measurePercentile(const EngineMeasure* measure, double p) {
+
+	if (measure->count == 0) {
+		return 0;
+	}
+
+	long below = 0;
+	for (int i = 0; i < ENGINE_BINS; i++) {
+		below += measure->bins[i];
+		if (below >= p * measure->count) {
+			double top = (i + 1) * ENGINE_BIN_US * .000001;
+			return top < measure->max ? top : measure->max;
+		}
+	}
+	return measure->max;
+}
+
+double engineClock(const Engine* engine) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return elapsed(&engine->start, &now);
+}
+
+struct timespec releaseTime(const Engine* engine, long cycle) {
+
+	struct timespec release = engine->start;
+	long long nanoseconds = (long long) cycle * engine->period * 1000;
+	release.tv_sec += nanoseconds / 1000000000;
+	release.tv_nsec += nanoseconds % 1000000000;
+	if (release.tv_nsec >= 1000000000) {
+		release.tv_sec++;
+		release.tv_nsec -= 1000000000;
+	}
+	return release;
+}
+
+void startCycle(Engine* engine, long cycle) {
+
+	double now = engineClock(engine);
+
+	//releases passed over were never run
+	if (cycle > engine->cycle + 1) {
+		__sync_fetch_and_add(&engine->missed, cycle - engine->cycle - 1);
+	}
+	engine->cycles += cycle - engine->cycle;
+	engine->cycle = cycle;
+	engine->time = cycle * engine->period * .000001;
+
+	recordMeasure(&engine->jitter, fabs(now - engine->time));
+}
+
+int engineRead(Engine* engine, int device, double time) {
+
+	EngineDevice* engineDevice = &engine->devices[device];
+
+	engineDevice->readStart[engineDevice->completed % ENGINE_READ_SLOTS] = engineClock(engine);
+	int result = engineDevice->read(engineDevice->device, time);
+	__sync_synchronize(); //the read and its start are complete before it's counted
+	engineDevice->completed++;
+
+	return result;
+}
+
+void* readFreeRunning(void* arg) {
+
+	EngineDevice* device = arg;
+	Engine* engine = device->engine;
+
+	while (engine->running) {
+		engineRead(engine, device->index, engineClock(engine));
+	}
+
+	return NULL;
+}
+
+void dropReads(Engine* engine, int device, long completed) {
+
+	EngineDevice* engineDevice = &engine->devices[device];
+
+	for (; engineDevice->consumed < completed; engineDevice->consumed++) {
+		engineDevice->update(engineDevice->device);
+		engineDevice->dropped++;
+	}
+}
+
+void finishCycle(Engine* engine, double time) {
+
+	unsigned fresh = 0;
+	int missed = 0;
+	double readStart[ENGINE_MAX_DEVICES];
+
+	for (int i = 0; i < engine->numDevices; i++) {
+		EngineDevice* device = &engine->devices[i];
+		long completed = engine->held & 1u << i ? device->consumed : device->completed;
+		__sync_synchronize(); //the count is read before the buffers it covers
+
+		//every finished read is swapped in, the newest one is saved
+		int updated = 0;
+		for (; device->consumed < completed; device->consumed++) {
+			if (device->update(device->device) == 1) {
+				device->overwritten += updated;
+				updated = 1;
+				readStart[i] = device->readStart[device->consumed % ENGINE_READ_SLOTS];
+			}
+		}
+
+		if (updated) {
+			fresh |= 1u << i;
+			device->fresh++;
+		} else if (!device->freeRunning) {
+			missed = 1;
+		}
+	}
+
+	if (missed) {
+		__sync_fetch_and_add(&engine->missed, 1);
+	}
+	if (engine->save != NULL) {
+		engine->save(engine->saveArg, engine, time, fresh);
+	}
+
+	//a free running device's reads are as old as its blocks are long, they'd swamp the cycle's latency
+	double now = engineClock(engine);
+	for (int i = 0; i < engine->numDevices; i++) {
+		if (fresh & 1u << i && !engine->devices[i].freeRunning) {
+			recordMeasure(&engine->latency, now - readStart[i]);
+		}
+	}
+}
+
+static void stopFreeRunning(Engine* engine) {
+
+	engine->running = 0;
+	for (int i = 0; i < engine->numDevices; i++) {
+		if (engine->devices[i].freeRunning) {
+			pthread_join(engine->devices[i].thread, NULL);
+		}
+	}
+}
+
+static void recordMeasure(EngineMeasure* measure, double value) {
+
+	measure->count++;
+	measure->sum += value;
+	measure->max = value > measure->max ? value : measure->max;
+
+	long bin = (long) (value * 1000000 / ENGINE_BIN_US);
+	measure->bins[bin < ENGINE_BINS ? bin : ENGINE_BINS - 1]++;
+}
+
+static double elapsed(const struct timespec* start, const struct timespec* end) {
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) * .000000001;
+}
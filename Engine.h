@@ -0,0 +1,217 @@
+/*
+ * Name: Engine.h
+ * Author: Elijah Pivo
+ *
+ * Acquisition engine with a selectable timing strategy.
+ *
+ * The engine holds the devices and runs the cycle: every period it takes
+ * the reads that finished, swaps them in (update) and hands them to a save
+ * function, measuring as it goes. How reads are started and how the cycle
+ * is paced is left to a TimingStrategy, so the timing designs tried in the
+ * test programs can run against the same devices and be compared:
+ * 	spawn		SIGALRM ticks, a thread created and joined per read
+ * 			(mobileArmTrack before WorkerPool)
+ * 	pool		SIGALRM ticks, persistent pinned workers with a deadline
+ * 			(mobileArmTrack)
+ * 	handshake	persistent threads woken by condition and spun on until
+ * 			done, cycle paced by spinning on the clock, free running
+ * 			devices waited for once a block, saving in the loop (the
+ * 			read stage of structureTest)
+ * 	print		handshake, with saving handed to a print thread
+ * 			(structureTest, multiDeviceRead, multiQuickDeviceRead)
+ * 	free		every device read back to back on its own thread, the
+ * 			cycle sleeps to its release and takes what's new
+ *
+ * A device is either read once a cycle or, if it's free running (EMG,
+ * whose blocks span many cycles), back to back on its own thread under
+ * every strategy. Reads are swapped in exactly once each, in order, so
+ * the drivers' double buffers stay in step however late a read finishes.
+ *
+ * Measured per run:
+ * 	jitter		how late each cycle started after its release
+ * 	missed		cycles where a cycle read device had no new read, or
+ * 			that were skipped altogether
+ * 	CPU		process CPU time over wall time (1 = one core busy)
+ * 	latency		from the start of a cycle read device's read to its data
+ * 			being saved
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "CacheLine.h"
+
+#define ENGINE_MAX_DEVICES 8
+#define ENGINE_READ_SLOTS 4 //read start times kept per device
+#define ENGINE_BIN_US 50 //histogram bin width
+#define ENGINE_BINS 2000 //histograms reach 100ms, anything longer goes in the last bin
+
+typedef struct Engine Engine;
+
+/*
+ * A device's read (getXData) and update (updateXRead), as the drivers
+ * have them. Both return 1 if succeeded, -1 otherwise.
+ */
+typedef int (*EngineRead)(void* device, double time);
+typedef int (*EngineUpdate)(void* device);
+
+/*
+ * Called each cycle after the reads are swapped in, with the cycle's
+ * release (s) and the mask of devices that have a new read.
+ */
+typedef void (*EngineSave)(void* arg, const Engine* engine, double time, unsigned fresh);
+
+/*
+ * Histogram of times with running mean and max.
+ */
+typedef struct {
+	long count;
+	double sum; //s
+	double max; //s
+	long bins[ENGINE_BINS];
+} EngineMeasure;
+
+typedef struct {
+	Engine* engine;
+	int index;
+	const char* name;
+	void* device;
+	EngineRead read;
+	EngineUpdate update;
+	int freeRunning; //read back to back on its own thread instead of once a cycle
+	pthread_t thread; //the free running read thread
+
+	//written by the thread reading the device
+	volatile long completed CACHE_ALIGNED; //reads finished
+	double readStart[ENGINE_READ_SLOTS]; //s, start of read n in slot n % ENGINE_READ_SLOTS
+
+	//written by the thread finishing cycles
+	long consumed CACHE_ALIGNED; //reads swapped in
+	long overwritten; //reads swapped in and replaced in the same cycle, never saved
+	long dropped; //reads that finished after their cycle gave up on them, never saved
+	long fresh; //cycles with a new read
+} EngineDevice;
+
+/*
+ * A timing design. start sets up the strategy's threads, cycle runs one
+ * cycle (waits for a release, calls startCycle, gets the cycle read
+ * devices read and calls finishCycle, or has another thread do it) and
+ * stop ends it all. start and cycle return 1 if succeeded, -1 to end
+ * the run.
+ */
+typedef struct {
+	const char* name;
+	int (*start)(Engine* engine);
+	int (*cycle)(Engine* engine);
+	void (*stop)(Engine* engine);
+} TimingStrategy;
+
+struct Engine {
+	EngineDevice devices[ENGINE_MAX_DEVICES];
+	int numDevices;
+	long period; //us
+	long deadline; //us after a release a cycle's reads may take, period if 0
+	int blockCycles; //cycles a free running device's read spans, for handshake
+
+	const TimingStrategy* strategy;
+	void* state; //the strategy's own
+	unsigned held; //devices whose reads finishCycle leaves for the strategy to drop, set each cycle
+	EngineSave save;
+	void* saveArg;
+
+	struct timespec start; //release of cycle 0
+	long cycle; //current cycle
+	double time; //s, current cycle's release
+	volatile int running;
+
+	long cycles; //released, missed ones included
+	volatile long missed;
+	EngineMeasure jitter;
+	EngineMeasure latency;
+	double wall; //s
+	double cpu; //s
+};
+
+/*
+ * Sets up an engine with no devices, cycling every period us.
+ * Returns 1 if succeeded, -1 if the period isn't positive.
+ */
+int initializeEngine(Engine* engine, long period);
+
+/*
+ * Adds a device. Returns its index, -1 if the engine is full.
+ */
+int addEngineDevice(Engine* engine, const char* name, void* device, EngineRead read, EngineUpdate update, int freeRunning);
+
+/*
+ * Returns the strategy called name, NULL if there's none.
+ */
+const TimingStrategy* findTimingStrategy(const char* name);
+
+/*
+ * Returns the index-th strategy, NULL past the last one.
+ */
+const TimingStrategy* timingStrategy(int index);
+
+/*
+ * Runs cycles with strategy until seconds have passed or running is
+ * cleared, calling save (which may be NULL) every cycle. The devices have
+ * to be started already. Measurements are reset at the start of a run.
+ * Returns 1 if the run completed, -1 if the strategy couldn't start.
+ */
+int runEngine(Engine* engine, const TimingStrategy* strategy, double seconds, EngineSave save, void* saveArg);
+
+/*
+ * Prints the column names of printEngineResults.
+ */
+void printEngineHeader(FILE* file);
+
+/*
+ * Prints a run's jitter, miss rate, CPU use and latency on one line.
+ */
+void printEngineResults(const Engine* engine, FILE* file);
+
+/*
+ * Returns the time below which fraction p of a measure falls (s).
+ */
+double measurePercentile(const EngineMeasure* measure, double p);
+
+/*
+ * For strategies:
+ *
+ * engineClock returns s since the release of cycle 0.
+ *
+ * releaseTime returns the release of a cycle.
+ *
+ * startCycle moves to cycle, counting the releases skipped to get there
+ * as missed, and measures how late it started.
+ *
+ * engineRead reads a device, stamped time, noting when its read started.
+ * Only one thread may read a device at a time.
+ *
+ * readFreeRunning reads a device (arg, its EngineDevice) back to back
+ * until the engine stops, a thread start routine.
+ *
+ * dropReads swaps in a device's reads up to its completed count as of
+ * completed without saving them, for reads that finished after their
+ * cycle gave up on them.
+ *
+ * finishCycle swaps in the reads that finished, calls save with time and
+ * measures the saved reads' latency. Held devices are left alone, as if
+ * they had no new read. The cycle is missed unless every cycle read
+ * device has a new read. Only one thread may finish cycles.
+ */
+double engineClock(const Engine* engine);
+struct timespec releaseTime(const Engine* engine, long cycle);
+void startCycle(Engine* engine, long cycle);
+int engineRead(Engine* engine, int device, double time);
+void* readFreeRunning(void* arg);
+void dropReads(Engine* engine, int device, long completed);
+void finishCycle(Engine* engine, double time);
+
+#endif
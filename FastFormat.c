@@ -0,0 +1,220 @@
+/*
+ * Name: FastFormat.c
+ * Author: Elijah Pivo
+ *
+ * Fixed precision number formatting for the text files, without printf.
+ */
+
+#include "FastFormat.h"
+
+#define FAST_LIMIT 1e15 //integer parts below this fit the fast path
+#define MAX_FRACTION_BITS 60 //fraction bits the digit loop can take without overflowing
+
+static const char digitPairs[] =
+		"00010203040506070809"
+		"10111213141516171819"
+		"20212223242526272829"
+		"30313233343536373839"
+		"40414243444546474849"
+		"50515253545556575859"
+		"60616263646566676869"
+		"70717273747576777879"
+		"80818283848586878889"
+		"90919293949596979899";
+
+/*
+ * Writes an unsigned integer's digits, returns the length written.
+ */
+static int formatDigits(char* out, uint64_t value) {
+
+	char digits[20];
+	int length = 0;
+
+	//two digits at a time from the end
+	while (value >= 100) {
+		int pair = (value % 100) * 2;
+		value /= 100;
+		digits[19 - length++] = digitPairs[pair + 1];
+		digits[19 - length++] = digitPairs[pair];
+	}
+	if (value >= 10) {
+		digits[19 - length++] = digitPairs[value * 2 + 1];
+		digits[19 - length++] = digitPairs[value * 2];
+	} else {
+		digits[19 - length++] = '0' + value;
+	}
+
+	memcpy(out, digits + 20 - length, length);
+	return length;
+}
+
+/*
+ * "%f" by integer arithmetic. Returns the length written, -1 if value
+ * isn't one the fast path can do.
+ */
+static int fastFixed(char* out, double value) {
+
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	int negative = bits >> 63;
+	int exponent = (bits >> 52) & 0x7ff;
+	uint64_t mantissa = bits & ((1ULL << 52) - 1);
+
+	uint64_t integer;
+	uint64_t fraction = 0; //fractionBits bits
+	int fractionBits = 0;
+
+	if (exponent == 0 && mantissa == 0) {
+		integer = 0; //zero, signed
+	} else if (exponent == 0x7ff || exponent == 0 || value >= FAST_LIMIT || value <= -FAST_LIMIT) {
+		return -1; //NaN, infinity, subnormal or too large
+	} else {
+		//value is mantissa * 2^-fractionBits
+		mantissa |= 1ULL << 52;
+		fractionBits = 1075 - exponent;
+		if (fractionBits <= 0) {
+			integer = mantissa << -fractionBits;
+			fractionBits = 0;
+		} else {
+			//trailing zero bits don't change the value, a float has at most 24 that don't
+			int zeros = __builtin_ctzll(mantissa);
+			if (zeros > fractionBits) {
+				zeros = fractionBits;
+			}
+			mantissa >>= zeros;
+			fractionBits -= zeros;
+			if (fractionBits > MAX_FRACTION_BITS) {
+				return -1;
+			}
+			integer = mantissa >> fractionBits;
+			fraction = mantissa & ((1ULL << fractionBits) - 1);
+		}
+	}
+
+	//six decimals, one at a time, the remainder decides the rounding
+	uint32_t decimals = 0;
+	for (int i = 0; i < 6; i++) {
+		fraction *= 10;
+		decimals = decimals * 10 + (uint32_t) (fractionBits > 0 ? fraction >> fractionBits : 0);
+		fraction = fractionBits > 0 ? fraction & ((1ULL << fractionBits) - 1) : 0;
+	}
+	if (fractionBits > 0) {
+		uint64_t half = 1ULL << (fractionBits - 1);
+		if (fraction > half || (fraction == half && (decimals & 1))) {
+			decimals++;
+			if (decimals == 1000000) {
+				decimals = 0;
+				integer++;
+			}
+		}
+	}
+
+	int length = 0;
+	if (negative) {
+		out[length++] = '-';
+	}
+	length += formatDigits(out + length, integer);
+	out[length++] = '.';
+	for (int i = 2; i >= 0; i--) {
+		int pair = (decimals % 100) * 2;
+		decimals /= 100;
+		out[length + i * 2] = digitPairs[pair];
+		out[length + i * 2 + 1] = digitPairs[pair + 1];
+	}
+
+	return length + 6;
+}
+
+int formatFixed(char* out, double value) {
+
+	int length = fastFixed(out, value);
+	if (length == -1) {
+		length = snprintf(out, FIXED_FORMAT_MAX, "%f", value);
+	}
+	return length;
+}
+
+int formatInt(char* out, long value) {
+
+	if (value < 0) {
+		out[0] = '-';
+		//negated as unsigned so LONG_MIN works
+		return 1 + formatDigits(out + 1, -(uint64_t) value);
+	}
+	return formatDigits(out, value);
+}
+
+void initializeTextBuffer(TextBuffer* buffer, char* bytes, size_t capacity, FILE* file) {
+	buffer->bytes = bytes;
+	buffer->length = 0;
+	buffer->capacity = capacity;
+	buffer->file = file;
+}
+
+int reserveText(TextBuffer* buffer, size_t size) {
+
+	if (buffer->capacity - buffer->length >= size) {
+		return 1;
+	}
+	if (flushText(buffer) != 1 || buffer->capacity < size) {
+		return -1;
+	}
+	return 1;
+}
+
+int appendFixed(TextBuffer* buffer, double value, char separator) {
+
+	//most values take the fast path and a short reservation
+	if (reserveText(buffer, FIXED_FORMAT_FAST + 1) != 1) {
+		return -1;
+	}
+	int length = fastFixed(buffer->bytes + buffer->length, value);
+	if (length == -1) {
+		if (reserveText(buffer, FIXED_FORMAT_MAX + 1) != 1) {
+			return -1;
+		}
+		length = snprintf(buffer->bytes + buffer->length, FIXED_FORMAT_MAX, "%f", value);
+	}
+	buffer->length += length;
+
+	if (separator != '\0') {
+		buffer->bytes[buffer->length++] = separator;
+	}
+	return 1;
+}
+
+int appendInt(TextBuffer* buffer, long value, char separator) {
+
+	if (reserveText(buffer, 22) != 1) {
+		return -1;
+	}
+	buffer->length += formatInt(buffer->bytes + buffer->length, value);
+
+	if (separator != '\0') {
+		buffer->bytes[buffer->length++] = separator;
+	}
+	return 1;
+}
+
+int appendText(TextBuffer* buffer, const char* text, size_t length) {
+
+	if (reserveText(buffer, length) != 1) {
+		return -1;
+	}
+	memcpy(buffer->bytes + buffer->length, text, length);
+	buffer->length += length;
+	return 1;
+}
+
+int flushText(TextBuffer* buffer) {
+
+	if (buffer->length == 0) {
+		return 1;
+	}
+	if (buffer->file == NULL || fwrite(buffer->bytes, 1, buffer->length, buffer->file) != buffer->length) {
+		return -1;
+	}
+	buffer->length = 0;
+	return 1;
+}
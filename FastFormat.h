@@ -0,0 +1,84 @@
+/*
+ * Name: FastFormat.h
+ * Author: Elijah Pivo
+ *
+ * Fixed precision number formatting for the text files, without printf.
+ *
+ * formatFixed writes exactly what printf's "%f" does (six decimals,
+ * rounded half to even on the double's exact value, "-0.000000" for
+ * negative zero and negative values that round to zero) for the C locale,
+ * so files written with it are byte for byte the ones fprintf wrote. The
+ * decimals come from integer arithmetic on the double's bits; values it
+ * can't do that way (|value| >= 1e15, NaN, infinities, tiny doubles
+ * using their full precision) go to snprintf, so the output never
+ * changes, only the time it takes.
+ *
+ * A TextBuffer builds whole lines in a caller's buffer, and writes them
+ * to its file when it fills, so a record is one fwrite rather than a
+ * fprintf per value.
+ */
+
+#ifndef FASTFORMAT_H
+#define FASTFORMAT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define FIXED_FORMAT_MAX 320 //bytes "%f" can take, the largest double with sign and NUL
+#define FIXED_FORMAT_FAST 24 //bytes the fast path can take
+
+typedef struct {
+	char* bytes;
+	size_t length;
+	size_t capacity;
+	FILE* file; //where a full buffer goes, NULL to fail instead
+} TextBuffer;
+
+/*
+ * Writes value as "%f" would, without the NUL. out needs FIXED_FORMAT_MAX
+ * bytes. Returns the length written.
+ */
+int formatFixed(char* out, double value);
+
+/*
+ * Writes value as "%i" (or "%li") would, without the NUL. out needs 21
+ * bytes. Returns the length written.
+ */
+int formatInt(char* out, long value);
+
+/*
+ * Sets up a text buffer over capacity bytes of bytes, flushed to file.
+ */
+void initializeTextBuffer(TextBuffer* buffer, char* bytes, size_t capacity, FILE* file);
+
+/*
+ * Makes sure size bytes can be appended, flushing if they can't.
+ * Returns 1 if they can, -1 if the buffer couldn't be flushed or is too small.
+ */
+int reserveText(TextBuffer* buffer, size_t size);
+
+/*
+ * Appends value as "%f" followed by separator, none if separator is '\0'.
+ * Returns 1 if appended, -1 if there was no room.
+ */
+int appendFixed(TextBuffer* buffer, double value, char separator);
+
+/*
+ * Appends value as "%i" followed by separator, none if separator is '\0'.
+ * Returns 1 if appended, -1 if there was no room.
+ */
+int appendInt(TextBuffer* buffer, long value, char separator);
+
+/*
+ * Appends length bytes of text. Returns 1 if appended, -1 if there was no room.
+ */
+int appendText(TextBuffer* buffer, const char* text, size_t length);
+
+/*
+ * Writes what's in the buffer to its file and empties it.
+ * Returns 1 if written (or there was nothing to write), -1 otherwise.
+ */
+int flushText(TextBuffer* buffer);
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * Name: FlightRecorder.c
+ * Author: Elijah Pivo
+ *
+ * Deadline miss flight recorder.
+ */
+
+#include "FlightRecorder.h"
+
+static const char* const eventNames[FLIGHT_EVENT_TYPES] = {
+		"Wakeup", "Release", "Request", "Response", "Handoff", "Persist", "OVERRUN", "ERRORS"
+};
+
+static int64_t sinceStart(const FlightRecorder* recorder) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - recorder->start.tv_sec) * 1000000000LL + (now.tv_nsec - recorder->start.tv_nsec);
+}
+
+int initializeFlightRecorder(FlightRecorder* recorder, Arena* arena, unsigned long capacity, unsigned long postEvents) {
+
+	recorder->capacity = 1;
+	while (recorder->capacity < capacity) {
+		recorder->capacity <<= 1;
+	}
+	recorder->postEvents = postEvents < recorder->capacity ? postEvents : recorder->capacity / 2;
+
+	recorder->events = arenaAlloc(arena, recorder->capacity * sizeof(FlightEvent), 0);
+	if (recorder->events == NULL) {
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &recorder->start);
+	recorder->head = 0;
+	recorder->freezeAt = ULONG_MAX;
+	recorder->triggerType = 0;
+	recorder->triggerSource = 0;
+	recorder->triggerTime = 0;
+	recorder->dumps = 0;
+	recorder->triggers = 0;
+
+	return 1;
+}
+
+void recordFlightEvent(FlightRecorder* recorder, int type, int source, int value) {
+
+	//frozen, leave the window alone until it's dumped
+	if (recorder->head >= recorder->freezeAt) {
+		return;
+	}
+
+	unsigned long index = __sync_fetch_and_add(&recorder->head, 1);
+	if (index >= recorder->freezeAt) {
+		return;
+	}
+
+	FlightEvent* event = &recorder->events[index & (recorder->capacity - 1)];
+	event->time = sinceStart(recorder);
+	event->value = value;
+	event->type = type;
+	event->source = source;
+
+	__sync_synchronize(); //the event is complete before it's marked so
+	event->sequence = index + 1;
+}
+
+void triggerFlightRecorder(FlightRecorder* recorder, int type, int source) {
+
+	recordFlightEvent(recorder, type, source, 0);
+	__sync_fetch_and_add(&recorder->triggers, 1);
+
+	if (__sync_bool_compare_and_swap(&recorder->freezeAt, ULONG_MAX, recorder->head + recorder->postEvents)) {
+		recorder->triggerType = type;
+		recorder->triggerSource = source;
+		recorder->triggerTime = sinceStart(recorder) * .000000001;
+	}
+}
+
+int isFlightRecorderFrozen(const FlightRecorder* recorder) {
+	return recorder->freezeAt != ULONG_MAX && recorder->head >= recorder->freezeAt;
+}
+
+int dumpFlightRecorder(FlightRecorder* recorder, const char* prefix, const char* const sourceNames[], int numSources) {
+
+	int result = -1;
+
+	if (recorder->dumps < FLIGHT_MAX_DUMPS) {
+		char name[256];
+		snprintf(name, sizeof(name), "%s%i.txt", prefix, recorder->dumps + 1);
+
+		FILE* file = fopen(name, "w");
+		if (file != NULL) {
+			unsigned long end = recorder->freezeAt;
+			unsigned long first = end > recorder->capacity ? end - recorder->capacity : 0;
+
+			fprintf(file, "Flight Record %i: %s on %s at %.6f s\tTriggers so far: %ld\n", recorder->dumps + 1,
+					eventNames[recorder->triggerType],
+					recorder->triggerSource < numSources ? sourceNames[recorder->triggerSource] : "?",
+					recorder->triggerTime, recorder->triggers);
+			fprintf(file, "Time (s)\tFrom Trigger (ms)\tEvent\tSource\tValue\n");
+
+			for (unsigned long i = first; i < end; i++) {
+				const FlightEvent* event = &recorder->events[i & (recorder->capacity - 1)];
+				if (event->sequence != (uint32_t) (i + 1)) {
+					continue; //overwritten before the freeze or never finished
+				}
+				double time = event->time * .000000001;
+				fprintf(file, "%.6f\t%.3f\t%s\t%s\t%i\n", time, (time - recorder->triggerTime) * 1000,
+						event->type < FLIGHT_EVENT_TYPES ? eventNames[event->type] : "?",
+						event->source < numSources ? sourceNames[event->source] : "?", event->value);
+			}
+
+			fclose(file);
+			result = 1;
+		} else {
+			fprintf(stderr, "Flight Recorder ERROR: Couldn't create %s.\n", name);
+		}
+		recorder->dumps++;
+	}
+
+	//rearm, recording picks up at the current head
+	__sync_synchronize();
+	recorder->freezeAt = ULONG_MAX;
+
+	return result;
+}
@@ -0,0 +1,101 @@
+/*
+ * Name: FlightRecorder.h
+ * Author: Elijah Pivo
+ *
+ * Deadline miss flight recorder.
+ *
+ * Every thread records what it does each cycle (release wake ups, sensor
+ * requests and responses, print hand-offs, record writes) into one fixed
+ * size ring, oldest events overwritten. Recording is a clock read, one
+ * atomic add and a 24 byte store, no locks, so it stays on in production.
+ *
+ * When a deadline is missed (triggerFlightRecorder) the recorder keeps going
+ * for postEvents more events and then freezes, so the ring holds the window
+ * around the miss. A time critical thread that sees the recorder frozen
+ * hands it to a normal priority thread, which dumps the window to a file
+ * and rearms it, so the dump never holds up a deadline of its own.
+ */
+
+#ifndef FLIGHTRECORDER_H
+#define FLIGHTRECORDER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+
+#include "Arena.h"
+#include "CacheLine.h"
+
+#define FLIGHT_MAX_DUMPS 16 //a sustained failure only fills the disk this far
+
+//event types
+#define FLIGHT_WAKEUP 0   //release thread woke up, value is lateness (ns)
+#define FLIGHT_RELEASE 1  //task released
+#define FLIGHT_REQUEST 2  //sensor thread started a read
+#define FLIGHT_RESPONSE 3 //sensor thread finished a read, value is the result
+#define FLIGHT_HANDOFF 4  //print thread picked up a record
+#define FLIGHT_PERSIST 5  //print thread finished writing a record, value is the record
+#define FLIGHT_OVERRUN 6  //task missed a release (trigger)
+#define FLIGHT_ERRORS 7   //sensor's consecutive errors crossed the threshold (trigger)
+#define FLIGHT_EVENT_TYPES 8
+
+typedef struct {
+	int64_t time; //ns since the recorder started
+	uint32_t sequence; //low bits of index + 1 once the event is complete
+	int32_t value;
+	uint8_t type;
+	uint8_t source; //task or thread role
+} FlightEvent;
+
+typedef struct {
+	FlightEvent* events;
+	unsigned long capacity; //power of two
+	unsigned long postEvents;
+	struct timespec start;
+
+	//written by every recording thread
+	volatile unsigned long head CACHE_ALIGNED;
+
+	//written by whichever thread triggers, then the dumping thread
+	volatile unsigned long freezeAt CACHE_ALIGNED; //ULONG_MAX while armed
+	int triggerType;
+	int triggerSource;
+	double triggerTime; //s since the recorder started
+	int dumps;
+	long triggers;
+} FlightRecorder;
+
+/*
+ * Sets up a ring of capacity events (rounded up to a power of two) from the
+ * arena. postEvents is how many events are kept after a trigger.
+ * Returns 1 if succeeded, -1 if the arena was too small.
+ */
+int initializeFlightRecorder(FlightRecorder* recorder, Arena* arena, unsigned long capacity, unsigned long postEvents);
+
+/*
+ * Records an event. Safe from any thread, never blocks.
+ */
+void recordFlightEvent(FlightRecorder* recorder, int type, int source, int value);
+
+/*
+ * Records a trigger event and, if armed, freezes the ring postEvents events
+ * later. Triggers while a window is pending or frozen are only counted.
+ */
+void triggerFlightRecorder(FlightRecorder* recorder, int type, int source);
+
+/*
+ * Returns 1 if a window is frozen and waiting to be dumped, 0 otherwise.
+ */
+int isFlightRecorderFrozen(const FlightRecorder* recorder);
+
+/*
+ * Writes the frozen window to <prefix><dump number>.txt, one event per line,
+ * and rearms the recorder. Blocks on file I/O, keep it off the real time
+ * threads. sourceNames names each event source.
+ * Returns 1 if written, -1 if the file couldn't be opened or the dump limit
+ * was reached (the recorder still rearms).
+ */
+int dumpFlightRecorder(FlightRecorder* recorder, const char* prefix, const char* const sourceNames[], int numSources);
+
+#endif
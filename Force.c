@@ -6,6 +6,7 @@
  */
 
 #include "Force.h"
+#include "Trace.h"
 
 int initializeForce(Force* Force) {
 
@@ -114,6 +115,8 @@ int restartForce(Force* Force) {
 
 int getForceData(Force* Force, double time) {
 
+	TRACE_SCOPE("getForceData");
+
 	Force->reads++;
 
 	uint8_t writeBuf[3]; //Buffer to store the 3 bytes we write to the I2C device
@@ -124,6 +127,7 @@ int getForceData(Force* Force, double time) {
 	case 0:
 		//read into readBuffer1 on even reads
 		Force->readBuffer1Time = time;
+		Force->hasNewRead1 = 0; //not new until this read finishes
 
 		for (int i = 0; i < FORCE_READ_SZ; i++) {
 
@@ -204,6 +208,7 @@ int getForceData(Force* Force, double time) {
 	case 1:
 		//read into readBuffer2 on odd reads
 		Force->readBuffer2Time = time;
+		Force->hasNewRead2 = 0;
 
 		for (int i = 0; i < FORCE_READ_SZ; i++) {
 
@@ -287,6 +292,8 @@ int getForceData(Force* Force, double time) {
 
 int updateForceRead(Force* Force) {
 
+	TRACE_SCOPE("updateForceRead");
+
 	switch (Force->bufferToUse) {
 	case 1:
 		Force->bufferToUse = 2;
@@ -20,25 +20,30 @@
 #include <stdlib.h>
 #include <fcntl.h>
 
+#include "CacheLine.h"
+
 #define FORCE_READ_SZ 4
 
 typedef struct {
 	int id;
 
-	int bufferToUse;
-	int hasNewRead1;
+	//each read buffer is filled by the collection thread on its own cache lines
+	int hasNewRead1 CACHE_ALIGNED;
 	float readBuffer1[FORCE_READ_SZ];
 	double readBuffer1Time;
-	int hasNewRead2;
+	int hasNewRead2 CACHE_ALIGNED;
 	float readBuffer2[FORCE_READ_SZ];
 	double readBuffer2Time;
 
+	//written by the thread calling updateForceRead
+	int bufferToUse CACHE_ALIGNED;
 	float read[FORCE_READ_SZ];
 	double readTime;
 
-	int reads;
 	int errors;
 	int consecutiveErrors;
+
+	int reads CACHE_ALIGNED; //counted by the collection thread
 } Force;
 
 /*
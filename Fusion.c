@@ -0,0 +1,128 @@
+/*
+ * Name: Fusion.c
+ * Author: Elijah Pivo
+ *
+ * Real time orientation fusion for the IMU chain.
+ * Madgwick IMU (accelerometer + gyroscope) filter, see:
+ * 	S. Madgwick, "An efficient orientation filter for inertial and
+ * 	inertial/magnetic sensor arrays", 2010.
+ */
+
+#include "Fusion.h"
+
+int initializeFusion(Fusion* Fusion, float gain) {
+
+	Fusion->gain = gain;
+	for (int i = 0; i < FUSION_NODES; i++) {
+		Fusion->q0[i] = 1;
+		Fusion->q1[i] = 0;
+		Fusion->q2[i] = 0;
+		Fusion->q3[i] = 0;
+
+		Fusion->read[i * 4] = 1;
+		Fusion->read[i * 4 + 1] = 0;
+		Fusion->read[i * 4 + 2] = 0;
+		Fusion->read[i * 4 + 3] = 0;
+	}
+	Fusion->readTime = 0;
+	Fusion->hasTime = 0;
+	Fusion->updates = 0;
+
+	return 1;
+}
+
+void setFusionGain(Fusion* Fusion, float gain) {
+	Fusion->gain = gain;
+}
+
+int updateFusion(Fusion* Fusion, const float IMURead[IMU_READ_SZ], double time) {
+
+	double dt = time - Fusion->readTime;
+
+	if (Fusion->hasTime == 0 || dt <= 0 || dt > FUSION_MAX_DT) {
+		//nothing to integrate over yet
+		Fusion->readTime = time;
+		Fusion->hasTime = 1;
+		return -1;
+	}
+
+	//split the frame into one array per axis so the filter loop is unit stride
+	float ax[FUSION_NODES], ay[FUSION_NODES], az[FUSION_NODES];
+	float gx[FUSION_NODES], gy[FUSION_NODES], gz[FUSION_NODES];
+
+	for (int i = 0; i < FUSION_NODES; i++) {
+		const float* node = &IMURead[i * FUSION_NODE_SZ];
+		ax[i] = node[0];
+		ay[i] = node[1];
+		az[i] = node[2];
+		gx[i] = node[3] * FUSION_GYRO_SCALE;
+		gy[i] = node[4] * FUSION_GYRO_SCALE;
+		gz[i] = node[5] * FUSION_GYRO_SCALE;
+	}
+
+	const float beta = Fusion->gain;
+	const float step = (float) dt;
+	float* restrict q0 = Fusion->q0;
+	float* restrict q1 = Fusion->q1;
+	float* restrict q2 = Fusion->q2;
+	float* restrict q3 = Fusion->q3;
+
+	//no branches in here, a node without an accelerometer reading just integrates its gyro,
+	//its corrective step is masked off by a zero step size
+	for (int i = 0; i < FUSION_NODES; i++) {
+		float w = q0[i], x = q1[i], y = q2[i], z = q3[i];
+
+		//rate of change of quaternion from gyroscope
+		float dw = 0.5f * (-x * gx[i] - y * gy[i] - z * gz[i]);
+		float dx = 0.5f * (w * gx[i] + y * gz[i] - z * gy[i]);
+		float dy = 0.5f * (w * gy[i] - x * gz[i] + z * gx[i]);
+		float dz = 0.5f * (w * gz[i] + x * gy[i] - y * gx[i]);
+
+		//normalise accelerometer measurement
+		float anorm = ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i];
+		float recip = anorm > 0 ? 1.0f / sqrtf(anorm) : 0;
+		float nx = ax[i] * recip, ny = ay[i] * recip, nz = az[i] * recip;
+
+		//gradient descent corrective step
+		float ww = w * w, xx = x * x, yy = y * y, zz = z * z;
+		float s0 = 4.0f * w * yy + 2.0f * y * nx + 4.0f * w * xx - 2.0f * x * ny;
+		float s1 = 4.0f * x * zz - 2.0f * z * nx + 4.0f * ww * x - 2.0f * w * ny - 4.0f * x
+				+ 8.0f * x * xx + 8.0f * x * yy + 4.0f * x * nz;
+		float s2 = 4.0f * ww * y + 2.0f * w * nx + 4.0f * y * zz - 2.0f * z * ny - 4.0f * y
+				+ 8.0f * y * xx + 8.0f * y * yy + 4.0f * y * nz;
+		float s3 = 4.0f * xx * z - 2.0f * x * nx + 4.0f * yy * z - 2.0f * y * ny;
+
+		//the gradient still has terms with no accelerometer reading, they're not a correction
+		float norm = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+		recip = norm > 0 && anorm > 0 ? beta / sqrtf(norm) : 0;
+
+		dw -= recip * s0;
+		dx -= recip * s1;
+		dy -= recip * s2;
+		dz -= recip * s3;
+
+		//integrate and normalise
+		w += dw * step;
+		x += dx * step;
+		y += dy * step;
+		z += dz * step;
+
+		recip = 1.0f / sqrtf(w * w + x * x + y * y + z * z);
+		q0[i] = w * recip;
+		q1[i] = x * recip;
+		q2[i] = y * recip;
+		q3[i] = z * recip;
+	}
+
+	//publish in node order
+	for (int i = 0; i < FUSION_NODES; i++) {
+		Fusion->read[i * 4] = q0[i];
+		Fusion->read[i * 4 + 1] = q1[i];
+		Fusion->read[i * 4 + 2] = q2[i];
+		Fusion->read[i * 4 + 3] = q3[i];
+	}
+	Fusion->readTime = time;
+	Fusion->updates++;
+
+	return 1;
+}
@@ -0,0 +1,66 @@
+/*
+ * Name: Fusion.h
+ * Author: Elijah Pivo
+ *
+ * Real time orientation fusion for the IMU chain.
+ *
+ * Each IMU frame holds IMU_READ_SZ floats, FUSION_NODE_SZ per node:
+ * 	accelerometer x, y, z (g) followed by gyroscope x, y, z (deg/s).
+ * Every node gets its own Madgwick filter. The filter state is kept
+ * as one array per quaternion component so all nodes in the chain are
+ * updated in a single pass the compiler can vectorize.
+ */
+
+#ifndef FUSION_H
+#define FUSION_H
+
+#include <math.h>
+#include <string.h>
+
+#include "IMU.h"
+
+#define FUSION_NODE_SZ 6
+#define FUSION_NODES (IMU_READ_SZ / FUSION_NODE_SZ)
+#define FUSION_READ_SZ (FUSION_NODES * 4) //w, x, y, z per node
+
+#define FUSION_DEFAULT_GAIN 0.1f //Madgwick beta
+#define FUSION_GYRO_SCALE 0.0174532925f //deg/s to rad/s
+#define FUSION_MAX_DT .5 //longer gaps restart integration instead of jumping
+
+typedef struct {
+	float gain;
+
+	//filter state, one entry per node
+	float q0[FUSION_NODES];
+	float q1[FUSION_NODES];
+	float q2[FUSION_NODES];
+	float q3[FUSION_NODES];
+
+	//most recent orientations, w x y z for each node in chain order
+	float read[FUSION_READ_SZ];
+	double readTime;
+
+	int hasTime;
+	int updates;
+} Fusion;
+
+/*
+ * Sets every node in the chain to the identity orientation and
+ * sets the filter gain. Returns 1.
+ */
+int initializeFusion(Fusion* Fusion, float gain);
+
+/*
+ * Changes the filter gain without resetting the orientations.
+ */
+void setFusionGain(Fusion* Fusion, float gain);
+
+/*
+ * Runs one filter step for every node using an IMU read and the time
+ * it was requested at. The first call (and the first call after a gap
+ * longer than FUSION_MAX_DT) only records the time. Updates read and
+ * readTime. Returns 1 if the orientations were updated, -1 otherwise.
+ */
+int updateFusion(Fusion* Fusion, const float IMURead[IMU_READ_SZ], double time);
+
+#endif
@@ -7,10 +7,26 @@
  */
 
 #include "IMU.h"
+#include "Trace.h"
+
+static int connectIMU(IMU* IMU, const speed_t bauds[], int numBauds);
 
 int initializeIMU(IMU* IMU) {
 
+	//find the fastest of IMU_BAUDS the IMU answers its state request at
+	const speed_t bauds[] = IMU_BAUDS;
+	return connectIMU(IMU, bauds, sizeof(bauds) / sizeof(bauds[0]));
+}
+
+/*
+ * Resets the IMU's reads and opens its port at the first of bauds it
+ * answers its state request at.
+ * Returns the device id if succeeded, -1 if failed.
+ */
+static int connectIMU(IMU* IMU, const speed_t bauds[], int numBauds) {
+
 	IMU->id = -1;
+	IMU->cancelled = NULL;
 	IMU->hasNewRead1 = 0;
 	IMU->hasNewRead2 = 0;
 	IMU->bufferToUse = 2;
@@ -24,73 +40,28 @@ int initializeIMU(IMU* IMU) {
 	IMU->errors = 0;
 	IMU->consecutiveErrors = 0;
 
-	const char device[] = "/dev/ttyACM0";
 	int tempID = 0;
+	SerialOptions options;
+	defaultSerialOptions(&options, IMU_BAUD);
 
-	if ((tempID = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK)) == -1) {
+	if ((tempID = openSerialPort(IMU_DEVICE, &options)) == -1) {
 		fprintf(stderr, "IMU Error: Failed to connect.\n");
 		return -1;
 	}
 
-	// Set BAUD rate
-	struct termios options;
-	tcgetattr(tempID, &options);
-	cfmakeraw(&options);
-	cfsetispeed(&options, IMU_BAUD);
-	cfsetospeed(&options, IMU_BAUD);
-	tcsetattr(tempID, TCSANOW, &options);
-
 	usleep(10000);      // 10mS
 
 	char send = 'i';
-	if (write(tempID, &send, 1) != 1) {
-		fprintf(stderr, "IMU Error: Failed to request state.\n");
+	char response = 'y';
+	if (probeSerialBaud(tempID, &options, bauds, numBauds, &send, 1, &response, 1, IMU_PROBE_TIMEOUT) == -1) {
+		fprintf(stderr, "IMU Error: No response received.\n");
+		close(tempID);
 		return -1;
 	}
 
-	unsigned char temp = 0x02;
-
-	for (int i = 0; IMUDataAvail(tempID) <= 0; i++) {
-		//wait at most 2 seconds
-		if (i == 2) {
-			fprintf(stderr, "IMU Error: No response received.\n");
-			return -1;
-		}
-		sleep(1);
-	}
-
-	int avail = IMUDataAvail(tempID);
-	int correctResponse = 0;
-	if (avail == 1) {
-
-		read(tempID, &temp, 1);
-
-		if (temp == 'y') {
-			correctResponse = 1;
-		} else {
-			fprintf(stderr, "IMU Error: Wrong response received: *%c*.\n", temp);
-
-			return -1;
-		}
-
-	} else {
-		//got too much data, print it out and quit
-		fprintf(stderr, "IMU Error: Wrong Response received:\n");
-
-		for (int i = 0; i < avail; i++) {
-			read(tempID, &temp, 1);
-			fprintf(stderr, "|%c|", temp);
-		}
-		fprintf(stderr, "\n");
-		return -1; //try to get response again
-	}
-
-	if (correctResponse == 1) {
-		IMU->id = tempID;
-		return IMU->id;
-	} else {
-		return -1;
-	}
+	IMU->baud = options.baud;
+	IMU->id = tempID;
+	return IMU->id;
 }
 
 int reconnectIMU(IMU* IMU) {
@@ -102,8 +73,14 @@ int reconnectIMU(IMU* IMU) {
 	//close the device
 	closeIMU(IMU);
 
-	//restart the device
-	initializeIMU(IMU);
+	//restart the device at the rate it answered at before, the firmware
+	//doesn't change rate, so there's no need to step down through the rest
+	const speed_t baud = IMU->baud;
+	if (baud == 0) {
+		initializeIMU(IMU); //never connected
+	} else {
+		connectIMU(IMU, &baud, 1);
+	}
 
 	IMU->errors = e;
 	IMU->reads = r;
@@ -139,15 +116,9 @@ int restartIMU(IMU* IMU) {
 
 int getIMUData(IMU* IMU, double time) {
 
-	IMU->reads++;
+	TRACE_SCOPE("getIMUData");
 
-	fd_set set;
-	struct timeval timeout;
-	timeout.tv_sec = 0;
-	timeout.tv_usec = 24000; //wait 24 ms
-	int retval = 1;
-	FD_ZERO(&set);
-	FD_SET(IMU->id, &set);
+	IMU->reads++;
 
 	unsigned char stop;
 
@@ -155,66 +126,66 @@ int getIMUData(IMU* IMU, double time) {
 	case 0:
 		//read into readBuffer1 on even reads
 		IMU->readBuffer1Time = time;
+		IMU->hasNewRead1 = 0; //not new until this read finishes
 
 		//request reading
 		if (write(IMU->id, "w", 1) != 1) {
 			return -1;
 		}
 
-		retval = select(IMU->id + 1, &set, NULL, NULL, &timeout);
-		if (retval <= 0) {
-			//either error or timeout was reached
-			return -1;
-		} else {
-			do {
-				//get the reading
-				read(IMU->id, &IMU->readBuffer1, IMU_READ_SZ * sizeof(float));
-
-				//check for the stop byte
-				if (read(IMU->id, &stop, sizeof(unsigned char))
-						!= sizeof(unsigned char)) {
-					//no stop byte
-					return -1;
-				}
-				if (stop != 0xFF) {
-					//not the stop byte
-					return -1;
-				}
-			} while (IMUDataAvail(IMU->id) != 0);
-		}
+		//keep reading while more are waiting, ensures its the most up to date,
+		//unless the read was given up on, then the reading it has will do
+		do {
+			//get the whole reading, even if it arrives in pieces
+			if (readSerialFrame(IMU->id, IMU->readBuffer1, IMU_READ_SZ * sizeof(float), IMU_READ_TIMEOUT) == -1) {
+				//either error or timeout was reached
+				return -1;
+			}
+
+			//check for the stop byte
+			if (readSerialFrame(IMU->id, &stop, sizeof(unsigned char), IMU_STOP_TIMEOUT) == -1) {
+				//no stop byte
+				return -1;
+			}
+			if (stop != 0xFF) {
+				//not the stop byte, drop the rest so the next read starts on a reading
+				tcflush(IMU->id, TCIFLUSH);
+				return -1;
+			}
+		} while (IMUDataAvail(IMU->id) != 0 && !(IMU->cancelled != NULL && *IMU->cancelled));
 
 
 		IMU->hasNewRead1 = 1;
 		break;
 	case 1:
 		IMU->readBuffer2Time = time;
+		IMU->hasNewRead2 = 0;
 
 		//request reading
 		if (write(IMU->id, "w", 1) != 1) {
 			return -1;
 		}
 
-		retval = select(IMU->id + 1, &set, NULL, NULL, &timeout);
-		if (retval <= 0) {
-			//either error or timeout was reached
-			return -1;
-		} else {
-			do {
-				//get the reading
-				read(IMU->id, &IMU->readBuffer2, IMU_READ_SZ * sizeof(float));
-
-				//check for the stop byte
-				if (read(IMU->id, &stop, sizeof(unsigned char))
-						!= sizeof(unsigned char)) {
-					//no stop byte
-					return -1;
-				}
-				if (stop != 0xFF) {
-					//not the stop byte
-					return -1;
-				}
-			} while (IMUDataAvail(IMU->id) != 0);
-		}
+		//keep reading while more are waiting, ensures its the most up to date,
+		//unless the read was given up on, then the reading it has will do
+		do {
+			//get the whole reading, even if it arrives in pieces
+			if (readSerialFrame(IMU->id, IMU->readBuffer2, IMU_READ_SZ * sizeof(float), IMU_READ_TIMEOUT) == -1) {
+				//either error or timeout was reached
+				return -1;
+			}
+
+			//check for the stop byte
+			if (readSerialFrame(IMU->id, &stop, sizeof(unsigned char), IMU_STOP_TIMEOUT) == -1) {
+				//no stop byte
+				return -1;
+			}
+			if (stop != 0xFF) {
+				//not the stop byte, drop the rest so the next read starts on a reading
+				tcflush(IMU->id, TCIFLUSH);
+				return -1;
+			}
+		} while (IMUDataAvail(IMU->id) != 0 && !(IMU->cancelled != NULL && *IMU->cancelled));
 
 		IMU->hasNewRead2 = 1;
 		break;
@@ -225,6 +196,8 @@ int getIMUData(IMU* IMU, double time) {
 
 int updateIMURead(IMU* IMU) {
 
+	TRACE_SCOPE("updateIMURead");
+
 	switch (IMU->bufferToUse) {
 	case 1:
 		IMU->bufferToUse = 2;
@@ -275,11 +248,5 @@ void closeIMU(IMU* IMU) {
 }
 
 int IMUDataAvail(const int fd) {
-	int result;
-
-	if (ioctl(fd, FIONREAD, &result) == -1) {
-		return -1;
-	}
-
-	return result;
+	return serialBytesWaiting(fd);
 }
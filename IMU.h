@@ -19,26 +19,39 @@
 #include <string.h>
 #include <sys/select.h>
 
+#include "CacheLine.h"
+#include "Serial.h"
+
+#define IMU_DEVICE "/dev/ttyACM0"
 #define IMU_READ_SZ 12
 #define IMU_BAUD B115200
+#define IMU_BAUDS {IMU_BAUD} //rates to try, fastest first, once the firmware can negotiate a rate add them here
+#define IMU_PROBE_TIMEOUT 1000000 //us to answer at each rate
+#define IMU_READ_TIMEOUT 24000 //us for a whole reading
+#define IMU_STOP_TIMEOUT 1000 //us for the stop byte after a reading
 
 typedef struct {
 	int id;
+	speed_t baud; //rate the IMU answered at
+	const volatile int* cancelled; //set by a caller that gives up on reads, checked between a read's steps, NULL if none
 
-	int bufferToUse;
-	int hasNewRead1;
+	//each read buffer is filled by the collection thread on its own cache lines
+	int hasNewRead1 CACHE_ALIGNED;
 	float readBuffer1[IMU_READ_SZ];
 	double readBuffer1Time;
-	int hasNewRead2;
+	int hasNewRead2 CACHE_ALIGNED;
 	float readBuffer2[IMU_READ_SZ];
 	double readBuffer2Time;
 
+	//written by the thread calling updateIMURead
+	int bufferToUse CACHE_ALIGNED;
 	float read[IMU_READ_SZ];
 	double readTime;
 
-	int reads;
 	int errors;
 	int consecutiveErrors;
+
+	int reads CACHE_ALIGNED; //counted by the collection thread
 } IMU;
 
 /*
@@ -50,7 +63,8 @@ int initializeIMU(IMU* IMU);
 
 /*
  * Reconnects to an IMU chain. Ensures its ready to read from.
- * Won't reset number of errors or reads done with the device.
+ * Won't reset number of errors or reads done with the device. Only the
+ * rate it answered at last time is tried.
  * Returns device id if succeeded, -1 if failed.
  */
 int reconnectIMU(IMU* IMU);
@@ -0,0 +1,163 @@
+/*
+ * Name: Kinematics.c
+ * Author: Elijah Pivo
+ *
+ * Real time forward kinematics for the arm and hand.
+ */
+
+#include "Kinematics.h"
+
+/*
+ * Rotation matrix (row major) from a unit quaternion w x y z.
+ */
+static void quaternionToMatrix(const float* q, float R[9]) {
+	float w = q[0], x = q[1], y = q[2], z = q[3];
+
+	R[0] = 1 - 2 * (y * y + z * z); R[1] = 2 * (x * y - w * z);     R[2] = 2 * (x * z + w * y);
+	R[3] = 2 * (x * y + w * z);     R[4] = 1 - 2 * (x * x + z * z); R[5] = 2 * (y * z - w * x);
+	R[6] = 2 * (x * z - w * y);     R[7] = 2 * (y * z + w * x);     R[8] = 1 - 2 * (x * x + y * y);
+}
+
+/*
+ * out = A * B for row major 3x3 matrices.
+ */
+static void multiplyMatrix(const float A[9], const float B[9], float out[9]) {
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 3; c++) {
+			out[r * 3 + c] = A[r * 3] * B[c] + A[r * 3 + 1] * B[3 + c] + A[r * 3 + 2] * B[6 + c];
+		}
+	}
+}
+
+/*
+ * out = origin + R * v
+ */
+static void transformPoint(const float R[9], const float origin[3], const float v[3], float out[3]) {
+	out[0] = origin[0] + R[0] * v[0] + R[1] * v[1] + R[2] * v[2];
+	out[1] = origin[1] + R[3] * v[0] + R[4] * v[1] + R[5] * v[2];
+	out[2] = origin[2] + R[6] * v[0] + R[7] * v[1] + R[8] * v[2];
+}
+
+void defaultSkeleton(Skeleton* skeleton) {
+
+	//average adult right arm, mm
+	skeleton->upperArm = 300;
+	skeleton->forearm = 260;
+
+	const float base[KIN_FINGERS][3] = {
+			{25, 20, -10}, //thumb carpometacarpal joint
+			{90, 25, 0},   //index
+			{95, 5, 0},    //middle
+			{88, -13, 0},  //ring
+			{80, -30, 0}   //pinky
+	};
+	const float bone[KIN_FINGERS][3] = {
+			{45, 35, 30},  //thumb metacarpal, proximal, distal
+			{45, 25, 20},
+			{50, 30, 22},
+			{45, 28, 22},
+			{35, 22, 18}
+	};
+	const float restAbduction[KIN_FINGERS] = {.7, .1, 0, -.1, -.2};
+
+	memcpy(skeleton->base, base, sizeof(base));
+	memcpy(skeleton->bone, bone, sizeof(bone));
+	memcpy(skeleton->restAbduction, restAbduction, sizeof(restAbduction));
+}
+
+int initializeKinematics(Kinematics* Kinematics, const Skeleton* skeleton) {
+
+	Kinematics->skeleton = *skeleton;
+	for (int i = 0; i < KIN_READ_SZ; i++) {
+		Kinematics->read[i] = 0;
+	}
+	Kinematics->readTime = 0;
+	Kinematics->updates = 0;
+
+	return 1;
+}
+
+int updateKinematics(Kinematics* Kinematics, const float orientations[FUSION_READ_SZ],
+		const float gloveAngles[KIN_GLOVE_SENSORS], double time) {
+
+	const Skeleton* s = &Kinematics->skeleton;
+	float (*joint)[3] = (float (*)[3]) Kinematics->read;
+
+	//segment transforms, each computed once and shared by everything below it
+	float upperArm[9], forearm[9], wrist[9], hand[9];
+	quaternionToMatrix(&orientations[KIN_UPPER_ARM_NODE * 4], upperArm);
+	quaternionToMatrix(&orientations[KIN_FOREARM_NODE * 4], forearm);
+
+	//wrist yaw about z then pitch about y, positive pitch bends toward the palm
+	float cp = cosf(gloveAngles[KIN_WRIST_PITCH]), sp = sinf(gloveAngles[KIN_WRIST_PITCH]);
+	float cy = cosf(gloveAngles[KIN_WRIST_YAW]), sy = sinf(gloveAngles[KIN_WRIST_YAW]);
+	wrist[0] = cy * cp; wrist[1] = -sy; wrist[2] = cy * sp;
+	wrist[3] = sy * cp; wrist[4] = cy;  wrist[5] = sy * sp;
+	wrist[6] = -sp;     wrist[7] = 0;   wrist[8] = cp;
+	multiplyMatrix(forearm, wrist, hand);
+
+	//arm
+	const float upperArmBone[3] = {s->upperArm, 0, 0};
+	const float forearmBone[3] = {s->forearm, 0, 0};
+	joint[KIN_SHOULDER][0] = 0;
+	joint[KIN_SHOULDER][1] = 0;
+	joint[KIN_SHOULDER][2] = 0;
+	transformPoint(upperArm, joint[KIN_SHOULDER], upperArmBone, joint[KIN_ELBOW]);
+	transformPoint(forearm, joint[KIN_ELBOW], forearmBone, joint[KIN_WRIST]);
+
+	//finger flexion (per bone) and spread, thumb first
+	float flexion[KIN_FINGERS][3] = {
+			{0, gloveAngles[KIN_THUMB_MCP], gloveAngles[KIN_THUMB_IP]},
+			{gloveAngles[KIN_INDEX_MCP], gloveAngles[KIN_INDEX_MCP + 1], gloveAngles[KIN_INDEX_MCP + 2]},
+			{gloveAngles[KIN_MIDDLE_MCP], gloveAngles[KIN_MIDDLE_MCP + 1], gloveAngles[KIN_MIDDLE_MCP + 2]},
+			{gloveAngles[KIN_RING_MCP], gloveAngles[KIN_RING_MCP + 1], gloveAngles[KIN_RING_MCP + 2]},
+			{gloveAngles[KIN_PINKY_MCP], gloveAngles[KIN_PINKY_MCP + 1], gloveAngles[KIN_PINKY_MCP + 2]}
+	};
+	float spread[KIN_FINGERS] = {
+			gloveAngles[KIN_THUMB_ABDUCTION],
+			gloveAngles[KIN_MIDDLE_INDEX_ABDUCTION],
+			0, //middle finger is the reference
+			-gloveAngles[KIN_RING_MIDDLE_ABDUCTION],
+			-gloveAngles[KIN_RING_MIDDLE_ABDUCTION] - gloveAngles[KIN_PINKY_RING_ABDUCTION]
+	};
+
+	float cr = cosf(gloveAngles[KIN_THUMB_ROLL]), sr = sinf(gloveAngles[KIN_THUMB_ROLL]);
+
+	for (int f = 0; f < KIN_FINGERS; f++) {
+		float abduction = s->restAbduction[f] + spread[f];
+		float ca = cosf(abduction), sa = sinf(abduction);
+
+		//walk the finger in the hand frame
+		float local[KIN_FINGER_JOINTS][3];
+		memcpy(local[0], s->base[f], sizeof(local[0]));
+
+		float angle = 0;
+		for (int b = 0; b < 3; b++) {
+			angle += flexion[f][b];
+			float c = cosf(angle);
+			float d[3] = {c * ca, c * sa, -sinf(angle)};
+
+			if (f == 0) {
+				//thumb plane rolls about the hand's long axis
+				float dy = d[1] * cr - d[2] * sr;
+				float dz = d[1] * sr + d[2] * cr;
+				d[1] = dy;
+				d[2] = dz;
+			}
+
+			local[b + 1][0] = local[b][0] + s->bone[f][b] * d[0];
+			local[b + 1][1] = local[b][1] + s->bone[f][b] * d[1];
+			local[b + 1][2] = local[b][2] + s->bone[f][b] * d[2];
+		}
+
+		float* out = &Kinematics->read[(KIN_FIRST_FINGER_JOINT + f * KIN_FINGER_JOINTS) * 3];
+		for (int j = 0; j < KIN_FINGER_JOINTS; j++) {
+			transformPoint(hand, joint[KIN_WRIST], local[j], &out[j * 3]);
+		}
+	}
+
+	Kinematics->readTime = time;
+	Kinematics->updates++;
+
+	return 1;
+}
@@ -0,0 +1,103 @@
+/*
+ * Name: Kinematics.h
+ * Author: Elijah Pivo
+ *
+ * Real time forward kinematics for the arm and hand.
+ *
+ * The upper arm and forearm orientations come from the IMU chain
+ * (see Fusion.h), the wrist and finger joint angles from a calibrated
+ * CyberGlove II. Positions are in mm relative to the shoulder, in the
+ * IMU world frame.
+ *
+ * Segment frames: x points along the segment (away from the shoulder),
+ * for the hand y points toward the thumb and z out of the back of the hand.
+ */
+
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+#include <math.h>
+#include <string.h>
+
+#include "Fusion.h"
+
+#if FUSION_NODES < 2
+#error "Kinematics needs an upper arm and a forearm node in the IMU chain"
+#endif
+
+#define KIN_UPPER_ARM_NODE 0
+#define KIN_FOREARM_NODE 1
+
+/*
+ * CyberGlove II 22 sensor order, joint angles in radians.
+ */
+#define KIN_THUMB_ROLL 0
+#define KIN_THUMB_MCP 1
+#define KIN_THUMB_IP 2
+#define KIN_THUMB_ABDUCTION 3
+#define KIN_INDEX_MCP 4          //index PIP and DIP follow, same for middle, ring, pinky
+#define KIN_MIDDLE_MCP 7
+#define KIN_MIDDLE_INDEX_ABDUCTION 10
+#define KIN_RING_MCP 11
+#define KIN_RING_MIDDLE_ABDUCTION 14
+#define KIN_PINKY_MCP 15
+#define KIN_PINKY_RING_ABDUCTION 18
+#define KIN_PALM_ARCH 19         //not modelled
+#define KIN_WRIST_PITCH 20
+#define KIN_WRIST_YAW 21
+#define KIN_GLOVE_SENSORS 22
+
+#define KIN_FINGERS 5            //thumb, index, middle, ring, pinky
+#define KIN_FINGER_JOINTS 4      //base, second joint, third joint, tip
+
+/*
+ * Joint positions, x y z each:
+ * 0: Shoulder
+ * 1: Elbow
+ * 2: Wrist
+ * 3 + 4 * finger + joint: finger joints, base first, tip last
+ */
+#define KIN_SHOULDER 0
+#define KIN_ELBOW 1
+#define KIN_WRIST 2
+#define KIN_FIRST_FINGER_JOINT 3
+#define KIN_JOINTS (KIN_FIRST_FINGER_JOINT + KIN_FINGERS * KIN_FINGER_JOINTS)
+#define KIN_READ_SZ (KIN_JOINTS * 3)
+
+typedef struct {
+	float upperArm;                   //shoulder to elbow
+	float forearm;                    //elbow to wrist
+	float base[KIN_FINGERS][3];       //finger base relative to the wrist, hand frame
+	float bone[KIN_FINGERS][3];       //phalanx lengths, base to tip
+	float restAbduction[KIN_FINGERS]; //finger direction in the palm plane with no spread
+} Skeleton;
+
+typedef struct {
+	Skeleton skeleton;
+
+	float read[KIN_READ_SZ];
+	double readTime;
+
+	int updates;
+} Kinematics;
+
+/*
+ * Fills in an average adult right arm and hand.
+ */
+void defaultSkeleton(Skeleton* skeleton);
+
+/*
+ * Sets up the kinematics stage with a skeleton. All joints start at
+ * the shoulder. Returns 1.
+ */
+int initializeKinematics(Kinematics* Kinematics, const Skeleton* skeleton);
+
+/*
+ * Computes every joint position from the IMU chain orientations
+ * (Fusion read) and the glove joint angles. Updates read and readTime.
+ * Returns 1.
+ */
+int updateKinematics(Kinematics* Kinematics, const float orientations[FUSION_READ_SZ],
+		const float gloveAngles[KIN_GLOVE_SENSORS], double time);
+
+#endif
@@ -1,135 +1,517 @@
 /*
+ * Name: Myo.c
+ * Author: Elijah Pivo
+ *
  * Myo interface
  *
- * Author: Elijah Pivo
- * Date: 11/7/2015
  */
 
-
 #include "Myo.h"
-#include "myohw.h"
+#include "Trace.h"
 
-/*
- * Sets up the connection to a Myo.
- * Ensures its ready to read from.
- * @param a pointer to a Myo struct so it can update the id
- * @return -1 if failed, otherwise new value for id
- */
-int initializeMyo(struct Myo* Myo) {
-	int status;
-	const char device[] = "\dev\ttyACM0";
+//IMU fields in read order, all scaled ints on the wire
+static const float IMUScales[MYO_IMU_SZ] = {
+		1 / MYOHW_ORIENTATION_SCALE, 1 / MYOHW_ORIENTATION_SCALE, 1 / MYOHW_ORIENTATION_SCALE, 1 / MYOHW_ORIENTATION_SCALE,
+		1 / MYOHW_ACCELEROMETER_SCALE, 1 / MYOHW_ACCELEROMETER_SCALE, 1 / MYOHW_ACCELEROMETER_SCALE,
+		1 / MYOHW_GYROSCOPE_SCALE, 1 / MYOHW_GYROSCOPE_SCALE, 1 / MYOHW_GYROSCOPE_SCALE
+};
+
+static const char* stateNames[] = {"disconnected", "scanning", "connecting", "reading firmware", "configuring", "streaming"};
 
+//writes made once connected, in order, each waits for the last to complete
+typedef struct {
+	uint16_t handle;
+	uint8_t value[5];
+	int length;
+} MyoWrite;
+
+static const MyoWrite setup[] = {
+		{MYO_COMMAND_HANDLE, {myohw_command_set_sleep_mode, 1, myohw_sleep_mode_never_sleep}, 3},
+		{MYO_IMU_HANDLE + MYO_CCCD_OFFSET, {0x01, 0x00}, 2}, //notify
+		{MYO_EMG0_HANDLE + MYO_CCCD_OFFSET, {0x01, 0x00}, 2},
+		{MYO_EMG0_HANDLE + 3 + MYO_CCCD_OFFSET, {0x01, 0x00}, 2},
+		{MYO_EMG0_HANDLE + 6 + MYO_CCCD_OFFSET, {0x01, 0x00}, 2},
+		{MYO_EMG0_HANDLE + 9 + MYO_CCCD_OFFSET, {0x01, 0x00}, 2},
+		{MYO_COMMAND_HANDLE, {myohw_command_set_mode, 3, myohw_emg_mode_send_emg, myohw_imu_mode_send_data,
+				myohw_classifier_mode_disabled}, 5}
+};
+#define SETUP_STEPS (int) (sizeof(setup) / sizeof(setup[0]))
+
+static void handleMyoPacket(Myo* Myo, const BGAPIPacket* packet);
+static int waitMyoState(Myo* Myo, MyoState target);
+static void decodeIMU(Myo* Myo, const uint8_t* value);
+static void decodeEMG(Myo* Myo, const uint8_t* value, int characteristic);
+
+int initializeMyo(Myo* Myo) {
+
+	Myo->id = -1;
+	Myo->hasNewRead1 = 0;
+	Myo->hasNewRead2 = 0;
+	Myo->bufferToUse = 2;
 	for (int i = 0; i < MYO_READ_SZ; i++) {
+		Myo->readBuffer1[i] = 0;
+		Myo->readBuffer2[i] = 0;
 		Myo->read[i] = 0;
 	}
-	Myo->id = -1;
+	for (int i = 0; i < MYO_IMU_SZ; i++) {
+		Myo->IMU[i] = 0;
+	}
+	Myo->reads = 0;
+	Myo->errors = 0;
+	Myo->consecutiveErrors = 0;
+
+	//the ring is left as is, only the consumer moves tail, samples from
+	//before a reconnect are still popped
+	Myo->pushed = 0;
+	Myo->sequence = 0;
+	Myo->lastEMG = -1;
+
+	Myo->state = MYO_DISCONNECTED;
+	Myo->setupStep = 0;
+	Myo->connection = 0;
+	Myo->newIMU = 0;
+	Myo->EMGPackets = 0;
+	Myo->IMUPackets = 0;
+	Myo->lostPackets = 0;
+	Myo->droppedSamples = 0;
+	initializeBGAPIParser(&Myo->parser);
 
-	if ((Myo->id = open(device, O_RDWR)) == -1) {
-		fprintf(stderr, "Myo Error: Failed to connect.\n");
-		Myo->id = -1;
+	int tempID = 0;
+	SerialOptions options;
+	defaultSerialOptions(&options, MYO_BAUD);
+
+	if ((tempID = openSerialPort(MYO_DEVICE, &options)) == -1) {
+		fprintf(stderr, "Myo Error: Failed to connect to dongle.\n");
 		return -1;
 	}
 
-	//try to connect
-	fprintf(stderr, "Get list of devices.");
-	uint8_t writeBuf[5];
-	writeBuf[0] = 0x00;
-	writeBuf[1] = 0x01;
-	writeBuf[2] = 6;
-	writeBuf[3] = 2;
-	writeBuf[4] = 0x01;
-	write(Myo->id, &writeBuf, 5);
+	Myo->id = tempID;
+
+	//end anything left over from a previous session, the dongle keeps it
+	endBGAPIProcedure(Myo->id);
+	for (uint8_t i = 0; i < 3; i++) {
+		disconnectBGAPI(Myo->id, i);
+	}
+	usleep(100000); //100mS
+	while (nextBGAPIPacket(Myo->id, &Myo->parser) == 1) {}
 
-	uint8_t readBuf[15];
-	for (int i = 0; i < 15; i++) {
-		readBuf[i] = 0x00;
+	if (discoverBGAPI(Myo->id) != 1) {
+		fprintf(stderr, "Myo Error: Failed to start scanning.\n");
+		closeMyo(Myo);
+		return -1;
 	}
+	Myo->state = MYO_SCANNING;
 
-	read(Myo->id, &readBuf, 15);
-	for (int i = 0; i < 15; i++) {
-		fprintf(stderr, "*%d*\n", (int) readBuf[i]);
+	if (waitMyoState(Myo, MYO_STREAMING) != 1) {
+		closeMyo(Myo);
+		return -1;
 	}
 
-	/*
+	fprintf(stderr, "Myo: Firmware %i.%i.%i streaming.\n", Myo->firmware.major,
+			Myo->firmware.minor, Myo->firmware.patch);
+
+	return 1;
+}
 
-	//test I can cause a vibration for now
+int reconnectMyo(Myo* Myo) {
 
-	fprintf(stderr, "Sending vibrate.\n");
-	//make a vibration command and then write it directly, see if that works
-	myohw_command_vibrate_t vibrateCommand;
-	vibrateCommand.header.command = myohw_command_set_mode;
-	vibrateCommand.header.payload_size = 1;
-	vibrateCommand.type = myohw_vibration_long;
-	write(Myo->id, vibrateCommand, sizeof(vibrateCommand)); //not sure if sizeof() works here
+	//save info we want to save
+	int e = Myo->errors;
+	int r = Myo->reads;
+	uint32_t s = Myo->sequence;
 
-	/*
-	//other method writing Bytes directly starting with the characteristic we
-	//we want to right to, then the command, then the type of vibration.
-	uint8_t writeBuf[5];
-	writeBuf[0] = CommandCharacteristic >> 8; //not sure this is right
-	writeBuf[1] = CommandCharacteristic; //not sure this is right
-	writeBuf[2] = myohw_command_vibrate;
-	writeBuf[3] = myohw_vibration_long;
-	write(Myo->id, writeBuf, 4);
-	 */
-	//test I get a response
+	//close the device
+	closeMyo(Myo);
 
+	//restart the device
+	int result = initializeMyo(Myo);
 
+	Myo->errors = e;
+	Myo->reads = r;
+	Myo->sequence = s;
+	return result;
 }
 
-/*
- * Reads data from a Myo.
- * Error messages will be reported to stderr.
- * @param takes a pointer to a Myo struct so it can update the read array
- * @return whether or not the read succeeded (-1 if it failed)
- */
-int getMyoData(struct Myo* Myo) {
-	//request reading
+int startMyo(Myo* Myo) {
+
+	//try to initialize 4 times
 
-	//get the reading
+	for (int attempt = 0; initializeMyo(Myo) == -1; attempt++) {
+		if (attempt == 3) {
+			return -1; //4th attempt failed, give up
+		}
+		sleep(1);
+	}
 
 	return 1;
 }
 
+int restartMyo(Myo* Myo) {
+
+	//try to reconnect 4 times
+	for (int attempt = 0; reconnectMyo(Myo) == -1; attempt++) {
+		if (attempt == 3) {
+			return -1; //4th attempt failed, give up
+		}
+		sleep(1);
+	}
+
+	return 1;
+}
+
+int getMyoData(Myo* Myo, double time) {
+
+	TRACE_SCOPE("getMyoData");
+
+	Myo->reads++;
+
+	float* buffer;
+	int* hasNewRead;
+
+	switch (Myo->reads % 2) {
+	case 0:
+		//read into readBuffer1 on even reads
+		Myo->readBuffer1Time = time;
+		Myo->hasNewRead1 = 0; //not new until this read finishes
+		buffer = Myo->readBuffer1;
+		hasNewRead = &Myo->hasNewRead1;
+		break;
+	default:
+		Myo->readBuffer2Time = time;
+		Myo->hasNewRead2 = 0;
+		buffer = Myo->readBuffer2;
+		hasNewRead = &Myo->hasNewRead2;
+		break;
+	}
+	Myo->newIMU = 0;
+	Myo->pushed = 0;
+
+	//notifications have been arriving since the last read, parse them all
+	int result;
+	while ((result = nextBGAPIPacket(Myo->id, &Myo->parser)) == 1) {
+		handleMyoPacket(Myo, &Myo->parser.packet);
+	}
+
+	if (Myo->pushed > 0) {
+		//the newest sample arrived by now, the rest a sample period apart before it
+		unsigned head = Myo->head;
+		uint32_t newest = Myo->samples[(head + Myo->pushed - 1) & (MYO_RING_SZ - 1)].sequence;
+		for (unsigned i = 0; i < Myo->pushed; i++) {
+			MyoSample* sample = &Myo->samples[(head + i) & (MYO_RING_SZ - 1)];
+			sample->time = time - (newest - sample->sequence) * MYO_SAMPLE_TIME;
+		}
+
+		__sync_synchronize(); //samples are complete before the consumer can see them
+		Myo->head = head + Myo->pushed;
+	}
+
+	if (result == -1 || Myo->state != MYO_STREAMING) {
+		return -1;
+	}
+	if (Myo->pushed == 0 && Myo->newIMU == 0) {
+		return -1; //nothing arrived
+	}
+
+	memcpy(buffer, Myo->IMU, MYO_IMU_SZ * sizeof(float));
+
+	*hasNewRead = 1;
+	return 1;
+}
+
+int updateMyoRead(Myo* Myo) {
+
+	TRACE_SCOPE("updateMyoRead");
+
+	switch (Myo->bufferToUse) {
+	case 1:
+		Myo->bufferToUse = 2;
+		Myo->readTime = Myo->readBuffer1Time;
+		if (Myo->hasNewRead1 == 1) {
+			//New data available
+			memcpy(&Myo->read, &Myo->readBuffer1, MYO_READ_SZ * sizeof(float)); //update the read field
+			Myo->consecutiveErrors = 0; //data collection was successful
+			Myo->hasNewRead1 = 0;
+			return 1;
+		}
+		break;
+	case 2:
+		Myo->bufferToUse = 1;
+		Myo->readTime = Myo->readBuffer2Time;
+		if (Myo->hasNewRead2 == 1) {
+			//New data available
+			memcpy(&Myo->read, &Myo->readBuffer2, MYO_READ_SZ * sizeof(float)); //update the read field
+			Myo->consecutiveErrors = 0; //data collection was successful
+			Myo->hasNewRead2 = 0;
+			return 1;
+		}
+		break;
+	}
+
+	//data collection must have been unsuccessful
+	Myo->errors++;
+	Myo->consecutiveErrors++;
+	return -1;
+}
+
+void closeMyo(Myo* Myo) {
+
+	if (Myo->id != -1) {
+		if (Myo->state >= MYO_READING_FIRMWARE) {
+			disconnectBGAPI(Myo->id, Myo->connection);
+		} else if (Myo->state == MYO_SCANNING) {
+			endBGAPIProcedure(Myo->id);
+		}
+		tcdrain(Myo->id);
+		tcflush(Myo->id, TCIOFLUSH);
+		close(Myo->id);
+	}
+
+	Myo->id = -1;
+	Myo->state = MYO_DISCONNECTED;
+	Myo->hasNewRead1 = 0;
+	Myo->hasNewRead2 = 0;
+	for (int i = 0; i < MYO_READ_SZ; i++) {
+		Myo->readBuffer1[i] = 0;
+		Myo->readBuffer2[i] = 0;
+		Myo->read[i] = 0;
+	}
+	Myo->reads = 0;
+	Myo->errors = 0;
+	Myo->consecutiveErrors = 0;
+}
+
+int popMyoSamples(Myo* Myo, MyoSample samples[], int max) {
+
+	unsigned tail = Myo->tail;
+	unsigned ready = Myo->head - tail;
+	__sync_synchronize(); //head is read before the samples it covers
+
+	int count = ready < (unsigned) max ? (int) ready : max;
+	for (int i = 0; i < count; i++) {
+		samples[i] = Myo->samples[(tail + i) & (MYO_RING_SZ - 1)];
+	}
+
+	__sync_synchronize(); //samples are copied before the collection thread can reuse their slots
+	Myo->tail = tail + count;
+	return count;
+}
+
 /*
- * For use in a pthread. Reads data from a Myo.
- * Error messages will be reported to stderr.
- * @param takes a pointer to a Myo struct so it can update the read array
- * @return status
+ * Moves the connection along as the dongle answers, and decodes
+ * notifications once streaming. Anything that fails drops back to
+ * MYO_DISCONNECTED.
  */
-void* pGetMyoData(void *threadarg) {
+static void handleMyoPacket(Myo* Myo, const BGAPIPacket* packet) {
+
+	const uint8_t* payload = packet->payload;
 
-	struct Myo* Myo = (struct Myo*) threadarg;
+	if (packet->type == BGAPI_EVENT && packet->class == BGAPI_ATTCLIENT
+			&& packet->command == BGAPI_ATTCLIENT_ATTRIBUTE_VALUE) {
+		//connection, handle, type, value length, value
+		if (packet->length < 5 || packet->length < 5 + payload[4]) {
+			return;
+		}
+		uint16_t handle = BGAPIUint16(&payload[1]);
+		int length = payload[4];
+		const uint8_t* value = &payload[5];
 
-	if (getMyoData(Myo) == -1) {
-		//error occured so don't let this thread complete
+		if (handle == MYO_IMU_HANDLE && length >= (int) sizeof(myohw_imu_data_t)) {
+			decodeIMU(Myo, value);
+		} else if (handle >= MYO_EMG0_HANDLE && handle <= MYO_EMG0_HANDLE + 9
+				&& (handle - MYO_EMG0_HANDLE) % 3 == 0 && length >= (int) sizeof(myohw_emg_data_t)) {
+			decodeEMG(Myo, value, (handle - MYO_EMG0_HANDLE) / 3);
+		} else if (handle == MYO_FIRMWARE_HANDLE && Myo->state == MYO_READING_FIRMWARE
+				&& length >= (int) sizeof(myohw_fw_version_t)) {
+			Myo->firmware.major = BGAPIUint16(&value[0]);
+			Myo->firmware.minor = BGAPIUint16(&value[2]);
+			Myo->firmware.patch = BGAPIUint16(&value[4]);
+			Myo->firmware.hardware_rev = BGAPIUint16(&value[6]);
+			if (Myo->firmware.major < MYOHW_FIRMWARE_VERSION_MAJOR) {
+				fprintf(stderr, "Myo Error: Firmware %i.%i can't stream EMG.\n",
+						Myo->firmware.major, Myo->firmware.minor);
+				Myo->state = MYO_DISCONNECTED;
+				return;
+			}
 
-		while (1 == 1) {}
+			Myo->state = MYO_CONFIGURING;
+			Myo->setupStep = 0;
+			writeBGAPIAttribute(Myo->id, Myo->connection, setup[0].handle, setup[0].value, setup[0].length);
+		}
+		return;
 	}
 
-	pthread_exit(NULL);
+	switch (Myo->state) {
+	case MYO_SCANNING:
+		//rssi, packet type, address, address type, bond, data length, data
+		if (packet->type == BGAPI_EVENT && packet->class == BGAPI_GAP
+				&& packet->command == BGAPI_GAP_SCAN_RESPONSE) {
+			//a Myo advertises its service UUID (type 0x06) last
+			int uuid = sizeof(kMyoServiceInfoUuid);
+			if (packet->length < 11 + uuid + 1 || payload[packet->length - uuid - 1] != 0x06
+					|| memcmp(&payload[packet->length - uuid], kMyoServiceInfoUuid, uuid) != 0) {
+				return;
+			}
+
+			memcpy(Myo->address, &payload[2], 6);
+			endBGAPIProcedure(Myo->id);
+			if (connectBGAPI(Myo->id, Myo->address, payload[8]) != 1) {
+				fprintf(stderr, "Myo Error: Failed to send connect.\n");
+				Myo->state = MYO_DISCONNECTED;
+				return;
+			}
+			Myo->state = MYO_CONNECTING;
+		}
+		break;
+	case MYO_CONNECTING:
+		if (packet->type == BGAPI_COMMAND && packet->class == BGAPI_GAP
+				&& packet->command == BGAPI_GAP_CONNECT_DIRECT && packet->length >= 3) {
+			//result, connection handle
+			if (BGAPIUint16(&payload[0]) != 0) {
+				fprintf(stderr, "Myo Error: Dongle refused to connect (0x%04x).\n", BGAPIUint16(&payload[0]));
+				Myo->state = MYO_DISCONNECTED;
+				return;
+			}
+			Myo->connection = payload[2];
+		} else if (packet->type == BGAPI_EVENT && packet->class == BGAPI_CONNECTION
+				&& packet->command == BGAPI_CONNECTION_STATUS && packet->length >= 2
+				&& payload[0] == Myo->connection && (payload[1] & 0x01)) {
+			//connected
+			Myo->state = MYO_READING_FIRMWARE;
+			readBGAPIAttribute(Myo->id, Myo->connection, MYO_FIRMWARE_HANDLE);
+		}
+		break;
+	case MYO_CONFIGURING:
+		if (packet->type == BGAPI_EVENT && packet->class == BGAPI_ATTCLIENT
+				&& packet->command == BGAPI_ATTCLIENT_PROCEDURE_COMPLETED && packet->length >= 3) {
+			//connection, result, characteristic handle
+			if (BGAPIUint16(&payload[1]) != 0) {
+				fprintf(stderr, "Myo Error: Configuring step %i failed (0x%04x).\n",
+						Myo->setupStep, BGAPIUint16(&payload[1]));
+				Myo->state = MYO_DISCONNECTED;
+				return;
+			}
+
+			Myo->setupStep++;
+			if (Myo->setupStep == SETUP_STEPS) {
+				Myo->state = MYO_STREAMING;
+				return;
+			}
+			const MyoWrite* step = &setup[Myo->setupStep];
+			writeBGAPIAttribute(Myo->id, Myo->connection, step->handle, step->value, step->length);
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (packet->type == BGAPI_EVENT && packet->class == BGAPI_CONNECTION
+			&& packet->command == BGAPI_CONNECTION_DISCONNECTED && Myo->state >= MYO_READING_FIRMWARE) {
+		fprintf(stderr, "Myo Error: Disconnected while %s.\n", stateNames[Myo->state]);
+		Myo->state = MYO_DISCONNECTED;
+	}
+}
+
+/*
+ * Feeds the dongle's packets to handleMyoPacket until the Myo reaches the
+ * target state. Each step gets its own timeout.
+ * Returns 1 once there, -1 if a step failed or timed out.
+ */
+static int waitMyoState(Myo* Myo, MyoState target) {
+
+	struct timespec start, now;
+	MyoState state = Myo->state;
+	int step = Myo->setupStep;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (1 == 1) {
+		int result = 0;
+		while (Myo->state != target && Myo->state != MYO_DISCONNECTED
+				&& (result = nextBGAPIPacket(Myo->id, &Myo->parser)) == 1) {
+			handleMyoPacket(Myo, &Myo->parser.packet);
+		}
+
+		if (Myo->state == target) {
+			return 1;
+		}
+		if (result == -1 || Myo->state == MYO_DISCONNECTED) {
+			return -1;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (Myo->state != state || Myo->setupStep != step) {
+			//made progress, restart the clock
+			state = Myo->state;
+			step = Myo->setupStep;
+			start = now;
+		}
+
+		int timeout = state == MYO_SCANNING ? MYO_SCAN_TIMEOUT : MYO_STEP_TIMEOUT;
+		int left = timeout - ((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000);
+		if (left <= 0) {
+			fprintf(stderr, "Myo Error: Timed out %s.\n", stateNames[state]);
+			return -1;
+		}
+
+		struct pollfd waitFor = {Myo->id, POLLIN, 0};
+		poll(&waitFor, 1, left);
+	}
 }
 
 /*
- * Updates the most recent read.
+ * Scales an IMU notification straight out of the input buffer. The Pi is
+ * little endian like BLE, so the int16 fields only need an unaligned load
+ * and the conversion and scaling vectorize.
  */
-void updateMyoRead(struct Myo* Myo) {
+static void decodeIMU(Myo* Myo, const uint8_t* value) {
+
+	int16_t raw[MYO_IMU_SZ];
+	memcpy(raw, value, sizeof(raw));
 
-	if (Myo->hasNewRead == 1) {
-		memcpy(&Myo->read, &Myo->readBuffer, MYO_READ_SZ * sizeof(int));
-		Myo->hasNewRead = 0;
+	float* restrict IMU = Myo->IMU;
+	for (int i = 0; i < MYO_IMU_SZ; i++) {
+		IMU[i] = raw[i] * IMUScales[i];
 	}
 
+	Myo->newIMU = 1;
+	Myo->IMUPackets++;
 }
 
 /*
- * Will end a session with a Myo device.
- * @param takes a pointer to a Myo struct
+ * Pushes the two samples of an EMG notification from the input buffer into
+ * the ring. The room left is checked once and the 16 values are converted
+ * in one loop, then copied to their slots. Samples aren't published until
+ * the read ends.
  */
-void closeMyo(struct Myo* Myo) {
+static void decodeEMG(Myo* Myo, const uint8_t* value, int characteristic) {
 
-	tcflush(Myo->id, TCIOFLUSH);
-	close(Myo->id);
-	Myo->id = -1;
+	//notifications rotate through the 4 characteristics, a skip means lost ones
+	if (Myo->lastEMG != -1) {
+		int missed = (characteristic - Myo->lastEMG - 1) & (MYO_EMG_HANDLES - 1);
+		Myo->lostPackets += missed;
+		Myo->sequence += 2 * missed;
+	}
+	Myo->lastEMG = characteristic;
+	Myo->EMGPackets++;
+
+	unsigned index = Myo->head + Myo->pushed;
+	unsigned room = MYO_RING_SZ - (index - Myo->tail);
+	int fit = room < 2 ? (int) room : 2;
+
+	int8_t raw[2 * MYO_EMG_SZ];
+	float converted[2 * MYO_EMG_SZ];
+	memcpy(raw, value, sizeof(raw));
+	for (int i = 0; i < 2 * MYO_EMG_SZ; i++) {
+		converted[i] = raw[i];
+	}
+
+	for (int s = 0; s < fit; s++) {
+		MyoSample* sample = &Myo->samples[(index + s) & (MYO_RING_SZ - 1)];
+		memcpy(sample->EMG, &converted[s * MYO_EMG_SZ], sizeof(sample->EMG));
+		sample->sequence = Myo->sequence++;
+	}
+	Myo->pushed += fit;
 
+	//consumer has fallen a whole ring behind
+	Myo->droppedSamples += 2 - fit;
+	Myo->sequence += 2 - fit;
 }
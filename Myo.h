@@ -1,63 +1,180 @@
-/* Myo interface
- *
+/*
+ * Name: Myo.h
  * Author: Elijah Pivo
- * Date: 11/7/2015
+ *
+ * Myo armband interface, through a BLED112 dongle (see MyoBluetooth.h).
+ *
+ * initializeMyo scans for a Myo, connects and configures it:
+ * 	scanning -> connecting -> reading firmware -> configuring -> streaming
+ * Each step is driven by the dongle's responses and events. Once streaming
+ * the Myo notifies IMU data at 50Hz and EMG at 200Hz (four characteristics,
+ * two 8 channel samples per notification) whether or not anyone asks, so a
+ * read just drains and parses whatever has arrived since the last one.
+ *
+ * Notifications are decoded where they sit in the dongle's input buffer.
+ * A read holds the newest IMU sample. EMG samples go to a single producer,
+ * single consumer ring, each with a time and a sequence number, so a
+ * consumer that falls behind a read or two still gets every sample.
+ *
+ * The Myo has no sample counter. It sends EMG on its four characteristics
+ * in turn, so a notification arriving on the wrong one means the ones in
+ * between were lost over the air. Their samples are counted in the
+ * sequence numbers. Losing four in a row can't be seen.
  */
 
 #ifndef MYO_H
 #define MYO_H
 
-#include <termios.h> //set up serial connection
-#include <fcntl.h> //open,
-#include <sys/ioctl.h> //ioctl
-#include <stdio.h> //input and output
-#include <pthread.h> //for pthread_exit()
-#include <unistd.h> //for sleep, usleep, write, read
-#include <stdlib.h> //for exit
-#include <stdint.h> //for uint8_t
+#include <termios.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "CacheLine.h"
+#include "Serial.h"
+#include "MyoBluetooth.h"
+#include "myohw.h"
+
+#define MYO_DEVICE "/dev/ttyACM1" //BLED112, the IMU chain takes ttyACM0
+#define MYO_BAUD B115200
+
+#define MYO_IMU_SZ 10 //orientation w x y z, accelerometer x y z (g), gyroscope x y z (deg/s)
+#define MYO_READ_SZ MYO_IMU_SZ
+#define MYO_EMG_SZ 8
+#define MYO_SAMPLE_TIME .005 //s between EMG samples, the newest sample in a read is at its read time
+#define MYO_RING_SZ 256 //EMG samples, 1.28s, must be a power of 2
+
+#define MYO_SCAN_TIMEOUT 5000 //ms
+#define MYO_STEP_TIMEOUT 2000 //ms, for each connect or configure step
+
+//GATT handles on the Myo
+#define MYO_FIRMWARE_HANDLE 0x17
+#define MYO_COMMAND_HANDLE 0x19
+#define MYO_IMU_HANDLE 0x1c
+#define MYO_EMG0_HANDLE 0x2b //EmgData1-3 follow every 3 handles
+#define MYO_EMG_HANDLES 4
+#define MYO_CCCD_OFFSET 1 //a value's notify descriptor follows it
+
+typedef enum {
+	MYO_DISCONNECTED,
+	MYO_SCANNING,
+	MYO_CONNECTING,
+	MYO_READING_FIRMWARE,
+	MYO_CONFIGURING,
+	MYO_STREAMING
+} MyoState;
+
+typedef struct {
+	double time;
+	uint32_t sequence; //counts every sample the Myo sent, lost ones included
+	float EMG[MYO_EMG_SZ];
+} MyoSample;
+
+typedef struct {
+	int id; //dongle's serial port
+
+	//each read buffer is filled by the collection thread on its own cache lines
+	int hasNewRead1 CACHE_ALIGNED;
+	float readBuffer1[MYO_READ_SZ];
+	double readBuffer1Time;
+	int hasNewRead2 CACHE_ALIGNED;
+	float readBuffer2[MYO_READ_SZ];
+	double readBuffer2Time;
 
-#define MYO_READ_SZ 8
+	//written by the thread calling updateMyoRead
+	int bufferToUse CACHE_ALIGNED;
+	float read[MYO_READ_SZ];
+	double readTime;
 
-struct Myo {
-	int id;
-	int hasNewRead;
-	int readBuffer[MYO_READ_SZ];
-	int read[MYO_READ_SZ];
-};
+	int errors;
+	int consecutiveErrors;
+
+	//EMG ring, samples between tail and head are ready to pop
+	MyoSample samples[MYO_RING_SZ] CACHE_ALIGNED;
+	volatile unsigned head CACHE_ALIGNED; //written by the collection thread
+	volatile unsigned tail CACHE_ALIGNED; //written by the consumer
+
+	int reads CACHE_ALIGNED; //counted by the collection thread
+
+	//connection, only touched by the collection thread once streaming
+	MyoState state;
+	int setupStep;
+	uint8_t connection;
+	uint8_t address[6];
+	myohw_fw_version_t firmware;
+	BGAPIParser parser;
+
+	//read being filled
+	float IMU[MYO_IMU_SZ]; //newest IMU sample
+	int newIMU;
+	unsigned pushed; //samples pushed this read, published to head when it ends
+	uint32_t sequence; //of the next sample
+	int lastEMG; //characteristic (0-3) of the last EMG notification, -1 before the first
+
+	long EMGPackets;
+	long IMUPackets;
+	long lostPackets; //EMG notifications missing from the rotation
+	long droppedSamples; //the ring was full
+} Myo;
+
+/*
+ * Finds, connects to and configures a Myo. The EMG ring is left as it is,
+ * so the Myo has to start zeroed (static or memset) before the first call.
+ * Returns 1 if it's streaming, -1 if it failed.
+ */
+int initializeMyo(Myo* Myo);
+
+/*
+ * Reconnects to a Myo. Ensures its ready to read from.
+ * Won't reset number of errors or reads done with the device.
+ * Returns 1 if succeeded, -1 if failed.
+ */
+int reconnectMyo(Myo* Myo);
+
+/*
+ * Will attempt to initialize a Myo 4 times with a 1 second pause
+ * between attempts. Returns 1 if connection succeeds, -1 if not.
+ */
+int startMyo(Myo* Myo);
 
 /*
- * Sets up the connection to a Myo.
- * Ensures its ready to read from.
- * @param a pointer to a Myo struct so it can update the id
- * @return whether or not the initialization succeeded (-1 if it failed)
+ * Will attempt to reconnect a Myo 4 times with a 1 second pause
+ * between attempts. Returns 1 if connection succeeds, -1 if not.
  */
-int initializeMyo(struct Myo* Myo);
+int restartMyo(Myo* Myo);
 
 /*
- * Reads data from a Myo.
- * Error messages will be reported to stderr.
- * @param takes a pointer to a Myo struct so it can update the read array
- * @return whether or not the read succeeded (-1 if it failed)
+ * Parses everything the Myo has sent since the last read, never blocks.
+ * EMG samples are timestamped back from time, a sample period apart, and
+ * pushed to the ring.
+ * Returns 1 if the read got new IMU or EMG data, -1 if nothing arrived or
+ * the Myo disconnected.
  */
-int getMyoData(struct Myo* Myo);
+int getMyoData(Myo* Myo, double time);
 
 /*
- * For use in a pthread. Reads data from a Myo.
- * Error messages will be reported to stderr.
- * @param takes a pointer to a Myo struct so it can update the read array
- * @return status
+ * Updates the most recent Myo read. Alternates between
+ * updating read from readBuffer1 and readBuffer2.
+ * Needs to be called before accessing a Myo's read
+ * information. Also updates the error
+ * and consecutiveError fields. Returns 1 if update
+ * occurred, -1 otherwise.
  */
-void* pGetMyoData(void *threadarg);
+int updateMyoRead(Myo* Myo);
 
 /*
- * Updates the most recent read.
+ * Copies up to max of the oldest EMG samples out of the ring, only one
+ * thread may pop. Returns the number of samples copied.
  */
-void updateMyoRead(struct Myo* Myo);
+int popMyoSamples(Myo* Myo, MyoSample samples[], int max);
 
 /*
- * Will end a session with a Myo device.
- * @param takes a pointer to a Myo struct
+ * Disconnects from the Myo and ends the session with the dongle.
  */
-void closeMyo(struct Myo* Myo);
+void closeMyo(Myo* Myo);
 
 #endif
@@ -1,35 +1,205 @@
 /*
- * Implements the non-Myo specific details of the Bluetooth protocol.
+ * Name: MyoBluetooth.c
+ * Author: Elijah Pivo
+ *
+ * BlueGiga BGAPI over serial, as spoken by the BLED112 USB dongle.
  */
 
-void recv_packet() {
+#include "MyoBluetooth.h"
 
-}
+void initializeBGAPIParser(BGAPIParser* parser) {
 
-void recv_packets(time) {
+	parser->have = 0;
+	parser->packet.length = 0;
+	parser->packet.payload = parser->assembled;
+	parser->inputLength = 0;
+	parser->inputPosition = 0;
+	parser->packets = 0;
+	parser->assembledPackets = 0;
+	parser->discarded = 0;
+}
 
+int parseBGAPIByte(BGAPIParser* parser, uint8_t byte) {
+
+	BGAPIPacket* packet = &parser->packet;
+
+	switch (parser->have) {
+	case 0:
+		//message type, technology bits must be BLE (0)
+		if ((byte & 0x78) != 0) {
+			parser->discarded++;
+			return 0;
+		}
+		packet->type = byte & 0x80;
+		packet->length = (byte & 0x07) << 8;
+		break;
+	case 1:
+		packet->length |= byte;
+		if (packet->length > BGAPI_MAX_PAYLOAD) {
+			parser->discarded += 2;
+			parser->have = 0;
+			return 0;
+		}
+		break;
+	case 2:
+		packet->class = byte;
+		break;
+	case 3:
+		packet->command = byte;
+		break;
+	default:
+		parser->assembled[parser->have - BGAPI_HEADER_SZ] = byte;
+		break;
+	}
+	parser->have++;
+
+	if (parser->have == BGAPI_HEADER_SZ + packet->length) {
+		parser->have = 0;
+		packet->payload = parser->assembled;
+		parser->packets++;
+		parser->assembledPackets++;
+		return 1;
+	}
+	return 0;
 }
 
-void proc_byte(c) {
+int nextBGAPIPacket(int fd, BGAPIParser* parser) {
+
+	while (1 == 1) {
+		//whole packets are handed out in place
+		const uint8_t* header = &parser->input[parser->inputPosition];
+		int waiting = parser->inputLength - parser->inputPosition;
+		int length = waiting >= BGAPI_HEADER_SZ ? (header[0] & 0x07) << 8 | header[1] : 0;
+		if (parser->have == 0 && waiting >= BGAPI_HEADER_SZ && (header[0] & 0x78) == 0
+				&& length <= BGAPI_MAX_PAYLOAD && waiting >= BGAPI_HEADER_SZ + length) {
+			BGAPIPacket* packet = &parser->packet;
+			packet->type = header[0] & 0x80;
+			packet->length = length;
+			packet->class = header[2];
+			packet->command = header[3];
+			packet->payload = &header[BGAPI_HEADER_SZ];
+			parser->inputPosition += BGAPI_HEADER_SZ + length;
+			parser->packets++;
+			return 1;
+		}
+
+		//anything else (a packet split across reads or junk) a byte at a time
+		while (parser->inputPosition < parser->inputLength) {
+			if (parseBGAPIByte(parser, parser->input[parser->inputPosition++]) == 1) {
+				return 1;
+			}
+		}
+
+		ssize_t got = read(fd, parser->input, BGAPI_INPUT_SZ);
+		if (got <= 0) {
+			if (got == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				return -1;
+			}
+			return 0; //nothing more waiting
+		}
+		parser->inputLength = got;
+		parser->inputPosition = 0;
+	}
+}
 
+int waitBGAPIPacket(int fd, BGAPIParser* parser, uint8_t type, uint8_t class, uint8_t command, int timeout,
+		void (*handler)(const BGAPIPacket* packet, void* context), void* context) {
+
+	struct timespec start, now;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (1 == 1) {
+		int result;
+		while ((result = nextBGAPIPacket(fd, parser)) == 1) {
+			const BGAPIPacket* packet = &parser->packet;
+			if (packet->type == type && packet->class == class && packet->command == command) {
+				return 1;
+			}
+			if (handler != NULL) {
+				handler(packet, context);
+			}
+		}
+		if (result == -1) {
+			return -1;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		int left = timeout - ((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000);
+		if (left <= 0) {
+			return -1;
+		}
+
+		struct pollfd waitFor = {fd, POLLIN, 0};
+		poll(&waitFor, 1, left);
+	}
 }
 
-void handle_event() {
+int sendBGAPICommand(int fd, uint8_t class, uint8_t command, const uint8_t* payload, int length) {
 
-}
+	uint8_t packet[BGAPI_HEADER_SZ + BGAPI_MAX_PAYLOAD];
+
+	packet[0] = BGAPI_COMMAND | (length >> 8 & 0x07);
+	packet[1] = length & 0xFF;
+	packet[2] = class;
+	packet[3] = command;
+	if (length > 0) {
+		memcpy(&packet[BGAPI_HEADER_SZ], payload, length);
+	}
 
-void add_handler() {
+	if (write(fd, packet, BGAPI_HEADER_SZ + length) != BGAPI_HEADER_SZ + length) {
+		return -1;
+	}
+	return 1;
+}
 
+int discoverBGAPI(int fd) {
+	uint8_t mode = BGAPI_DISCOVER_GENERIC;
+	return sendBGAPICommand(fd, BGAPI_GAP, BGAPI_GAP_DISCOVER, &mode, 1);
 }
 
-void remove_handler() {
+int endBGAPIProcedure(int fd) {
+	return sendBGAPICommand(fd, BGAPI_GAP, BGAPI_GAP_END_PROCEDURE, NULL, 0);
+}
 
+int connectBGAPI(int fd, const uint8_t address[6], uint8_t addressType) {
+
+	/*
+	 * address, address type, connection interval min and max (1.25ms units),
+	 * supervision timeout (10ms units), slave latency.
+	 * A 7.5ms interval leaves room for 200Hz EMG.
+	 */
+	uint8_t payload[15];
+	memcpy(payload, address, 6);
+	payload[6] = addressType;
+	payload[7] = 6; payload[8] = 0;
+	payload[9] = 6; payload[10] = 0;
+	payload[11] = 64; payload[12] = 0;
+	payload[13] = 0; payload[14] = 0;
+
+	return sendBGAPICommand(fd, BGAPI_GAP, BGAPI_GAP_CONNECT_DIRECT, payload, sizeof(payload));
 }
 
-void wait_event() {
+int disconnectBGAPI(int fd, uint8_t connection) {
+	return sendBGAPICommand(fd, BGAPI_CONNECTION, BGAPI_CONNECTION_DISCONNECT, &connection, 1);
+}
 
+int readBGAPIAttribute(int fd, uint8_t connection, uint16_t handle) {
+	uint8_t payload[3] = {connection, handle & 0xFF, handle >> 8};
+	return sendBGAPICommand(fd, BGAPI_ATTCLIENT, BGAPI_ATTCLIENT_READ_BY_HANDLE, payload, sizeof(payload));
 }
 
-void connect(addr) {
+int writeBGAPIAttribute(int fd, uint8_t connection, uint16_t handle, const uint8_t* value, int length) {
+
+	uint8_t payload[BGAPI_MAX_PAYLOAD];
+	if (length > BGAPI_MAX_PAYLOAD - 4) {
+		return -1;
+	}
+
+	payload[0] = connection;
+	payload[1] = handle & 0xFF;
+	payload[2] = handle >> 8;
+	payload[3] = length;
+	memcpy(&payload[4], value, length);
 
+	return sendBGAPICommand(fd, BGAPI_ATTCLIENT, BGAPI_ATTCLIENT_ATTRIBUTE_WRITE, payload, 4 + length);
 }
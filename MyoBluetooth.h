@@ -0,0 +1,135 @@
+/*
+ * Name: MyoBluetooth.h
+ * Author: Elijah Pivo
+ *
+ * BlueGiga BGAPI over serial, as spoken by the BLED112 USB dongle.
+ *
+ * Every packet is a 4 byte header followed by its payload:
+ * 	byte 0: message type (0x00 command/response, 0x80 event) | length bits 8-10
+ * 	byte 1: payload length bits 0-7
+ * 	byte 2: class
+ * 	byte 3: command or event id
+ * Multi-byte fields are little endian.
+ *
+ * The parser never blocks, so it can be driven from a collection thread
+ * that drains whatever the dongle has sent since its last release. A packet
+ * that arrived whole in one read is handed out where it sits in the input
+ * buffer, only one split across reads is assembled a byte at a time.
+ */
+
+#ifndef MYOBLUETOOTH_H
+#define MYOBLUETOOTH_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+
+#define BGAPI_HEADER_SZ 4
+#define BGAPI_MAX_PAYLOAD 255 //BLED112 payloads are far shorter, longer lengths mean a lost byte
+#define BGAPI_INPUT_SZ 512
+
+#define BGAPI_COMMAND 0x00
+#define BGAPI_EVENT 0x80
+
+//classes
+#define BGAPI_CONNECTION 3
+#define BGAPI_ATTCLIENT 4
+#define BGAPI_GAP 6
+
+//commands (and their responses)
+#define BGAPI_CONNECTION_DISCONNECT 0   //class 3
+#define BGAPI_ATTCLIENT_READ_BY_HANDLE 4 //class 4
+#define BGAPI_ATTCLIENT_ATTRIBUTE_WRITE 5 //class 4
+#define BGAPI_GAP_DISCOVER 2         //class 6
+#define BGAPI_GAP_CONNECT_DIRECT 3   //class 6
+#define BGAPI_GAP_END_PROCEDURE 4    //class 6
+
+//events
+#define BGAPI_CONNECTION_STATUS 0        //class 3
+#define BGAPI_CONNECTION_DISCONNECTED 4  //class 3
+#define BGAPI_ATTCLIENT_PROCEDURE_COMPLETED 1 //class 4
+#define BGAPI_ATTCLIENT_ATTRIBUTE_VALUE 5     //class 4
+#define BGAPI_GAP_SCAN_RESPONSE 0        //class 6
+
+#define BGAPI_DISCOVER_GENERIC 1
+
+typedef struct {
+	uint8_t type; //BGAPI_COMMAND (a response) or BGAPI_EVENT
+	uint8_t class;
+	uint8_t command;
+	int length;
+	const uint8_t* payload; //in the parser's input or assembled, valid until the next packet is parsed
+} BGAPIPacket;
+
+typedef struct {
+	BGAPIPacket packet; //last completed packet
+	int have; //bytes of the current packet received, header included
+	uint8_t assembled[BGAPI_MAX_PAYLOAD]; //payload of a packet split across reads
+
+	//bytes read from the port but not parsed yet
+	uint8_t input[BGAPI_INPUT_SZ];
+	int inputLength;
+	int inputPosition;
+
+	long packets;
+	long assembledPackets; //packets that had to be copied together
+	long discarded; //bytes skipped finding the start of a packet
+} BGAPIParser;
+
+/*
+ * Clears the parser and any buffered input.
+ */
+void initializeBGAPIParser(BGAPIParser* parser);
+
+/*
+ * Parses one byte. Returns 1 if it completed a packet (parser->packet),
+ * 0 otherwise. A header that can't be BGAPI is skipped a byte at a time
+ * until the stream lines up again.
+ */
+int parseBGAPIByte(BGAPIParser* parser, uint8_t byte);
+
+/*
+ * Parses buffered bytes, reading more from fd (opened O_NONBLOCK) when
+ * they run out, until a packet completes. Never blocks. The packet's
+ * payload points into the input buffer when the whole packet is there.
+ * Returns 1 if a packet completed, 0 if nothing more is waiting, -1 if the
+ * port failed.
+ */
+int nextBGAPIPacket(int fd, BGAPIParser* parser);
+
+/*
+ * Waits up to timeout ms for a packet of the given type, class and command.
+ * Every other packet is passed to handler (if not NULL) with context.
+ * Returns 1 if it arrived (parser->packet), -1 on timeout or port failure.
+ */
+int waitBGAPIPacket(int fd, BGAPIParser* parser, uint8_t type, uint8_t class, uint8_t command, int timeout,
+		void (*handler)(const BGAPIPacket* packet, void* context), void* context);
+
+/*
+ * Sends a command. Returns 1 if written, -1 otherwise.
+ */
+int sendBGAPICommand(int fd, uint8_t class, uint8_t command, const uint8_t* payload, int length);
+
+/*
+ * Commands used to find, connect and talk to a peripheral. Each returns
+ * 1 if the command was sent, -1 otherwise. The response (and any events)
+ * come back through the parser.
+ */
+int discoverBGAPI(int fd);
+int endBGAPIProcedure(int fd);
+int connectBGAPI(int fd, const uint8_t address[6], uint8_t addressType);
+int disconnectBGAPI(int fd, uint8_t connection);
+int readBGAPIAttribute(int fd, uint8_t connection, uint16_t handle);
+int writeBGAPIAttribute(int fd, uint8_t connection, uint16_t handle, const uint8_t* value, int length);
+
+/*
+ * Reads a little endian field out of a payload.
+ */
+static inline uint16_t BGAPIUint16(const uint8_t* bytes) {
+	return bytes[0] | bytes[1] << 8;
+}
+
+#endif
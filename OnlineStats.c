@@ -0,0 +1,163 @@
+/*
+ * Name: OnlineStats.c
+ * Author: Elijah Pivo
+ *
+ * Running per channel quality statistics for a sensor.
+ */
+
+#include "OnlineStats.h"
+
+int initializeOnlineStats(OnlineStats* stats, const char* name, int numChannels, float clipLow, float clipHigh) {
+
+	if (numChannels > STATS_MAX_CHANNELS) {
+		fprintf(stderr, "Online Stats ERROR: %s has more than %i channels.\n", name, STATS_MAX_CHANNELS);
+		return -1;
+	}
+
+	memset(stats, 0, sizeof(OnlineStats));
+	stats->name = name;
+	stats->numChannels = numChannels;
+	stats->stuckRun = STATS_STUCK_RUN;
+
+	for (int i = 0; i < numChannels; i++) {
+		stats->clipLow[i] = clipLow;
+		stats->clipHigh[i] = clipHigh;
+		stats->min[i] = INFINITY;
+		stats->max[i] = -INFINITY;
+	}
+
+	return 1;
+}
+
+/*
+ * One sample for every channel, the caller holds the sequence.
+ */
+static void addSample(OnlineStats* stats, const float* restrict values) {
+
+	stats->count++;
+	double scale = 1.0 / stats->count;
+	int first = stats->count == 1;
+
+	for (int i = 0; i < stats->numChannels; i++) {
+		float x = values[i];
+
+		//Welford
+		double delta = x - stats->mean[i];
+		stats->mean[i] += delta * scale;
+		stats->m2[i] += delta * (x - stats->mean[i]);
+
+		stats->min[i] = x < stats->min[i] ? x : stats->min[i];
+		stats->max[i] = x > stats->max[i] ? x : stats->max[i];
+		stats->clipped[i] += (x <= stats->clipLow[i]) | (x >= stats->clipHigh[i]);
+
+		int above = x > stats->mean[i];
+		stats->crossings[i] += !first & (above != stats->above[i]);
+		stats->above[i] = above;
+
+		stats->run[i] = !first & (x == stats->last[i]) ? stats->run[i] + 1 : 1;
+		stats->longestRun[i] = stats->run[i] > stats->longestRun[i] ? stats->run[i] : stats->longestRun[i];
+		stats->last[i] = x;
+	}
+}
+
+void updateOnlineStats(OnlineStats* stats, const float values[]) {
+
+	stats->sequence++;
+	__sync_synchronize(); //readers see the odd count before any change
+
+	addSample(stats, values);
+
+	__sync_synchronize(); //every change is visible before the even count
+	stats->sequence++;
+}
+
+void updateOnlineStatsBlock(OnlineStats* stats, const float values[], int rows) {
+
+	stats->sequence++;
+	__sync_synchronize();
+
+	for (int r = 0; r < rows; r++) {
+		addSample(stats, &values[r * stats->numChannels]);
+	}
+
+	__sync_synchronize();
+	stats->sequence++;
+}
+
+void updateOnlineStatsCounts(OnlineStats* stats, const signed short values[], int rows) {
+
+	float row[STATS_MAX_CHANNELS];
+
+	stats->sequence++;
+	__sync_synchronize();
+
+	for (int r = 0; r < rows; r++) {
+		for (int i = 0; i < stats->numChannels; i++) {
+			row[i] = values[r * stats->numChannels + i];
+		}
+		addSample(stats, row);
+	}
+
+	__sync_synchronize();
+	stats->sequence++;
+}
+
+void snapshotOnlineStats(const OnlineStats* stats, StatsSnapshot* snapshot) {
+
+	OnlineStats copy;
+	unsigned start;
+
+	//retry while an update is in progress or one happened during the copy
+	do {
+		start = stats->sequence;
+		__sync_synchronize();
+		memcpy(&copy, (const void*) stats, sizeof(OnlineStats));
+		__sync_synchronize();
+	} while ((start & 1) || start != stats->sequence);
+
+	snapshot->name = copy.name;
+	snapshot->numChannels = copy.numChannels;
+	snapshot->count = copy.count;
+	snapshot->stuckRun = copy.stuckRun;
+
+	for (int i = 0; i < copy.numChannels; i++) {
+		snapshot->mean[i] = copy.mean[i];
+		snapshot->std[i] = copy.count > 1 ? sqrt(copy.m2[i] / (copy.count - 1)) : 0;
+		snapshot->min[i] = copy.min[i];
+		snapshot->max[i] = copy.max[i];
+		snapshot->clipRate[i] = copy.count > 0 ? copy.clipped[i] / (float) copy.count : 0;
+		snapshot->crossingRate[i] = copy.count > 1 ? copy.crossings[i] / (float) (copy.count - 1) : 0;
+		snapshot->run[i] = copy.run[i];
+		snapshot->longestRun[i] = copy.longestRun[i];
+	}
+}
+
+int printStatsWarnings(const StatsSnapshot* snapshot, float clipRate, FILE* file) {
+
+	int flagged = 0;
+
+	for (int i = 0; i < snapshot->numChannels; i++) {
+		if (snapshot->clipRate[i] > clipRate) {
+			fprintf(file, "WARNING: %s channel %i clipping %.1f%% of samples.\n",
+					snapshot->name, i + 1, snapshot->clipRate[i] * 100);
+			flagged++;
+		} else if (snapshot->run[i] >= snapshot->stuckRun) {
+			fprintf(file, "WARNING: %s channel %i stuck for the last %ld samples.\n",
+					snapshot->name, i + 1, snapshot->run[i]);
+			flagged++;
+		}
+	}
+
+	return flagged;
+}
+
+void printStatsSnapshot(const StatsSnapshot* snapshot, FILE* file) {
+
+	fprintf(file, "%s Stats: %ld samples\n", snapshot->name, snapshot->count);
+	fprintf(file, "Channel\tMean\tStd\tMin\tMax\tClipped\tCrossings\tLongest Run\n");
+	for (int i = 0; i < snapshot->numChannels; i++) {
+		fprintf(file, "%i\t%f\t%f\t%f\t%f\t%.2f%%\t%.3f\t%ld\n", i + 1, snapshot->mean[i], snapshot->std[i],
+				snapshot->min[i], snapshot->max[i], snapshot->clipRate[i] * 100,
+				snapshot->crossingRate[i], snapshot->longestRun[i]);
+	}
+}
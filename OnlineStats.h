@@ -0,0 +1,116 @@
+/*
+ * Name: OnlineStats.h
+ * Author: Elijah Pivo
+ *
+ * Running per channel quality statistics for a sensor.
+ *
+ * Every read updates, per channel: Welford mean and variance, min and max,
+ * how many samples were at or past the clip limits (saturated or railing),
+ * how many times the signal crossed its running mean and the current and
+ * longest run of identical samples. A channel is stuck while its current
+ * run is at least the table's stuckRun, so a sensor that froze once and
+ * recovered isn't reported for the rest of the session. Each update is O(1) per channel with
+ * no allocation, and the state is kept as one array per statistic so a read
+ * updates every channel in a single pass the compiler can vectorize.
+ *
+ * One thread updates a table. Any other thread can take a consistent
+ * snapshot at any time without blocking it: updates are bracketed by a
+ * sequence count (a seqlock), readers copy and retry if it changed.
+ */
+
+#ifndef ONLINESTATS_H
+#define ONLINESTATS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "CacheLine.h"
+
+#define STATS_MAX_CHANNELS 24
+#define STATS_STUCK_RUN 100 //default identical samples in a row before a channel counts as stuck
+
+typedef struct {
+	const char* name;
+	int numChannels;
+	float clipLow[STATS_MAX_CHANNELS];
+	float clipHigh[STATS_MAX_CHANNELS];
+	long stuckRun; //identical samples in a row that count as stuck, set to about a second of the sensor's samples
+
+	//odd while an update is in progress
+	volatile unsigned sequence CACHE_ALIGNED;
+
+	long count;
+	double mean[STATS_MAX_CHANNELS];
+	double m2[STATS_MAX_CHANNELS]; //sum of squared differences from the mean
+	float min[STATS_MAX_CHANNELS];
+	float max[STATS_MAX_CHANNELS];
+	long clipped[STATS_MAX_CHANNELS];
+	long crossings[STATS_MAX_CHANNELS];
+	float last[STATS_MAX_CHANNELS];
+	int above[STATS_MAX_CHANNELS]; //last sample was above the running mean
+	long run[STATS_MAX_CHANNELS]; //identical samples in a row
+	long longestRun[STATS_MAX_CHANNELS];
+} OnlineStats;
+
+/*
+ * Read only copy of a table, derived values filled in.
+ */
+typedef struct {
+	const char* name;
+	int numChannels;
+	long count;
+	float mean[STATS_MAX_CHANNELS];
+	float std[STATS_MAX_CHANNELS];
+	float min[STATS_MAX_CHANNELS];
+	float max[STATS_MAX_CHANNELS];
+	float clipRate[STATS_MAX_CHANNELS]; //fraction of samples at or past a clip limit
+	float crossingRate[STATS_MAX_CHANNELS]; //mean crossings per sample
+	long run[STATS_MAX_CHANNELS]; //identical samples in a row up to the newest
+	long longestRun[STATS_MAX_CHANNELS];
+	long stuckRun;
+} StatsSnapshot;
+
+/*
+ * Clears a table. Samples <= clipLow or >= clipHigh count as clipped, use
+ * -INFINITY and INFINITY for a sensor that can't saturate. stuckRun starts
+ * at STATS_STUCK_RUN. Returns 1 if succeeded, -1 if there are too many channels.
+ */
+int initializeOnlineStats(OnlineStats* stats, const char* name, int numChannels, float clipLow, float clipHigh);
+
+/*
+ * Adds one read, numChannels values. Only one thread may update a table.
+ */
+void updateOnlineStats(OnlineStats* stats, const float values[]);
+
+/*
+ * Adds rows reads stored one after another (a block of EMG samples), under
+ * a single sequence update.
+ */
+void updateOnlineStatsBlock(OnlineStats* stats, const float values[], int rows);
+
+/*
+ * Same as updateOnlineStatsBlock for a block of device counts, which stay
+ * counts, so the clip limits have to be in counts too.
+ */
+void updateOnlineStatsCounts(OnlineStats* stats, const signed short values[], int rows);
+
+/*
+ * Copies a consistent view of the table, safe to call from any thread
+ * while it's being updated.
+ */
+void snapshotOnlineStats(const OnlineStats* stats, StatsSnapshot* snapshot);
+
+/*
+ * Prints a line for each channel that is clipping more than clipRate of its
+ * samples, or is stuck now. Returns the number of channels flagged.
+ * Formats and writes to file, so keep it off the real time threads.
+ */
+int printStatsWarnings(const StatsSnapshot* snapshot, float clipRate, FILE* file);
+
+/*
+ * Prints every channel's statistics.
+ */
+void printStatsSnapshot(const StatsSnapshot* snapshot, FILE* file);
+
+#endif
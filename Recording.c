@@ -0,0 +1,823 @@
+/*
+ * Name: Recording.c
+ * Author: Elijah Pivo
+ *
+ * Offline access to recorded sessions, for converting and querying them.
+ */
+
+#include <time.h>
+
+#include "Recording.h"
+
+#define FIELD_SZ 64 //longest number handed to strtod
+
+typedef struct {
+	char* bytes;
+	size_t length;
+	size_t capacity;
+	long rows;
+	long missedRows;
+	size_t bytesDecoded; //of the chunk, the rest was passed over by time
+
+	//rows kept, column file output only
+	double* time;
+	float* values; //row major
+	uint8_t* flags;
+	long rowCapacity;
+} ChunkOutput;
+
+typedef struct {
+	const Recording* Recording;
+	const RecordingQuery* query;
+	const int* channels;
+	int numChannels;
+	ChunkOutput* outputs;
+	int firstChunk;
+} QueryWork;
+
+typedef struct {
+	int (*task)(void* context, int index);
+	void* context;
+	int count;
+	volatile int next;
+	volatile int failed;
+} ParallelWork;
+
+//exact powers of ten, a decimal of up to 15 digits divided by one is correctly rounded
+static const double powersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+};
+
+static double seconds(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec * .000000001;
+}
+
+static void* parallelWorker(void* arg) {
+
+	ParallelWork* work = arg;
+
+	while (1 == 1) {
+		int index = __sync_fetch_and_add(&work->next, 1);
+		if (index >= work->count || work->failed) {
+			return NULL;
+		}
+		if (work->task(work->context, index) != 1) {
+			work->failed = 1;
+		}
+	}
+}
+
+/*
+ * Runs task for every index in [0, count) on up to threads threads.
+ * Returns 1 if every task succeeded, -1 otherwise.
+ */
+static int runParallel(int threads, int count, int (*task)(void* context, int index), void* context) {
+
+	ParallelWork work = {task, context, count, 0, 0};
+	pthread_t workers[RECORDING_MAX_THREADS];
+
+	if (threads > count) {
+		threads = count;
+	}
+
+	//the calling thread is one of the workers
+	int started = 0;
+	while (started < threads - 1 && pthread_create(&workers[started], NULL, parallelWorker, &work) == 0) {
+		started++;
+	}
+	parallelWorker(&work);
+	for (int i = 0; i < started; i++) {
+		pthread_join(workers[i], NULL);
+	}
+
+	return work.failed ? -1 : 1;
+}
+
+/*
+ * Parses a number filling [p, end). Plain decimals like the ones the
+ * recorder prints are parsed here, anything else (exponents, nan, inf,
+ * long values) goes through strtod. Returns 1 if the whole field was a
+ * number, -1 otherwise.
+ */
+static int parseField(const char* p, const char* end, double* value) {
+
+	const char* start = p;
+	int negative = 0;
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int scale = 0;
+
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	while (p < end && *p >= '0' && *p <= '9') {
+		mantissa = mantissa * 10 + (*p++ - '0');
+		digits++;
+	}
+	if (p < end && *p == '.') {
+		p++;
+		while (p < end && *p >= '0' && *p <= '9') {
+			mantissa = mantissa * 10 + (*p++ - '0');
+			digits++;
+			scale++;
+		}
+	}
+
+	if (p == end && digits > 0 && digits <= 15) {
+		*value = mantissa / powersOfTen[scale];
+		if (negative) {
+			*value = -*value;
+		}
+		return 1;
+	}
+
+	//mapped text isn't terminated, strtod needs a copy
+	char field[FIELD_SZ];
+	char* stop;
+	if (end - start >= FIELD_SZ || end == start) {
+		return -1;
+	}
+	memcpy(field, start, end - start);
+	field[end - start] = '\0';
+	*value = strtod(field, &stop);
+	return *stop == '\0' ? 1 : -1;
+}
+
+/*
+ * Splits a line into fields, tab separated, a trailing tab or carriage
+ * return doesn't start one. Returns the number of fields, at most max.
+ */
+static int splitFields(const char* p, const char* end, const char* starts[], const char* ends[], int max) {
+
+	int fields = 0;
+
+	while (end > p && (end[-1] == '\r' || end[-1] == '\t' || end[-1] == ' ')) {
+		end--;
+	}
+
+	while (p < end && fields < max) {
+		const char* tab = memchr(p, '\t', end - p);
+		if (tab == NULL) {
+			tab = end;
+		}
+		starts[fields] = p;
+		ends[fields] = tab;
+		fields++;
+		p = tab + 1;
+	}
+
+	return fields;
+}
+
+static int reserveBytes(ChunkOutput* output, size_t more) {
+
+	if (output->length + more <= output->capacity) {
+		return 1;
+	}
+
+	size_t capacity = output->capacity > 0 ? output->capacity : 64 * 1024;
+	while (capacity < output->length + more) {
+		capacity *= 2;
+	}
+	char* bytes = realloc(output->bytes, capacity);
+	if (bytes == NULL) {
+		fprintf(stderr, "Recording ERROR: Out of memory.\n");
+		return -1;
+	}
+	output->bytes = bytes;
+	output->capacity = capacity;
+	return 1;
+}
+
+static int appendBytes(ChunkOutput* output, const void* bytes, size_t length) {
+
+	if (reserveBytes(output, length) != 1) {
+		return -1;
+	}
+	memcpy(output->bytes + output->length, bytes, length);
+	output->length += length;
+	return 1;
+}
+
+static int appendNumber(ChunkOutput* output, double value) {
+
+	if (reserveBytes(output, FIXED_FORMAT_MAX) != 1) {
+		return -1;
+	}
+	output->length += formatFixed(output->bytes + output->length, value);
+	return 1;
+}
+
+static int reserveRows(ChunkOutput* output, int numChannels) {
+
+	if (output->rows < output->rowCapacity) {
+		return 1;
+	}
+
+	long capacity = output->rowCapacity > 0 ? output->rowCapacity * 2 : 4096;
+	double* time = realloc(output->time, capacity * sizeof(double));
+	float* values = realloc(output->values, capacity * numChannels * sizeof(float));
+	uint8_t* flags = realloc(output->flags, capacity);
+	if (time != NULL) {
+		output->time = time;
+	}
+	if (values != NULL) {
+		output->values = values;
+	}
+	if (flags != NULL) {
+		output->flags = flags;
+	}
+	if (time == NULL || values == NULL || flags == NULL) {
+		fprintf(stderr, "Recording ERROR: Out of memory.\n");
+		return -1;
+	}
+	output->rowCapacity = capacity;
+	return 1;
+}
+
+/*
+ * Adds a CSV row end, the missed read flag.
+ */
+static int endCSVRow(ChunkOutput* output, int flag) {
+	return appendBytes(output, flag ? ",1\n" : ",0\n", 3);
+}
+
+/*
+ * Turns the rows kept for a column file into a block, in the column file
+ * layout. The chunk number is filled in when the block is written.
+ */
+static int writeBlock(ChunkOutput* output, int numChannels) {
+
+	int header[3] = {0, (int) output->rows, numChannels};
+
+	if (output->rows == 0) {
+		return 1;
+	}
+	if (reserveBytes(output, sizeof(header) + output->rows * (sizeof(double) + numChannels * sizeof(float) + 1)) != 1) {
+		return -1;
+	}
+
+	appendBytes(output, header, sizeof(header));
+	appendBytes(output, output->time, output->rows * sizeof(double));
+	for (int c = 0; c < numChannels; c++) {
+		float* column = (float*) (output->bytes + output->length);
+		for (long r = 0; r < output->rows; r++) {
+			memcpy(&column[r], &output->values[r * numChannels + c], sizeof(float));
+		}
+		output->length += output->rows * sizeof(float);
+	}
+	appendBytes(output, output->flags, output->rows);
+
+	return 1;
+}
+
+static int countTextRows(void* context, int index) {
+
+	Recording* Recording = context;
+	RecordingChunk* chunk = &Recording->chunks[index];
+
+	long rows = 0;
+	const char* p = Recording->data + chunk->start;
+	const char* end = Recording->data + chunk->end;
+	while (p < end) {
+		const char* line = memchr(p, '\n', end - p);
+		rows++;
+		p = line != NULL ? line + 1 : end;
+	}
+	chunk->rows = rows;
+	return 1;
+}
+
+static int decodeTextChunk(const QueryWork* work, const RecordingChunk* chunk, ChunkOutput* output) {
+
+	const Recording* Recording = work->Recording;
+	const RecordingQuery* query = work->query;
+	int timeField = Recording->sampleTime == 0;
+	int maxFields = Recording->columns + timeField;
+
+	const char* starts[RECORDING_MAX_COLUMNS + 1];
+	const char* ends[RECORDING_MAX_COLUMNS + 1];
+
+	const char* p = Recording->data + chunk->start;
+	const char* end = Recording->data + chunk->end;
+	for (long row = chunk->firstRow; p < end; row++) {
+
+		const char* lineEnd = memchr(p, '\n', end - p);
+		if (lineEnd == NULL) {
+			lineEnd = end;
+		}
+		const char* line = p;
+		p = lineEnd + 1;
+
+		int flag = 0;
+		if (line < lineEnd && *line == '*') {
+			flag = 1;
+			line++;
+		}
+		int fields = splitFields(line, lineEnd, starts, ends, maxFields);
+		if (fields == 0) {
+			continue; //blank line
+		}
+
+		double time = row * Recording->sampleTime;
+		if (timeField && parseField(starts[0], ends[0], &time) != 1) {
+			continue; //cut off line
+		}
+		if (time < query->startTime || time >= query->endTime) {
+			continue;
+		}
+
+		if (query->output == RECORDING_CSV) {
+			//fields go out as they were recorded
+			if (timeField) {
+				appendBytes(output, starts[0], ends[0] - starts[0]);
+			} else {
+				appendNumber(output, time);
+			}
+			for (int c = 0; c < work->numChannels; c++) {
+				int field = work->channels[c] + timeField;
+				appendBytes(output, ",", 1);
+				if (field < fields) {
+					appendBytes(output, starts[field], ends[field] - starts[field]);
+				}
+			}
+			if (endCSVRow(output, flag) != 1) {
+				return -1;
+			}
+		} else {
+			if (reserveRows(output, work->numChannels) != 1) {
+				return -1;
+			}
+			output->time[output->rows] = time;
+			output->flags[output->rows] = flag;
+			float* values = &output->values[output->rows * work->numChannels];
+			for (int c = 0; c < work->numChannels; c++) {
+				int field = work->channels[c] + timeField;
+				double value;
+				values[c] = field < fields && parseField(starts[field], ends[field], &value) == 1 ? value : NAN;
+			}
+		}
+
+		output->rows++;
+		output->missedRows += flag;
+	}
+
+	return 1;
+}
+
+/*
+ * Copies row r of channel c out of a block's columns, a count as volts.
+ */
+static float columnValue(const char* columns, size_t valueSize, long rows, int c, long r, float gain, float offset) {
+
+	const char* at = columns + ((size_t) c * rows + r) * valueSize;
+	if (valueSize == sizeof(signed short)) {
+		signed short count;
+		memcpy(&count, at, sizeof(count));
+		return offset + gain * count;
+	}
+
+	float value;
+	memcpy(&value, at, sizeof(value));
+	return value;
+}
+
+static int decodeColumnChunk(const QueryWork* work, const RecordingChunk* chunk, ChunkOutput* output) {
+
+	const Recording* Recording = work->Recording;
+	const RecordingQuery* query = work->query;
+	long rows = chunk->rows;
+
+	//blocks aren't aligned in the file, values are copied out
+	const char* time = Recording->data + chunk->start;
+	const char* columns = time + rows * sizeof(double);
+	size_t valueSize = chunk->calibration != 0 ? sizeof(signed short) : sizeof(float);
+	const uint8_t* flags = (const uint8_t*) columns + rows * Recording->columns * valueSize;
+
+	//a count block's kept channels are converted to volts on the way out
+	float gain[RECORDING_MAX_COLUMNS], offset[RECORDING_MAX_COLUMNS];
+	if (chunk->calibration != 0) {
+		const char* calibration = Recording->data + chunk->calibration;
+		for (int c = 0; c < work->numChannels; c++) {
+			memcpy(&gain[c], calibration + work->channels[c] * sizeof(float), sizeof(float));
+			memcpy(&offset[c], calibration + (Recording->columns + work->channels[c]) * sizeof(float), sizeof(float));
+		}
+	}
+
+	//times only go forward, a block outside the range is skipped whole
+	double first, last;
+	memcpy(&first, time, sizeof(double));
+	memcpy(&last, time + (rows - 1) * sizeof(double), sizeof(double));
+	if (last < query->startTime || first >= query->endTime) {
+		return 1;
+	}
+
+	for (long r = 0; r < rows; r++) {
+
+		double t;
+		memcpy(&t, time + r * sizeof(double), sizeof(double));
+		if (t < query->startTime || t >= query->endTime) {
+			continue;
+		}
+
+		if (query->output == RECORDING_CSV) {
+			appendNumber(output, t);
+			for (int c = 0; c < work->numChannels; c++) {
+				float value = columnValue(columns, valueSize, rows, work->channels[c], r, gain[c], offset[c]);
+				appendBytes(output, ",", 1);
+				appendNumber(output, value);
+			}
+			if (endCSVRow(output, flags[r] != 0) != 1) {
+				return -1;
+			}
+		} else {
+			if (reserveRows(output, work->numChannels) != 1) {
+				return -1;
+			}
+			output->time[output->rows] = t;
+			output->flags[output->rows] = flags[r];
+			for (int c = 0; c < work->numChannels; c++) {
+				output->values[output->rows * work->numChannels + c]
+						= columnValue(columns, valueSize, rows, work->channels[c], r, gain[c], offset[c]);
+			}
+		}
+
+		output->rows++;
+		output->missedRows += flags[r] != 0;
+	}
+
+	//only the kept rows were decoded, the rest just had their time looked at
+	output->bytesDecoded = output->rows * (sizeof(double) + Recording->columns * valueSize + 1);
+
+	return 1;
+}
+
+static int decodeChunk(void* context, int index) {
+
+	QueryWork* work = context;
+	const RecordingChunk* chunk = &work->Recording->chunks[work->firstChunk + index];
+	ChunkOutput* output = &work->outputs[index];
+
+	output->length = 0;
+	output->rows = 0;
+	output->missedRows = 0;
+	output->bytesDecoded = 0;
+
+	int result = work->Recording->format == RECORDING_TEXT
+			? decodeTextChunk(work, chunk, output) : decodeColumnChunk(work, chunk, output);
+	if (work->Recording->format == RECORDING_TEXT) {
+		output->bytesDecoded = chunk->end - chunk->start; //every line is parsed for its time
+	}
+	if (result == 1 && work->query->output == RECORDING_COLUMN_FILE) {
+		result = writeBlock(output, work->numChannels);
+	}
+	return result;
+}
+
+static int writeAll(int fd, const void* buffer, size_t size) {
+
+	const uint8_t* bytes = buffer;
+	while (size > 0) {
+		ssize_t written = write(fd, bytes, size);
+		if (written <= 0) {
+			if (written == -1 && errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		bytes += written;
+		size -= written;
+	}
+	return 1;
+}
+
+/*
+ * Counts the channels of the first row of a text file.
+ */
+static int countTextColumns(const Recording* Recording) {
+
+	const char* starts[RECORDING_MAX_COLUMNS + 2];
+	const char* ends[RECORDING_MAX_COLUMNS + 2];
+
+	const char* p = Recording->data;
+	const char* end = Recording->data + Recording->size;
+	while (p < end) {
+		const char* lineEnd = memchr(p, '\n', end - p);
+		if (lineEnd == NULL) {
+			lineEnd = end;
+		}
+		if (*p == '*') {
+			p++;
+		}
+		int fields = splitFields(p, lineEnd, starts, ends, RECORDING_MAX_COLUMNS + 2);
+		if (fields > 0) {
+			return fields - (Recording->sampleTime == 0);
+		}
+		p = lineEnd + 1;
+	}
+	return 0;
+}
+
+static int splitText(Recording* Recording) {
+
+	int capacity = Recording->size / RECORDING_CHUNK_SZ + 1;
+	Recording->chunks = malloc(capacity * sizeof(RecordingChunk));
+	if (Recording->chunks == NULL) {
+		return -1;
+	}
+
+	//pieces end at a line end so each can be decoded on its own
+	size_t start = 0;
+	while (start < Recording->size) {
+		size_t end = start + RECORDING_CHUNK_SZ;
+		if (end >= Recording->size) {
+			end = Recording->size;
+		} else {
+			const char* line = memchr(Recording->data + end, '\n', Recording->size - end);
+			end = line != NULL ? (size_t) (line - Recording->data) + 1 : Recording->size;
+		}
+		RecordingChunk* chunk = &Recording->chunks[Recording->numChunks++];
+		chunk->start = start;
+		chunk->end = end;
+		chunk->calibration = 0;
+		start = end;
+	}
+
+	//row numbers time stamp rows without a time column
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	runParallel(threads < RECORDING_MAX_THREADS ? threads : RECORDING_MAX_THREADS, Recording->numChunks,
+			countTextRows, Recording);
+	long rows = 0;
+	for (int i = 0; i < Recording->numChunks; i++) {
+		Recording->chunks[i].firstRow = rows;
+		rows += Recording->chunks[i].rows;
+	}
+
+	Recording->columns = countTextColumns(Recording);
+	if (Recording->columns > RECORDING_MAX_COLUMNS) {
+		fprintf(stderr, "Recording ERROR: More than %i channels.\n", RECORDING_MAX_COLUMNS);
+		return -1;
+	}
+	return 1;
+}
+
+static int splitColumns(Recording* Recording) {
+
+	int capacity = 16;
+	Recording->chunks = malloc(capacity * sizeof(RecordingChunk));
+	Recording->columns = -1;
+
+	//a chunk per block, found by walking the block headers
+	size_t offset = 0;
+	long rows = 0;
+	while (offset < Recording->size && Recording->chunks != NULL) {
+		int header[3];
+		if (Recording->size - offset < sizeof(header)) {
+			break; //cut off block
+		}
+		memcpy(header, Recording->data + offset, sizeof(header));
+		//a count block has its columns negated and gains and offsets after the header
+		int counts = header[2] < 0;
+		int columns = counts ? -header[2] : header[2];
+		size_t calibration = counts ? 2 * columns * sizeof(float) : 0;
+		size_t block = sizeof(header) + calibration
+				+ (size_t) header[1] * (sizeof(double) + columns * (counts ? sizeof(signed short) : sizeof(float)) + 1);
+		if (header[1] <= 0 || columns == 0 || columns > RECORDING_MAX_COLUMNS
+				|| (Recording->columns != -1 && columns != Recording->columns)) {
+			fprintf(stderr, "Recording ERROR: Bad block at byte %zu.\n", offset);
+			return -1;
+		}
+		if (Recording->size - offset < block) {
+			break;
+		}
+
+		if (Recording->numChunks == capacity) {
+			capacity *= 2;
+			RecordingChunk* chunks = realloc(Recording->chunks, capacity * sizeof(RecordingChunk));
+			if (chunks == NULL) {
+				break;
+			}
+			Recording->chunks = chunks;
+		}
+		RecordingChunk* chunk = &Recording->chunks[Recording->numChunks++];
+		chunk->calibration = counts ? offset + sizeof(header) : 0;
+		chunk->start = offset + sizeof(header) + calibration;
+		chunk->end = offset + block;
+		chunk->firstRow = rows;
+		chunk->rows = header[1];
+		Recording->columns = columns;
+
+		rows += header[1];
+		offset += block;
+	}
+
+	if (Recording->chunks == NULL) {
+		return -1;
+	}
+	if (offset < Recording->size) {
+		fprintf(stderr, "Recording WARNING: Ignoring a cut off block at the end.\n");
+	}
+	if (Recording->columns == -1) {
+		Recording->columns = 0;
+	}
+	return 1;
+}
+
+int openRecording(Recording* Recording, const char* file, RecordingFormat format, double sampleTime) {
+
+	Recording->format = format;
+	Recording->sampleTime = format == RECORDING_TEXT ? sampleTime : 0;
+	Recording->data = NULL;
+	Recording->size = 0;
+	Recording->columns = 0;
+	Recording->chunks = NULL;
+	Recording->numChunks = 0;
+
+	int fd = open(file, O_RDONLY);
+	struct stat info;
+	if (fd == -1 || fstat(fd, &info) != 0) {
+		fprintf(stderr, "Recording ERROR: Couldn't open %s.\n", file);
+		if (fd != -1) {
+			close(fd);
+		}
+		return -1;
+	}
+	if (info.st_size == 0) {
+		fprintf(stderr, "Recording ERROR: %s is empty.\n", file);
+		close(fd);
+		return -1;
+	}
+
+	void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); //the mapping keeps the file
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "Recording ERROR: Couldn't map %s.\n", file);
+		return -1;
+	}
+	madvise(data, info.st_size, MADV_SEQUENTIAL);
+	Recording->data = data;
+	Recording->size = info.st_size;
+
+	if ((format == RECORDING_TEXT ? splitText(Recording) : splitColumns(Recording)) != 1) {
+		fprintf(stderr, "Recording ERROR: Couldn't split %s into chunks.\n", file);
+		closeRecording(Recording);
+		return -1;
+	}
+
+	return 1;
+}
+
+void defaultRecordingQuery(RecordingQuery* query) {
+
+	query->startTime = -INFINITY;
+	query->endTime = INFINITY;
+	query->numChannels = 0;
+	query->output = RECORDING_CSV;
+
+	query->threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (query->threads < 1) {
+		query->threads = 1;
+	} else if (query->threads > RECORDING_MAX_THREADS) {
+		query->threads = RECORDING_MAX_THREADS;
+	}
+}
+
+int parseRecordingChannels(RecordingQuery* query, const char* list) {
+
+	const char* p = list;
+	char* end;
+
+	query->numChannels = 0;
+	while (*p != '\0') {
+		long first = strtol(p, &end, 10);
+		long last = first;
+		if (end == p) {
+			return -1;
+		}
+		if (*end == '-') {
+			p = end + 1;
+			last = strtol(p, &end, 10);
+			if (end == p) {
+				return -1;
+			}
+		}
+		if (first < 0 || last < first || last >= RECORDING_MAX_COLUMNS) {
+			return -1;
+		}
+		for (long c = first; c <= last; c++) {
+			if (query->numChannels == RECORDING_MAX_COLUMNS) {
+				return -1;
+			}
+			query->channels[query->numChannels++] = c;
+		}
+		if (*end != ',' && *end != '\0') {
+			return -1;
+		}
+		p = *end == ',' ? end + 1 : end;
+	}
+
+	return query->numChannels > 0 ? 1 : -1;
+}
+
+int queryRecording(const Recording* Recording, const RecordingQuery* query, int fd, RecordingReport* report) {
+
+	double start = seconds();
+	RecordingReport local;
+	if (report == NULL) {
+		report = &local;
+	}
+	memset(report, 0, sizeof(RecordingReport));
+
+	//every channel unless asked for a subset
+	int allChannels[RECORDING_MAX_COLUMNS];
+	QueryWork work = {Recording, query, query->channels, query->numChannels, NULL, 0};
+	if (query->numChannels == 0) {
+		for (int c = 0; c < Recording->columns; c++) {
+			allChannels[c] = c;
+		}
+		work.channels = allChannels;
+		work.numChannels = Recording->columns;
+	}
+	for (int c = 0; c < work.numChannels; c++) {
+		if (work.channels[c] >= Recording->columns) {
+			fprintf(stderr, "Recording ERROR: No channel %i, the recording has %i.\n", work.channels[c], Recording->columns);
+			return -1;
+		}
+	}
+
+	if (query->output == RECORDING_CSV) {
+		char header[32];
+		int ok = writeAll(fd, "time", 4);
+		for (int c = 0; c < work.numChannels && ok == 1; c++) {
+			int length = snprintf(header, sizeof(header), ",c%i", work.channels[c]);
+			ok = writeAll(fd, header, length);
+		}
+		if (ok != 1 || writeAll(fd, ",missed\n", 8) != 1) {
+			fprintf(stderr, "Recording ERROR: Couldn't write the output.\n");
+			return -1;
+		}
+	}
+
+	int batch = query->threads * RECORDING_BATCH;
+	work.outputs = calloc(batch, sizeof(ChunkOutput));
+	if (work.outputs == NULL) {
+		return -1;
+	}
+
+	int result = 1;
+	int blocks = 0;
+	for (int first = 0; first < Recording->numChunks && result == 1; first += batch) {
+
+		int count = Recording->numChunks - first < batch ? Recording->numChunks - first : batch;
+		work.firstChunk = first;
+
+		double decodeStart = seconds();
+		result = runParallel(query->threads, count, decodeChunk, &work);
+		report->decodeTime += seconds() - decodeStart;
+
+		//written in order, column file blocks numbered as they go out
+		for (int i = 0; i < count && result == 1; i++) {
+			ChunkOutput* output = &work.outputs[i];
+			if (query->output == RECORDING_COLUMN_FILE && output->length > 0) {
+				memcpy(output->bytes, &blocks, sizeof(int));
+				blocks++;
+			}
+			if (writeAll(fd, output->bytes, output->length) != 1) {
+				fprintf(stderr, "Recording ERROR: Couldn't write the output.\n");
+				result = -1;
+			}
+			report->rows += output->rows;
+			report->missedRows += output->missedRows;
+			report->bytesOut += output->length;
+			report->bytesIn += output->bytesDecoded;
+			report->bytesSkipped += Recording->chunks[first + i].end - Recording->chunks[first + i].start - output->bytesDecoded;
+		}
+	}
+
+	for (int i = 0; i < batch; i++) {
+		free(work.outputs[i].bytes);
+		free(work.outputs[i].time);
+		free(work.outputs[i].values);
+		free(work.outputs[i].flags);
+	}
+	free(work.outputs);
+
+	report->totalTime = seconds() - start;
+	return result;
+}
+
+void closeRecording(Recording* Recording) {
+
+	if (Recording->data != NULL) {
+		munmap((void*) Recording->data, Recording->size);
+	}
+	free(Recording->chunks);
+	Recording->data = NULL;
+	Recording->chunks = NULL;
+	Recording->numChunks = 0;
+}
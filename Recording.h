@@ -0,0 +1,129 @@
+/*
+ * Name: Recording.h
+ * Author: Elijah Pivo
+ *
+ * Offline access to recorded sessions, for converting and querying them.
+ *
+ * A recording is mapped (mmap) rather than read, and split into chunks
+ * that can each be decoded on their own:
+ * 	text (ArmTrackData.txt, ArmTrackEMGData.txt, ArmTrackMyoData.txt):
+ * 		~RECORDING_CHUNK_SZ byte pieces, each ending at a line end
+ * 	column files (*.columns, see SessionStore.h): one chunk per block
+ * Chunks are decoded in parallel by a pool of threads, a batch at a time,
+ * and written out in order, so memory stays bounded by the batch and not
+ * the session.
+ *
+ * A query keeps rows in a time range and a subset of the channels (the
+ * columns after time) and writes them as CSV or as a column file. Text
+ * fields going to CSV are copied as recorded, not reparsed and reprinted,
+ * the rest are printed by formatFixed, as "%f" would.
+ *
+ * A text row is time followed by its channels, tab separated, a leading
+ * '*' marks a missed read. ArmTrackEMGData.txt rows have no time, each is
+ * timestamped from its row number and the sample time, and hold counts
+ * (volts with ArmTrackEMGCalibration.txt, see EMGCalibration.h); the EMG
+ * column file holds counts with each block's calibration, and reads back
+ * as volts.
+ */
+
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "FastFormat.h"
+
+#define RECORDING_MAX_COLUMNS 256
+#define RECORDING_MAX_THREADS 64
+#define RECORDING_CHUNK_SZ (4 * 1024 * 1024) //bytes of text per chunk
+#define RECORDING_BATCH 4 //chunks per thread decoded before they're written
+
+typedef enum {
+	RECORDING_TEXT,
+	RECORDING_COLUMNS
+} RecordingFormat;
+
+typedef enum {
+	RECORDING_CSV,
+	RECORDING_COLUMN_FILE
+} RecordingOutput;
+
+typedef struct {
+	size_t start; //byte offset, for a column file where the block's time column starts
+	size_t end;
+	size_t calibration; //byte offset of a count block's gains and offsets, 0 for a float block
+	long firstRow; //rows before this chunk
+	long rows;
+} RecordingChunk;
+
+typedef struct {
+	RecordingFormat format;
+	const char* data; //the mapped file
+	size_t size;
+	int columns; //channels per row, time and flags not included
+	double sampleTime; //s between rows of a text file without a time column, 0 if it has one
+
+	RecordingChunk* chunks;
+	int numChunks;
+} Recording;
+
+typedef struct {
+	double startTime; //rows in [startTime, endTime) are kept
+	double endTime;
+	int numChannels; //0 for every channel
+	int channels[RECORDING_MAX_COLUMNS];
+	RecordingOutput output;
+	int threads;
+} RecordingQuery;
+
+typedef struct {
+	long rows; //rows written
+	long missedRows; //rows flagged as a missed read
+	size_t bytesIn; //bytes of the recording decoded
+	size_t bytesSkipped; //bytes of column rows outside the time range, passed over without decoding
+	size_t bytesOut;
+	double decodeTime; //s, wall time in the decoding threads
+	double totalTime; //s
+} RecordingReport;
+
+/*
+ * Maps a recording and splits it into chunks. sampleTime is 0 for a text
+ * file whose rows start with a time, or the s between rows of one without
+ * (ArmTrackEMGData.txt). Ignored for a column file.
+ * Returns 1 if succeeded, -1 (with a message on stderr) otherwise.
+ */
+int openRecording(Recording* Recording, const char* file, RecordingFormat format, double sampleTime);
+
+/*
+ * Sets up a query for every row and channel, as CSV, on every core.
+ */
+void defaultRecordingQuery(RecordingQuery* query);
+
+/*
+ * Parses a channel list like "0-3,12" into query. Returns 1 if
+ * understood, -1 otherwise.
+ */
+int parseRecordingChannels(RecordingQuery* query, const char* list);
+
+/*
+ * Runs query over the whole recording, writing to fd. report may be NULL.
+ * Returns 1 if succeeded, -1 if a chunk couldn't be decoded or written.
+ */
+int queryRecording(const Recording* Recording, const RecordingQuery* query, int fd, RecordingReport* report);
+
+/*
+ * Unmaps a recording.
+ */
+void closeRecording(Recording* Recording);
+
+#endif
@@ -0,0 +1,468 @@
+/*
+ * Name: Replay.c
+ * Author: Elijah Pivo
+ *
+ * Replays a recorded session through the sensor driver interface.
+ *
+ * Record layout (one line per cycle, tab separated):
+ * 	time, IMU_READ_SZ IMU floats, WIRED_CYGL_READ_SZ CyGl values,
+ * 	FORCE_READ_SZ Force floats, then derived columns that are ignored.
+ * EMG layout: samplesPerRead lines of config.channels counts per block, the
+ * EMG has to be configured (configureEMG) like the recorded session was.
+ * Recordings from before the EMG was kept in counts hold volts, a value
+ * with a decimal point is converted back with the EMG's calibration.
+ */
+
+#include <math.h>
+
+#include "Replay.h"
+
+typedef struct {
+	FILE* file;
+	char line[REPLAY_LINE_SZ];
+	int records;
+} ReplayStream;
+
+static char replayDataFile[256];
+static char replayEMGFile[256];
+static double replaySpeed;
+static double replayFirstTime;
+static struct timespec replayStart;
+static volatile int replayFinished;
+
+static ReplayStream IMUStream, CyGlStream, ForceStream;
+#ifdef REPLAY_EMG
+static ReplayStream EMGStream;
+#endif
+
+/*
+ * Sleeps until a sample recorded at recordTime is due.
+ */
+static void waitForSample(double recordTime) {
+
+	if (replaySpeed <= 0) {
+		return;
+	}
+
+	double offset = (recordTime - replayFirstTime) / replaySpeed;
+	if (offset <= 0) {
+		return;
+	}
+
+	struct timespec due = replayStart;
+	due.tv_sec += (time_t) offset;
+	due.tv_nsec += (long) ((offset - (time_t) offset) * 1e9);
+	if (due.tv_nsec >= 1000000000) {
+		due.tv_sec++;
+		due.tv_nsec -= 1000000000;
+	}
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) != 0) {}
+}
+
+static int openStream(ReplayStream* stream, const char* file) {
+
+	stream->records = 0;
+	if ((stream->file = fopen(file, "r")) == NULL) {
+		fprintf(stderr, "Replay ERROR: Couldn't open %s.\n", file);
+		return -1;
+	}
+	return 1;
+}
+
+static void closeStream(ReplayStream* stream) {
+
+	if (stream->file != NULL) {
+		fclose(stream->file);
+		stream->file = NULL;
+	}
+}
+
+/*
+ * Reads the next record and parses the columns up to and including
+ * the ones asked for (pass NULL to skip a sensor). Returns 1 if a
+ * record was read, -1 at the end of the recording.
+ */
+static int nextRecord(ReplayStream* stream, double* time, float* IMURead,
+		uint8_t* CyGlRead, float* ForceRead) {
+
+	if (stream->file == NULL || fgets(stream->line, REPLAY_LINE_SZ, stream->file) == NULL) {
+		replayFinished = 1;
+		return -1;
+	}
+
+	char* p = stream->line;
+	char* end;
+
+	*time = strtod(p, &end);
+	if (end == p) {
+		replayFinished = 1;
+		return -1; //blank or cut off line
+	}
+	p = end;
+
+	for (int i = 0; i < IMU_READ_SZ; i++) {
+		float value = strtof(p, &p);
+		if (IMURead != NULL) {
+			IMURead[i] = value;
+		}
+	}
+	if (CyGlRead == NULL && ForceRead == NULL) {
+		stream->records++;
+		return 1;
+	}
+
+	for (int i = 0; i < WIRED_CYGL_READ_SZ; i++) {
+		long value = strtol(p, &p, 10);
+		if (CyGlRead != NULL) {
+			CyGlRead[i] = (uint8_t) value;
+		}
+	}
+	if (ForceRead == NULL) {
+		stream->records++;
+		return 1;
+	}
+
+	for (int i = 0; i < FORCE_READ_SZ; i++) {
+		ForceRead[i] = strtof(p, &p);
+	}
+
+	stream->records++;
+	return 1;
+}
+
+int startReplay(const char* dataFile, const char* EMGFile, double speed) {
+
+	snprintf(replayDataFile, sizeof(replayDataFile), "%s", dataFile);
+	snprintf(replayEMGFile, sizeof(replayEMGFile), "%s", EMGFile != NULL ? EMGFile : "");
+	replaySpeed = speed;
+	replayFinished = 0;
+
+	//recorded times are relative to the first record
+	ReplayStream first;
+	if (openStream(&first, dataFile) == -1) {
+		return -1;
+	}
+	if (nextRecord(&first, &replayFirstTime, NULL, NULL, NULL) == -1) {
+		fprintf(stderr, "Replay ERROR: %s has no records.\n", dataFile);
+		closeStream(&first);
+		return -1;
+	}
+	closeStream(&first);
+	replayFinished = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &replayStart);
+
+	return 1;
+}
+
+int replayDone() {
+	return replayFinished;
+}
+
+int replayRecords() {
+	return IMUStream.records;
+}
+
+void endReplay() {
+	closeStream(&IMUStream);
+	closeStream(&CyGlStream);
+	closeStream(&ForceStream);
+#ifdef REPLAY_EMG
+	closeStream(&EMGStream);
+#endif
+	replayFinished = 1;
+}
+
+int initializeIMUReplay(IMU* IMU) {
+
+	IMU->id = -1;
+	IMU->hasNewRead1 = 0;
+	IMU->hasNewRead2 = 0;
+	IMU->bufferToUse = 2;
+	for (int i = 0; i < IMU_READ_SZ; i++) {
+		IMU->readBuffer1[i] = 0;
+		IMU->readBuffer2[i] = 0;
+		IMU->read[i] = 0;
+	}
+	IMU->reads = 0;
+	IMU->errors = 0;
+	IMU->consecutiveErrors = 0;
+
+	if (openStream(&IMUStream, replayDataFile) == -1) {
+		return -1;
+	}
+
+	IMU->id = 1;
+	return IMU->id;
+}
+
+int getIMUReplayData(IMU* IMU, double time) {
+
+	(void) time; //recorded times are used instead
+
+	IMU->reads++;
+
+	double recordTime;
+	float* buffer = IMU->reads % 2 == 0 ? IMU->readBuffer1 : IMU->readBuffer2;
+
+	if (nextRecord(&IMUStream, &recordTime, buffer, NULL, NULL) == -1) {
+		return -1;
+	}
+	waitForSample(recordTime);
+
+	if (IMU->reads % 2 == 0) {
+		IMU->readBuffer1Time = recordTime;
+		IMU->hasNewRead1 = 1;
+	} else {
+		IMU->readBuffer2Time = recordTime;
+		IMU->hasNewRead2 = 1;
+	}
+
+	return 1;
+}
+
+void closeIMUReplay(IMU* IMU) {
+
+	closeStream(&IMUStream);
+
+	IMU->id = -1;
+	IMU->hasNewRead1 = 0;
+	IMU->hasNewRead2 = 0;
+	for (int i = 0; i < IMU_READ_SZ; i++) {
+		IMU->readBuffer1[i] = 0;
+		IMU->readBuffer2[i] = 0;
+		IMU->read[i] = 0;
+	}
+	IMU->reads = 0;
+	IMU->errors = 0;
+	IMU->consecutiveErrors = 0;
+}
+
+int initializeCyGlReplay(CyGl* CyGl) {
+
+	CyGl->id = -1;
+	CyGl->hasNewRead1 = 0;
+	CyGl->hasNewRead2 = 0;
+	CyGl->bufferToUse = 2;
+	for (int i = 0; i < WIRED_CYGL_READ_SZ; i++) {
+		CyGl->readBuffer1[i] = 0;
+		CyGl->readBuffer2[i] = 0;
+		CyGl->read[i] = 0;
+	}
+	CyGl->WiredCyGl = 1;
+	CyGl->reads = 0;
+	CyGl->errors = 0;
+	CyGl->consecutiveErrors = 0;
+
+	if (openStream(&CyGlStream, replayDataFile) == -1) {
+		return -1;
+	}
+
+	CyGl->id = 1;
+	return CyGl->id;
+}
+
+int getCyGlReplayData(CyGl* CyGl, double time) {
+
+	(void) time;
+
+	CyGl->reads++;
+
+	double recordTime;
+	uint8_t* buffer = CyGl->reads % 2 == 0 ? CyGl->readBuffer1 : CyGl->readBuffer2;
+
+	if (nextRecord(&CyGlStream, &recordTime, NULL, buffer, NULL) == -1) {
+		return -1;
+	}
+	waitForSample(recordTime);
+
+	if (CyGl->reads % 2 == 0) {
+		CyGl->readBuffer1Time = recordTime;
+		CyGl->hasNewRead1 = 1;
+	} else {
+		CyGl->readBuffer2Time = recordTime;
+		CyGl->hasNewRead2 = 1;
+	}
+
+	return 1;
+}
+
+void closeCyGlReplay(CyGl* CyGl) {
+
+	closeStream(&CyGlStream);
+
+	CyGl->id = -1;
+	CyGl->hasNewRead1 = 0;
+	CyGl->hasNewRead2 = 0;
+	CyGl->bufferToUse = 2;
+	for (int i = 0; i < WIRED_CYGL_READ_SZ; i++) {
+		CyGl->readBuffer1[i] = 0;
+		CyGl->readBuffer2[i] = 0;
+		CyGl->read[i] = 0;
+	}
+	CyGl->reads = 0;
+	CyGl->errors = 0;
+	CyGl->consecutiveErrors = 0;
+}
+
+int initializeForceReplay(Force* Force) {
+
+	Force->id = -1;
+	Force->hasNewRead1 = 0;
+	Force->hasNewRead2 = 0;
+	Force->bufferToUse = 2;
+	for (int i = 0; i < FORCE_READ_SZ; i++) {
+		Force->readBuffer1[i] = 0;
+		Force->readBuffer2[i] = 0;
+		Force->read[i] = 0;
+	}
+	Force->reads = 0;
+	Force->errors = 0;
+	Force->consecutiveErrors = 0;
+
+	if (openStream(&ForceStream, replayDataFile) == -1) {
+		return -1;
+	}
+
+	Force->id = 1;
+	return Force->id;
+}
+
+int getForceReplayData(Force* Force, double time) {
+
+	(void) time;
+
+	Force->reads++;
+
+	double recordTime;
+	float* buffer = Force->reads % 2 == 0 ? Force->readBuffer1 : Force->readBuffer2;
+
+	if (nextRecord(&ForceStream, &recordTime, NULL, NULL, buffer) == -1) {
+		return -1;
+	}
+	waitForSample(recordTime);
+
+	if (Force->reads % 2 == 0) {
+		Force->readBuffer1Time = recordTime;
+		Force->hasNewRead1 = 1;
+	} else {
+		Force->readBuffer2Time = recordTime;
+		Force->hasNewRead2 = 1;
+	}
+
+	return 1;
+}
+
+void closeForceReplay(Force* Force) {
+
+	closeStream(&ForceStream);
+
+	Force->id = -1;
+	Force->hasNewRead1 = 0;
+	Force->hasNewRead2 = 0;
+	for (int i = 0; i < FORCE_READ_SZ; i++) {
+		Force->readBuffer1[i] = 0;
+		Force->readBuffer2[i] = 0;
+		Force->read[i] = 0;
+	}
+	Force->reads = 0;
+	Force->errors = 0;
+	Force->consecutiveErrors = 0;
+}
+
+#ifdef REPLAY_EMG
+
+int initializeEMGReplay(EMG* EMG) {
+
+	EMG->id = -1;
+	EMG->udev = NULL;
+	EMG->hasNewRead1 = 0;
+	EMG->hasNewRead2 = 0;
+	EMG->bufferToUse = 2;
+	EMG->reads = 0;
+	EMG->errors = 0;
+	EMG->consecutiveErrors = 0;
+
+	if (EMG->read == NULL) {
+		return -1;
+	}
+	for (int i = 0; i < EMG->readSize; i++) {
+		EMG->readBuffer1[i] = 0;
+		EMG->readBuffer2[i] = 0;
+		EMG->read[i] = 0;
+	}
+	EMG->hasVolts = 0;
+
+	if (replayEMGFile[0] == '\0' || openStream(&EMGStream, replayEMGFile) == -1) {
+		return -1;
+	}
+
+	EMG->id = 1;
+	return EMG->id;
+}
+
+int getEMGReplayData(EMG* EMG, double time) {
+
+	(void) time;
+
+	EMG->reads++;
+
+	signed short* buffer = EMG->reads % 2 == 0 ? EMG->readBuffer1 : EMG->readBuffer2;
+
+	int channels = EMG->config.channels;
+	for (int i = 0; i < EMG->samplesPerRead; i++) {
+		if (fgets(EMGStream.line, REPLAY_LINE_SZ, EMGStream.file) == NULL) {
+			replayFinished = 1;
+			return -1;
+		}
+		char* p = EMGStream.line;
+		for (int j = 0; j < channels; j++) {
+			char* end;
+			long count = strtol(p, &end, 10);
+			if (*end == '.') {
+				buffer[i * channels + j] = voltsToCount(&EMG->calibration, j, strtof(p, &end));
+			} else {
+				buffer[i * channels + j] = (signed short) count;
+			}
+			p = end;
+		}
+	}
+
+	//EMG blocks aren't time stamped, they follow each other every block time
+	double recordTime = replayFirstTime + EMGStream.records * EMG->samplesPerRead * EMG->sampleTime;
+	EMGStream.records++;
+	waitForSample(recordTime);
+
+	if (EMG->reads % 2 == 0) {
+		EMG->readBuffer1Time = recordTime;
+		EMG->hasNewRead1 = 1;
+	} else {
+		EMG->readBuffer2Time = recordTime;
+		EMG->hasNewRead2 = 1;
+	}
+
+	return 1;
+}
+
+void closeEMGReplay(EMG* EMG) {
+
+	closeStream(&EMGStream);
+
+	EMG->id = -1;
+	EMG->udev = NULL;
+	EMG->hasNewRead1 = 0;
+	EMG->hasNewRead2 = 0;
+	EMG->bufferToUse = 2;
+	for (int i = 0; EMG->read != NULL && i < EMG->readSize; i++) {
+		EMG->readBuffer1[i] = 0;
+		EMG->readBuffer2[i] = 0;
+		EMG->read[i] = 0;
+	}
+	EMG->hasVolts = 0;
+	EMG->reads = 0;
+	EMG->errors = 0;
+	EMG->consecutiveErrors = 0;
+}
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * Name: Replay.h
+ * Author: Elijah Pivo
+ *
+ * Replays a recorded session (ArmTrackData.txt and ArmTrackEMGData.txt)
+ * through the same interface the sensor drivers use.
+ *
+ * getIMUReplayData, getCyGlReplayData, getForceReplayData and
+ * getEMGReplayData take the place of getIMUData, getCyGlData,
+ * getForceData and getEMGData: they fill the sensor's read buffers and
+ * hasNewRead flags the same way, so the drivers' own update*Read
+ * functions and everything downstream run unchanged. Each call waits
+ * until the next recorded sample is due, keeping the original spacing
+ * between samples scaled by the replay speed. Read times are the
+ * recorded times, not the time passed in.
+ *
+ * EMG replay needs the mcc-libusb headers like the EMG driver does, so
+ * it is only compiled with -DREPLAY_EMG.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "IMU.h"
+#include "CyGl.h"
+#include "Force.h"
+#ifdef REPLAY_EMG
+#include "EMG.h"
+#endif
+
+#define REPLAY_REAL_TIME 1.0
+#define REPLAY_AS_FAST_AS_POSSIBLE 0.0
+#define REPLAY_LINE_SZ 8192
+
+/*
+ * Opens a recorded session for replay. speed scales the recorded timing,
+ * 1 for real time, N for N times real time, REPLAY_AS_FAST_AS_POSSIBLE to
+ * never wait. EMGFile may be NULL. Returns 1 if the session was opened,
+ * -1 otherwise.
+ */
+int startReplay(const char* dataFile, const char* EMGFile, double speed);
+
+/*
+ * Returns 1 once any replayed sensor has run out of recorded samples, 0 otherwise.
+ */
+int replayDone();
+
+/*
+ * Returns the number of records the IMU stream has replayed.
+ */
+int replayRecords();
+
+/*
+ * Ends the replay session and closes the recording.
+ */
+void endReplay();
+
+/*
+ * Set up a sensor struct to be filled from the replay like
+ * initialize*() does for the hardware. Returns the device id if
+ * succeeded, -1 if the recording couldn't be opened.
+ */
+int initializeIMUReplay(IMU* IMU);
+int initializeCyGlReplay(CyGl* CyGl);
+int initializeForceReplay(Force* Force);
+
+/*
+ * Replace get*Data(). Fill the next read buffer with the next recorded
+ * sample once it is due. Return 1 if a sample was replayed, -1 at the
+ * end of the recording.
+ */
+int getIMUReplayData(IMU* IMU, double time);
+int getCyGlReplayData(CyGl* CyGl, double time);
+int getForceReplayData(Force* Force, double time);
+
+/*
+ * Replace close*(). Reset the sensor struct and close its stream.
+ */
+void closeIMUReplay(IMU* IMU);
+void closeCyGlReplay(CyGl* CyGl);
+void closeForceReplay(Force* Force);
+
+/*
+ * The EMG has to be configured (configureEMG) like the recorded session.
+ */
+#ifdef REPLAY_EMG
+int initializeEMGReplay(EMG* EMG);
+int getEMGReplayData(EMG* EMG, double time);
+void closeEMGReplay(EMG* EMG);
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Name: SampleRing.c
+ * Author: Elijah Pivo
+ *
+ * Single producer, single consumer ring of sensor reads.
+ */
+
+#include "SampleRing.h"
+
+int initializeSampleRing(SampleRing* ring, Arena* arena, const char* name, int width, unsigned capacity) {
+
+	ring->name = name;
+	ring->width = width;
+	ring->capacity = 1;
+	while (ring->capacity < capacity) {
+		ring->capacity <<= 1;
+	}
+
+	ring->times = arenaAlloc(arena, ring->capacity * sizeof(double), 0);
+	ring->results = arenaAlloc(arena, ring->capacity * sizeof(int), 0);
+	ring->values = arenaAlloc(arena, ring->capacity * width * sizeof(float), 0);
+	if (ring->times == NULL || ring->results == NULL || ring->values == NULL) {
+		fprintf(stderr, "SampleRing ERROR: No room for %s's ring.\n", name);
+		return -1;
+	}
+
+	ring->head = 0;
+	ring->tail = 0;
+	ring->pushed = 0;
+	ring->dropped = 0;
+
+	return 1;
+}
+
+int pushSample(SampleRing* ring, double time, int result, const float values[]) {
+
+	unsigned head = ring->head;
+	if (head - ring->tail >= ring->capacity) {
+		ring->dropped++;
+		return -1;
+	}
+
+	unsigned slot = head & (ring->capacity - 1);
+	ring->times[slot] = time;
+	ring->results[slot] = result;
+	memcpy(&ring->values[slot * ring->width], values, ring->width * sizeof(float));
+	ring->pushed++;
+
+	__sync_synchronize(); //the read is complete before the consumer can see it
+	ring->head = head + 1;
+	return 1;
+}
+
+int popSample(SampleRing* ring, double* time, int* result, float values[]) {
+
+	unsigned tail = ring->tail;
+	if (ring->head == tail) {
+		return 0;
+	}
+	__sync_synchronize(); //head is read before the read it covers
+
+	unsigned slot = tail & (ring->capacity - 1);
+	*time = ring->times[slot];
+	*result = ring->results[slot];
+	memcpy(values, &ring->values[slot * ring->width], ring->width * sizeof(float));
+
+	__sync_synchronize(); //the read is copied before the producer can reuse its slot
+	ring->tail = tail + 1;
+	return 1;
+}
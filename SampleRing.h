@@ -0,0 +1,63 @@
+/*
+ * Name: SampleRing.h
+ * Author: Elijah Pivo
+ *
+ * Single producer, single consumer ring of sensor reads.
+ *
+ * A sensor read faster than it's recorded (Force at 250 Hz, the CyberGlove
+ * drifting against the 100 Hz records) used to hand its reads over through
+ * the driver's two read buffers, so a read was lost whenever two finished
+ * between records. Instead the collection thread pushes every read it
+ * finishes, stamped and flagged, and the print thread pops all of them.
+ * Neither side blocks or locks: the head is only written by the producer
+ * and the tail by the consumer, and a read that finds the ring full is
+ * counted as dropped rather than overwriting one not yet popped.
+ *
+ * Slots come from the locked arena.
+ */
+
+#ifndef SAMPLERING_H
+#define SAMPLERING_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Arena.h"
+#include "CacheLine.h"
+
+typedef struct {
+	const char* name;
+	int width; //floats per read
+	unsigned capacity; //reads, a power of 2
+
+	double* times;
+	int* results; //1 if the read succeeded, -1 otherwise
+	float* values; //read n at values + (n & (capacity - 1)) * width
+
+	volatile unsigned head CACHE_ALIGNED; //written by the producer
+	long pushed;
+	long dropped; //the ring was full
+
+	volatile unsigned tail CACHE_ALIGNED; //written by the consumer
+} SampleRing;
+
+/*
+ * Sets up an empty ring of at least capacity reads of width floats,
+ * allocated from the arena. Returns 1 if succeeded, -1 if the arena was
+ * too small.
+ */
+int initializeSampleRing(SampleRing* ring, Arena* arena, const char* name, int width, unsigned capacity);
+
+/*
+ * Adds a read, result as the driver returned it. Producer only.
+ * Returns 1, -1 if the ring was full and the read was dropped.
+ */
+int pushSample(SampleRing* ring, double time, int result, const float values[]);
+
+/*
+ * Copies the oldest read out of the ring, consumer only.
+ * Returns 1, 0 if the ring was empty.
+ */
+int popSample(SampleRing* ring, double* time, int* result, float values[]);
+
+#endif
@@ -0,0 +1,263 @@
+/*
+ * Name: Scheduler.c
+ * Author: Elijah Pivo
+ *
+ * Multi-rate release scheduler for the data collection threads.
+ * Response time analysis as in:
+ * 	M. Joseph, P. Pandya, "Finding Response Times in a Real-Time
+ * 	System", 1986.
+ */
+
+#include "Scheduler.h"
+#include "Trace.h"
+
+static int64_t gcd(int64_t a, int64_t b) {
+	while (b != 0) {
+		int64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/*
+ * Returns 1 if no earlier task has the same period.
+ */
+static int firstWithPeriod(const Scheduler* Scheduler, int task) {
+	for (int i = 0; i < task; i++) {
+		if (Scheduler->tasks[i].period == Scheduler->tasks[task].period) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Returns 1 if two tasks can run on the same core.
+ */
+static int shareCore(const SchedulerTask* a, const SchedulerTask* b) {
+	return a->cpus == 0 || b->cpus == 0 || (a->cpus & b->cpus) != 0;
+}
+
+/*
+ * Returns 1 if a task counts against a core.
+ */
+static int onCore(const SchedulerTask* task, int cpu) {
+	return task->cpus == 0 || (task->cpus & 1 << cpu) != 0;
+}
+
+int initializeScheduler(Scheduler* Scheduler) {
+
+	Scheduler->numTasks = 0;
+	Scheduler->tick = 0;
+	Scheduler->hyperperiod = 0;
+	Scheduler->utilization = 0;
+	for (int c = 0; c < SCHEDULER_MAX_CPUS; c++) {
+		Scheduler->coreUtilization[c] = 0;
+	}
+	Scheduler->now = -1; //nothing released yet
+
+	return 1;
+}
+
+int addSchedulerTask(Scheduler* Scheduler, const char* name, long period, long phase, long cost, int cpus) {
+
+	if (Scheduler->numTasks >= SCHEDULER_MAX_TASKS) {
+		fprintf(stderr, "Scheduler ERROR: Too many tasks, %s not added.\n", name);
+		return -1;
+	}
+	if (period <= 0 || phase < 0 || phase >= period || cost < 0) {
+		fprintf(stderr, "Scheduler ERROR: %s needs period > 0, 0 <= phase < period and cost >= 0.\n", name);
+		return -1;
+	}
+	if (cpus < 0 || cpus >= 1 << SCHEDULER_MAX_CPUS) {
+		fprintf(stderr, "Scheduler ERROR: %s is pinned past the last of %i cores.\n", name, SCHEDULER_MAX_CPUS);
+		return -1;
+	}
+
+	SchedulerTask* task = &Scheduler->tasks[Scheduler->numTasks];
+	task->name = name;
+	task->period = period;
+	task->phase = phase;
+	task->cost = cost;
+	task->cpus = cpus;
+	task->priority = 0;
+	task->response = 0;
+	task->released = 0;
+	task->pending = 0;
+	task->releases = 0;
+	task->completions = 0;
+	task->overruns = 0;
+
+	return Scheduler->numTasks++;
+}
+
+int configureScheduler(Scheduler* Scheduler, int lowPriority, int highPriority) {
+
+	int n = Scheduler->numTasks;
+	if (n == 0) {
+		fprintf(stderr, "Scheduler ERROR: No tasks.\n");
+		return -1;
+	}
+
+	//timeline
+	Scheduler->tick = 0;
+	Scheduler->hyperperiod = 1;
+	for (int i = 0; i < n; i++) {
+		SchedulerTask* task = &Scheduler->tasks[i];
+		Scheduler->tick = gcd(Scheduler->tick, task->period);
+		Scheduler->tick = gcd(Scheduler->tick, task->phase);
+		Scheduler->hyperperiod = Scheduler->hyperperiod / gcd(Scheduler->hyperperiod, task->period) * task->period;
+	}
+	Scheduler->now = -1;
+
+	//load on each core, a task that can run on several counts on all of them
+	Scheduler->utilization = 0;
+	for (int c = 0; c < SCHEDULER_MAX_CPUS; c++) {
+		Scheduler->coreUtilization[c] = 0;
+		for (int i = 0; i < n; i++) {
+			if (onCore(&Scheduler->tasks[i], c)) {
+				Scheduler->coreUtilization[c] += Scheduler->tasks[i].cost / (double) Scheduler->tasks[i].period;
+			}
+		}
+		if (Scheduler->coreUtilization[c] > Scheduler->utilization) {
+			Scheduler->utilization = Scheduler->coreUtilization[c];
+		}
+	}
+
+	//rate monotonic priorities, one level per distinct period
+	int levels = 0;
+	for (int i = 0; i < n; i++) {
+		levels += firstWithPeriod(Scheduler, i);
+	}
+	for (int i = 0; i < n; i++) {
+		int rank = 0; //distinct periods shorter than this one
+		for (int j = 0; j < n; j++) {
+			if (firstWithPeriod(Scheduler, j) && Scheduler->tasks[j].period < Scheduler->tasks[i].period) {
+				rank++;
+			}
+		}
+		Scheduler->tasks[i].priority = levels == 1 ? highPriority
+				: highPriority - rank * (highPriority - lowPriority) / (levels - 1);
+	}
+
+	for (int c = 0; c < SCHEDULER_MAX_CPUS; c++) {
+		if (Scheduler->coreUtilization[c] > 1) {
+			fprintf(stderr, "Scheduler ERROR: Core %i overloaded, utilization %.3f.\n", c, Scheduler->coreUtilization[c]);
+			return -1;
+		}
+	}
+
+	//worst case response times against the tasks sharing a core,
+	//equal priorities share the core round robin so count as interference
+	int ok = 1;
+	for (int i = 0; i < n; i++) {
+		SchedulerTask* task = &Scheduler->tasks[i];
+		long response = task->cost;
+		long last = -1;
+
+		while (response != last && response <= task->period) {
+			last = response;
+			response = task->cost;
+			for (int j = 0; j < n; j++) {
+				SchedulerTask* other = &Scheduler->tasks[j];
+				if (j != i && other->priority >= task->priority && shareCore(task, other)) {
+					response += (last + other->period - 1) / other->period * other->cost;
+				}
+			}
+		}
+
+		task->response = response;
+		if (response > task->period) {
+			fprintf(stderr, "Scheduler ERROR: %s can miss its period, response %ld us > period %ld us.\n",
+					task->name, response, task->period);
+			ok = -1;
+		}
+	}
+
+	for (int c = 0; ok == 1 && c < SCHEDULER_MAX_CPUS; c++) {
+		int tasks = 0;
+		for (int i = 0; i < n; i++) {
+			tasks += onCore(&Scheduler->tasks[i], c);
+		}
+		if (tasks > 0 && Scheduler->coreUtilization[c] > tasks * (pow(2, 1.0 / tasks) - 1)) {
+			//still schedulable, just not by the simple bound
+			fprintf(stderr, "Scheduler: Core %i utilization %.3f is over the rate monotonic bound, response times checked.\n",
+					c, Scheduler->coreUtilization[c]);
+		}
+	}
+
+	return ok;
+}
+
+int64_t nextSchedulerRelease(Scheduler* Scheduler) {
+
+	int64_t next = -1;
+
+	for (int i = 0; i < Scheduler->numTasks; i++) {
+		SchedulerTask* task = &Scheduler->tasks[i];
+		int64_t release;
+		if (Scheduler->now < task->phase) {
+			release = task->phase;
+		} else {
+			release = task->phase + ((Scheduler->now - task->phase) / task->period + 1) * task->period;
+		}
+		if (next == -1 || release < next) {
+			next = release;
+		}
+	}
+
+	for (int i = 0; i < Scheduler->numTasks; i++) {
+		SchedulerTask* task = &Scheduler->tasks[i];
+		task->released = next >= task->phase && (next - task->phase) % task->period == 0;
+	}
+
+	Scheduler->now = next;
+	return next;
+}
+
+int isTaskReleased(Scheduler* Scheduler, int task, int ready) {
+
+	SchedulerTask* t = &Scheduler->tasks[task];
+
+	if (t->released == 1) {
+		t->released = 0;
+		if (!ready) {
+			//still busy with the last release
+			TRACE_INSTANT("overrun");
+			t->overruns++;
+			t->pending = 1;
+			return 0;
+		}
+		t->pending = 0;
+		t->releases++;
+		TRACE_INSTANT(t->name);
+		return 1;
+	}
+
+	if (t->pending == 1 && ready) {
+		//late, but before the next release
+		t->pending = 0;
+		t->releases++;
+		TRACE_INSTANT(t->name);
+		return 1;
+	}
+
+	return 0;
+}
+
+void completeSchedulerTask(Scheduler* Scheduler, int task) {
+	__sync_fetch_and_add(&Scheduler->tasks[task].completions, 1); //reads are done before the print thread sees this
+}
+
+void printSchedule(const Scheduler* Scheduler, FILE* file) {
+
+	fprintf(file, "Tick: %ld us\tHyperperiod: %lld us\tUtilization: %.3f (busiest core)\n",
+			Scheduler->tick, (long long) Scheduler->hyperperiod, Scheduler->utilization);
+	fprintf(file, "Task\tPeriod\tPhase\tCost\tCores\tPriority\tResponse\tReleases\tCompleted\tOverruns\n");
+	for (int i = 0; i < Scheduler->numTasks; i++) {
+		const SchedulerTask* task = &Scheduler->tasks[i];
+		fprintf(file, "%s\t%ld\t%ld\t%ld\t%#x\t%i\t%ld\t%ld\t%ld\t%ld\n", task->name, task->period, task->phase,
+				task->cost, task->cpus, task->priority, task->response, task->releases, task->completions, task->overruns);
+	}
+}
@@ -0,0 +1,113 @@
+/*
+ * Name: Scheduler.h
+ * Author: Elijah Pivo
+ *
+ * Multi-rate release scheduler for the data collection threads.
+ *
+ * Every task (a sensor read or the print/save stage) declares its own
+ * period, phase and worst case CPU time per release, all in microseconds.
+ * Releases follow a fixed timeline that repeats every hyperperiod (the
+ * least common multiple of the periods). Thread priorities are assigned
+ * rate monotonic (shorter period, higher priority) and the task set is
+ * checked for overload before recording starts: utilization of each core,
+ * then worst case response time of every task against its period.
+ *
+ * Each task names the cores its thread is pinned to (see ThreadPlan.h) and
+ * is analysed against the tasks that can share a core with it, partitioned
+ * fixed priority scheduling. A task pinned to several cores is counted on
+ * each of them and one that may run anywhere (cpus 0) on every core, so
+ * the analysis stays an upper bound whatever core it ends up on.
+ *
+ * A release that finds its task still busy with the previous one is an
+ * overrun. The release is held and handed out as soon as the task is
+ * ready again, unless the next release comes first.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "CacheLine.h"
+
+#define SCHEDULER_MAX_TASKS 8
+#define SCHEDULER_MAX_CPUS 8
+
+typedef struct {
+	const char* name;
+	long period; //us
+	long phase;  //us, first release
+	long cost;   //us, worst case CPU time per release
+	int cpus;    //mask of cores the task's thread is pinned to, 0 if any
+	int priority;
+	long response; //us, worst case response time, set by configureScheduler
+
+	int released; //released at the current release point
+	int pending;  //release held because the task was busy
+	long releases;
+	long overruns;
+
+	volatile long completions CACHE_ALIGNED; //counted by the task's own thread
+} SchedulerTask;
+
+typedef struct {
+	SchedulerTask tasks[SCHEDULER_MAX_TASKS];
+	int numTasks;
+
+	long tick;           //us, greatest common divisor of the periods and phases
+	int64_t hyperperiod; //us, least common multiple of the periods
+	double utilization;  //of the busiest core
+	double coreUtilization[SCHEDULER_MAX_CPUS];
+
+	int64_t now; //us since the start of the schedule, the current release point, 64 bit so it outlasts a session
+} Scheduler;
+
+/*
+ * Sets up an empty schedule. Returns 1.
+ */
+int initializeScheduler(Scheduler* Scheduler);
+
+/*
+ * Adds a task. Periods, phases and costs are in microseconds, cpus is a
+ * mask of the cores it runs on (THREAD_PLAN_CPU(n) values), 0 for any.
+ * Returns the task's index, -1 if the task is invalid or there are
+ * already SCHEDULER_MAX_TASKS tasks.
+ */
+int addSchedulerTask(Scheduler* Scheduler, const char* name, long period, long phase, long cost, int cpus);
+
+/*
+ * Computes the tick and hyperperiod, assigns rate monotonic priorities
+ * between lowPriority and highPriority and checks the task set for
+ * overload. Returns 1 if every task meets its period, -1 (with the
+ * reason on stderr) otherwise.
+ */
+int configureScheduler(Scheduler* Scheduler, int lowPriority, int highPriority);
+
+/*
+ * Moves to the next release point and marks the tasks released there
+ * (see isTaskReleased). Returns the release point in microseconds since
+ * the start of the schedule.
+ */
+int64_t nextSchedulerRelease(Scheduler* Scheduler);
+
+/*
+ * Returns 1 if a task should be handed a release at the current release
+ * point, 0 otherwise. ready says whether the task's thread can take a
+ * release now; a release that can't be taken counts as an overrun and is
+ * held (returns 0).
+ */
+int isTaskReleased(Scheduler* Scheduler, int task, int ready);
+
+/*
+ * Called by a task's thread when it has finished a release.
+ */
+void completeSchedulerTask(Scheduler* Scheduler, int task);
+
+/*
+ * Prints each task's period, phase, priority, response time and counters.
+ */
+void printSchedule(const Scheduler* Scheduler, FILE* file);
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * Name: Serial.c
+ * Author: Elijah Pivo
+ *
+ * Serial transport shared by the tty sensors.
+ */
+
+#include "Serial.h"
+
+void defaultSerialOptions(SerialOptions* options, speed_t baud) {
+
+	options->baud = baud;
+	options->lowLatency = 1;
+	options->blocking = 0;
+	options->minBytes = 0;
+	options->interByteTimeout = 0;
+}
+
+int openSerialPort(const char* device, const SerialOptions* options) {
+
+	int fd;
+
+	//non-blocking so a missing device can't hang the open on carrier detect
+	if ((fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK)) == -1) {
+		return -1;
+	}
+
+	if (configureSerialPort(fd, options) != 1) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int configureSerialPort(int fd, const SerialOptions* options) {
+
+	struct termios settings;
+	if (tcgetattr(fd, &settings) == -1) {
+		return -1;
+	}
+
+	cfmakeraw(&settings);
+	cfsetispeed(&settings, options->baud);
+	cfsetospeed(&settings, options->baud);
+
+	//8N1, receiver on, ignore modem lines, no flow control
+	settings.c_cflag |= (CLOCAL | CREAD);
+	settings.c_cflag &= ~(PARENB | CSTOPB | CSIZE | CRTSCTS);
+	settings.c_cflag |= CS8;
+	settings.c_iflag &= ~(IXON | IXOFF | IXANY);
+
+	if (options->blocking) {
+		settings.c_cc[VMIN] = options->minBytes;
+		settings.c_cc[VTIME] = options->interByteTimeout;
+	} else {
+		settings.c_cc[VMIN] = 0;
+		settings.c_cc[VTIME] = 0;
+	}
+
+	if (tcsetattr(fd, TCSANOW, &settings) == -1) {
+		return -1;
+	}
+	tcflush(fd, TCIOFLUSH);
+
+	setSerialLowLatency(fd, options->lowLatency);
+
+	return setSerialBlocking(fd, options->blocking);
+}
+
+int setSerialBlocking(int fd, int blocking) {
+
+	int flags = fcntl(fd, F_GETFL, 0);
+	if (flags == -1) {
+		return -1;
+	}
+
+	if (blocking) {
+		flags &= ~O_NONBLOCK;
+	} else {
+		flags |= O_NONBLOCK;
+	}
+
+	if (fcntl(fd, F_SETFL, flags) == -1) {
+		return -1;
+	}
+	return 1;
+}
+
+int setSerialLowLatency(int fd, int lowLatency) {
+
+	struct serial_struct serial;
+	if (ioctl(fd, TIOCGSERIAL, &serial) == -1) {
+		return -1;
+	}
+
+	if (lowLatency) {
+		serial.flags |= ASYNC_LOW_LATENCY;
+	} else {
+		serial.flags &= ~ASYNC_LOW_LATENCY;
+	}
+
+	if (ioctl(fd, TIOCSSERIAL, &serial) == -1) {
+		return -1;
+	}
+	return 1;
+}
+
+int readSerialFrame(int fd, void* buffer, int length, long timeout) {
+
+	struct timespec start, now;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	uint8_t* bytes = buffer;
+	int have = 0;
+
+	while (have < length) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		long left = timeout - ((now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000);
+		if (left <= 0) {
+			//the rest of the frame may still arrive, it can't be mistaken for the next one
+			tcflush(fd, TCIFLUSH);
+			return -1;
+		}
+
+		//poll first so a blocking port never waits past the timeout
+		struct pollfd waitFor = {fd, POLLIN, 0};
+		int ready = poll(&waitFor, 1, (left + 999) / 1000);
+		if (ready == -1 && errno != EINTR) {
+			tcflush(fd, TCIFLUSH);
+			return -1;
+		}
+		if (ready <= 0) {
+			continue;
+		}
+		if (waitFor.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			return -1;
+		}
+
+		ssize_t got = read(fd, bytes + have, length - have);
+		if (got == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+			tcflush(fd, TCIFLUSH);
+			return -1;
+		}
+		if (got > 0) {
+			have += got;
+		}
+	}
+
+	return length;
+}
+
+int serialBytesWaiting(int fd) {
+
+	int result;
+
+	if (ioctl(fd, FIONREAD, &result) == -1) {
+		return -1;
+	}
+
+	return result;
+}
+
+int probeSerialBaud(int fd, SerialOptions* options, const speed_t bauds[], int numBauds,
+		const void* request, int requestLength, const void* expected, int responseLength, long timeout) {
+
+	uint8_t response[responseLength];
+
+	for (int i = 0; i < numBauds; i++) {
+		options->baud = bauds[i];
+		if (configureSerialPort(fd, options) != 1) {
+			continue;
+		}
+		usleep(10000); //10mS, let the line settle at the new rate
+
+		if (write(fd, request, requestLength) != requestLength) {
+			continue;
+		}
+		if (readSerialFrame(fd, response, responseLength, timeout) == responseLength
+				&& (expected == NULL || memcmp(response, expected, responseLength) == 0)) {
+			tcflush(fd, TCIFLUSH); //drop anything that followed
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+long serialBaudRate(speed_t baud) {
+
+	switch (baud) {
+	case B9600: return 9600;
+	case B19200: return 19200;
+	case B38400: return 38400;
+	case B57600: return 57600;
+	case B115200: return 115200;
+	case B230400: return 230400;
+	case B460800: return 460800;
+	case B921600: return 921600;
+	default: return 0;
+	}
+}
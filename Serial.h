@@ -0,0 +1,99 @@
+/*
+ * Name: Serial.h
+ * Author: Elijah Pivo
+ *
+ * Serial transport shared by the tty sensors (IMU chain, CyberGlove, Myo dongle).
+ *
+ * Ports are opened raw, 8N1 with no flow control. A port is either
+ * non-blocking (VMIN and VTIME 0, reads return what's there) or blocking
+ * with an explicit VMIN/VTIME, never the leftover cfmakeraw defaults.
+ * ASYNC_LOW_LATENCY is asked for where the driver supports it, on an FTDI
+ * adapter it drops the 16ms latency timer to 1ms.
+ *
+ * Named to stay clear of wiringSerial (serialOpen, serialDataAvail, ...).
+ */
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <termios.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+
+typedef struct {
+	speed_t baud;
+	int lowLatency; //1 to ask for ASYNC_LOW_LATENCY
+	int blocking; //0 for a non-blocking port
+	int minBytes; //VMIN, blocking ports only
+	int interByteTimeout; //VTIME in tenths of a second, blocking ports only
+} SerialOptions;
+
+/*
+ * Fills options with a non-blocking, low latency port at baud.
+ */
+void defaultSerialOptions(SerialOptions* options, speed_t baud);
+
+/*
+ * Opens and configures a serial port.
+ * Returns the port's fd, -1 if it couldn't be opened or configured.
+ */
+int openSerialPort(const char* device, const SerialOptions* options);
+
+/*
+ * Applies options to an open port, discarding anything unread.
+ * A low latency flag the driver refuses isn't an error.
+ * Returns 1 if configured, -1 otherwise.
+ */
+int configureSerialPort(int fd, const SerialOptions* options);
+
+/*
+ * Sets or clears O_NONBLOCK, leaving the port's other flags alone.
+ * Returns 1 if set, -1 otherwise.
+ */
+int setSerialBlocking(int fd, int blocking);
+
+/*
+ * Asks for (or drops) ASYNC_LOW_LATENCY.
+ * Returns 1 if the driver took it, -1 if it doesn't support it.
+ */
+int setSerialLowLatency(int fd, int lowLatency);
+
+/*
+ * Reads exactly length bytes, waiting at most timeout us for all of them.
+ * Works on blocking and non-blocking ports, a frame split across several
+ * reads is put back together.
+ * Returns length, or -1 on timeout or error. Then the partial frame and
+ * anything waiting behind it are flushed, so the next read starts clean.
+ */
+int readSerialFrame(int fd, void* buffer, int length, long timeout);
+
+/*
+ * Returns the number of bytes waiting to be read, -1 on error.
+ */
+int serialBytesWaiting(int fd);
+
+/*
+ * Finds the fastest rate the device answers at. For each rate in bauds
+ * (fastest first) the port is reconfigured, request is sent and a reply of
+ * responseLength bytes is waited for, at most timeout us. The reply has to
+ * match expected, unless it's NULL, so garbage at a wrong rate doesn't count.
+ * Returns the index of the first rate that answered (left configured in
+ * the port and options), -1 if none did.
+ */
+int probeSerialBaud(int fd, SerialOptions* options, const speed_t bauds[], int numBauds,
+		const void* request, int requestLength, const void* expected, int responseLength, long timeout);
+
+/*
+ * Returns the rate in bits per second of a termios speed, 0 if unknown.
+ */
+long serialBaudRate(speed_t baud);
+
+#endif
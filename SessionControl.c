@@ -0,0 +1,234 @@
+/*
+ * Name: SessionControl.c
+ * Author: Elijah Pivo
+ *
+ * Session switch and status LEDs, kept off the real time path.
+ */
+
+#define _GNU_SOURCE //pthread_setaffinity_np
+
+#include "SessionControl.h"
+
+static SessionSwitch* watched; //wiringPi's handlers don't take an argument
+
+static int64_t now(void) {
+
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	return time.tv_sec * 1000000000LL + time.tv_nsec;
+}
+
+/*
+ * Runs on wiringPi's interrupt thread on every edge.
+ */
+static void switchEdge(void) {
+
+	SessionSwitch* Switch = watched;
+	if (Switch == NULL) {
+		return;
+	}
+
+	Switch->level = digitalRead(Switch->pin);
+	Switch->edgeTime = now();
+	Switch->edges++;
+	__sync_synchronize(); //level and time are out before the waiting thread wakes
+
+	uint64_t one = 1;
+	if (write(Switch->eventFd, &one, sizeof(one)) != sizeof(one)) {
+		//counter is already signalled, the waiting thread will see this edge too
+	}
+}
+
+int initializeSessionSwitch(SessionSwitch* Switch, int pin) {
+
+	Switch->pin = pin;
+	Switch->edges = 0;
+	Switch->edgeTime = now();
+
+	pinMode(pin, INPUT);
+	pullUpDnControl(pin, PUD_UP);
+	Switch->level = digitalRead(pin);
+	Switch->stableLevel = Switch->level;
+
+	Switch->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	Switch->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (Switch->eventFd == -1 || Switch->timerFd == -1) {
+		fprintf(stderr, "SessionControl.c ERROR: Couldn't create the switch's event and timer.\n");
+		closeSessionSwitch(Switch);
+		return -1;
+	}
+
+	watched = Switch;
+	if (wiringPiISR(pin, INT_EDGE_BOTH, switchEdge) < 0) {
+		fprintf(stderr, "SessionControl.c ERROR: Couldn't watch the switch's edges.\n");
+		closeSessionSwitch(Switch);
+		return -1;
+	}
+
+	return 1;
+}
+
+int readSessionSwitch(SessionSwitch* Switch) {
+
+	uint64_t edges;
+	while (read(Switch->eventFd, &edges, sizeof(edges)) == sizeof(edges)) {}
+
+	//a level that hasn't held yet may still be the switch bouncing
+	__sync_synchronize();
+	int level = Switch->level;
+	if (now() - Switch->edgeTime >= SWITCH_DEBOUNCE) {
+		Switch->stableLevel = level;
+	}
+
+	return Switch->stableLevel;
+}
+
+int waitForRelease(SessionSwitch* Switch, const struct timespec* due) {
+
+	struct itimerspec timer = {{0, 0}, *due};
+	if (timerfd_settime(Switch->timerFd, TFD_TIMER_ABSTIME, &timer, NULL) != 0) {
+		return -1;
+	}
+
+	struct pollfd waitFor[2] = {{Switch->timerFd, POLLIN, 0}, {Switch->eventFd, POLLIN, 0}};
+	while (1 == 1) {
+		if (poll(waitFor, 2, -1) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+
+		if (waitFor[0].revents & POLLIN) {
+			uint64_t expirations;
+			if (read(Switch->timerFd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+				return -1;
+			}
+			return 1;
+		}
+		if (waitFor[1].revents & POLLIN) {
+			return 0;
+		}
+	}
+}
+
+void closeSessionSwitch(SessionSwitch* Switch) {
+
+	//wiringPi can't remove a handler, it just stops finding a switch
+	watched = NULL;
+
+	if (Switch->eventFd != -1) {
+		close(Switch->eventFd);
+	}
+	if (Switch->timerFd != -1) {
+		close(Switch->timerFd);
+	}
+	Switch->eventFd = -1;
+	Switch->timerFd = -1;
+}
+
+static void setLEDs(Indicator* Indicator, int green, int red) {
+
+	if (green != Indicator->green) {
+		digitalWrite(Indicator->greenPin, green);
+		Indicator->green = green;
+	}
+	if (red != Indicator->red) {
+		digitalWrite(Indicator->redPin, red);
+		Indicator->red = red;
+	}
+}
+
+static void* indicatorThread(void* arg) {
+
+	Indicator* Indicator = arg;
+
+	if (Indicator->cpus != 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu = 0; cpu < CPU_SETSIZE && cpu < 32; cpu++) {
+			if (Indicator->cpus & (1 << cpu)) {
+				CPU_SET(cpu, &set);
+			}
+		}
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	}
+
+	struct timespec period = {0, INDICATOR_PERIOD};
+
+	while (Indicator->running) {
+
+		int64_t time = now();
+
+		//a new miss restarts the red flash
+		long misses = Indicator->misses;
+		if (misses != Indicator->lastMisses) {
+			Indicator->lastMisses = misses;
+			Indicator->missTime = time;
+		}
+		int missed = time - Indicator->missTime < INDICATOR_MISS_HOLD;
+
+		switch (Indicator->status) {
+		case INDICATOR_OFF:
+			setLEDs(Indicator, 0, 0);
+			break;
+		case INDICATOR_RECORDING:
+			setLEDs(Indicator, !missed, missed);
+			break;
+		case INDICATOR_DEGRADED:
+			setLEDs(Indicator, !missed, missed || time % INDICATOR_BLINK < INDICATOR_BLINK / 2);
+			break;
+		case INDICATOR_RECONNECTING:
+			setLEDs(Indicator, 0, 1);
+			break;
+		case INDICATOR_UPLOADING:
+			setLEDs(Indicator, 1, 1);
+			break;
+		}
+
+		nanosleep(&period, NULL);
+	}
+
+	setLEDs(Indicator, 0, 0);
+	return NULL;
+}
+
+int startIndicator(Indicator* Indicator, int greenPin, int redPin, int cpus, const pthread_attr_t* attributes) {
+
+	Indicator->greenPin = greenPin;
+	Indicator->redPin = redPin;
+	Indicator->cpus = cpus;
+	Indicator->status = INDICATOR_OFF;
+	Indicator->misses = 0;
+	Indicator->lastMisses = 0;
+	Indicator->missTime = now() - INDICATOR_MISS_HOLD;
+	Indicator->running = 1;
+
+	//make sure the first render writes both pins
+	Indicator->green = -1;
+	Indicator->red = -1;
+
+	if (pthread_create(&Indicator->thread, attributes, indicatorThread, Indicator) != 0) {
+		fprintf(stderr, "SessionControl.c ERROR: Couldn't start the indicator thread.\n");
+		Indicator->running = 0;
+		return -1;
+	}
+	return 1;
+}
+
+void setIndicatorStatus(Indicator* Indicator, IndicatorStatus status) {
+	Indicator->status = status;
+}
+
+void reportIndicatorMiss(Indicator* Indicator) {
+	Indicator->misses++;
+}
+
+void stopIndicator(Indicator* Indicator) {
+
+	if (Indicator->running) {
+		Indicator->running = 0;
+		pthread_join(Indicator->thread, NULL);
+	}
+}
@@ -0,0 +1,127 @@
+/*
+ * Name: SessionControl.h
+ * Author: Elijah Pivo
+ *
+ * Session switch and status LEDs, kept off the real time path.
+ *
+ * The switch is watched with an edge interrupt (wiringPiISR). The handler
+ * runs on wiringPi's interrupt thread, notes the pin's level and the time
+ * of the edge and signals an eventfd. The release thread sleeps on a
+ * timerfd set to its next release and that eventfd together
+ * (waitForRelease), so a flipped switch wakes it straight away but a
+ * release cycle never touches a GPIO. A level only counts once it has held
+ * for SWITCH_DEBOUNCE.
+ *
+ * The LEDs belong to an indicator thread that runs at normal priority. The
+ * time critical threads only store a status (recording, degraded,
+ * reconnecting, uploading) or count a missed read, the indicator thread
+ * renders that every INDICATOR_PERIOD and only writes a pin that changes.
+ */
+
+#ifndef SESSIONCONTROL_H
+#define SESSIONCONTROL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "wiringPi.h"
+
+#define SWITCH_DEBOUNCE 50000000LL //ns a level has to hold
+#define INDICATOR_PERIOD 50000000L //ns between LED updates
+#define INDICATOR_MISS_HOLD 100000000LL //ns the red LED stays on after a missed read
+#define INDICATOR_BLINK 1000000000LL //ns, blink period while degraded
+
+typedef struct {
+	int pin;
+	int eventFd; //signalled on every edge
+
+	//written by the interrupt handler
+	volatile int level;
+	volatile int64_t edgeTime; //ns, CLOCK_MONOTONIC
+	volatile long edges;
+
+	//written by the thread reading the switch
+	int stableLevel;
+	int timerFd; //next release
+} SessionSwitch;
+
+typedef enum {
+	INDICATOR_OFF, //both off
+	INDICATOR_RECORDING, //green, red flashes on each missed read
+	INDICATOR_DEGRADED, //recording without a sensor that couldn't be reconnected, red blinks
+	INDICATOR_RECONNECTING, //red
+	INDICATOR_UPLOADING //green and red
+} IndicatorStatus;
+
+typedef struct {
+	int greenPin;
+	int redPin;
+	int cpus; //mask of cores the thread may run on, 0 to leave it unpinned
+
+	volatile IndicatorStatus status;
+	volatile long misses; //counted by a single thread
+	volatile int running;
+	pthread_t thread;
+
+	//only touched by the indicator thread
+	long lastMisses;
+	int64_t missTime;
+	int green;
+	int red;
+} Indicator;
+
+/*
+ * Sets up the switch pin (pulled up) and its edge interrupt. Only one
+ * switch can be watched, wiringPi's handlers don't take an argument.
+ * Returns 1 if succeeded, -1 otherwise.
+ */
+int initializeSessionSwitch(SessionSwitch* Switch, int pin);
+
+/*
+ * Returns the switch's debounced level, 1 or 0. Clears any edge
+ * notifications. Only one thread may read the switch.
+ */
+int readSessionSwitch(SessionSwitch* Switch);
+
+/*
+ * Sleeps until due (CLOCK_MONOTONIC) or until the switch changes.
+ * Returns 1 at the release, 0 if the switch woke it first, -1 on error.
+ */
+int waitForRelease(SessionSwitch* Switch, const struct timespec* due);
+
+/*
+ * Stops watching the switch.
+ */
+void closeSessionSwitch(SessionSwitch* Switch);
+
+/*
+ * Starts the indicator thread, at normal priority. attributes may be NULL.
+ * Returns 1 if started, -1 otherwise.
+ */
+int startIndicator(Indicator* Indicator, int greenPin, int redPin, int cpus, const pthread_attr_t* attributes);
+
+/*
+ * Sets what the LEDs show. Any thread, never blocks.
+ */
+void setIndicatorStatus(Indicator* Indicator, IndicatorStatus status);
+
+/*
+ * Flashes the red LED for a missed read. Only one thread may report misses.
+ */
+void reportIndicatorMiss(Indicator* Indicator);
+
+/*
+ * Stops the indicator thread and turns both LEDs off, the caller owns
+ * the LEDs again.
+ */
+void stopIndicator(Indicator* Indicator);
+
+#endif
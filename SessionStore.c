@@ -0,0 +1,530 @@
+/*
+ * Name: SessionStore.c
+ * Author: Elijah Pivo
+ *
+ * In memory columnar store for a recording session.
+ */
+
+#include "SessionStore.h"
+
+static float* column(const SessionTable* table, int slot, int c) {
+	return table->columns + ((size_t) slot * table->numColumns + c) * table->chunkRows;
+}
+
+static signed short* countColumn(const SessionTable* table, int slot, int c) {
+	return table->counts + ((size_t) slot * table->numColumns + c) * table->chunkRows;
+}
+
+static void closeRun(SessionTable* table) {
+
+	if (table->currentRun == 0) {
+		return;
+	}
+
+	int bin = 0;
+	while (bin < SESSION_RUN_BINS - 1 && table->currentRun > (1L << bin)) {
+		bin++;
+	}
+	table->runLengths[bin]++;
+	table->missedRuns++;
+	if (table->currentRun > table->longestRun) {
+		table->longestRun = table->currentRun;
+	}
+	table->currentRun = 0;
+}
+
+/*
+ * Folds a filled (or the last, partly filled) chunk into the session summary.
+ * One pass per column over contiguous values, a count table's stay counts.
+ */
+static void summarizeChunk(SessionTable* table, int slot, int rows) {
+
+	const double* time = table->time + (size_t) slot * table->chunkRows;
+	const uint8_t* flags = table->flags + (size_t) slot * table->chunkRows;
+
+	for (int c = 0; c < table->numColumns; c++) {
+		float low = table->summary[c].min;
+		float high = table->summary[c].max;
+		double sum = 0, sumSquares = 0;
+
+		if (table->counts != NULL) {
+			const signed short* values = countColumn(table, slot, c);
+			for (int r = 0; r < rows; r++) {
+				low = values[r] < low ? values[r] : low;
+				high = values[r] > high ? values[r] : high;
+				sum += values[r];
+				sumSquares += values[r] * values[r];
+			}
+		} else {
+			const float* values = column(table, slot, c);
+			for (int r = 0; r < rows; r++) {
+				low = values[r] < low ? values[r] : low;
+				high = values[r] > high ? values[r] : high;
+				sum += values[r];
+				sumSquares += values[r] * values[r];
+			}
+		}
+
+		table->summary[c].min = low;
+		table->summary[c].max = high;
+		table->summary[c].sum += sum;
+		table->summary[c].sumSquares += sumSquares;
+	}
+
+	//sample intervals, the first row of the session has none
+	double last = table->lastTime;
+	for (int r = 0; r < rows; r++) {
+		if (table->rows - rows + r > 0) {
+			double interval = time[r] - last;
+			int bin = interval / SESSION_INTERVAL_BIN;
+			bin = bin < 0 ? 0 : bin >= SESSION_INTERVAL_BINS ? SESSION_INTERVAL_BINS - 1 : bin;
+			table->intervals[bin]++;
+			if (interval > table->maxInterval) {
+				table->maxInterval = interval;
+			}
+		}
+		last = time[r];
+	}
+	table->lastTime = last;
+
+	//missed read runs, a run can carry on into the next chunk
+	for (int r = 0; r < rows; r++) {
+		if (flags[r] != 0) {
+			table->currentRun++;
+			table->missedRows++;
+		} else {
+			closeRun(table);
+		}
+	}
+
+	if (!table->reportRMSPerMinute) {
+		return;
+	}
+
+	//RMS per minute, a chunk usually falls in one minute but may straddle two
+	for (int start = 0, end; start < rows; start = end) {
+		int minute = (time[start] - table->firstTime) / 60;
+		for (end = start + 1; end < rows && (int) ((time[end] - table->firstTime) / 60) == minute; end++) {}
+
+		if (minute < 0 || minute >= SESSION_MAX_MINUTES) {
+			continue;
+		}
+		for (int c = 0; c < table->numColumns; c++) {
+			double sum = 0, sumSquares = 0;
+			if (table->counts != NULL) {
+				const signed short* values = countColumn(table, slot, c);
+				for (int r = start; r < end; r++) {
+					sum += values[r];
+					sumSquares += values[r] * values[r];
+				}
+				table->minuteSums[minute * table->numColumns + c] += sum;
+			} else {
+				const float* values = column(table, slot, c);
+				for (int r = start; r < end; r++) {
+					sumSquares += values[r] * values[r];
+				}
+			}
+			table->minuteSquares[minute * table->numColumns + c] += sumSquares;
+		}
+		table->minuteRows[minute] += end - start;
+	}
+}
+
+static int writeAll(int fd, const void* buffer, size_t size) {
+
+	const uint8_t* bytes = buffer;
+	while (size > 0) {
+		ssize_t written = write(fd, bytes, size);
+		if (written <= 0) {
+			return -1;
+		}
+		bytes += written;
+		size -= written;
+	}
+	return 1;
+}
+
+/*
+ * Writes a chunk still in memory to the column file, on the writer thread.
+ */
+static int spillChunk(SessionTable* table, int chunk, int rows) {
+
+	int slot = chunk % table->memoryChunks;
+	int counts = table->counts != NULL;
+	int header[3] = {chunk, rows, counts ? -table->numColumns : table->numColumns};
+
+	if (writeAll(table->spillFile, header, sizeof(header)) != 1
+			|| (counts && (writeAll(table->spillFile, table->gain, table->numColumns * sizeof(float)) != 1
+					|| writeAll(table->spillFile, table->offset, table->numColumns * sizeof(float)) != 1))
+			|| writeAll(table->spillFile, table->time + (size_t) slot * table->chunkRows, rows * sizeof(double)) != 1) {
+		fprintf(stderr, "Session Store ERROR: Couldn't spill %s chunk %i.\n", table->name, chunk);
+		return -1;
+	}
+	for (int c = 0; c < table->numColumns; c++) {
+		int ok = counts ? writeAll(table->spillFile, countColumn(table, slot, c), rows * sizeof(signed short))
+				: writeAll(table->spillFile, column(table, slot, c), rows * sizeof(float));
+		if (ok != 1) {
+			fprintf(stderr, "Session Store ERROR: Couldn't spill %s chunk %i.\n", table->name, chunk);
+			return -1;
+		}
+	}
+	if (writeAll(table->spillFile, table->flags + (size_t) slot * table->chunkRows, rows) != 1) {
+		fprintf(stderr, "Session Store ERROR: Couldn't spill %s chunk %i.\n", table->name, chunk);
+		return -1;
+	}
+
+	return 1;
+}
+
+/*
+ * Writer thread, writes chunks in order as they're filled until the table
+ * is finished and every chunk is out.
+ */
+static void* writeChunks(void* arg) {
+
+	SessionTable* table = arg;
+
+	pthread_mutex_lock(&table->writerLock);
+	while (1 == 1) {
+		while (table->spilled == table->filled && !table->finishing) {
+			pthread_cond_wait(&table->writerSignal, &table->writerLock);
+		}
+		if (table->spilled == table->filled) {
+			break; //finishing and nothing left
+		}
+
+		int chunk = table->spilled;
+		int rows = table->finishing && chunk == table->filled - 1 ? table->lastRows : table->chunkRows;
+		pthread_mutex_unlock(&table->writerLock);
+
+		int ok = spillChunk(table, chunk, rows);
+
+		pthread_mutex_lock(&table->writerLock);
+		if (ok != 1) {
+			table->spillErrors++;
+		}
+		__sync_synchronize(); //the chunk is out before its slot can be reused
+		table->spilled++;
+	}
+	pthread_mutex_unlock(&table->writerLock);
+
+	return NULL;
+}
+
+/*
+ * Hands the chunks below filled to the writer.
+ */
+static void handOffChunks(SessionTable* table, int filled) {
+
+	pthread_mutex_lock(&table->writerLock);
+	table->filled = filled;
+	pthread_cond_signal(&table->writerSignal);
+	pthread_mutex_unlock(&table->writerLock);
+}
+
+/*
+ * Sets up a float table, or a count table if gain isn't NULL.
+ */
+static int setUpTable(SessionTable* table, Arena* arena, const char* name, int numColumns,
+		const char* const columnNames[], const float gain[], const float offset[],
+		int chunkRows, int memoryChunks, const char* spillFile) {
+
+	if (numColumns > SESSION_MAX_COLUMNS || chunkRows <= 0 || memoryChunks <= 0) {
+		fprintf(stderr, "Session Store ERROR: %s needs at most %i columns and at least one chunk.\n",
+				name, SESSION_MAX_COLUMNS);
+		return -1;
+	}
+
+	table->name = name;
+	table->numColumns = numColumns;
+	table->columnNames = columnNames;
+	table->chunkRows = chunkRows;
+	table->memoryChunks = memoryChunks;
+
+	size_t rows = (size_t) chunkRows * memoryChunks;
+	table->time = arenaAlloc(arena, rows * sizeof(double), 0);
+	table->columns = NULL;
+	table->counts = NULL;
+	table->minuteSums = NULL;
+	if (gain != NULL) {
+		table->counts = arenaAlloc(arena, rows * numColumns * sizeof(signed short), 0);
+		table->minuteSums = arenaAlloc(arena, SESSION_MAX_MINUTES * numColumns * sizeof(double), 0);
+		memcpy(table->gain, gain, numColumns * sizeof(float));
+		memcpy(table->offset, offset, numColumns * sizeof(float));
+	} else {
+		table->columns = arenaAlloc(arena, rows * numColumns * sizeof(float), 0);
+	}
+	table->flags = arenaAlloc(arena, rows, 0);
+	table->minuteSquares = arenaAlloc(arena, SESSION_MAX_MINUTES * numColumns * sizeof(double), 0);
+	table->minuteRows = arenaAlloc(arena, SESSION_MAX_MINUTES * sizeof(long), 0);
+	if (table->time == NULL || (table->columns == NULL && table->counts == NULL) || table->flags == NULL
+			|| table->minuteSquares == NULL || table->minuteRows == NULL
+			|| (gain != NULL && table->minuteSums == NULL)) {
+		return -1;
+	}
+
+	table->chunks = 0;
+	table->row = 0;
+	table->rows = 0;
+	table->droppedRows = 0;
+	table->filled = 0;
+	table->lastRows = 0;
+	table->finishing = 0;
+	table->spilled = 0;
+	table->spillErrors = 0;
+
+	for (int c = 0; c < numColumns; c++) {
+		table->summary[c].min = INFINITY;
+		table->summary[c].max = -INFINITY;
+		table->summary[c].sum = 0;
+		table->summary[c].sumSquares = 0;
+	}
+	table->firstTime = 0;
+	table->lastTime = 0;
+	table->missedRows = 0;
+	table->missedRuns = 0;
+	table->longestRun = 0;
+	table->currentRun = 0;
+	for (int i = 0; i < SESSION_RUN_BINS; i++) {
+		table->runLengths[i] = 0;
+	}
+	for (int i = 0; i < SESSION_INTERVAL_BINS; i++) {
+		table->intervals[i] = 0;
+	}
+	table->maxInterval = 0;
+	table->reportRMSPerMinute = 0;
+
+	table->spillFile = -1;
+	if (spillFile == NULL) {
+		return 1;
+	}
+
+	table->spillFile = open(spillFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (table->spillFile == -1) {
+		fprintf(stderr, "Session Store ERROR: Couldn't create %s.\n", spillFile);
+		return -1;
+	}
+
+	//the writer blocks in write(), so it runs at normal priority whoever starts it
+	pthread_attr_t attributes;
+	struct sched_param param = {0};
+	pthread_mutexattr_t lockAttributes;
+	pthread_mutexattr_init(&lockAttributes);
+	pthread_mutexattr_setprotocol(&lockAttributes, PTHREAD_PRIO_INHERIT); //a real time thread may wait on the writer's lock
+	pthread_mutex_init(&table->writerLock, &lockAttributes);
+	pthread_mutexattr_destroy(&lockAttributes);
+	pthread_cond_init(&table->writerSignal, NULL);
+	if (arenaThreadAttributes(arena, &attributes, SESSION_WRITER_STACK_SZ) != 1
+			|| pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED) != 0
+			|| pthread_attr_setschedpolicy(&attributes, SCHED_OTHER) != 0
+			|| pthread_attr_setschedparam(&attributes, &param) != 0
+			|| pthread_create(&table->writer, &attributes, writeChunks, table) != 0) {
+		fprintf(stderr, "Session Store ERROR: Couldn't start the %s writer.\n", name);
+		close(table->spillFile);
+		table->spillFile = -1;
+		return -1;
+	}
+	pthread_attr_destroy(&attributes);
+
+	return 1;
+}
+
+int initializeSessionTable(SessionTable* table, Arena* arena, const char* name, int numColumns,
+		const char* const columnNames[], int chunkRows, int memoryChunks, const char* spillFile) {
+	return setUpTable(table, arena, name, numColumns, columnNames, NULL, NULL, chunkRows, memoryChunks, spillFile);
+}
+
+int initializeSessionCountTable(SessionTable* table, Arena* arena, const char* name, int numColumns,
+		const char* const columnNames[], const float gain[], const float offset[],
+		int chunkRows, int memoryChunks, const char* spillFile) {
+	return setUpTable(table, arena, name, numColumns, columnNames, gain, offset, chunkRows, memoryChunks, spillFile);
+}
+
+/*
+ * Makes room for the next row, starting a chunk if the last one is full.
+ * Returns the row's slot, -1 if the row has to be dropped.
+ */
+static int startRow(SessionTable* table, double time) {
+
+	if (table->chunks == 0 || table->row == table->chunkRows) {
+		//the next slot still holds the chunk memoryChunks back, it has to be written out first
+		if (table->spillFile != -1 && table->chunks >= table->memoryChunks
+				&& table->spilled <= table->chunks - table->memoryChunks) {
+			table->droppedRows++;
+			return -1;
+		}
+		__sync_synchronize(); //the slot is written out before it's refilled
+
+		if (table->chunks > 0) {
+			summarizeChunk(table, (table->chunks - 1) % table->memoryChunks, table->row);
+			if (table->spillFile != -1) {
+				handOffChunks(table, table->chunks);
+			}
+		}
+		table->chunks++;
+		table->row = 0;
+	}
+
+	if (table->rows == 0) {
+		table->firstTime = time;
+	}
+
+	int slot = (table->chunks - 1) % table->memoryChunks;
+	table->time[(size_t) slot * table->chunkRows + table->row] = time;
+	return slot;
+}
+
+int appendSessionRow(SessionTable* table, double time, const float values[], uint8_t flags) {
+
+	int slot = startRow(table, time);
+	if (slot == -1) {
+		return -1;
+	}
+
+	for (int c = 0; c < table->numColumns; c++) {
+		column(table, slot, c)[table->row] = values[c];
+	}
+	table->flags[(size_t) slot * table->chunkRows + table->row] = flags;
+
+	table->row++;
+	table->rows++;
+
+	return 1;
+}
+
+int appendSessionCounts(SessionTable* table, double time, const signed short counts[], uint8_t flags) {
+
+	int slot = startRow(table, time);
+	if (slot == -1) {
+		return -1;
+	}
+
+	for (int c = 0; c < table->numColumns; c++) {
+		countColumn(table, slot, c)[table->row] = counts[c];
+	}
+	table->flags[(size_t) slot * table->chunkRows + table->row] = flags;
+
+	table->row++;
+	table->rows++;
+
+	return 1;
+}
+
+int finishSessionTable(SessionTable* table) {
+
+	int ok = 1;
+
+	if (table->chunks > 0) {
+		summarizeChunk(table, (table->chunks - 1) % table->memoryChunks, table->row);
+	}
+	closeRun(table);
+
+	if (table->spillFile == -1) {
+		return 1;
+	}
+
+	//the writer takes the partly filled last chunk too, then ends
+	pthread_mutex_lock(&table->writerLock);
+	table->filled = table->chunks;
+	table->lastRows = table->row;
+	table->finishing = 1;
+	pthread_cond_signal(&table->writerSignal);
+	pthread_mutex_unlock(&table->writerLock);
+	pthread_join(table->writer, NULL);
+
+	pthread_mutex_destroy(&table->writerLock);
+	pthread_cond_destroy(&table->writerSignal);
+	close(table->spillFile);
+	table->spillFile = -1;
+
+	if (table->spillErrors > 0 || table->droppedRows > 0) {
+		ok = -1;
+	}
+
+	return ok;
+}
+
+void writeSessionSummary(const SessionTable* table, FILE* file) {
+
+	fprintf(file, "Table: %s\tRows: %ld\tChunks: %i\tSpilled: %i\tDropped Rows: %ld\tSpan (sec): %.3f\n", table->name,
+			table->rows, table->chunks, table->spilled, table->droppedRows,
+			table->rows > 0 ? table->lastTime - table->firstTime : 0);
+
+	fprintf(file, "Channel\tMin\tMax\tMean\tStd\n");
+	for (int c = 0; c < table->numColumns && table->rows > 0; c++) {
+		double low = table->summary[c].min;
+		double high = table->summary[c].max;
+		double mean = table->summary[c].sum / table->rows;
+		double variance = table->summary[c].sumSquares / table->rows - mean * mean;
+		double std = variance > 0 ? sqrt(variance) : 0;
+		if (table->counts != NULL) {
+			//summarized in counts, reported in volts
+			double gain = table->gain[c], offset = table->offset[c];
+			low = offset + gain * (gain < 0 ? table->summary[c].max : table->summary[c].min);
+			high = offset + gain * (gain < 0 ? table->summary[c].min : table->summary[c].max);
+			mean = offset + gain * mean;
+			std *= fabs(gain);
+		}
+		fprintf(file, "%s\t%f\t%f\t%f\t%f\n", table->columnNames[c], low, high, mean, std);
+	}
+
+	fprintf(file, "Missed Rows: %ld (%.3f%%)\tRuns: %ld\tLongest Run: %ld\n", table->missedRows,
+			table->rows > 0 ? table->missedRows * 100.0 / table->rows : 0, table->missedRuns, table->longestRun);
+	fprintf(file, "Run Length\t1\t2\t3-4\t5-8\t9-16\t17+\nRuns");
+	for (int i = 0; i < SESSION_RUN_BINS; i++) {
+		fprintf(file, "\t%ld", table->runLengths[i]);
+	}
+	fprintf(file, "\n");
+
+	//interval distribution, only bins that were hit, then percentiles
+	long intervals = 0;
+	for (int i = 0; i < SESSION_INTERVAL_BINS; i++) {
+		intervals += table->intervals[i];
+	}
+	fprintf(file, "Interval (ms)\tCount\n");
+	for (int i = 0; i < SESSION_INTERVAL_BINS; i++) {
+		if (table->intervals[i] > 0) {
+			fprintf(file, "%s%.1f\t%ld\n", i == SESSION_INTERVAL_BINS - 1 ? ">=" : "",
+					i * SESSION_INTERVAL_BIN * 1000, table->intervals[i]);
+		}
+	}
+	double percentiles[3] = {.5, .99, .999};
+	fprintf(file, "Interval Percentiles (ms)");
+	for (int p = 0; p < 3; p++) {
+		long seen = 0;
+		int bin = 0;
+		while (bin < SESSION_INTERVAL_BINS - 1 && seen + table->intervals[bin] < percentiles[p] * intervals) {
+			seen += table->intervals[bin];
+			bin++;
+		}
+		fprintf(file, "\tp%g: %.1f", percentiles[p] * 100, (bin + 1) * SESSION_INTERVAL_BIN * 1000);
+	}
+	fprintf(file, "\tmax: %.1f\n", table->maxInterval * 1000);
+
+	if (!table->reportRMSPerMinute) {
+		return;
+	}
+
+	fprintf(file, "RMS per Minute\nMinute");
+	for (int c = 0; c < table->numColumns; c++) {
+		fprintf(file, "\t%s", table->columnNames[c]);
+	}
+	fprintf(file, "\n");
+	for (int m = 0; m < SESSION_MAX_MINUTES; m++) {
+		if (table->minuteRows[m] == 0) {
+			continue;
+		}
+		fprintf(file, "%i", m);
+		for (int c = 0; c < table->numColumns; c++) {
+			double squares = table->minuteSquares[m * table->numColumns + c];
+			if (table->counts != NULL) {
+				//sum of (offset + gain * count)^2 from the sums of counts and their squares
+				double gain = table->gain[c], offset = table->offset[c];
+				squares = table->minuteRows[m] * offset * offset
+						+ 2 * offset * gain * table->minuteSums[m * table->numColumns + c] + gain * gain * squares;
+			}
+			fprintf(file, "\t%f", sqrt(squares > 0 ? squares / table->minuteRows[m] : 0));
+		}
+		fprintf(file, "\n");
+	}
+}
@@ -0,0 +1,163 @@
+/*
+ * Name: SessionStore.h
+ * Author: Elijah Pivo
+ *
+ * In memory columnar store for a recording session.
+ *
+ * A table keeps a time column, one column per channel and a flags column
+ * (one missed read bit per sensor). Columns hold floats or, in a count
+ * table, the device's signed short counts (half the memory and file) with
+ * a per channel calibration, volts = offset + gain * count, that the
+ * summary and column file carry so readers get volts back. Rows are added to fixed size
+ * chunks; a full chunk is summarized in one pass per column and once every
+ * chunk in memory is in use the oldest is spilled to the table's column
+ * file to make room. Memory is bounded by chunkRows * memoryChunks no
+ * matter how long the session runs, and all chunk memory comes from the
+ * locked arena.
+ *
+ * Spilling happens on the table's own writer thread (normal priority), so
+ * the thread adding rows only ever copies into memory. Each chunk is handed
+ * to the writer as soon as it fills; its slot is reused once it's written.
+ * If the writer falls a whole memory's worth of chunks behind, rows are
+ * dropped (and counted) rather than holding up the thread adding them.
+ *
+ * Because every chunk is summarized as it fills, the end of session
+ * summary (per channel min/max/mean/std, missed read runs, sample interval
+ * distribution, RMS per minute) is ready as soon as recording stops.
+ *
+ * Column file format, one block per chunk, native byte order:
+ * 	int chunk, int rows, int columns (negated for a count table)
+ * 	float gain[columns], float offset[columns] (count table only)
+ * 	double time[rows]
+ * 	float column[columns][rows] (signed short in a count table)
+ * 	uint8_t flags[rows]
+ */
+
+#ifndef SESSIONSTORE_H
+#define SESSIONSTORE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "Arena.h"
+
+#define SESSION_MAX_COLUMNS 64
+#define SESSION_MAX_MINUTES 120 //RMS per minute is kept for the first two hours
+#define SESSION_INTERVAL_BIN .0005 //s, sample interval histogram bin width
+#define SESSION_INTERVAL_BINS 100  //up to 50ms, longer intervals go in the last bin
+#define SESSION_RUN_BINS 6 //missed read runs of 1, 2, 3-4, 5-8, 9-16, 17+ rows
+#define SESSION_WRITER_STACK_SZ (64 * 1024)
+
+typedef struct {
+	float min;
+	float max;
+	double sum;
+	double sumSquares;
+} ColumnSummary;
+
+typedef struct {
+	const char* name;
+	int numColumns;
+	const char* const* columnNames;
+	int chunkRows;
+	int memoryChunks;
+
+	//chunk pool, chunk k lives in slot k % memoryChunks
+	double* time;
+	float* columns; //slot s, column c starts at columns + (s * numColumns + c) * chunkRows, NULL in a count table
+	signed short* counts; //laid out the same in a count table, NULL otherwise
+	uint8_t* flags;
+
+	//count table only, volts = offset + gain * count
+	float gain[SESSION_MAX_COLUMNS];
+	float offset[SESSION_MAX_COLUMNS];
+
+	int chunks; //chunks started
+	int row;    //rows in the chunk being filled
+	long rows;  //rows in the session
+	int spillFile; //-1 if there is none
+	long droppedRows; //the writer was too far behind to free a chunk
+
+	//writer thread, chunks below filled are ready for it
+	pthread_t writer;
+	pthread_mutex_t writerLock;
+	pthread_cond_t writerSignal;
+	int filled;
+	int lastRows; //rows in the last chunk, once finishing
+	int finishing;
+	volatile int spilled; //chunks written to the column file, written by the writer
+	int spillErrors;
+
+	//session summary, updated as each chunk fills, in counts in a count table
+	ColumnSummary summary[SESSION_MAX_COLUMNS];
+	double firstTime;
+	double lastTime;
+
+	long missedRows;
+	long missedRuns;
+	long longestRun;
+	long runLengths[SESSION_RUN_BINS];
+	long currentRun; //carries a run over chunk boundaries
+
+	long intervals[SESSION_INTERVAL_BINS];
+	double maxInterval;
+
+	int reportRMSPerMinute;
+	double* minuteSquares; //[minute * numColumns + column]
+	double* minuteSums; //count table only, to give the RMS in volts
+	long* minuteRows;
+} SessionTable;
+
+/*
+ * Sets up a table with memoryChunks chunks of chunkRows rows allocated from
+ * the arena, and starts its writer. columnNames must stay valid for the
+ * life of the table. If spillFile is NULL full chunks are summarized and
+ * then overwritten, with no writer. Returns 1 if succeeded, -1 if the
+ * arena was too small, the column file couldn't be created or the writer
+ * couldn't start.
+ */
+int initializeSessionTable(SessionTable* table, Arena* arena, const char* name, int numColumns,
+		const char* const columnNames[], int chunkRows, int memoryChunks, const char* spillFile);
+
+/*
+ * Same as initializeSessionTable, for a count table. Each column's counts
+ * convert to volts by gain and offset.
+ */
+int initializeSessionCountTable(SessionTable* table, Arena* arena, const char* name, int numColumns,
+		const char* const columnNames[], const float gain[], const float offset[],
+		int chunkRows, int memoryChunks, const char* spillFile);
+
+/*
+ * Adds a row. values holds numColumns floats, flags has a bit set for each
+ * sensor whose read was missed. Never waits on the writer. Returns 1, -1
+ * if the row was dropped because the writer hadn't freed its chunk yet.
+ */
+int appendSessionRow(SessionTable* table, double time, const float values[], uint8_t flags);
+
+/*
+ * Same as appendSessionRow, for a count table, counts holds numColumns counts.
+ */
+int appendSessionCounts(SessionTable* table, double time, const signed short counts[], uint8_t flags);
+
+/*
+ * Summarizes the partly filled last chunk, waits for the writer to write
+ * every chunk still in memory to the column file, then closes it. Call
+ * once, when recording stops. Returns 1 if succeeded, -1 if a chunk
+ * couldn't be written.
+ */
+int finishSessionTable(SessionTable* table);
+
+/*
+ * Writes the table's summary: per channel min/max/mean/std, missed read
+ * runs, sample interval distribution and, if reportRMSPerMinute is set,
+ * RMS per channel per minute.
+ */
+void writeSessionSummary(const SessionTable* table, FILE* file);
+
+#endif
@@ -0,0 +1,248 @@
+/*
+ * Name: ThreadPlan.c
+ * Author: Elijah Pivo
+ *
+ * Thread placement for the data collection program.
+ */
+
+#define _GNU_SOURCE //pthread_setaffinity_np, sched_getcpu
+
+#include "ThreadPlan.h"
+
+static pthread_once_t memoryLocked = PTHREAD_ONCE_INIT;
+static int memoryLockError = 0;
+
+static void lockMemory() {
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+		memoryLockError = 1;
+	}
+}
+
+static const char* policyName(int policy) {
+	switch (policy) {
+	case SCHED_FIFO:
+		return "FIFO";
+	case SCHED_RR:
+		return "RR";
+	default:
+		return "OTHER";
+	}
+}
+
+int initializeThreadPlan(ThreadPlan* ThreadPlan) {
+
+	ThreadPlan->numRoles = 0;
+	ThreadPlan->numIRQs = 0;
+
+	return 1;
+}
+
+int addThreadRole(ThreadPlan* ThreadPlan, const char* name, int cpus, int policy, int priority) {
+
+	if (ThreadPlan->numRoles >= THREAD_PLAN_MAX_ROLES) {
+		fprintf(stderr, "Thread Plan ERROR: Too many roles, %s not added.\n", name);
+		return -1;
+	}
+
+	ThreadRole* role = &ThreadPlan->roles[ThreadPlan->numRoles];
+	role->name = name;
+	role->cpus = cpus;
+	role->policy = policy;
+	role->priority = priority;
+	role->wakeups = 0;
+	role->totalLatency = 0;
+	role->maxLatency = 0;
+	role->lastCPU = -1;
+	role->migrations = 0;
+
+	return ThreadPlan->numRoles++;
+}
+
+void setThreadRolePriority(ThreadPlan* ThreadPlan, int role, int priority) {
+	ThreadPlan->roles[role].priority = priority;
+}
+
+int addIRQSteering(ThreadPlan* ThreadPlan, const char* name, int cpus) {
+
+	if (ThreadPlan->numIRQs >= THREAD_PLAN_MAX_IRQS) {
+		fprintf(stderr, "Thread Plan ERROR: Too many interrupts, %s not added.\n", name);
+		return -1;
+	}
+
+	ThreadPlan->irqNames[ThreadPlan->numIRQs] = name;
+	ThreadPlan->irqCPUs[ThreadPlan->numIRQs] = cpus;
+	ThreadPlan->numIRQs++;
+
+	return 1;
+}
+
+int validateThreadPlan(const ThreadPlan* ThreadPlan) {
+
+	int ok = 1;
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	int online = cores >= 31 ? ~0 : (1 << cores) - 1;
+
+	for (int i = 0; i < ThreadPlan->numRoles; i++) {
+		const ThreadRole* role = &ThreadPlan->roles[i];
+
+		if (role->cpus != THREAD_PLAN_ANY_CPU && (role->cpus & ~online) != 0) {
+			fprintf(stderr, "Thread Plan ERROR: %s is pinned to a core that isn't online (mask 0x%x, %ld cores).\n",
+					role->name, role->cpus, cores);
+			ok = -1;
+		}
+		if (role->policy != SCHED_FIFO && role->policy != SCHED_RR) {
+			fprintf(stderr, "Thread Plan ERROR: %s needs SCHED_FIFO or SCHED_RR.\n", role->name);
+			ok = -1;
+			continue;
+		}
+		if (role->priority < sched_get_priority_min(role->policy)
+				|| role->priority > sched_get_priority_max(role->policy)) {
+			fprintf(stderr, "Thread Plan ERROR: %s priority %i is out of range for %s.\n",
+					role->name, role->priority, policyName(role->policy));
+			ok = -1;
+		}
+
+		//FIFO threads of equal priority on one core only yield to each other by blocking
+		for (int j = 0; j < i; j++) {
+			const ThreadRole* other = &ThreadPlan->roles[j];
+			if (role->policy == SCHED_FIFO && other->policy == SCHED_FIFO && role->priority == other->priority
+					&& role->cpus == other->cpus && role->cpus != THREAD_PLAN_ANY_CPU
+					&& (role->cpus & (role->cpus - 1)) == 0) {
+				fprintf(stderr, "Thread Plan WARNING: %s and %s share a core at FIFO priority %i.\n",
+						role->name, other->name, role->priority);
+			}
+		}
+	}
+
+	for (int i = 0; i < ThreadPlan->numIRQs; i++) {
+		if (ThreadPlan->irqCPUs[i] == 0 || (ThreadPlan->irqCPUs[i] & ~online) != 0) {
+			fprintf(stderr, "Thread Plan ERROR: %s interrupts are steered to a core that isn't online (mask 0x%x).\n",
+					ThreadPlan->irqNames[i], ThreadPlan->irqCPUs[i]);
+			ok = -1;
+		}
+	}
+
+	return ok;
+}
+
+int steerIRQs(const ThreadPlan* ThreadPlan) {
+
+	if (ThreadPlan->numIRQs == 0) {
+		return 0;
+	}
+
+	FILE* interrupts = fopen("/proc/interrupts", "r");
+	if (interrupts == NULL) {
+		fprintf(stderr, "Thread Plan ERROR: Couldn't read /proc/interrupts.\n");
+		return -1;
+	}
+
+	char line[512];
+	char path[64];
+	int steered = 0;
+
+	while (fgets(line, sizeof(line), interrupts) != NULL) {
+		int irq;
+		if (sscanf(line, " %i:", &irq) != 1) {
+			continue; //header or a named (non numbered) interrupt
+		}
+
+		for (int i = 0; i < ThreadPlan->numIRQs; i++) {
+			if (strstr(line, ThreadPlan->irqNames[i]) == NULL) {
+				continue;
+			}
+
+			snprintf(path, sizeof(path), "/proc/irq/%i/smp_affinity", irq);
+			FILE* affinity = fopen(path, "w");
+			if (affinity == NULL || fprintf(affinity, "%x\n", ThreadPlan->irqCPUs[i]) < 0
+					|| fclose(affinity) != 0) {
+				fprintf(stderr, "Thread Plan WARNING: Couldn't steer interrupt %i (%s).\n",
+						irq, ThreadPlan->irqNames[i]);
+			} else {
+				fprintf(stderr, "Steered interrupt %i (%s) to mask 0x%x.\n",
+						irq, ThreadPlan->irqNames[i], ThreadPlan->irqCPUs[i]);
+				steered++;
+			}
+			break;
+		}
+	}
+
+	fclose(interrupts);
+	return steered;
+}
+
+int applyThreadRole(ThreadPlan* ThreadPlan, int role) {
+
+	ThreadRole* r = &ThreadPlan->roles[role];
+	int ok = 1;
+
+	if (r->cpus != THREAD_PLAN_ANY_CPU) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu = 0; cpu < 31; cpu++) {
+			if (r->cpus & THREAD_PLAN_CPU(cpu)) {
+				CPU_SET(cpu, &set);
+			}
+		}
+		if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+			fprintf(stderr, "Thread Plan ERROR: Couldn't pin %s to mask 0x%x.\n", r->name, r->cpus);
+			ok = -1;
+		}
+	}
+
+	//should be careful with this!
+	struct sched_param param;
+	param.sched_priority = r->priority;
+	if (pthread_setschedparam(pthread_self(), r->policy, &param) != 0) {
+		fprintf(stderr, "Thread Plan ERROR: %s priority not set.\n", r->name);
+		fprintf(stderr, "*Remember to run as root.*\n");
+		ok = -1;
+	}
+
+	pthread_once(&memoryLocked, lockMemory);
+	if (memoryLockError) {
+		fprintf(stderr, "Thread Plan ERROR: Couldn't lock process in memory.\n");
+		ok = -1;
+	}
+
+	r->lastCPU = sched_getcpu();
+
+	return ok;
+}
+
+void markThreadRelease(ThreadPlan* ThreadPlan, int role) {
+	clock_gettime(CLOCK_MONOTONIC, &ThreadPlan->roles[role].releaseTime);
+}
+
+void recordThreadWakeup(ThreadPlan* ThreadPlan, int role) {
+
+	ThreadRole* r = &ThreadPlan->roles[role];
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	double latency = (now.tv_sec - r->releaseTime.tv_sec) * 1000000.0
+			+ (now.tv_nsec - r->releaseTime.tv_nsec) * .001;
+
+	r->wakeups++;
+	r->totalLatency += latency;
+	if (latency > r->maxLatency) {
+		r->maxLatency = latency;
+	}
+
+	int cpu = sched_getcpu();
+	if (r->lastCPU != -1 && cpu != r->lastCPU) {
+		r->migrations++;
+	}
+	r->lastCPU = cpu;
+}
+
+void printThreadPlan(const ThreadPlan* ThreadPlan, FILE* file) {
+
+	fprintf(file, "Thread\tCores\tPolicy\tPriority\tWakeups\tMean Latency (us)\tMax Latency (us)\tMigrations\n");
+	for (int i = 0; i < ThreadPlan->numRoles; i++) {
+		const ThreadRole* r = &ThreadPlan->roles[i];
+		fprintf(file, "%s\t0x%x\t%s\t%i\t%ld\t%.1f\t%.1f\t%ld\n", r->name, r->cpus, policyName(r->policy),
+				r->priority, r->wakeups, r->wakeups > 0 ? r->totalLatency / r->wakeups : 0,
+				r->maxLatency, r->migrations);
+	}
+}
@@ -0,0 +1,121 @@
+/*
+ * Name: ThreadPlan.h
+ * Author: Elijah Pivo
+ *
+ * Thread placement for the data collection program.
+ *
+ * One table says, for every thread role (a sensor thread, the print thread,
+ * the release thread), which cores it may run on, its real time policy
+ * (SCHED_FIFO or SCHED_RR) and its priority. Optionally the USB and UART
+ * interrupts are steered to chosen cores through /proc/irq. The plan is
+ * checked against the machine before any thread starts, each thread applies
+ * its own role once it is running, and the process is locked in memory once.
+ *
+ * Each role also keeps wakeup statistics: how late its thread started after
+ * being released, and how often it came back on a different core.
+ */
+
+#ifndef THREADPLAN_H
+#define THREADPLAN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "CacheLine.h"
+
+#define THREAD_PLAN_MAX_ROLES 8
+#define THREAD_PLAN_MAX_IRQS 4
+#define THREAD_PLAN_ANY_CPU 0 //cpu mask that leaves the thread unpinned
+#define THREAD_PLAN_CPU(n) (1 << (n))
+
+typedef struct {
+	const char* name;
+	int cpus; //mask of cores the thread may run on
+	int policy;
+	int priority;
+
+	struct timespec releaseTime; //written by the releasing thread
+
+	//wakeup statistics, written by the role's own thread
+	long wakeups CACHE_ALIGNED;
+	double totalLatency; //us
+	double maxLatency;   //us
+	int lastCPU;
+	long migrations;
+} ThreadRole;
+
+typedef struct {
+	ThreadRole roles[THREAD_PLAN_MAX_ROLES];
+	int numRoles;
+
+	//interrupts to steer, matched against the names in /proc/interrupts
+	const char* irqNames[THREAD_PLAN_MAX_IRQS];
+	int irqCPUs[THREAD_PLAN_MAX_IRQS];
+	int numIRQs;
+} ThreadPlan;
+
+/*
+ * Sets up an empty plan. Returns 1.
+ */
+int initializeThreadPlan(ThreadPlan* ThreadPlan);
+
+/*
+ * Adds a role. cpus is a mask of THREAD_PLAN_CPU(n) values, or
+ * THREAD_PLAN_ANY_CPU. Returns the role's index, -1 if the table is full.
+ */
+int addThreadRole(ThreadPlan* ThreadPlan, const char* name, int cpus, int policy, int priority);
+
+/*
+ * Changes a role's priority, e.g. to the one the Scheduler assigned.
+ */
+void setThreadRolePriority(ThreadPlan* ThreadPlan, int role, int priority);
+
+/*
+ * Asks for every interrupt whose /proc/interrupts line contains name to be
+ * steered to cpus. Returns 1, -1 if the table is full.
+ */
+int addIRQSteering(ThreadPlan* ThreadPlan, const char* name, int cpus);
+
+/*
+ * Checks the plan against the machine: cores exist and are online, policies
+ * are real time and priorities are in range. Warns (but passes) when more
+ * SCHED_FIFO roles of the same priority share one core than can take turns.
+ * Returns 1 if the plan can be applied, -1 (with the reasons on stderr) otherwise.
+ */
+int validateThreadPlan(const ThreadPlan* ThreadPlan);
+
+/*
+ * Writes the requested masks to /proc/irq/<n>/smp_affinity. Some
+ * interrupts can't be moved (e.g. the Pi's USB controller on older
+ * boards), those are reported and skipped. Returns the number of
+ * interrupts steered, -1 if /proc/interrupts couldn't be read.
+ */
+int steerIRQs(const ThreadPlan* ThreadPlan);
+
+/*
+ * Called by a thread to take on a role: pins it to the role's cores, sets
+ * its policy and priority, and locks the process in memory the first time
+ * any thread calls it. Returns 1 if everything was applied, -1 otherwise.
+ */
+int applyThreadRole(ThreadPlan* ThreadPlan, int role);
+
+/*
+ * Called by the releasing thread just before it hands a role's thread a
+ * release, and by that thread when it wakes up for it.
+ */
+void markThreadRelease(ThreadPlan* ThreadPlan, int role);
+void recordThreadWakeup(ThreadPlan* ThreadPlan, int role);
+
+/*
+ * Prints each role's placement and wakeup latency, mean and max, and
+ * core migrations.
+ */
+void printThreadPlan(const ThreadPlan* ThreadPlan, FILE* file);
+
+#endif
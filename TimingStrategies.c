@@ -0,0 +1,559 @@
+/*
+ * Name: TimingStrategies.c
+ * Author: Elijah Pivo
+ *
+ * The timing designs the Engine can run, see Engine.h.
+ *
+ * None of them set thread priorities or pin threads (that needs root and
+ * a ThreadPlan), so they're compared on equal footing as ordinary threads.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <semaphore.h>
+#include <sys/time.h>
+
+#include "Engine.h"
+#include "CacheLine.h"
+#include "WorkerPool.h"
+
+typedef struct {
+	Engine* engine;
+	int device;
+	double time;
+} SpawnRead;
+
+/*
+ * Every strategy keeps its state here, one engine runs at a time.
+ */
+typedef struct {
+	//spawn and pool, SIGALRM ticks
+	struct sigaction oldAction;
+
+	//spawn
+	SpawnRead reads[ENGINE_MAX_DEVICES];
+
+	//pool
+	WorkerPool pool;
+
+	//handshake and print, one slot per device and one for printing
+	//0: handling a request, 1: request made, 2: ready for a request
+	ControlSlot control[ENGINE_MAX_DEVICES + 1];
+	pthread_t threads[ENGINE_MAX_DEVICES + 1];
+	pthread_mutex_t locks[ENGINE_MAX_DEVICES + 1];
+	pthread_cond_t signals[ENGINE_MAX_DEVICES + 1];
+	unsigned threadsStarted; //bit i for slot i
+	double printTime;
+} StrategyState;
+
+#define PRINT_SLOT ENGINE_MAX_DEVICES
+
+static StrategyState state;
+static sem_t ticks; //posted by the timer, once a tick
+
+static unsigned cycleDevices(const Engine* engine);
+static void tick(int signum);
+static int startTicks(Engine* engine);
+static long waitTicks(Engine* engine);
+static void stopTicks();
+static long waitRelease(Engine* engine, int spin);
+
+static int startSpawn(Engine* engine);
+static int cycleSpawn(Engine* engine);
+static void stopSpawn(Engine* engine);
+static void* spawnRead(void* arg);
+static int startPool(Engine* engine);
+static int cyclePool(Engine* engine);
+static void stopPool(Engine* engine);
+static int poolRead(void* arg, double time, const volatile int* cancelled);
+static int startHandshake(Engine* engine);
+static int startPrint(Engine* engine);
+static int cycleHandshake(Engine* engine);
+static int cyclePrint(Engine* engine);
+static void readHandshake(Engine* engine);
+static void stopHandshake(Engine* engine);
+static void* handshakeThread(void* arg);
+static void* printThread(void* arg);
+static int startFree(Engine* engine);
+static int cycleFree(Engine* engine);
+static void stopFree(Engine* engine);
+
+const TimingStrategy SpawnStrategy = {"spawn", startSpawn, cycleSpawn, stopSpawn};
+const TimingStrategy PoolStrategy = {"pool", startPool, cyclePool, stopPool};
+const TimingStrategy HandshakeStrategy = {"handshake", startHandshake, cycleHandshake, stopHandshake};
+const TimingStrategy PrintStrategy = {"print", startPrint, cyclePrint, stopHandshake};
+const TimingStrategy FreeStrategy = {"free", startFree, cycleFree, stopFree};
+
+/*
+ * spawn: the timer's signal releases a cycle, a thread is created for each
+ * read and joined before saving. A cycle that runs long makes the next
+ * releases go by, they're missed.
+ */
+static int startSpawn(Engine* engine) {
+	return startTicks(engine);
+}
+
+static int cycleSpawn(Engine* engine) {
+
+	long cycle = waitTicks(engine);
+	if (cycle < 0) {
+		return -1;
+	}
+	startCycle(engine, cycle);
+
+	unsigned devices = cycleDevices(engine);
+	pthread_t threads[ENGINE_MAX_DEVICES];
+	unsigned started = 0;
+	for (int i = 0; i < engine->numDevices; i++) {
+		if (devices & 1u << i) {
+			state.reads[i].engine = engine;
+			state.reads[i].device = i;
+			state.reads[i].time = engine->time;
+			if (pthread_create(&threads[i], NULL, spawnRead, &state.reads[i]) == 0) {
+				started |= 1u << i;
+			}
+		}
+	}
+	for (int i = 0; i < engine->numDevices; i++) {
+		if (started & 1u << i) {
+			pthread_join(threads[i], NULL);
+		}
+	}
+
+	finishCycle(engine, engine->time);
+	return 1;
+}
+
+static void stopSpawn(Engine* engine) {
+
+	(void) engine;
+
+	stopTicks();
+}
+
+static void* spawnRead(void* arg) {
+
+	SpawnRead* read = arg;
+	engineRead(read->engine, read->device, read->time);
+	return NULL;
+}
+
+/*
+ * pool: the timer's signal releases a cycle, persistent workers (WorkerPool)
+ * read and are waited for until the deadline. A late read is dropped once
+ * the pool reports it, like mobileArmTrack does, its worker sits out the
+ * releases it's busy for.
+ */
+static int startPool(Engine* engine) {
+
+	if (initializeWorkerPool(&state.pool, NULL) != 1) {
+		return -1;
+	}
+	for (int i = 0; i < engine->numDevices; i++) {
+		if (!engine->devices[i].freeRunning) {
+			if (addPoolTask(&state.pool, engine->devices[i].name, poolRead, &engine->devices[i], -1) == -1) {
+				return -1;
+			}
+		}
+	}
+	if (startWorkerPool(&state.pool) != 1) {
+		return -1;
+	}
+
+	if (startTicks(engine) != 1) {
+		stopWorkerPool(&state.pool);
+		return -1;
+	}
+	return 1;
+}
+
+static int cyclePool(Engine* engine) {
+
+	long cycle = waitTicks(engine);
+	if (cycle < 0) {
+		return -1;
+	}
+	startCycle(engine, cycle);
+
+	//counted before dispatching, so a late read is never dropped along with a new one
+	long completed[POOL_MAX_WORKERS];
+	for (int i = 0; i < state.pool.numWorkers; i++) {
+		completed[i] = ((EngineDevice*) state.pool.workers[i].arg)->completed;
+	}
+	__sync_synchronize(); //the counts are read before the late tasks
+
+	unsigned late;
+	unsigned dispatched = dispatchTasks(&state.pool, (1u << state.pool.numWorkers) - 1, engine->time, &late);
+
+	//reads that finished after their cycle was given up on are stale, one
+	//that finished after the count above is saved as overwritten instead
+	for (int i = 0; i < state.pool.numWorkers; i++) {
+		if (late & 1u << i) {
+			dropReads(engine, ((EngineDevice*) state.pool.workers[i].arg)->index, completed[i]);
+		}
+	}
+
+	struct timespec deadline = releaseTime(engine, cycle);
+	deadline.tv_nsec += (engine->deadline > 0 ? engine->deadline : engine->period) * 1000;
+	deadline.tv_sec += deadline.tv_nsec / 1000000000;
+	deadline.tv_nsec %= 1000000000;
+	int results[POOL_MAX_WORKERS];
+	unsigned finished = awaitTasks(&state.pool, dispatched, &deadline, results);
+
+	//a read that isn't done by the deadline is left for dropReads, even if it finishes before finishCycle
+	engine->held = 0;
+	for (int i = 0; i < state.pool.numWorkers; i++) {
+		if (!(finished & 1u << i)) {
+			engine->held |= 1u << ((EngineDevice*) state.pool.workers[i].arg)->index;
+		}
+	}
+
+	finishCycle(engine, engine->time);
+	return 1;
+}
+
+static void stopPool(Engine* engine) {
+
+	stopTicks();
+	stopWorkerPool(&state.pool);
+	engine->held = 0;
+}
+
+/*
+ * A simulated read is a single wait, so cancelled is only checked before
+ * it starts. A read that's skipped isn't counted, the engine sees no new
+ * read and the cycle is missed.
+ */
+static int poolRead(void* arg, double time, const volatile int* cancelled) {
+
+	EngineDevice* device = arg;
+
+	if (*cancelled) {
+		return -1;
+	}
+	return engineRead(device->engine, device->index, time);
+}
+
+/*
+ * handshake: a persistent thread per device waits on its condition for a
+ * request, the loop makes the requests and spins until every thread is
+ * ready again. Free running devices are waited for once every blockCycles
+ * cycles. The loop spins on the clock until the next release; if it's
+ * late past one or more releases it starts at the newest, the rest are
+ * missed.
+ *
+ * print: handshake, the loop then hands the cycle to a print thread that
+ * swaps the reads in and saves them.
+ */
+static int startHandshake(Engine* engine) {
+
+	state.threadsStarted = 0;
+
+	for (int i = 0; i < engine->numDevices; i++) {
+		if (engine->devices[i].freeRunning) {
+			continue;
+		}
+		state.control[i].value = 0;
+		pthread_mutex_init(&state.locks[i], NULL);
+		pthread_cond_init(&state.signals[i], NULL);
+		if (pthread_create(&state.threads[i], NULL, handshakeThread, &engine->devices[i]) != 0) {
+			fprintf(stderr, "TimingStrategies.c ERROR: Couldn't start the %s thread.\n", engine->devices[i].name);
+			stopHandshake(engine);
+			return -1;
+		}
+		state.threadsStarted |= 1u << i;
+	}
+
+	return 1;
+}
+
+static int startPrint(Engine* engine) {
+
+	if (startHandshake(engine) != 1) {
+		return -1;
+	}
+
+	state.control[PRINT_SLOT].value = 0;
+	pthread_mutex_init(&state.locks[PRINT_SLOT], NULL);
+	pthread_cond_init(&state.signals[PRINT_SLOT], NULL);
+	if (pthread_create(&state.threads[PRINT_SLOT], NULL, printThread, engine) != 0) {
+		fprintf(stderr, "TimingStrategies.c ERROR: Couldn't start the print thread.\n");
+		stopHandshake(engine);
+		return -1;
+	}
+	state.threadsStarted |= 1u << PRINT_SLOT;
+
+	return 1;
+}
+
+static int cycleHandshake(Engine* engine) {
+
+	startCycle(engine, waitRelease(engine, 1));
+	readHandshake(engine);
+	finishCycle(engine, engine->time);
+	return 1;
+}
+
+static int cyclePrint(Engine* engine) {
+
+	startCycle(engine, waitRelease(engine, 1));
+	readHandshake(engine);
+
+	//wait for the print thread to be ready
+	while (state.control[PRINT_SLOT].value != 2) {}
+	pthread_mutex_lock(&state.locks[PRINT_SLOT]);
+	state.printTime = engine->time;
+	state.control[PRINT_SLOT].value = 1;
+	pthread_cond_signal(&state.signals[PRINT_SLOT]);
+	pthread_mutex_unlock(&state.locks[PRINT_SLOT]);
+
+	return 1;
+}
+
+static void readHandshake(Engine* engine) {
+
+	unsigned devices = cycleDevices(engine);
+
+	for (int i = 0; i < engine->numDevices; i++) {
+		if (devices & 1u << i) {
+			while (state.control[i].value != 2) {} //ready for a request
+			pthread_mutex_lock(&state.locks[i]);
+			state.control[i].value = 1;
+			pthread_cond_signal(&state.signals[i]);
+			pthread_mutex_unlock(&state.locks[i]);
+		}
+	}
+
+	//wait for data collection to be ready for another cycle
+	for (int i = 0; i < engine->numDevices; i++) {
+		if (devices & 1u << i) {
+			while (state.control[i].value != 2) {}
+		}
+	}
+
+	//once a block, wait for new data from the free running devices
+	if (engine->cycle % engine->blockCycles == engine->blockCycles - 1) {
+		for (int i = 0; i < engine->numDevices; i++) {
+			EngineDevice* device = &engine->devices[i];
+			while (device->freeRunning && device->completed == device->consumed && engine->running) {}
+		}
+	}
+}
+
+static void stopHandshake(Engine* engine) {
+
+	(void) engine;
+
+	for (int i = 0; i <= PRINT_SLOT; i++) {
+		if (!(state.threadsStarted & 1u << i)) {
+			continue;
+		}
+		pthread_mutex_lock(&state.locks[i]);
+		state.control[i].value = -1; //stop
+		pthread_cond_signal(&state.signals[i]);
+		pthread_mutex_unlock(&state.locks[i]);
+		pthread_join(state.threads[i], NULL);
+		pthread_mutex_destroy(&state.locks[i]);
+		pthread_cond_destroy(&state.signals[i]);
+	}
+	state.threadsStarted = 0;
+}
+
+static void* handshakeThread(void* arg) {
+
+	EngineDevice* device = arg;
+	Engine* engine = device->engine;
+	int i = device->index;
+
+	//stop (-1) can come while reading, it's checked before taking another request
+	pthread_mutex_lock(&state.locks[i]);
+	while (state.control[i].value != -1) {
+		state.control[i].value = 2; //signals ready to accept a collection request
+		while (state.control[i].value == 2) {
+			pthread_cond_wait(&state.signals[i], &state.locks[i]);
+		}
+		if (state.control[i].value == -1) {
+			break;
+		}
+		state.control[i].value = 0;
+		pthread_mutex_unlock(&state.locks[i]);
+
+		engineRead(engine, i, engine->time);
+
+		pthread_mutex_lock(&state.locks[i]);
+	}
+	pthread_mutex_unlock(&state.locks[i]);
+
+	return NULL;
+}
+
+static void* printThread(void* arg) {
+
+	Engine* engine = arg;
+
+	pthread_mutex_lock(&state.locks[PRINT_SLOT]);
+	while (state.control[PRINT_SLOT].value != -1) {
+		state.control[PRINT_SLOT].value = 2; //signals ready to accept a print request
+		while (state.control[PRINT_SLOT].value == 2) {
+			pthread_cond_wait(&state.signals[PRINT_SLOT], &state.locks[PRINT_SLOT]);
+		}
+		if (state.control[PRINT_SLOT].value == -1) {
+			break;
+		}
+		state.control[PRINT_SLOT].value = 0;
+		double time = state.printTime;
+		pthread_mutex_unlock(&state.locks[PRINT_SLOT]);
+
+		finishCycle(engine, time);
+
+		pthread_mutex_lock(&state.locks[PRINT_SLOT]);
+	}
+	pthread_mutex_unlock(&state.locks[PRINT_SLOT]);
+
+	return NULL;
+}
+
+/*
+ * free: every device is read back to back on its own thread, the loop
+ * sleeps until each release and takes whatever finished since the last.
+ */
+static int startFree(Engine* engine) {
+
+	state.threadsStarted = 0;
+
+	for (int i = 0; i < engine->numDevices; i++) {
+		if (engine->devices[i].freeRunning) {
+			continue;
+		}
+		if (pthread_create(&state.threads[i], NULL, readFreeRunning, &engine->devices[i]) != 0) {
+			fprintf(stderr, "TimingStrategies.c ERROR: Couldn't start the %s thread.\n", engine->devices[i].name);
+			stopFree(engine);
+			return -1;
+		}
+		state.threadsStarted |= 1u << i;
+	}
+
+	return 1;
+}
+
+static int cycleFree(Engine* engine) {
+
+	startCycle(engine, waitRelease(engine, 0));
+	finishCycle(engine, engine->time);
+	return 1;
+}
+
+static void stopFree(Engine* engine) {
+
+	//the readers stop with the engine
+	engine->running = 0;
+	for (int i = 0; i < engine->numDevices; i++) {
+		if (state.threadsStarted & 1u << i) {
+			pthread_join(state.threads[i], NULL);
+		}
+	}
+	state.threadsStarted = 0;
+}
+
+/*
+ * Returns the mask of devices read once a cycle.
+ */
+static unsigned cycleDevices(const Engine* engine) {
+
+	unsigned devices = 0;
+	for (int i = 0; i < engine->numDevices; i++) {
+		if (!engine->devices[i].freeRunning) {
+			devices |= 1u << i;
+		}
+	}
+	return devices;
+}
+
+static void tick(int signum) {
+
+	(void) signum;
+
+	//only wakes the loop, everything else happens there
+	sem_post(&ticks);
+}
+
+/*
+ * Starts a timer ticking every period from the engine's cycle 0 release.
+ */
+static int startTicks(Engine* engine) {
+
+	sem_init(&ticks, 0, 0);
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = &tick;
+	sa.sa_flags = SA_RESTART;
+	if (sigaction(SIGALRM, &sa, &state.oldAction) != 0) {
+		return -1;
+	}
+
+	//the first tick at cycle 0's release
+	double first = -engineClock(engine);
+	struct itimerval timer;
+	timer.it_value.tv_sec = 0;
+	timer.it_value.tv_usec = first > .000001 ? (long) (first * 1000000) : 1;
+	timer.it_interval.tv_sec = engine->period / 1000000;
+	timer.it_interval.tv_usec = engine->period % 1000000;
+	if (setitimer(ITIMER_REAL, &timer, NULL) != 0) {
+		sigaction(SIGALRM, &state.oldAction, NULL);
+		return -1;
+	}
+
+	return 1;
+}
+
+/*
+ * Waits for a tick and returns the cycle it releases, the newest one if
+ * more than one went by. Returns -1 if the engine stopped.
+ */
+static long waitTicks(Engine* engine) {
+
+	while (sem_wait(&ticks) != 0) {
+		if (errno != EINTR || !engine->running) {
+			return -1;
+		}
+	}
+	long cycle = engine->cycle + 1;
+	while (sem_trywait(&ticks) == 0) {
+		cycle++;
+	}
+	return cycle;
+}
+
+static void stopTicks() {
+
+	struct itimerval off;
+	memset(&off, 0, sizeof(off));
+	setitimer(ITIMER_REAL, &off, NULL);
+	sigaction(SIGALRM, &state.oldAction, NULL);
+	sem_destroy(&ticks);
+}
+
+/*
+ * Waits for the next release, spinning on the clock or sleeping, and
+ * returns the cycle it releases. A loop already late past releases gets
+ * the newest one.
+ */
+static long waitRelease(Engine* engine, int spin) {
+
+	long cycle = engine->cycle + 1;
+	double now = engineClock(engine);
+	double period = engine->period * .000001;
+
+	if (now >= (cycle + 1) * period) {
+		return (long) (now / period);
+	}
+
+	if (spin) {
+		while (engineClock(engine) < cycle * period) {}
+	} else {
+		struct timespec release = releaseTime(engine, cycle);
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &release, NULL) == EINTR) {}
+	}
+	return cycle;
+}
@@ -0,0 +1,147 @@
+/*
+ * Name: Trace.c
+ * Author: Elijah Pivo
+ *
+ * Opt in timeline tracing of the acquisition pipeline.
+ */
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "Trace.h"
+
+volatile int traceEnabled = 0;
+
+static TraceBuffer buffers[TRACE_MAX_THREADS];
+static int numBuffers = 0;
+static volatile int claimed = 0;
+static long capacity = 0;
+static struct timespec start;
+
+//the calling thread's buffer, NULL until its first event
+static __thread TraceBuffer* threadBuffer = NULL;
+static __thread int untraced = 0; //no buffer was left for this thread
+
+int initializeTrace(Arena* arena, int threads, long eventsPerThread) {
+
+	if (threads > TRACE_MAX_THREADS) {
+		fprintf(stderr, "Trace ERROR: At most %i threads can be traced.\n", TRACE_MAX_THREADS);
+		return -1;
+	}
+
+	for (int i = 0; i < threads; i++) {
+		buffers[i].events = arenaAlloc(arena, eventsPerThread * sizeof(TraceEvent), 0);
+		if (buffers[i].events == NULL) {
+			return -1;
+		}
+		buffers[i].count = 0;
+		buffers[i].dropped = 0;
+		buffers[i].tid = 0;
+		buffers[i].name = NULL;
+	}
+
+	numBuffers = threads;
+	capacity = eventsPerThread;
+	claimed = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	return 1;
+}
+
+void setTraceEnabled(int enabled) {
+	traceEnabled = enabled && capacity > 0;
+}
+
+/*
+ * Returns the calling thread's buffer, claiming one the first time.
+ * Returns NULL if they're all taken.
+ */
+static TraceBuffer* ownBuffer() {
+
+	if (threadBuffer == NULL && !untraced) {
+		int index = __sync_fetch_and_add(&claimed, 1);
+		if (index >= numBuffers) {
+			untraced = 1;
+			return NULL;
+		}
+		threadBuffer = &buffers[index];
+		threadBuffer->tid = syscall(SYS_gettid);
+	}
+
+	return threadBuffer;
+}
+
+void traceThreadName(const char* name) {
+
+	TraceBuffer* buffer = ownBuffer();
+	if (buffer != NULL) {
+		buffer->name = name;
+	}
+}
+
+void traceEvent(const char* name, char phase) {
+
+	TraceBuffer* buffer = ownBuffer();
+	if (buffer == NULL) {
+		return;
+	}
+	if (buffer->count == capacity) {
+		buffer->dropped++;
+		return;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	TraceEvent* event = &buffer->events[buffer->count];
+	event->time = (now.tv_sec - start.tv_sec) * 1000000000LL + (now.tv_nsec - start.tv_nsec);
+	event->name = name;
+	event->phase = phase;
+
+	buffer->count++;
+}
+
+int writeChromeTrace(const char* file) {
+
+	FILE* out = fopen(file, "w");
+	if (out == NULL) {
+		fprintf(stderr, "Trace ERROR: Couldn't create %s.\n", file);
+		return -1;
+	}
+
+	int threads = claimed < numBuffers ? claimed : numBuffers;
+	int first = 1;
+	long dropped = 0;
+	pid_t pid = getpid();
+
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	for (int t = 0; t < threads; t++) {
+		const TraceBuffer* buffer = &buffers[t];
+
+		if (buffer->name != NULL) {
+			fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%i,\"tid\":%i,\"args\":{\"name\":\"%s\"}}",
+					first ? "" : ",\n", pid, buffer->tid, buffer->name);
+			first = 0;
+		}
+
+		//timestamps are in us, ns kept as the fraction
+		for (long i = 0; i < buffer->count; i++) {
+			const TraceEvent* event = &buffer->events[i];
+			fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld.%03lld,\"pid\":%i,\"tid\":%i%s}",
+					first ? "" : ",\n", event->name, event->phase, (long long) event->time / 1000,
+					(long long) event->time % 1000, pid, buffer->tid, event->phase == 'i' ? ",\"s\":\"t\"" : "");
+			first = 0;
+		}
+		dropped += buffer->dropped;
+	}
+
+	fprintf(out, "\n]}\n");
+	fclose(out);
+
+	if (dropped > 0) {
+		fprintf(stderr, "Trace WARNING: %ld events dropped, buffers were full.\n", dropped);
+	}
+
+	return 1;
+}
@@ -0,0 +1,104 @@
+/*
+ * Name: Trace.h
+ * Author: Elijah Pivo
+ *
+ * Opt in timeline tracing of the acquisition pipeline.
+ *
+ * Trace points record begin and end events, with the thread and a
+ * CLOCK_MONOTONIC time, into a buffer owned by the recording thread (no
+ * locks, no sharing). At the end of a session the buffers are written as
+ * a Chrome trace (JSON), which chrome://tracing and ui.perfetto.dev open
+ * as a timeline, one track per thread.
+ *
+ * Build with -DARMTRACK_TRACE (and Trace.c) to compile the trace points in.
+ * Without it every TRACE_* macro is empty and costs nothing. Compiled in,
+ * tracing still starts disabled, a disabled trace point is one branch.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "Arena.h"
+
+#define TRACE_MAX_THREADS 16
+
+typedef struct {
+	int64_t time; //ns since initializeTrace
+	const char* name; //must be a string literal (or otherwise outlive the trace)
+	char phase; //'B' begin, 'E' end, 'i' instant
+} TraceEvent;
+
+typedef struct {
+	TraceEvent* events;
+	long count;
+	long dropped; //events after the buffer filled
+	int tid;
+	const char* name;
+} TraceBuffer;
+
+extern volatile int traceEnabled;
+
+/*
+ * Allocates a buffer of eventsPerThread events for each of threads threads
+ * from the arena, so recording never allocates. A full buffer keeps its
+ * first events and drops the rest. Tracing stays disabled.
+ * Returns 1 if succeeded, -1 if the arena was too small or threads is
+ * more than TRACE_MAX_THREADS.
+ */
+int initializeTrace(Arena* arena, int threads, long eventsPerThread);
+
+/*
+ * Turns recording on or off.
+ */
+void setTraceEnabled(int enabled);
+
+/*
+ * Names the calling thread's track.
+ */
+void traceThreadName(const char* name);
+
+/*
+ * Records an event for the calling thread. The first event from a thread
+ * claims it a buffer, threads after the buffers run out aren't traced.
+ */
+void traceEvent(const char* name, char phase);
+
+/*
+ * Writes every thread's events as a Chrome trace. Call once the traced
+ * threads are stopped. Returns 1 if written, -1 otherwise.
+ */
+int writeChromeTrace(const char* file);
+
+#ifdef ARMTRACK_TRACE
+static inline const char* traceScopeBegin(const char* name) {
+	if (traceEnabled) {
+		traceEvent(name, 'B');
+	}
+	return name;
+}
+
+static inline void traceScopeEnd(const char** name) {
+	if (traceEnabled) {
+		traceEvent(*name, 'E');
+	}
+}
+
+#define TRACE_BEGIN(name) do { if (traceEnabled) traceEvent(name, 'B'); } while (0)
+#define TRACE_END(name) do { if (traceEnabled) traceEvent(name, 'E'); } while (0)
+#define TRACE_INSTANT(name) do { if (traceEnabled) traceEvent(name, 'i'); } while (0)
+//begin now, end whenever the enclosing block is left (any return)
+#define TRACE_SCOPE(name) const char* traceScope __attribute__((cleanup(traceScopeEnd), unused)) = traceScopeBegin(name)
+#define TRACE_THREAD(name) traceThreadName(name)
+#else
+#define TRACE_BEGIN(name) do {} while (0)
+#define TRACE_END(name) do {} while (0)
+#define TRACE_INSTANT(name) do {} while (0)
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_THREAD(name) do {} while (0)
+#endif
+
+#endif
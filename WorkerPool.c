@@ -0,0 +1,217 @@
+/*
+ * Name: WorkerPool.c
+ * Author: Elijah Pivo
+ *
+ * Fixed pool of long lived worker threads for a periodic loop.
+ */
+
+#include "WorkerPool.h"
+
+static void* runWorker(void* arg);
+
+int initializeWorkerPool(WorkerPool* pool, ThreadPlan* ThreadPlan) {
+
+	memset(pool, 0, sizeof(*pool));
+	pool->ThreadPlan = ThreadPlan;
+
+	//deadlines are on the monotonic clock, the wall clock can be set under a session
+	pthread_condattr_t attributes;
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	int error = pthread_mutex_init(&pool->lock, NULL) != 0 || pthread_cond_init(&pool->done, &attributes) != 0;
+	pthread_condattr_destroy(&attributes);
+
+	if (error) {
+		fprintf(stderr, "WorkerPool.c ERROR: Couldn't set up the pool's lock.\n");
+		return -1;
+	}
+	return 1;
+}
+
+int addPoolTask(WorkerPool* pool, const char* name, PoolTask task, void* arg, int role) {
+
+	if (pool->numWorkers == POOL_MAX_WORKERS || pool->running) {
+		return -1;
+	}
+
+	PoolWorker* worker = &pool->workers[pool->numWorkers];
+	worker->pool = pool;
+	worker->index = pool->numWorkers;
+	worker->name = name;
+	worker->task = task;
+	worker->arg = arg;
+	worker->role = role;
+	worker->tick = -1;
+	worker->doneTick = -1;
+	if (pthread_cond_init(&worker->wake, NULL) != 0) {
+		return -1;
+	}
+
+	return pool->numWorkers++;
+}
+
+int startWorkerPool(WorkerPool* pool) {
+
+	pool->running = 1;
+
+	for (int i = 0; i < pool->numWorkers; i++) {
+		if (pthread_create(&pool->workers[i].thread, NULL, runWorker, &pool->workers[i]) != 0) {
+			fprintf(stderr, "WorkerPool.c ERROR: Couldn't start the %s worker.\n", pool->workers[i].name);
+			pool->numWorkers = i; //only the ones started are stopped
+			stopWorkerPool(pool);
+			return -1;
+		}
+	}
+
+	return 1;
+}
+
+unsigned dispatchTasks(WorkerPool* pool, unsigned tasks, double time, unsigned* late) {
+
+	unsigned dispatched = 0;
+
+	pthread_mutex_lock(&pool->lock);
+
+	//taken under the same lock, a worker that finishes late from here on is still busy and sits this tick out
+	if (late != NULL) {
+		*late = pool->lateTasks;
+		pool->lateTasks = 0;
+	}
+
+	pool->tick++;
+	pool->time = time;
+	for (int i = 0; i < pool->numWorkers; i++) {
+		PoolWorker* worker = &pool->workers[i];
+		if (!(tasks & 1u << i)) {
+			continue;
+		}
+		if (worker->busy || worker->pending) {
+			worker->busyTicks++; //still on a read it was late with
+			continue;
+		}
+		worker->tick = pool->tick;
+		worker->pending = 1;
+		worker->cancelled = 0;
+		if (pool->ThreadPlan != NULL && worker->role != -1) {
+			markThreadRelease(pool->ThreadPlan, worker->role);
+		}
+		pthread_cond_signal(&worker->wake);
+		dispatched |= 1u << i;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return dispatched;
+}
+
+unsigned awaitTasks(WorkerPool* pool, unsigned dispatched, const struct timespec* deadline, int* results) {
+
+	unsigned finished;
+
+	pthread_mutex_lock(&pool->lock);
+	while (1 == 1) {
+		finished = 0;
+		for (int i = 0; i < pool->numWorkers; i++) {
+			if ((dispatched & 1u << i) && pool->workers[i].doneTick == pool->tick) {
+				finished |= 1u << i;
+			}
+		}
+		if (finished == dispatched) {
+			break;
+		}
+		if (pthread_cond_timedwait(&pool->done, &pool->lock, deadline) == ETIMEDOUT) {
+			//one last look, a worker may have finished right at the deadline
+			finished = 0;
+			for (int i = 0; i < pool->numWorkers; i++) {
+				if ((dispatched & 1u << i) && pool->workers[i].doneTick == pool->tick) {
+					finished |= 1u << i;
+				}
+			}
+			break;
+		}
+	}
+
+	for (int i = 0; i < pool->numWorkers; i++) {
+		if (finished & 1u << i) {
+			results[i] = pool->workers[i].result;
+		} else if (dispatched & 1u << i) {
+			pool->workers[i].cancelled = 1; //given up on, the worker stops as soon as it can
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return finished;
+}
+
+void stopWorkerPool(WorkerPool* pool) {
+
+	pthread_mutex_lock(&pool->lock);
+	pool->running = 0;
+	for (int i = 0; i < pool->numWorkers; i++) {
+		pool->workers[i].cancelled = 1;
+		pthread_cond_signal(&pool->workers[i].wake);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	for (int i = 0; i < pool->numWorkers; i++) {
+		pthread_join(pool->workers[i].thread, NULL);
+	}
+}
+
+void printWorkerPool(const WorkerPool* pool, FILE* file) {
+
+	for (int i = 0; i < pool->numWorkers; i++) {
+		const PoolWorker* worker = &pool->workers[i];
+		fprintf(file, "%s worker: %li reads, %li late, %li given up before starting, %li ticks still busy\n",
+				worker->name, worker->runs, worker->late, worker->skipped, worker->busyTicks);
+	}
+}
+
+static void* runWorker(void* arg) {
+
+	PoolWorker* worker = arg;
+	WorkerPool* pool = worker->pool;
+
+	//pinned and prioritized once, for the life of the pool
+	if (pool->ThreadPlan != NULL && worker->role != -1 && applyThreadRole(pool->ThreadPlan, worker->role) != 1) {
+		fprintf(stderr, "WorkerPool.c ERROR: The %s worker couldn't take its role.\n", worker->name);
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	while (1 == 1) {
+		while (pool->running && !worker->pending) {
+			pthread_cond_wait(&worker->wake, &pool->lock);
+		}
+		if (!pool->running) {
+			break;
+		}
+
+		long tick = worker->tick;
+		double time = pool->time;
+		worker->pending = 0;
+		if (worker->cancelled) {
+			worker->skipped++; //the tick was over before this worker got going
+			continue;
+		}
+		worker->busy = 1;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (pool->ThreadPlan != NULL && worker->role != -1) {
+			recordThreadWakeup(pool->ThreadPlan, worker->role);
+		}
+		int result = worker->task(worker->arg, time, &worker->cancelled);
+
+		pthread_mutex_lock(&pool->lock);
+		worker->busy = 0;
+		worker->result = result;
+		worker->doneTick = tick;
+		worker->runs++;
+		if (worker->cancelled) {
+			worker->late++;
+			pool->lateTasks |= 1u << worker->index;
+		}
+		pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
@@ -0,0 +1,123 @@
+/*
+ * Name: WorkerPool.h
+ * Author: Elijah Pivo
+ *
+ * Fixed pool of long lived worker threads for a periodic loop.
+ *
+ * Each worker runs one task (a sensor read) and is created once, pinned
+ * and given its real time priority by its ThreadPlan role, then sleeps on
+ * its own condition until the loop dispatches a tick. The loop waits for
+ * the tick's tasks with a deadline; a task still running at the deadline
+ * is given up on, not killed: its cancelled flag is set (a task can check
+ * it between steps, and a worker that hadn't started yet skips the read),
+ * the worker finishes on its own and isn't dispatched again until it has.
+ * A read that finishes after its tick was given up on is reported by the
+ * next dispatchTasks so its buffer can be drained.
+ *
+ * Tasks are identified by their index, masks have bit i set for task i.
+ */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <stdio.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "CacheLine.h"
+#include "ThreadPlan.h"
+
+#define POOL_MAX_WORKERS 8
+
+typedef struct WorkerPool WorkerPool;
+
+/*
+ * Runs one tick's work at time (s). cancelled is set once the tick has
+ * been given up on. Returns 1 if succeeded, -1 otherwise.
+ */
+typedef int (*PoolTask)(void* arg, double time, const volatile int* cancelled);
+
+typedef struct {
+	WorkerPool* pool;
+	int index;
+	const char* name;
+	PoolTask task;
+	void* arg;
+	int role; //ThreadPlan role, -1 to leave the thread as it's created
+	pthread_t thread;
+	pthread_cond_t wake;
+
+	//handed over under the pool's lock, each worker on its own cache lines
+	long tick CACHE_ALIGNED; //tick dispatched
+	long doneTick; //last tick finished
+	int pending; //dispatched, not started
+	int busy;
+	int result;
+	volatile int cancelled;
+
+	long runs;
+	long late; //finished after their tick was given up on
+	long skipped; //given up on before they started
+	long busyTicks; //not dispatched, still on a late read
+} PoolWorker;
+
+struct WorkerPool {
+	PoolWorker workers[POOL_MAX_WORKERS];
+	int numWorkers;
+	ThreadPlan* ThreadPlan; //NULL to leave threads unpinned
+
+	pthread_mutex_t lock;
+	pthread_cond_t done; //signalled by a worker when it finishes
+	long tick;
+	double time;
+	int running;
+	unsigned lateTasks; //finished late since dispatchTasks last looked
+};
+
+/*
+ * Sets up an empty pool. Workers take their roles from ThreadPlan, which
+ * may be NULL. Returns 1 if succeeded, -1 otherwise.
+ */
+int initializeWorkerPool(WorkerPool* pool, ThreadPlan* ThreadPlan);
+
+/*
+ * Adds a task with its own worker, taking ThreadPlan role role (-1 for
+ * none). Returns the task's index, -1 if the pool is full or running.
+ */
+int addPoolTask(WorkerPool* pool, const char* name, PoolTask task, void* arg, int role);
+
+/*
+ * Creates the workers. Returns 1 if every worker started, -1 otherwise
+ * (the ones started are stopped again).
+ */
+int startWorkerPool(WorkerPool* pool);
+
+/*
+ * Starts a tick: hands each task in tasks the time and wakes its worker.
+ * A worker still on a read it was late with isn't dispatched. If late
+ * isn't NULL it gets the mask of tasks that finished a read after its
+ * tick was given up on since the last dispatch, taken under the same lock
+ * so none of them is dispatched before it's reported.
+ * Returns the mask of tasks dispatched.
+ */
+unsigned dispatchTasks(WorkerPool* pool, unsigned tasks, double time, unsigned* late);
+
+/*
+ * Waits for the tasks dispatched this tick until deadline (CLOCK_MONOTONIC).
+ * Tasks not done by then are cancelled. Puts each finished task's result
+ * in results (indexed by task) and returns the mask of tasks that finished.
+ */
+unsigned awaitTasks(WorkerPool* pool, unsigned dispatched, const struct timespec* deadline, int* results);
+
+/*
+ * Stops and joins every worker, each after its current task finishes.
+ */
+void stopWorkerPool(WorkerPool* pool);
+
+/*
+ * Prints each worker's runs, late reads and skipped ticks.
+ */
+void printWorkerPool(const WorkerPool* pool, FILE* file);
+
+#endif
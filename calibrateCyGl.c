@@ -0,0 +1,53 @@
+/*
+ * Name: calibrateCyGl.c
+ * Author: Elijah Pivo
+ *
+ * Description:
+ * 	Calibrates a CyberGlove II for the subject wearing it. Walks through a
+ * 	few hand poses, fits each sensor's gain and offset and saves them for
+ * 	mobileArmTrackTest to load.
+ *
+ * Usage:
+ * 	Compile with: gcc -o calibrateCyGl calibrateCyGl.c CyGlCalibration.c CyGl.c Serial.c -std=gnu99 -Wall -Wextra -lm
+ * 	Run with: ./calibrateCyGl [calibration file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "CyGl.h"
+#include "CyGlCalibration.h"
+
+#define DEFAULT_CALIBRATION_FILE "/home/pi/Desktop/ArmTrack/CyGlCalibration.txt"
+
+int main(int argc, char* argv[]) {
+
+	const char* file = DEFAULT_CALIBRATION_FILE;
+	if (argc > 1) {
+		file = argv[1];
+	}
+
+	CyGl CyGl;
+	if (startCyGl(&CyGl) != 1) {
+		fprintf(stderr, "ERROR: Couldn't connect to CyberGlove II.\n");
+		exit(1);
+	}
+
+	//start from the last calibration so sensors the poses can't fit keep theirs
+	static CyGlCalibration cal;
+	loadCyGlCalibration(&cal, file);
+
+	if (runCyGlCalibration(&CyGl, &cal) == -1) {
+		closeCyGl(&CyGl);
+		exit(1);
+	}
+
+	closeCyGl(&CyGl);
+
+	if (saveCyGlCalibration(&cal, file) != 1) {
+		exit(1);
+	}
+
+	fprintf(stderr, "Saved calibration to %s\n", file);
+	return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * Name: classifyEMG.c
+ * Author: Elijah Pivo
+ *
+ * Description:
+ * 	Runs a recorded EMG file (ArmTrackEMGData.txt, counts) through the
+ * 	streaming feature stage, converted to volts a block at a time with the
+ * 	session's ArmTrackEMGCalibration.txt. With a classifier prints each
+ * 	window's time and gesture, without one prints each window's time and
+ * 	feature vector, tab separated, for training a classifier offline.
+ *
+ * Usage:
+ * 	Compile with: gcc -O2 -o classifyEMG classifyEMG.c EMGFeatures.c EMGCalibration.c Arena.c FastFormat.c -std=gnu99 -Wall -Wextra -lm
+ * 	Run with: ./classifyEMG <ArmTrackEMGData.txt> <ArmTrackEMGCalibration.txt> [classifier file] [feature spec, see parseFeatureConfig]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "EMGFeatures.h"
+#include "EMGCalibration.h"
+#include "FastFormat.h"
+
+#define LINE_SZ 1024
+#define BLOCK_SCANS 200 //fed in recorder sized blocks
+#define MAX_WINDOWS 256
+
+int main(int argc, char* argv[]) {
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s <ArmTrackEMGData.txt> <ArmTrackEMGCalibration.txt> [classifier file] [feature spec]\n", argv[0]);
+		exit(1);
+	}
+
+	//the calibration has the channels and the sample time too
+	EMGCalibration calibration;
+	if (loadEMGCalibration(&calibration, argv[2]) != 1) {
+		exit(1);
+	}
+	int channels = calibration.channels;
+	double sampleTime = calibration.sampleTime;
+	FeatureConfig config;
+	defaultFeatureConfig(&config);
+	if (argc > 4 && parseFeatureConfig(&config, argv[4]) != 1) {
+		exit(1);
+	}
+
+	static Classifier classifier;
+	int classify = argc > 3 && strcmp(argv[3], "-") != 0;
+	if (classify && loadClassifier(&classifier, argv[3]) != 1) {
+		exit(1);
+	}
+
+	FILE* in = fopen(argv[1], "r");
+	if (in == NULL) {
+		fprintf(stderr, "ERROR: Couldn't open %s.\n", argv[1]);
+		exit(1);
+	}
+
+	char line[LINE_SZ];
+	EMGFeatures features;
+	if (initializeEMGFeatures(&features, &config, channels, sampleTime, NULL) != 1) {
+		exit(1);
+	}
+	if (classify && classifier.numFeatures != channels * FEATURES_PER_CHANNEL) {
+		fprintf(stderr, "ERROR: The classifier takes %i features, %i channels give %i.\n",
+				classifier.numFeatures, channels, channels * FEATURES_PER_CHANNEL);
+		exit(1);
+	}
+
+	static signed short counts[BLOCK_SCANS * FEATURE_MAX_CHANNELS];
+	static float block[BLOCK_SCANS * FEATURE_MAX_CHANNELS];
+	static FeatureWindow windows[MAX_WINDOWS];
+	char outBytes[64 * 1024];
+	TextBuffer out;
+	initializeTextBuffer(&out, outBytes, sizeof(outBytes), stdout);
+
+	long scans = 0;
+	long numWindows = 0;
+	int done = 0;
+	while (!done) {
+
+		int numScans = 0;
+		while (numScans < BLOCK_SCANS && fgets(line, sizeof(line), in) != NULL) {
+			char* p = line;
+			char* end;
+			int c = 0;
+			for (; c < channels; c++) {
+				counts[numScans * channels + c] = (signed short) strtol(p, &end, 10);
+				if (end == p) {
+					break;
+				}
+				p = end;
+			}
+			if (c == channels) {
+				numScans++; //a cut off line is skipped
+			}
+		}
+		done = numScans < BLOCK_SCANS;
+		countsToVolts(&calibration, counts, numScans, block);
+
+		int closed = addEMGScans(&features, block, numScans, scans * sampleTime, windows, MAX_WINDOWS);
+		scans += numScans;
+		numWindows += closed;
+
+		for (int w = 0; w < closed; w++) {
+			appendFixed(&out, windows[w].time, '\t');
+			if (classify) {
+				float score;
+				int gesture = classifyGesture(&classifier, windows[w].features, &score);
+				appendText(&out, classifier.names[gesture], strlen(classifier.names[gesture]));
+				appendText(&out, "\t", 1);
+				appendFixed(&out, score, '\n');
+			} else {
+				for (int f = 0; f < channels * FEATURES_PER_CHANNEL; f++) {
+					appendFixed(&out, windows[w].features[f], f + 1 < channels * FEATURES_PER_CHANNEL ? '\t' : '\n');
+				}
+			}
+		}
+	}
+	flushText(&out);
+	fclose(in);
+
+	fprintf(stderr, "%li scans of %i channels, %li windows of %i scans every %i scans\n",
+			scans, channels, numWindows, features.windowSamples, features.stepSamples);
+	return 0;
+}
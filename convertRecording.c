@@ -0,0 +1,157 @@
+/*
+ * Name: convertRecording.c
+ * Author: Elijah Pivo
+ *
+ * Description:
+ * 	Converts or queries a recorded session offline. The recording is
+ * 	mapped and decoded in parallel on every core (see Recording.h), rows
+ * 	in a time range and a subset of the channels are written as CSV or as
+ * 	a column file. Reports how fast the recording was read.
+ *
+ * Usage:
+ * 	Compile with: gcc -O2 -pthread -o convertRecording convertRecording.c Recording.c FastFormat.c -std=gnu99 -Wall -Wextra -lm
+ * 	Run with: ./convertRecording [options] <recording> <output file, - for stdout>
+ * 		-f text|columns  input format, by default columns for a *.columns file and text otherwise
+ * 		-o csv|columns  output format, csv by default
+ * 		-t start:end  time range in s, either end may be left out
+ * 		-c 0-3,12  channels (columns after time), all by default
+ * 		-e sampleTime  s between rows of a text file without a time column (ArmTrackEMGData.txt, .001 at 1kHz)
+ * 		-j threads  decoding threads, every core by default
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Recording.h"
+
+static void usage(const char* program) {
+	fprintf(stderr, "Usage: %s [-f text|columns] [-o csv|columns] [-t start:end] [-c channels] [-e sampleTime] [-j threads] <recording> <output file>\n", program);
+	exit(1);
+}
+
+static int parseTimeRange(RecordingQuery* query, const char* range) {
+
+	char* end;
+	const char* colon = strchr(range, ':');
+	if (colon == NULL) {
+		return -1;
+	}
+	if (colon != range) {
+		query->startTime = strtod(range, &end);
+		if (end != colon) {
+			return -1;
+		}
+	}
+	if (colon[1] != '\0') {
+		query->endTime = strtod(colon + 1, &end);
+		if (*end != '\0') {
+			return -1;
+		}
+	}
+	return query->startTime < query->endTime ? 1 : -1;
+}
+
+int main(int argc, char* argv[]) {
+
+	RecordingQuery query;
+	defaultRecordingQuery(&query);
+
+	int format = -1;
+	double sampleTime = 0;
+	int option;
+	while ((option = getopt(argc, argv, "f:o:t:c:e:j:")) != -1) {
+		switch (option) {
+		case 'f':
+			if (strcmp(optarg, "text") == 0) {
+				format = RECORDING_TEXT;
+			} else if (strcmp(optarg, "columns") == 0) {
+				format = RECORDING_COLUMNS;
+			} else {
+				usage(argv[0]);
+			}
+			break;
+		case 'o':
+			if (strcmp(optarg, "csv") == 0) {
+				query.output = RECORDING_CSV;
+			} else if (strcmp(optarg, "columns") == 0) {
+				query.output = RECORDING_COLUMN_FILE;
+			} else {
+				usage(argv[0]);
+			}
+			break;
+		case 't':
+			if (parseTimeRange(&query, optarg) != 1) {
+				fprintf(stderr, "ERROR: Bad time range %s.\n", optarg);
+				exit(1);
+			}
+			break;
+		case 'c':
+			if (parseRecordingChannels(&query, optarg) != 1) {
+				fprintf(stderr, "ERROR: Bad channel list %s.\n", optarg);
+				exit(1);
+			}
+			break;
+		case 'e':
+			sampleTime = atof(optarg);
+			if (sampleTime <= 0) {
+				usage(argv[0]);
+			}
+			break;
+		case 'j':
+			query.threads = atoi(optarg);
+			if (query.threads < 1 || query.threads > RECORDING_MAX_THREADS) {
+				fprintf(stderr, "ERROR: Between 1 and %i threads.\n", RECORDING_MAX_THREADS);
+				exit(1);
+			}
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (argc - optind != 2) {
+		usage(argv[0]);
+	}
+
+	const char* input = argv[optind];
+	const char* outputFile = argv[optind + 1];
+	if (format == -1) {
+		size_t length = strlen(input);
+		format = length > 8 && strcmp(input + length - 8, ".columns") == 0 ? RECORDING_COLUMNS : RECORDING_TEXT;
+	}
+
+	Recording recording;
+	if (openRecording(&recording, input, format, sampleTime) != 1) {
+		exit(1);
+	}
+
+	int fd = STDOUT_FILENO;
+	if (strcmp(outputFile, "-") != 0 && (fd = open(outputFile, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+		fprintf(stderr, "ERROR: Couldn't open %s.\n", outputFile);
+		closeRecording(&recording);
+		exit(1);
+	}
+
+	RecordingReport report;
+	int result = queryRecording(&recording, &query, fd, &report);
+	if (fd != STDOUT_FILENO && close(fd) != 0) {
+		fprintf(stderr, "ERROR: Couldn't close %s.\n", outputFile);
+		result = -1;
+	}
+
+	fprintf(stderr, "%s: %i channels, %i chunks, %zu bytes\n", input, recording.columns, recording.numChunks, recording.size);
+	fprintf(stderr, "Rows: %li (%li missed reads)\n", report.rows, report.missedRows);
+	fprintf(stderr, "Read: %zu bytes in %f s, %f GB/s\n", report.bytesIn, report.decodeTime,
+			report.decodeTime > 0 ? report.bytesIn / report.decodeTime / 1e9 : 0);
+	if (report.bytesSkipped > 0) {
+		fprintf(stderr, "Skipped: %zu bytes outside the time range\n", report.bytesSkipped);
+	}
+	fprintf(stderr, "Wrote: %zu bytes, %f s total, %f GB/s\n", report.bytesOut, report.totalTime,
+			report.totalTime > 0 ? report.bytesIn / report.totalTime / 1e9 : 0);
+
+	closeRecording(&recording);
+	return result == 1 ? 0 : 1;
+}
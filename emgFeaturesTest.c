@@ -0,0 +1,283 @@
+/*
+ * Name: emgFeaturesTest.c
+ * Author: Elijah Pivo
+ *
+ * Description:
+ * 	Checks the streaming EMG features against features worked out from
+ * 	scratch over every window of a synthetic 8 channel signal fed in
+ * 	blocks of random sizes, counts against the same scans in volts, and a
+ * 	classifier loaded from a file against hand worked scores, then measures how long a 200ms block (1600
+ * 	values) takes to go through the feature stage and a classifier.
+ *
+ * Usage:
+ * 	Compile with: gcc -O2 -o emgFeaturesTest emgFeaturesTest.c EMGFeatures.c Arena.c -std=gnu99 -Wall -Wextra -lm
+ * 	(add -mfpu=neon on the Pi)
+ * 	Run with: ./emgFeaturesTest [number of blocks to time]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "EMGFeatures.h"
+
+#define CHANNELS 8
+#define SAMPLE_TIME .001 //1kHz a channel
+#define BLOCK_SCANS 200
+#define SIGNAL_SCANS 20000
+#define MAX_WINDOWS 64
+#define CLASSIFIER_FILE "emgFeaturesTestClassifier.txt"
+
+static float signal[SIGNAL_SCANS * CHANNELS];
+static signed short counts[SIGNAL_SCANS * CHANNELS];
+static float countVolts[SIGNAL_SCANS * CHANNELS];
+
+static double seconds(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec * .000000001;
+}
+
+/*
+ * Features of the window of scans [first, first + length), from scratch.
+ */
+static void windowFeatures(int first, int length, float threshold, float* out) {
+
+	for (int c = 0; c < CHANNELS; c++) {
+		double absolute = 0, squares = 0, waveform = 0;
+		int crossings = 0, slopeChanges = 0;
+		for (int i = first; i < first + length; i++) {
+			float x = signal[i * CHANNELS + c];
+			absolute += fabsf(x);
+			squares += x * x;
+			if (i > first) {
+				float previous = signal[(i - 1) * CHANNELS + c];
+				waveform += fabsf(x - previous);
+				crossings += x * previous < 0 && fabsf(x - previous) >= threshold;
+			}
+			if (i > first && i < first + length - 1) {
+				float previous = signal[(i - 1) * CHANNELS + c];
+				float next = signal[(i + 1) * CHANNELS + c];
+				slopeChanges += (x - previous) * (x - next) > threshold * threshold;
+			}
+		}
+		out[c * FEATURES_PER_CHANNEL + FEATURE_MAV] = absolute / length;
+		out[c * FEATURES_PER_CHANNEL + FEATURE_RMS] = sqrt(squares / length);
+		out[c * FEATURES_PER_CHANNEL + FEATURE_WL] = waveform;
+		out[c * FEATURES_PER_CHANNEL + FEATURE_ZC] = crossings;
+		out[c * FEATURES_PER_CHANNEL + FEATURE_SSC] = slopeChanges;
+	}
+}
+
+/*
+ * Feeds the signal as counts (a made up calibration per channel) and as
+ * those counts in volts, in the same blocks, and checks every window's
+ * features match. Returns 1 if they do, -1 otherwise.
+ */
+static int checkCounts(const FeatureConfig* config) {
+
+	EMGCalibration cal;
+	memset(&cal, 0, sizeof(cal));
+	cal.channels = CHANNELS;
+	cal.sampleTime = SAMPLE_TIME;
+	for (int c = 0; c < CHANNELS; c++) {
+		cal.gain[c] = .0003f * (c + 1);
+		cal.offset[c] = -.001f * c;
+	}
+	for (int i = 0; i < SIGNAL_SCANS * CHANNELS; i++) {
+		int c = i % CHANNELS;
+		counts[i] = lroundf((signal[i] - cal.offset[c]) / cal.gain[c]);
+		countVolts[i] = cal.offset[c] + cal.gain[c] * counts[i];
+	}
+
+	EMGFeatures fromVolts, fromCounts;
+	if (initializeEMGFeatures(&fromVolts, config, CHANNELS, SAMPLE_TIME, NULL) != 1
+			|| initializeEMGFeatures(&fromCounts, config, CHANNELS, SAMPLE_TIME, NULL) != 1) {
+		return -1;
+	}
+
+	FeatureWindow voltWindows[MAX_WINDOWS], countWindows[MAX_WINDOWS];
+	int windows = 0;
+	for (int scan = 0; scan < SIGNAL_SCANS; scan += BLOCK_SCANS) {
+		int closed = addEMGScans(&fromVolts, &countVolts[scan * CHANNELS], BLOCK_SCANS, scan * SAMPLE_TIME,
+				voltWindows, MAX_WINDOWS);
+		if (addEMGCounts(&fromCounts, &cal, &counts[scan * CHANNELS], BLOCK_SCANS, scan * SAMPLE_TIME,
+				countWindows, MAX_WINDOWS) != closed) {
+			fprintf(stderr, "ERROR: Counts closed a different number of windows.\n");
+			return -1;
+		}
+		for (int w = 0; w < closed; w++) {
+			for (int f = 0; f < CHANNELS * FEATURES_PER_CHANNEL; f++) {
+				float expected = voltWindows[w].features[f];
+				if (fabsf(countWindows[w].features[f] - expected) > 1e-5f * (fabsf(expected) + 1e-3f)) {
+					fprintf(stderr, "ERROR: Window %i differs between counts and volts.\n", windows + w);
+					return -1;
+				}
+			}
+		}
+		windows += closed;
+	}
+	printf("Counts: %i windows match volts\n", windows);
+
+	return 1;
+}
+
+/*
+ * Loads a 6 feature, 3 class classifier and checks the class and score it
+ * gives hand built feature vectors, standardized scores worked out by hand:
+ * 	rest	.5 + (f0 - 1)
+ * 	fist	f1 - 2
+ * 	open	10 * (f5 - 6)
+ * Two of the vectors pick another class if the mean and scale are left out.
+ * Returns 1 if they all match, -1 otherwise.
+ */
+static int checkClassifier(void) {
+
+	FILE* out = fopen(CLASSIFIER_FILE, "w");
+	if (out == NULL) {
+		fprintf(stderr, "ERROR: Couldn't write %s.\n", CLASSIFIER_FILE);
+		return -1;
+	}
+	fprintf(out, "# made up for emgFeaturesTest\n");
+	fprintf(out, "features 6\n");
+	fprintf(out, "mean 1 2 3 4 5 6\n");
+	fprintf(out, "scale 1 1 1 1 1 10\n");
+	fprintf(out, "class rest .5 1 0 0 0 0 0\n");
+	fprintf(out, "class fist 0 0 1 0 0 0 0\n");
+	fprintf(out, "class open 0 0 0 0 0 0 1\n");
+	fclose(out);
+
+	Classifier classifier;
+	int loaded = loadClassifier(&classifier, CLASSIFIER_FILE);
+	remove(CLASSIFIER_FILE);
+	if (loaded != 1) {
+		return -1;
+	}
+
+	static const struct {
+		float features[6];
+		int label;
+		float score;
+	} checks[] = {
+		{{3, 2, 3, 4, 5, 6}, 0, 2.5f},
+		{{1, 4, 3, 4, 5, 6}, 1, 2},
+		{{1, 2, 3, 4, 5, 6.5f}, 2, 5},
+		{{5, 2, 3, 4, 5, 6.3f}, 0, 4.5f}, //open on the raw features, its scale brings it down
+		{{2, 3.8f, 3, 4, 5, 6}, 1, 1.8f} //open on the raw features, the means take it away
+	};
+
+	int result = 1;
+	for (int i = 0; i < (int) (sizeof(checks) / sizeof(checks[0])); i++) {
+		float score;
+		int label = classifyGesture(&classifier, checks[i].features, &score);
+		if (label != checks[i].label || fabsf(score - checks[i].score) > 1e-4f) {
+			fprintf(stderr, "ERROR: Vector %i classified %s (%g), expected %s (%g).\n", i,
+					classifier.names[label], score, classifier.names[checks[i].label], checks[i].score);
+			result = -1;
+		}
+	}
+	printf("Classifier: %s\n", result == 1 ? "every vector matched" : "mismatched");
+
+	return result;
+}
+
+int main(int argc, char* argv[]) {
+
+	int blocks = 10000;
+	if (argc > 1) {
+		blocks = atoi(argv[1]);
+	}
+
+	//noise bursts on a slow drift, different on each channel
+	srand(1);
+	for (int i = 0; i < SIGNAL_SCANS; i++) {
+		for (int c = 0; c < CHANNELS; c++) {
+			float burst = (i / 500 + c) % 3 == 0 ? 1.0f : .05f;
+			signal[i * CHANNELS + c] = burst * (rand() / (float) RAND_MAX - .5f) + .02f * sinf(i * .01f + c);
+		}
+	}
+
+	FeatureConfig config;
+	defaultFeatureConfig(&config);
+	EMGFeatures features;
+	if (initializeEMGFeatures(&features, &config, CHANNELS, SAMPLE_TIME, NULL) != 1) {
+		exit(1);
+	}
+
+	//streamed in uneven blocks, every window checked
+	FeatureWindow windows[MAX_WINDOWS];
+	float expected[FEATURE_MAX_LENGTH];
+	int checked = 0;
+	double worst = 0;
+	for (int scan = 0; scan < SIGNAL_SCANS;) {
+		int numScans = 1 + rand() % 300;
+		if (numScans > SIGNAL_SCANS - scan) {
+			numScans = SIGNAL_SCANS - scan;
+		}
+		int closed = addEMGScans(&features, &signal[scan * CHANNELS], numScans, scan * SAMPLE_TIME, windows, MAX_WINDOWS);
+		for (int w = 0; w < closed; w++) {
+			int last = lround(windows[w].time / SAMPLE_TIME);
+			windowFeatures(last + 1 - features.windowSamples, features.windowSamples, config.threshold, expected);
+			for (int f = 0; f < CHANNELS * FEATURES_PER_CHANNEL; f++) {
+				double error = fabs(windows[w].features[f] - expected[f]) / (fabs(expected[f]) + 1e-3);
+				worst = error > worst ? error : worst;
+			}
+			checked++;
+		}
+		scan += numScans;
+	}
+	printf("Windows: %i checked, worst relative error %g\n", checked, worst);
+	int expectedWindows = (SIGNAL_SCANS - features.windowSamples) / features.stepSamples + 1;
+	if (checked != expectedWindows || worst > 1e-4) {
+		fprintf(stderr, "ERROR: Streaming features don't match (%i windows, expected %i).\n", checked, expectedWindows);
+		return 1;
+	}
+	if (checkCounts(&config) != 1 || checkClassifier() != 1) {
+		return 1;
+	}
+
+	//a classifier with made up weights, only its speed matters here
+	Classifier classifier;
+	classifier.numFeatures = CHANNELS * FEATURES_PER_CHANNEL;
+	classifier.numClasses = 6;
+	for (int k = 0; k < classifier.numClasses; k++) {
+		snprintf(classifier.names[k], CLASSIFIER_NAME_SZ, "gesture%i", k);
+		classifier.bias[k] = k;
+		for (int f = 0; f < classifier.numFeatures; f++) {
+			classifier.weights[k][f] = rand() / (float) RAND_MAX - .5f;
+		}
+	}
+
+	//recorder sized blocks, as the print thread hands them over
+	resetEMGFeatures(&features);
+	int labels[CLASSIFIER_MAX_CLASSES] = {0};
+	double slowest = 0;
+	double start = seconds();
+	for (int b = 0; b < blocks; b++) {
+		double blockStart = seconds();
+		int scan = (b * BLOCK_SCANS) % (SIGNAL_SCANS - BLOCK_SCANS);
+		int closed = addEMGScans(&features, &signal[scan * CHANNELS], BLOCK_SCANS, b * BLOCK_SCANS * SAMPLE_TIME,
+				windows, MAX_WINDOWS);
+		for (int w = 0; w < closed; w++) {
+			labels[classifyGesture(&classifier, windows[w].features, NULL)]++;
+		}
+		double blockTime = seconds() - blockStart;
+		slowest = blockTime > slowest ? blockTime : slowest;
+	}
+	double elapsed = seconds() - start;
+
+	printf("Blocks: %i of %i scans, %i windows each\n", blocks, BLOCK_SCANS, BLOCK_SCANS / features.stepSamples);
+	printf("Per block: %.1f us mean, %.1f us slowest (%.4f%% of a %.0f ms block)\n",
+			elapsed / blocks * 1e6, slowest * 1e6, elapsed / blocks / (BLOCK_SCANS * SAMPLE_TIME) * 100,
+			BLOCK_SCANS * SAMPLE_TIME * 1000);
+	printf("Labels:");
+	for (int k = 0; k < classifier.numClasses; k++) {
+		printf(" %s %i", classifier.names[k], labels[k]);
+	}
+	printf("\n");
+
+	return 0;
+}
@@ -0,0 +1,200 @@
+/*
+ * Name: fastFormatTest.c
+ * Author: Elijah Pivo
+ *
+ * Description:
+ * 	Checks that FastFormat writes exactly what printf's "%f" and "%i" do,
+ * 	over edge cases, values next to every rounding tie, sensor range floats
+ * 	and random bit patterns, then times a session's EMG blocks (1600 values
+ * 	every 200ms) and records written with fprintf against a TextBuffer.
+ *
+ * Usage:
+ * 	Compile with: gcc -O2 -o fastFormatTest fastFormatTest.c FastFormat.c -std=gnu99 -Wall -Wextra -lm
+ * 	Run with: ./fastFormatTest [values to check, 1000000 by default]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <time.h>
+
+#include "FastFormat.h"
+
+#define EMG_BLOCK_VALUES 1600
+#define BLOCKS 3000 //10 minutes of EMG blocks
+#define RECORD_VALUES 150 //about a mobileArmTrackTest record
+
+static long checked = 0;
+static long failures = 0;
+
+static double seconds(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec * .000000001;
+}
+
+static uint64_t random64(void) {
+	return ((uint64_t) rand() << 42) ^ ((uint64_t) rand() << 21) ^ (uint64_t) rand();
+}
+
+static void check(double value) {
+
+	char expected[FIXED_FORMAT_MAX];
+	char formatted[FIXED_FORMAT_MAX];
+
+	snprintf(expected, sizeof(expected), "%f", value);
+	int length = formatFixed(formatted, value);
+	formatted[length] = '\0';
+
+	checked++;
+	if (strcmp(expected, formatted) != 0 && failures++ < 20) {
+		printf("FAILED: %a printf \"%s\" formatFixed \"%s\"\n", value, expected, formatted);
+	}
+}
+
+static void checkInt(long value) {
+
+	char expected[32];
+	char formatted[32];
+
+	snprintf(expected, sizeof(expected), "%li", value);
+	int length = formatInt(formatted, value);
+	formatted[length] = '\0';
+
+	checked++;
+	if (strcmp(expected, formatted) != 0 && failures++ < 20) {
+		printf("FAILED: printf \"%s\" formatInt \"%s\"\n", expected, formatted);
+	}
+}
+
+static float randomValue(float low, float high) {
+	return low + (high - low) * (rand() / (float) RAND_MAX);
+}
+
+int main(int argc, char* argv[]) {
+
+	long count = argc > 1 ? atol(argv[1]) : 1000000;
+	srand(1);
+
+	//edge cases
+	const double edges[] = {
+			0.0, -0.0, 1.0, -1.0, .5, .0000005, -.0000005, .0000015, .0000025, 1e-7, -1e-7, 1e-300, -1e-300,
+			DBL_MIN, -DBL_MIN, 4.9e-324, .9999995, 9.9999995, 999999.9999995, 1e14, 999999999999999.9,
+			1e15, -1e15, 1e16, 1e22, 1e300, DBL_MAX, -DBL_MAX, FLT_MAX, FLT_MIN, INFINITY, -INFINITY, NAN, -NAN,
+			0.1, 0.2, 0.3, 2.5e-6, 1.2345675, 123456.7890125, 4294967296.0, 18446744073709551616.0
+	};
+	for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+		check(edges[i]);
+	}
+	for (long i = -100000; i <= 100000; i++) {
+		checkInt(i);
+	}
+	checkInt(LONG_MAX);
+	checkInt(LONG_MIN);
+
+	//every tie n.5e-6 and its neighbours
+	for (long i = 0; i < count / 10; i++) {
+		double tie = (rand() % 2000000 * 2 + 1) * .0000005 + rand() % 1000;
+		check(tie);
+		check(nextafter(tie, 0));
+		check(nextafter(tie, INFINITY));
+		check((float) tie);
+		check(-tie);
+	}
+
+	//floats in sensor ranges, as the recorder writes them
+	for (long i = 0; i < count / 2; i++) {
+		check(randomValue(-10, 10)); //EMG volts
+		check(randomValue(-2000, 2000)); //IMU
+	}
+
+	//any double, and any float
+	for (long i = 0; i < count / 2; i++) {
+		uint64_t bits = random64();
+		double value;
+		memcpy(&value, &bits, sizeof(value));
+		check(value);
+
+		uint32_t floatBits = bits;
+		float single;
+		memcpy(&single, &floatBits, sizeof(single));
+		check(single);
+
+		//doubles near the fast range, where the decimals matter
+		check(ldexp((double) (random64() >> 11), -(rand() % 80)));
+	}
+
+	printf("Checked %li values, %li differed from printf.\n", checked, failures);
+
+	//time a session's EMG blocks and records both ways
+	float* block = malloc(EMG_BLOCK_VALUES * sizeof(float));
+	float record[RECORD_VALUES];
+	for (int i = 0; i < EMG_BLOCK_VALUES; i++) {
+		block[i] = randomValue(-10, 10);
+	}
+	for (int i = 0; i < RECORD_VALUES; i++) {
+		record[i] = randomValue(-2000, 2000);
+	}
+
+	FILE* file = fopen("/dev/null", "w");
+	char bytes[64 * 1024];
+	TextBuffer text;
+	initializeTextBuffer(&text, bytes, sizeof(bytes), file);
+
+	double start = seconds();
+	for (int b = 0; b < BLOCKS; b++) {
+		for (int i = 0; i < EMG_BLOCK_VALUES; i++) {
+			fprintf(file, "%f\t", block[i]);
+			if (i % 8 == 7) {
+				fprintf(file, "\n");
+			}
+		}
+	}
+	double EMGfprintf = seconds() - start;
+
+	start = seconds();
+	for (int b = 0; b < BLOCKS; b++) {
+		for (int i = 0; i < EMG_BLOCK_VALUES; i++) {
+			appendFixed(&text, block[i], i % 8 == 7 ? '\n' : '\t');
+		}
+		flushText(&text);
+	}
+	double EMGText = seconds() - start;
+
+	start = seconds();
+	for (int r = 0; r < BLOCKS * 8; r++) {
+		for (int i = 0; i < RECORD_VALUES; i++) {
+			fprintf(file, "%f\t", record[i]);
+		}
+		fprintf(file, "\n");
+	}
+	double recordfprintf = seconds() - start;
+
+	start = seconds();
+	for (int r = 0; r < BLOCKS * 8; r++) {
+		for (int i = 0; i < RECORD_VALUES; i++) {
+			appendFixed(&text, record[i], '\t');
+		}
+		appendText(&text, "\n", 1);
+		flushText(&text);
+	}
+	double recordText = seconds() - start;
+
+	double EMGValues = (double) BLOCKS * EMG_BLOCK_VALUES;
+	double recordValues = (double) BLOCKS * 8 * RECORD_VALUES;
+	printf("EMG blocks: fprintf %.1f ns/value (%.3f ms a block), TextBuffer %.1f ns/value (%.3f ms a block), %.1fx\n",
+			EMGfprintf / EMGValues * 1e9, EMGfprintf / BLOCKS * 1e3,
+			EMGText / EMGValues * 1e9, EMGText / BLOCKS * 1e3, EMGfprintf / EMGText);
+	printf("Records: fprintf %.1f ns/value, TextBuffer %.1f ns/value, %.1fx\n",
+			recordfprintf / recordValues * 1e9, recordText / recordValues * 1e9, recordfprintf / recordText);
+
+	fclose(file);
+	free(block);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+/*
+ * Name: fusionTest.c
+ * Author: Elijah Pivo
+ *
+ * Description:
+ * 	Measures how long one fusion step for the whole IMU chain takes
+ * 	and how much of a 100 Hz (10ms) cycle that uses. Also checks that a
+ * 	still, tilted chain converges to the tilt given by gravity, and that
+ * 	a chain with no accelerometer reading just integrates its gyro.
+ *
+ * Usage:
+ * 	Compile with: gcc -O2 -o fusionTest fusionTest.c Fusion.c -std=gnu99 -Wall -Wextra -lm
+ * 	Run with: ./fusionTest [number of samples]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "Fusion.h"
+
+#define CYCLE_BUDGET .01 //100 Hz
+
+int checkGyroOnly(void);
+
+int main(int argc, char* argv[]) {
+
+	int samples = 1000000;
+	if (argc > 1) {
+		samples = atoi(argv[1]);
+	}
+
+	Fusion fusion;
+	initializeFusion(&fusion, FUSION_DEFAULT_GAIN);
+
+	//still chain tilted 30 degrees about x with a little gyro noise
+	float tilt = 30 * M_PI / 180;
+	float read[IMU_READ_SZ];
+	for (int i = 0; i < FUSION_NODES; i++) {
+		read[i * FUSION_NODE_SZ] = 0;
+		read[i * FUSION_NODE_SZ + 1] = sinf(tilt);
+		read[i * FUSION_NODE_SZ + 2] = cosf(tilt);
+		read[i * FUSION_NODE_SZ + 3] = 0.1f;
+		read[i * FUSION_NODE_SZ + 4] = -0.1f;
+		read[i * FUSION_NODE_SZ + 5] = 0.05f;
+	}
+
+	struct timespec start, end;
+	double time = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < samples; i++) {
+		time += CYCLE_BUDGET;
+		updateFusion(&fusion, read, time);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * .000000001;
+	double perSample = elapsed / samples;
+
+	printf("Nodes: %i\tSamples: %i\n", FUSION_NODES, samples);
+	printf("Per sample: %.1f ns\t(%.4f%% of a %.0f ms cycle)\n",
+			perSample * 1e9, perSample / CYCLE_BUDGET * 100, CYCLE_BUDGET * 1000);
+
+	//roll recovered from the first node's quaternion
+	float w = fusion.read[0], x = fusion.read[1], y = fusion.read[2], z = fusion.read[3];
+	float roll = atan2f(2 * (w * x + y * z), 1 - 2 * (x * x + y * y)) * 180 / M_PI;
+	printf("Node 0 orientation: %f\t%f\t%f\t%f\t(roll %.2f deg, expected %.2f)\n",
+			w, x, y, z, roll, tilt * 180 / M_PI);
+
+	if (fabs(roll - tilt * 180 / M_PI) > 1) {
+		fprintf(stderr, "ERROR: Filter didn't converge.\n");
+		return 1;
+	}
+
+	return checkGyroOnly() == 1 ? 0 : 1;
+}
+
+/*
+ * Zero accelerometer, constant gyro: the filter has to follow plain gyro
+ * integration, q += q * (0, w) / 2 * dt renormalised, with no correction.
+ * Returns 1 if it does, -1 otherwise.
+ */
+int checkGyroOnly(void) {
+
+	Fusion fusion;
+	initializeFusion(&fusion, FUSION_DEFAULT_GAIN);
+
+	float gyro[3] = {20, -35, 50}; //deg/s
+	float read[IMU_READ_SZ];
+	for (int i = 0; i < FUSION_NODES; i++) {
+		for (int j = 0; j < 3; j++) {
+			read[i * FUSION_NODE_SZ + j] = 0;
+			read[i * FUSION_NODE_SZ + 3 + j] = gyro[j];
+		}
+	}
+
+	float gx = gyro[0] * FUSION_GYRO_SCALE, gy = gyro[1] * FUSION_GYRO_SCALE, gz = gyro[2] * FUSION_GYRO_SCALE;
+	float w = 1, x = 0, y = 0, z = 0;
+	double time = 0;
+
+	updateFusion(&fusion, read, time); //first update only starts the clock
+	for (int i = 0; i < 500; i++) {
+		time += CYCLE_BUDGET;
+		updateFusion(&fusion, read, time);
+
+		float dw = 0.5f * (-x * gx - y * gy - z * gz);
+		float dx = 0.5f * (w * gx + y * gz - z * gy);
+		float dy = 0.5f * (w * gy - x * gz + z * gx);
+		float dz = 0.5f * (w * gz + x * gy - y * gx);
+		w += dw * CYCLE_BUDGET;
+		x += dx * CYCLE_BUDGET;
+		y += dy * CYCLE_BUDGET;
+		z += dz * CYCLE_BUDGET;
+		float recip = 1.0f / sqrtf(w * w + x * x + y * y + z * z);
+		w *= recip;
+		x *= recip;
+		y *= recip;
+		z *= recip;
+	}
+
+	float expected[4] = {w, x, y, z};
+	float worst = 0;
+	for (int i = 0; i < FUSION_NODES; i++) {
+		for (int j = 0; j < 4; j++) {
+			float error = fabsf(fusion.read[i * 4 + j] - expected[j]);
+			worst = error > worst ? error : worst;
+		}
+	}
+
+	printf("Gyro only: %f\t%f\t%f\t%f\t(largest difference %g)\n", w, x, y, z, worst);
+
+	if (worst > 1e-5f) {
+		fprintf(stderr, "ERROR: Filter corrected with no accelerometer reading.\n");
+		return -1;
+	}
+
+	return 1;
+}
@@ -0,0 +1,81 @@
+/*
+ * Name: kinematicsTest.c
+ * Author: Elijah Pivo
+ *
+ * Description:
+ * 	Measures how long one forward kinematics update takes against a
+ * 	100 Hz (10ms) cycle and checks the joint positions of a straight arm
+ * 	with a flat, closed hand.
+ *
+ * Usage:
+ * 	Compile with: gcc -O2 -o kinematicsTest kinematicsTest.c Kinematics.c Fusion.c -std=gnu99 -Wall -Wextra -lm
+ * 	Run with: ./kinematicsTest [number of frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "Kinematics.h"
+
+#define CYCLE_BUDGET .01 //100 Hz
+
+int main(int argc, char* argv[]) {
+
+	int frames = 1000000;
+	if (argc > 1) {
+		frames = atoi(argv[1]);
+	}
+
+	Skeleton skeleton;
+	defaultSkeleton(&skeleton);
+
+	Kinematics kinematics;
+	initializeKinematics(&kinematics, &skeleton);
+
+	Fusion fusion;
+	initializeFusion(&fusion, FUSION_DEFAULT_GAIN); //identity, arm straight out along x
+
+	float angles[KIN_GLOVE_SENSORS];
+	for (int i = 0; i < KIN_GLOVE_SENSORS; i++) {
+		angles[i] = 0;
+	}
+
+	updateKinematics(&kinematics, fusion.read, angles, 0);
+
+	//middle finger tip of a straight arm and flat hand
+	const float* tip = &kinematics.read[(KIN_FIRST_FINGER_JOINT + 2 * KIN_FINGER_JOINTS + 3) * 3];
+	float expected[3] = {skeleton.upperArm + skeleton.forearm + skeleton.base[2][0]
+			+ skeleton.bone[2][0] + skeleton.bone[2][1] + skeleton.bone[2][2], skeleton.base[2][1], 0};
+
+	printf("Wrist: %f\t%f\t%f\n", kinematics.read[KIN_WRIST * 3],
+			kinematics.read[KIN_WRIST * 3 + 1], kinematics.read[KIN_WRIST * 3 + 2]);
+	printf("Middle tip: %f\t%f\t%f\t(expected %f\t%f\t%f)\n",
+			tip[0], tip[1], tip[2], expected[0], expected[1], expected[2]);
+
+	for (int i = 0; i < 3; i++) {
+		if (fabsf(tip[i] - expected[i]) > .01f) {
+			fprintf(stderr, "ERROR: Wrong middle finger tip position.\n");
+			return 1;
+		}
+	}
+
+	struct timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < frames; i++) {
+		angles[KIN_INDEX_MCP] = (i % 90) * .01f; //keep the angles changing
+		updateKinematics(&kinematics, fusion.read, angles, i * CYCLE_BUDGET);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * .000000001;
+	double perFrame = elapsed / frames;
+
+	printf("Joints: %i\tFrames: %i\n", KIN_JOINTS, frames);
+	printf("Per frame: %.1f ns\t(%.4f%% of a %.0f ms cycle)\n",
+			perFrame * 1e9, perFrame / CYCLE_BUDGET * 100, CYCLE_BUDGET * 1000);
+
+	return 0;
+}
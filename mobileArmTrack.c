@@ -6,8 +6,22 @@
  * 	Stores data from connected sensors to
  * 	a textfile after a switch is flipped on.
  *
+ * 	A 25ms timer (SIGALRM) ticks the loop. Each sensor is read by its own
+ * 	worker (WorkerPool), a thread started once and pinned, which the loop
+ * 	wakes every tick and waits for until SAVE_US before the next tick. A
+ * 	sensor not done by then misses the cycle: its read is told it was given
+ * 	up on and stops at its next step (the drivers time out on their own
+ * 	within a step), the late read is thrown away and the sensor sits out
+ * 	the ticks it's still busy for.
+ *
+ * 	The EMG is read back to back on its own thread (pinned like a worker),
+ * 	in blocks of the channels, rate and length of ARMTRACK_EMG if it holds
+ * 	an EMG spec (see parseEMGConfig), so no samples fall between ticks.
+ * 	Its line of a record is the block that finished since the last record,
+ * 	in counts, empty if none did.
+ *
  * Usage:
- * 	Compile with: gcc -o mobileArmTrack mobileArmTrack.c IMU.c CyGl.c Force.c EMG.c -lwiringPi -pthread -std=gnu99 -Wall -Wextra
+ * 	Compile with: gcc -o mobileArmTrack mobileArmTrack.c IMU.c CyGl.c Force.c EMG.c EMGCalibration.c Arena.c Serial.c WorkerPool.c ThreadPlan.c -lwiringPi -pthread -std=gnu99 -Wall -Wextra -L. -lmccusb -lm -L/usr/local/lib -lhidapi-libusb -lusb-1.0
  *	Run with: sudo ./mobileArmTrack
  *
  * 	Starts and stops recording data when a switch is flipped.
@@ -45,7 +59,8 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <unistd.h>
-#include <setjmp.h>
+#include <semaphore.h>
+#include <time.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <pthread.h>
@@ -54,6 +69,8 @@
 #include "CyGl.h"
 #include "IMU.h"
 #include "EMG.h"
+#include "ThreadPlan.h"
+#include "WorkerPool.h"
 
 #include "wiringPi.h"
 #include "wiringSerial.h"
@@ -64,19 +81,62 @@
 #define RED_LED 28
 #define SWITCH 27
 
-void getData(struct IMU* IMU, struct CyGl* CyGl, struct Force* Force, struct EMG* EMG);
-void updateReads(struct IMU* IMU, struct CyGl* CyGl, struct Force* Force, struct EMG* EMG);
-void saveData(FILE* outFile, double time, struct IMU IMU, struct CyGl CyGl, struct Force Force, struct EMG EMG);
-void setMode(int signum);
-void startTimer();
-void startSensors(struct IMU* IMU, struct CyGl* CyGl, struct Force* Force, struct EMG* EMG);
-void fatalError();
+#define PERIOD_US 25000 //a tick
+#define SAVE_US 2000 //left at the end of a tick to update and save the reads
 
-pthread_t threads[NUM_SENSORS];
+//worker tasks, task i takes thread role i, the EMG thread takes EMG_ROLE
+#define IMU_TASK 0
+#define CYGL_TASK 1
+#define FORCE_TASK 2
+#define EMG_ROLE 3
+#define LOOP_ROLE 4
+
+/*
+ * The EMG thread, reading blocks back to back while the loop ticks.
+ */
+typedef struct {
+	EMG* EMG;
+	ThreadPlan* ThreadPlan; //NULL to leave it unpinned
+	pthread_t thread;
+	struct timespec start; //release of the first tick, session time 0
+	volatile int stopping; //the EMG's cancelled flag, no new block is started once it's set
+
+	volatile long blocks; //finished, written by the EMG thread
+	long taken; //swapped in by the loop
+	long overwritten; //swapped in and replaced before they were saved
+} EMGReader;
 
-volatile int mode = 0;
+/*
+ * Thread placement: the serial sensors share core 2, the Force adapter
+ * gets core 1 and the EMG thread blocks in libusb on core 3. The loop hands
+ * out the ticks from core 1, above every worker.
+ */
+#define THREAD_POLICY SCHED_FIFO
+#define IMU_CPUS THREAD_PLAN_CPU(2)
+#define CYGL_CPUS THREAD_PLAN_CPU(2)
+#define FORCE_CPUS THREAD_PLAN_CPU(1)
+#define EMG_CPUS THREAD_PLAN_CPU(3)
+#define LOOP_CPUS THREAD_PLAN_CPU(1)
+#define WORKER_PRIORITY 90
+#define LOOP_PRIORITY 95
+
+int readIMU(void* arg, double time, const volatile int* cancelled);
+int readCyGl(void* arg, double time, const volatile int* cancelled);
+int readForce(void* Force, double time, const volatile int* cancelled);
+int startWorkers(WorkerPool* pool, ThreadPlan* ThreadPlan, IMU* IMU, CyGl* CyGl, Force* Force);
+void startEMGReader(EMGReader* reader, EMG* EMG, ThreadPlan* ThreadPlan);
+void* readEMGBlocks(void* arg);
+int takeEMGBlocks(EMGReader* reader);
+void stopEMGReader(EMGReader* reader);
+int updateReads(IMU* IMU, CyGl* CyGl, Force* Force, unsigned sensors, unsigned finished);
+void drainReads(IMU* IMU, CyGl* CyGl, Force* Force, unsigned late);
+void saveData(FILE* outFile, double time, const IMU* IMU, const CyGl* CyGl, const Force* Force, const EMG* EMG, int newEMG);
+void tick(int signum);
+void startTimer();
+void startSensors(IMU* IMU, CyGl* CyGl, Force* Force, EMG* EMG);
+void fatalError();
 
-jmp_buf return_to_loop;
+sem_t ticks; //posted by the timer, once a tick
 
 int main(void) {
 
@@ -94,10 +154,20 @@ int main(void) {
 	pinMode(SWITCH, INPUT);
 	pullUpDnControl(SWITCH, PUD_UP);
 
-	struct IMU IMU;
-	struct CyGl CyGl;
-	struct Force Force;
-	struct EMG EMG;
+	static IMU IMU;
+	static CyGl CyGl;
+	static Force Force;
+	static EMG EMG;
+
+	//the EMG layout is set once, it's read back to back so its blocks can span many ticks
+	EMGConfig EMGSetup;
+	defaultEMGConfig(&EMGSetup);
+	if (getenv("ARMTRACK_EMG") != NULL && parseEMGConfig(&EMGSetup, getenv("ARMTRACK_EMG")) != 1) {
+		exit(1);
+	}
+	if (configureEMG(&EMG, &EMGSetup, NULL) != 1) {
+		exit(1);
+	}
 
 	//repeatedly initialize until switch is flipped on
 	while (digitalRead(SWITCH) == 0) {
@@ -117,71 +187,99 @@ int main(void) {
 
 	FILE *outFile = fopen("/home/pi/Desktop/ArmTrack/ArmTrackData.txt", "w");
 
+	//the workers are started once and live for the whole session
+	static ThreadPlan threadPlan;
+	static WorkerPool pool;
+	int planned = startWorkers(&pool, &threadPlan, &IMU, &CyGl, &Force);
+
 	fprintf(stderr, "Collecting data... \n");
 	//turn on green LED while recording data
 	digitalWrite(GREEN_LED, 1);
 
+	//the first tick comes a period after the timer starts, EMG blocks are timed from it
+	static EMGReader EMGReader;
+	sem_init(&ticks, 0, 0);
+	clock_gettime(CLOCK_MONOTONIC, &EMGReader.start);
+	EMGReader.start.tv_nsec += PERIOD_US * 1000L;
+	if (EMGReader.start.tv_nsec >= 1000000000) {
+		EMGReader.start.tv_sec++;
+		EMGReader.start.tv_nsec -= 1000000000;
+	}
+	if (EMG.id != -1) {
+		startEMGReader(&EMGReader, &EMG, planned ? &threadPlan : NULL);
+	}
 	startTimer();
 
-	double time = -.025;
+	double time = -PERIOD_US * .000001;
 	int errors = 0;
 
-	sigset_t z;
-	sigemptyset(&z);
-	sigaddset(&z, SIGALRM);
-
-	if (setjmp(return_to_loop)!= 0) {
-		sigprocmask(SIG_UNBLOCK, &z, NULL);
-	}
-
 	while(digitalRead(SWITCH) == 1) {
-		/* Modes:
-       mode 0) Waiting to read data
-       mode 1) Collecting data
-       mode 2) ERROR: read wasn't completed
-		 */
-
-		if (mode == 1) {
-
-			time += .025; //update time first so that this is never missed
-
-			//collect data
-			getData(&IMU, &CyGl, &Force, &EMG);
-
-			//block alarm now
-			sigprocmask(SIG_BLOCK, &z, NULL);
 
-			updateReads(&IMU, &CyGl, &Force, &EMG);
-
-			mode = 0;
-
-			//save data to a file
-			saveData(outFile, time, IMU, CyGl, Force, EMG);
+		//wait for the timer, its signal only posts the semaphore
+		if (sem_wait(&ticks) != 0) {
+			continue;
+		}
+		struct timespec start;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		time += PERIOD_US * .000001; //update time first so that this is never missed
 
-			digitalWrite(RED_LED, 0);
-			digitalWrite(GREEN_LED, 1);
+		//ticks that went by while the last cycle was still saving are missed
+		while (sem_trywait(&ticks) == 0) {
+			fprintf(outFile, "*");
+			saveData(outFile, time, &IMU, &CyGl, &Force, &EMG, 0);
+			errors++;
+			time += PERIOD_US * .000001;
+		}
 
-			//unblock alarm signal
-			sigprocmask(SIG_UNBLOCK, &z, NULL);
+		//collect data, every connected sensor at once
+		unsigned sensors = (IMU.id != -1) << IMU_TASK | (CyGl.id != -1) << CYGL_TASK
+				| (Force.id != -1) << FORCE_TASK;
+		unsigned late;
+		unsigned dispatched = dispatchTasks(&pool, sensors, time, &late);
+
+		//reads that finished after their tick was given up on are stale, their
+		//workers weren't dispatched again until they were reported here
+		drainReads(&IMU, &CyGl, &Force, late);
+
+		struct timespec deadline = start;
+		deadline.tv_nsec += (PERIOD_US - SAVE_US) * 1000L;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		int results[NUM_SENSORS];
+		unsigned finished = awaitTasks(&pool, dispatched, &deadline, results);
 
-		} else if (mode == 2) {
+		int EMGResult = EMG.id != -1 ? takeEMGBlocks(&EMGReader) : 0;
+		if (updateReads(&IMU, &CyGl, &Force, sensors, finished) != 1 || EMGResult == -1) {
 			//turn RED led on and GREEN led off while handling error
-
 			digitalWrite(RED_LED, 1);
 			digitalWrite(GREEN_LED, 0);
 
 			//data collection wasn't completed for at least one sensor
 			fprintf(outFile, "*");
-			saveData(outFile, time, IMU, CyGl, Force, EMG);
-
 			errors++;
-			mode = 1;
-
+		} else {
+			digitalWrite(RED_LED, 0);
+			digitalWrite(GREEN_LED, 1);
 		}
+
+		//save data to a file
+		saveData(outFile, time, &IMU, &CyGl, &Force, &EMG, EMGResult == 1);
 	}
 
-	//first block alarm signal
-	sigprocmask(SIG_BLOCK, &z, NULL);
+	//first stop the timer, then the workers and EMG thread once their reads are done
+	struct itimerval off;
+	memset(&off, 0, sizeof(off));
+	setitimer(ITIMER_REAL, &off, NULL);
+	stopWorkerPool(&pool);
+	if (EMG.id != -1) {
+		stopEMGReader(&EMGReader);
+		fprintf(stderr, "EMG: %ld blocks, %ld overwritten before they were saved\n",
+				EMGReader.blocks, EMGReader.overwritten);
+	}
+	printWorkerPool(&pool, stderr);
+	printThreadPlan(&threadPlan, stderr);
 
 	closeIMU(&IMU);
 	closeCyGl(&CyGl);
@@ -189,7 +287,7 @@ int main(void) {
 	closeEMG(&EMG);
 	fclose(outFile);
 
-	double percentMissed = (errors /(time / .025)) * 100;
+	double percentMissed = time > 0 ? (errors /(time / (PERIOD_US * .000001))) * 100 : 0;
 
 	fprintf(stderr, "Elapsed Time (sec): %05.3f\tPercent Missed: %5.3f%%\n",
 			time, percentMissed);
@@ -230,57 +328,152 @@ int main(void) {
 	return 0;
 }
 
-void getData(struct IMU* IMU, struct CyGl* CyGl, struct Force* Force, struct EMG* EMG) {
+/*
+ * Worker tasks, a read each. The IMU and CyGl drivers check cancelled
+ * between the frames of a read, so a read that's given up on stops after
+ * the frame it's on; the Force read is a single step.
+ */
+int readIMU(void* arg, double time, const volatile int* cancelled) {
+
+	IMU* IMU = arg;
 
-	void *status;
+	if (*cancelled) {
+		return -1;
+	}
+	IMU->cancelled = cancelled;
+	return getIMUData(IMU, time);
+}
 
-	//for each of the connected sensors, create a pthread and wait for them to complete
-	//when they do return
+int readCyGl(void* arg, double time, const volatile int* cancelled) {
 
-	if (IMU->id != -1) {
-		//create a pthread for IMU
-		pthread_create(&threads[0], NULL, pGetIMUData, (void *) IMU);
+	CyGl* CyGl = arg;
+
+	if (*cancelled) {
+		return -1;
 	}
+	CyGl->cancelled = cancelled;
+	return getCyGlData(CyGl, time);
+}
 
-	if (CyGl->id != -1) {
-		//create a pthread for CyberGlove
-		pthread_create(&threads[1], NULL, pGetCyGlData, (void *) CyGl);
+int readForce(void* Force, double time, const volatile int* cancelled) {
+	if (*cancelled) {
+		return -1;
 	}
+	return getForceData(Force, time);
+}
 
-	if (Force->id != -1) {
-		//create a pthread for Force sensors
+/*
+ * Plans the worker and EMG threads and starts the workers. If the plan
+ * doesn't fit this Pi they run unpinned. Returns 1 if they're pinned,
+ * 0 otherwise.
+ */
+int startWorkers(WorkerPool* pool, ThreadPlan* ThreadPlan, IMU* IMU, CyGl* CyGl, Force* Force) {
+
+	initializeThreadPlan(ThreadPlan);
+	addThreadRole(ThreadPlan, "IMU", IMU_CPUS, THREAD_POLICY, WORKER_PRIORITY);
+	addThreadRole(ThreadPlan, "CyGl", CYGL_CPUS, THREAD_POLICY, WORKER_PRIORITY);
+	addThreadRole(ThreadPlan, "Force", FORCE_CPUS, THREAD_POLICY, WORKER_PRIORITY);
+	addThreadRole(ThreadPlan, "EMG", EMG_CPUS, THREAD_POLICY, WORKER_PRIORITY); //EMG_ROLE, the EMG thread's
+	addThreadRole(ThreadPlan, "Loop", LOOP_CPUS, THREAD_POLICY, LOOP_PRIORITY);
+
+	int planned = validateThreadPlan(ThreadPlan) == 1;
+	if (!planned) {
+		fprintf(stderr, "Thread plan doesn't fit this Pi, running unpinned.\n");
+	}
 
-		pthread_create(&threads[2], NULL, pGetForceData, (void *) Force);
+	if (initializeWorkerPool(pool, planned ? ThreadPlan : NULL) != 1
+			|| addPoolTask(pool, "IMU", readIMU, IMU, IMU_TASK) != IMU_TASK
+			|| addPoolTask(pool, "CyGl", readCyGl, CyGl, CYGL_TASK) != CYGL_TASK
+			|| addPoolTask(pool, "Force", readForce, Force, FORCE_TASK) != FORCE_TASK
+			|| startWorkerPool(pool) != 1) {
+		fatalError();
 	}
 
-	if (EMG->id != -1) {
-		//create a pthread for EMG
-		pthread_create(&threads[3], NULL, pGetEMGData, (void *) EMG);
+	if (planned && applyThreadRole(ThreadPlan, LOOP_ROLE) != 1) {
+		fprintf(stderr, "Couldn't give the loop its thread role.\n");
 	}
 
-	if (IMU->id != -1) {
-		//wait for IMU to finish
-		pthread_join(threads[0], &status);
+	return planned;
+}
+
+/*
+ * Starts the EMG thread, reading blocks back to back stamped with their
+ * start in session time. reader->start has to be set already.
+ */
+void startEMGReader(EMGReader* reader, EMG* EMG, ThreadPlan* ThreadPlan) {
+
+	reader->EMG = EMG;
+	reader->ThreadPlan = ThreadPlan;
+	reader->stopping = 0;
+	reader->blocks = 0;
+	reader->taken = 0;
+	reader->overwritten = 0;
+	EMG->cancelled = &reader->stopping;
+
+	if (pthread_create(&reader->thread, NULL, readEMGBlocks, reader) != 0) {
+		fprintf(stderr, "Couldn't start the EMG thread.\n");
+		fatalError();
 	}
+}
 
-	if (CyGl->id != -1) {
-		//wait for CyberGlove to finish
-		pthread_join(threads[1], &status);
+void* readEMGBlocks(void* arg) {
+
+	EMGReader* reader = arg;
+
+	if (reader->ThreadPlan != NULL && applyThreadRole(reader->ThreadPlan, EMG_ROLE) != 1) {
+		fprintf(stderr, "Couldn't give the EMG thread its thread role.\n");
 	}
 
-	if (Force->id != -1) {
-		//wait for Force sensors to finish
-		pthread_join(threads[2], &status);
+	while (!reader->stopping) {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		double time = (now.tv_sec - reader->start.tv_sec) + (now.tv_nsec - reader->start.tv_nsec) * .000000001;
+
+		//a failed block is kept too, its errors are counted by the driver
+		getEMGData(reader->EMG, time);
+		__sync_synchronize(); //the block is complete before it's counted
+		reader->blocks++;
 	}
 
-	if (EMG->id != -1) {
-		//wait for EMG to finish
-		pthread_join(threads[3], &status);
+	return NULL;
+}
+
+/*
+ * Swaps in every block that finished since the last call, in order, so
+ * the EMG's buffers stay in step. Returns 1 if there's a new block to
+ * save, 0 if none finished, -1 if swapping one in failed.
+ */
+int takeEMGBlocks(EMGReader* reader) {
+
+	long blocks = reader->blocks;
+	__sync_synchronize(); //the count is read before the buffers it covers
+
+	int result = 0;
+	for (; reader->taken < blocks; reader->taken++) {
+		if (updateEMGRead(reader->EMG) != 1) {
+			result = -1;
+		} else if (result != -1) {
+			reader->overwritten += result;
+			result = 1;
+		}
 	}
 
+	return result;
+}
+
+/*
+ * Cancels the block being read and waits for the EMG thread, then swaps
+ * in what it finished so the buffers are in step for closeEMG.
+ */
+void stopEMGReader(EMGReader* reader) {
+
+	reader->stopping = 1;
+	pthread_join(reader->thread, NULL);
+	takeEMGBlocks(reader);
+	reader->EMG->cancelled = NULL;
 }
 
-void saveData(FILE* outFile, double time, struct IMU IMU, struct CyGl CyGl, struct Force Force, struct EMG EMG) {
+void saveData(FILE* outFile, double time, const IMU* IMU, const CyGl* CyGl, const Force* Force, const EMG* EMG, int newEMG) {
 
 	/* Prints:
 	 *
@@ -297,33 +490,38 @@ void saveData(FILE* outFile, double time, struct IMU IMU, struct CyGl CyGl, stru
 	 * EMG READ
 	 *
 	 * ...
+	 *
+	 * An EMG read is a block of counts, scan after scan, left empty if no
+	 * block finished since the last record.
 	 */
 
 	fprintf(outFile, "%05.3f\n", time);
 
-	if (IMU.id != -1) {
+	if (IMU->id != -1) {
 		for (int i = 0; i < IMU_READ_SZ; i++) {
-			fprintf(outFile, "%03.2f\t", IMU.read[i]);
+			fprintf(outFile, "%03.2f\t", IMU->read[i]);
 		}
 	}
 	fprintf(outFile, "\n");
 
-	if (CyGl.id != -1) {
-		for (int i = 0; i < CYGL_READ_SZ; i++) {
-			fprintf(outFile, "%i\t", CyGl.read[i]);
+	if (CyGl->id != -1) {
+		for (int i = 0; i < WIRED_CYGL_READ_SZ; i++) {
+			fprintf(outFile, "%i\t", CyGl->read[i]);
 		}
 	}
 	fprintf(outFile, "\n");
 
-	if (Force.id != -1) {
+	if (Force->id != -1) {
 		for (int i = 0; i < FORCE_READ_SZ; i++) {
-				fprintf(outFile, "%06.6f\t", Force.read[i]);
+				fprintf(outFile, "%06.6f\t", Force->read[i]);
 			}
 	}
 	fprintf(outFile, "\n");
 
-	if (EMG.id != -1) {
-		//need to implement
+	if (EMG->id != -1 && newEMG) {
+		for (int i = 0; i < EMG->readSize; i++) {
+			fprintf(outFile, "%i\t", EMG->read[i]);
+		}
 	}
 	fprintf(outFile, "\n");
 
@@ -331,29 +529,15 @@ void saveData(FILE* outFile, double time, struct IMU IMU, struct CyGl CyGl, stru
 
 }
 
-void setMode(int signum) {
-
-	/* Modes:
-       mode 0) Waiting to read data
-       mode 1) Collecting data
-       mode 2) ERROR: either read or save wasn't completed
-	 */
-
-	for (int i = 0; i < NUM_SENSORS; i++) {
-		pthread_cancel(threads[i]);
-	}
-
-	if (mode == 0) {
-		mode = 1;
-	} else if (mode == 1) {
-		mode = 2;
-	}
+void tick(int signum) {
 
-	longjmp(return_to_loop, 1);
+	(void) signum;
 
+	//only wakes the loop, everything else happens there
+	sem_post(&ticks);
 }
 
-void startSensors(struct IMU* IMU, struct CyGl* CyGl, struct Force* Force, struct EMG* EMG) {
+void startSensors(IMU* IMU, CyGl* CyGl, Force* Force, EMG* EMG) {
 
 	closeIMU(IMU);
 	closeCyGl(CyGl);
@@ -424,25 +608,63 @@ void startSensors(struct IMU* IMU, struct CyGl* CyGl, struct Force* Force, struc
 }
 
 /*
- * After a successful read, update last read.
+ * After a tick, update last read of the sensors whose reads finished.
+ * A sensor that was still busy or too slow keeps its last read and counts
+ * an error, its buffers are left for drainReads. Returns 1 if every
+ * sensor got a new read, -1 otherwise.
  */
-void updateReads(struct IMU* IMU, struct CyGl* CyGl, struct Force* Force, struct EMG* EMG) {
+int updateReads(IMU* IMU, CyGl* CyGl, Force* Force, unsigned sensors, unsigned finished) {
 
-	if (IMU->id != -1) {
+	int result = 1;
+
+	if (sensors & 1u << IMU_TASK) {
+		if (!(finished & 1u << IMU_TASK)) {
+			IMU->errors++;
+			IMU->consecutiveErrors++;
+			result = -1;
+		} else if (updateIMURead(IMU) != 1) {
+			result = -1;
+		}
+	}
+	if (sensors & 1u << CYGL_TASK) {
+		if (!(finished & 1u << CYGL_TASK)) {
+			CyGl->errors++;
+			CyGl->consecutiveErrors++;
+			result = -1;
+		} else if (updateCyGlRead(CyGl) != 1) {
+			result = -1;
+		}
+	}
+	if (sensors & 1u << FORCE_TASK) {
+		if (!(finished & 1u << FORCE_TASK)) {
+			Force->errors++;
+			Force->consecutiveErrors++;
+			result = -1;
+		} else if (updateForceRead(Force) != 1) {
+			result = -1;
+		}
+	}
+
+	return result;
+}
+
+/*
+ * Takes the reads that finished after their tick was given up on out of
+ * their buffers, so they aren't saved as a later tick's read.
+ */
+void drainReads(IMU* IMU, CyGl* CyGl, Force* Force, unsigned late) {
+
+	if (late & 1u << IMU_TASK) {
 		updateIMURead(IMU);
 	}
-	if (CyGl->id != -1) {
+	if (late & 1u << CYGL_TASK) {
 		updateCyGlRead(CyGl);
 	}
-	if (Force->id != -1) {
+	if (late & 1u << FORCE_TASK) {
 		updateForceRead(Force);
 	}
-	if (EMG->id != -1) {
-		updateEMGRead(EMG);
-	}
 }
 
-
 void startTimer() {
 
 	//necessary timer variables
@@ -451,7 +673,7 @@ void startTimer() {
 
 	//Set Up and Start Timer
 	memset(&sa, 0, sizeof(sa));
-	sa.sa_handler = &setMode;
+	sa.sa_handler = &tick;
 	sa.sa_flags = SA_RESTART;
 	sigaction(SIGALRM, &sa, NULL);
 
@@ -8,7 +8,22 @@
  *
  * Usage:
  * 	Compile with:
- * 		gcc -std=gnu99 -g -Wall -lwiringPi -pthread -Wextra -L. -lmccusb  -lm -L/usr/local/lib -lhidapi-libusb -lusb-1.0 -I. -o mobileArmTrackTest mobileArmTrackTest.c IMU.c CyGl.c Force.c EMG.c
+ * 		gcc -std=gnu99 -g -O2 -mfpu=neon -Wall -lwiringPi -pthread -Wextra -L. -lmccusb  -lm -L/usr/local/lib -lhidapi-libusb -lusb-1.0 -I. -o mobileArmTrackTest mobileArmTrackTest.c IMU.c CyGl.c Force.c EMG.c Fusion.c Kinematics.c CyGlCalibration.c Scheduler.c SampleRing.c ThreadPlan.c Arena.c SessionStore.c OnlineStats.c FlightRecorder.c Myo.c MyoBluetooth.c Serial.c SessionControl.c FastFormat.c EMGFeatures.c EMGCalibration.c
+ *
+ * 	For a timeline of the threads add -DARMTRACK_TRACE Trace.c to the compile
+ * 	line and run with ARMTRACK_TRACE=1 set, the trace is written to
+ * 	ArmTrackTrace.json (open in chrome://tracing or ui.perfetto.dev).
+ *
+ * 	The EMG runs 8 single ended channels at 1kHz in 200ms blocks unless
+ * 	ARMTRACK_EMG holds an EMG spec (see parseEMGConfig), e.g.
+ * 	ARMTRACK_EMG="channels=0,1,2,3 rate=16000" or ARMTRACK_EMG="block=.05".
+ * 	ArmTrackEMGData.txt holds the EMG in counts, ArmTrackEMGCalibration.txt
+ * 	(see EMGCalibration.h) converts them to volts.
+ *
+ * 	With ARMTRACK_CLASSIFIER set to a classifier file (see EMGFeatures.h)
+ * 	each EMG window is classified as it closes and its gesture written to
+ * 	ArmTrackGestures.txt. Windows are 200ms every 50ms unless
+ * 	ARMTRACK_FEATURES holds a feature spec (see parseFeatureConfig).
  *
  * 	Starts and stops recording data when a switch is flipped.
  *
@@ -19,13 +34,14 @@
  * 		been initialized or not. The Green LED will blink if it has been initialized,
  * 	    the Red LED will blink if not. The first flash represents whether or not the
  * 	    IMU chain is initialized, second whether or not the Wireless CyberGlove 2
- * 	    is initialized, third whether or not the Force sensor is initialized, and
- * 	    lastly whether or not the EMG sensor band is initialized.
+ * 	    is initialized, third whether or not the Force sensor is initialized, fourth
+ * 	    whether or not the EMG sensor band is initialized, and lastly whether or
+ * 	    not the Myo armband is connected and streaming.
  * 	 2.	Once all desired sensors are initialized, flip the switch to start
  * 	 	recording data.
  * 	 3.	During successful data recording, the Green LED will remain on and data
  * 	 	will be stored to the file ArmTrackData.txt. A missed read means one
- * 	 	of the sensors didnt return data within the 25ms read cycle so the most
+ * 	 	of the sensors didnt return data within its read period so the most
  * 	 	recent data available was used instead. A missed read on a single sensor
  * 	 	will cause the Red LED to flash and the most recent successful data will
  * 	 	be stored instead with an asterisk preceding the line. A sustained program
@@ -33,7 +49,7 @@
  * 	 	program failure the Red LED will remain on while the Pi will attempt to
  * 	 	reconnect to all the sensors that were being used. If the program cant
  * 	 	reconnect to a sensor it will ignore that sensor and record with the
- * 	 	functional sensors.
+ * 	 	functional sensors, blinking the Red LED once a second.
  * 	 4.	At the end of a recording session flip the switch off.
  * 	 5.	The Green and Red LED will blink once simultaneously followed by a number
  * 	  	of blinks of just the Red LED. After these, the Green and Red LED will flash
@@ -57,6 +73,7 @@
 #include <sys/types.h>
 #include <pthread.h>
 #include <sched.h>
+#include <semaphore.h>
 #include <sys/mman.h>
 
 #include "wiringPi.h"
@@ -65,17 +82,86 @@
 #include "CyGl.h"
 #include "Force.h"
 #include "EMG.h"
+#include "Myo.h"
+#include "Fusion.h"
+#include "Kinematics.h"
+#include "CyGlCalibration.h"
+#include "Scheduler.h"
+#include "SampleRing.h"
+#include "ThreadPlan.h"
+#include "Arena.h"
+#include "SessionStore.h"
+#include "OnlineStats.h"
+#include "FlightRecorder.h"
+#include "Trace.h"
+#include "SessionControl.h"
+#include "FastFormat.h"
+#include "EMGFeatures.h"
 
+/*
+ * Fields written by different threads are kept on separate cache lines
+ * (see CacheLine.h). The sensor structs already split their collection
+ * thread's fields, read buffers and print thread's fields.
+ */
 typedef struct {
 	IMU IMU;
 	CyGl CyGl;
 	Force Force;
 	EMG EMG;
-
-	int readsSinceEMG;
-	double time;
+	Myo Myo;
+
+	//every IMU, CyGl and Force read, pushed by its collection thread and popped by the print thread
+	SampleRing IMUReads;
+	SampleRing CyGlReads;
+	SampleRing ForceReads;
+
+	//written by the print thread
+	float IMURead[IMU_READ_SZ] CACHE_ALIGNED; //newest read of each ring, what the record holds
+	uint8_t CyGlRead[WIRED_CYGL_READ_SZ];
+	float ForceRead[FORCE_READ_SZ];
+	double IMUTime, CyGlTime, ForceTime;
+	long overwrittenReads[6]; //EMG and Myo reads replaced before a record took them, same order as controlValues
+	Fusion IMUFusion; //orientation of each node in the IMU chain
+	CyGlCalibration CyGlCal; //per subject glove lookup tables
+	float gloveAngles[KIN_GLOVE_SENSORS]; //CyberGlove joint angles in radians
+	Kinematics armKinematics; //shoulder, elbow, wrist and finger joint positions
 	int errors;
 	int reads;
+	FILE* EMGFile; //holds just EMG data
+	FILE* MyoFile; //holds every Myo EMG sample with the newest Myo IMU read
+	FILE* outFile; //holds time stamped IMU, CyGl, Force sensor info
+	SessionTable IMURecords; //every raw IMU, CyGl and Force read by column, for the session summary
+	SessionTable CyGlRecords;
+	SessionTable ForceRecords;
+	SessionTable EMGRecords; //EMG samples by channel
+	OnlineStats IMUStats; //running per channel quality statistics, read by the main thread
+	OnlineStats CyGlStats;
+	OnlineStats ForceStats;
+	OnlineStats EMGStats;
+	OnlineStats MyoStats; //Myo EMG channels
+	EMGFeatures EMGFeatures; //sliding window EMG features, only used with a classifier
+	Classifier gestureClassifier;
+	int classifying; //1 if a classifier was loaded
+	FILE* gestureFile; //time, gesture and score of each classified window
+
+	//written by the main (release) thread
+	double time CACHE_ALIGNED;
+	Scheduler schedule; //release timeline for the sensor and print threads
+	ThreadPlan threadPlan; //core, policy and priority of every thread
+	Arena arena; //locked memory for thread stacks and file buffers
+	FlightRecorder flightRecorder; //recent per cycle timing from every thread, frozen on a deadline miss
+	SessionSwitch sessionSwitch; //recording runs while it's on
+	Indicator indicator; //LED status, rendered by its own thread
+	int sensorsLost; //sensors that couldn't be reconnected
+	long overrunRuns[6]; //releases in a row each task was still busy for, same order as controlValues
+	long overrunsSeen[6]; //the schedule's overruns and releases as of the last checkSensors
+	long releasesSeen[6];
+	StatsSnapshot statsSnapshots[5]; //taken by checkStats, printed by the report thread
+	int numStatsSnapshots;
+	volatile int statsPending; //snapshots not printed yet
+	volatile int dumpPending; //the print thread handed the report thread a frozen flight record
+
+	sem_t reportWake; //posted when there's something for the report thread
 
 	/*
 	 * Array Location Significance:
@@ -84,42 +170,191 @@ typedef struct {
 	 * 2: Force Control
 	 * 3: EMG Control
 	 * 4: Print Control
-	 * 5: Special EMG Thread Control (0 -> thread stop, 1 -> thread go)
+	 * 5: Myo Control
+	 * 6: Special EMG Thread Control (0 -> thread stop, 1 -> thread go)
 	 *
 	 * Value Meanings:
 	 * 0: Handling a read or print request.
 	 * 1: Get a read or trigger print.
 	 * 2: Ready to accept a read or print request.
+	 *
+	 * Each is written by both sides of a hand-off, so each gets its own cache line.
 	 */
-	int controlValues[6];
-	FILE* EMGFile; //holds just EMG data
-	FILE* outFile; //holds time stamped IMU, CyGl, Force sensor info
+	ControlSlot controlValues[7];
 } Data;
 
 #define GREEN_LED 28
 #define RED_LED 29
 #define SWITCH 27
 
-void setPriority(int priority);
+#define CYGL_CALIBRATION_FILE "/home/pi/Desktop/ArmTrack/CyGlCalibration.txt"
+
+/*
+ * Scheduler tasks, same order as controlValues.
+ * Period, phase and worst case CPU time per release, in us.
+ */
+#define IMU_TASK 0
+#define IMU_PERIOD 10000   //100 Hz
+#define IMU_PHASE 0
+#define IMU_COST 1000
+#define CYGL_TASK 1
+#define CYGL_PERIOD 11000  //~90 Hz
+#define CYGL_PHASE 2000
+#define CYGL_COST 1000
+#define FORCE_TASK 2
+#define FORCE_PERIOD 4000  //250 Hz
+#define FORCE_PHASE 1000
+#define FORCE_COST 500
+#define EMG_TASK 3         //period is one EMG block, set by the EMG config
+#define EMG_PHASE 3000
+#define EMG_COST 2000
+#define PRINT_TASK 4
+#define PRINT_PERIOD 10000 //one record per IMU read
+#define PRINT_PHASE 8000   //leaves the IMU 8ms to answer
+#define PRINT_COST 3000
+#define MYO_TASK 5
+#define MYO_PERIOD 20000   //50 Hz, one Myo IMU read and ~4 EMG samples
+#define MYO_PHASE 5000
+#define MYO_COST 500
+
+#define TASK_LOW_PRIORITY 80
+#define TASK_HIGH_PRIORITY 94
+#define RELEASE_PRIORITY 95 //main thread hands out releases so it goes above every task
+#define READ_RING_SZ 64 //reads per sensor the print thread can fall behind by, 256ms of Force
+
+/*
+ * Thread placement, roles 0-5 are the scheduler tasks, priorities come from the scheduler.
+ * Core 0 keeps the kernel, the USB and UART interrupts and the print thread,
+ * the serial sensors (Myo dongle included) share core 2 and EMG blocks in libusb on core 3.
+ */
+#define RELEASE_ROLE 6
+#define THREAD_POLICY SCHED_FIFO
+#define IMU_CPUS THREAD_PLAN_CPU(2)
+#define CYGL_CPUS THREAD_PLAN_CPU(2)
+#define FORCE_CPUS THREAD_PLAN_CPU(1)
+#define EMG_CPUS THREAD_PLAN_CPU(3)
+#define PRINT_CPUS THREAD_PLAN_CPU(0)
+#define MYO_CPUS THREAD_PLAN_CPU(2)
+#define RELEASE_CPUS THREAD_PLAN_CPU(1)
+#define STEER_IRQS 1 //0 to leave interrupt affinity to the kernel
+#define IRQ_CPUS THREAD_PLAN_CPU(0)
+#define INDICATOR_CPUS THREAD_PLAN_CPU(0) //normal priority, not in the thread plan
+
+#define ARENA_SZ (10 * 1024 * 1024) //8 thread stacks, 3 file buffers, the flight recorder and the session store with its writers, with room to spare
+//EMG read buffers are added on top, sized by the EMG config
+#define MAIN_STACK_SZ (64 * 1024)
+#define GESTURE_MAX_WINDOWS 32 //windows closed by one EMG block, a 1 s block at the shortest step
+#define TEXT_LINE_SZ 4096 //bytes each text file's lines are built in before going to its stdio buffer
+
+/*
+ * Session store, keeps every raw read by column and summarizes them when
+ * recording stops. Only the most recent chunks stay in memory, the rest are
+ * spilled to the column files. Sensors run at their own rates while the
+ * text file has one record per IMU period, so the text file holds each
+ * sensor's newest read and the store holds all of them, one row per read.
+ */
+#define SESSION_STORE 1 //0 to keep only the text files
+#define STORE_CHUNK_ROWS 1024     //~10 s of IMU reads, ~4 s of Force
+#define STORE_CHUNKS 8
+#define EMG_STORE_CHUNK_ROWS 4096 //~4 s of EMG samples
+#define EMG_STORE_CHUNKS 8
+
+/*
+ * Online statistics, the main thread checks them for saturated, railing
+ * or stuck channels every STATS_CHECK_PERIOD seconds, the report thread
+ * prints the warnings.
+ */
+#define STATS_CHECK_PERIOD 10
+#define STATS_STUCK_TIME 1 //s of identical samples before a channel counts as stuck
+#define CYGL_STUCK_TIME 10 //s, an 8 bit glove sensor on a still hand can hold its value a while
+#define STATS_CLIP_RATE .01 //warn when more than 1% of a channel's samples are clipped
+#define FORCE_CLIP 6.143f   //V, ADC full scale
+#define EMG_CLIP .999f      //of each EMG channel's full scale
+#define MYO_CLIP_LOW -128   //Myo EMG is int8
+#define MYO_CLIP_HIGH 127
+#define MYO_POP_SZ 32 //Myo EMG samples taken off the ring at a time
+#define CYGL_CLIP_LOW 0
+#define CYGL_CLIP_HIGH 255
+
+/*
+ * Flight recorder, ~2000 events a second so the ring covers the last ~8 s.
+ * After a trigger ~1 s more is kept, then the report thread dumps the window.
+ */
+#define FLIGHT_CAPACITY 16384
+#define FLIGHT_POST_EVENTS 2048
+#define FLIGHT_ERROR_THRESHOLD 5 //consecutive errors that trigger a dump
+#define FLIGHT_RECORD_PREFIX "/home/pi/Desktop/ArmTrack/FlightRecord"
+
+/*
+ * Tracing, one buffer per thread. The release thread records ~2000 events
+ * a second so a buffer holds about the first minute of a session.
+ */
+#define TRACE_THREADS (RELEASE_ROLE + 1)
+#define TRACE_EVENTS 131072
+#define TRACE_FILE "/home/pi/Desktop/ArmTrack/ArmTrackTrace.json"
+#ifdef ARMTRACK_TRACE
+#define TRACE_ARENA_SZ (TRACE_THREADS * TRACE_EVENTS * sizeof(TraceEvent))
+#else
+#define TRACE_ARENA_SZ 0
+#endif
+
+void takeRole(int role);
+void planThreads();
+void startThread(int thread, void* (*run)(), const char* error);
 void startSensors();
 void startThreads();
-void getData();
+void releaseTasks();
 void* IMUThread();
 void* CyGlThread();
 void* ForceThread();
 void* EMGThread();
+void* MyoThread();
+void countOverruns();
 void checkSensors();
+void resumeIndicator();
+void checkStats();
+void* reportThread();
 void* printSaveDataThread();
+void startSessionStore();
+void storeEMGBlock(int EMGError);
+int drainReads(int task, SampleRing* ring, SessionTable* table);
+int finishedReads(int task, long consumed[], int* bufferToUse);
+int overran(int task, long overruns[]);
 void endSession();
 
 Data data;
 
+const char* const IMUColumns[IMU_READ_SZ] = {
+		"IMU1", "IMU2", "IMU3", "IMU4", "IMU5", "IMU6", "IMU7", "IMU8",
+		"IMU9", "IMU10", "IMU11", "IMU12"
+};
+const char* const CyGlColumns[WIRED_CYGL_READ_SZ] = {
+		"CyGl1", "CyGl2", "CyGl3", "CyGl4", "CyGl5", "CyGl6", "CyGl7", "CyGl8",
+		"CyGl9", "CyGl10", "CyGl11", "CyGl12", "CyGl13", "CyGl14", "CyGl15", "CyGl16",
+		"CyGl17", "CyGl18", "CyGl19", "CyGl20", "CyGl21", "CyGl22", "CyGl23", "CyGl24"
+};
+const char* const ForceColumns[FORCE_READ_SZ] = {
+		"Force1", "Force2", "Force3", "Force4"
+};
+const char* const EMGChannelNames[EMG_MAX_CHANNELS] = {
+		"EMG1", "EMG2", "EMG3", "EMG4", "EMG5", "EMG6", "EMG7", "EMG8"
+};
+const char* EMGColumns[EMG_MAX_CHANNELS]; //the configured channels, in the order they're read
+
+/*
+ * Flight recorder event sources, tasks then the release thread.
+ */
+const char* const flightSources[RELEASE_ROLE + 1] = {
+		"IMU", "CyGl", "Force", "EMG", "Print", "Myo", "Release"
+};
+
 /*
  * Array location significance is the same as controlValues.
  */
-pthread_t threads[5];
-pthread_mutex_t threadLocks[5];
-pthread_cond_t threadSignals[5];
+pthread_t threads[6];
+pthread_mutex_t threadLocks[6];
+pthread_cond_t threadSignals[6];
+pthread_t reporter; //normal priority, writes out what the real time threads hand it
 
 int main(void) {
 
@@ -132,10 +367,59 @@ int main(void) {
 
 	pinMode(GREEN_LED, OUTPUT);
 	pinMode(RED_LED, OUTPUT);
-	pinMode(SWITCH, INPUT);
-	pullUpDnControl(SWITCH, PUD_UP);
+	if (initializeSessionSwitch(&data.sessionSwitch, SWITCH) != 1) {
+		exit(1);
+	}
 
-	data.readsSinceEMG = 0;
+	EMGConfig EMGSetup;
+	defaultEMGConfig(&EMGSetup);
+	if (getenv("ARMTRACK_EMG") != NULL && parseEMGConfig(&EMGSetup, getenv("ARMTRACK_EMG")) != 1) {
+		exit(1);
+	}
+
+	//gestures are classified only if there's a classifier for this EMG layout
+	FeatureConfig featureSetup;
+	defaultFeatureConfig(&featureSetup);
+	if (getenv("ARMTRACK_FEATURES") != NULL && parseFeatureConfig(&featureSetup, getenv("ARMTRACK_FEATURES")) != 1) {
+		exit(1);
+	}
+	size_t gestureSize = 0;
+	data.classifying = 0;
+	if (getenv("ARMTRACK_CLASSIFIER") != NULL) {
+		if (loadClassifier(&data.gestureClassifier, getenv("ARMTRACK_CLASSIFIER")) != 1) {
+			exit(1);
+		}
+		if (data.gestureClassifier.numFeatures != EMGSetup.channels * FEATURES_PER_CHANNEL) {
+			fprintf(stderr, "ERROR: The classifier takes %i features, %i EMG channels give %i.\n",
+					data.gestureClassifier.numFeatures, EMGSetup.channels, EMGSetup.channels * FEATURES_PER_CHANNEL);
+			exit(1);
+		}
+		data.classifying = 1;
+		gestureSize = EMGFeaturesSize(&featureSetup, EMGSetup.channels, EMGSetup.channels / EMGSetup.scanRate) + ARENA_FILE_BUFFER_SZ;
+	}
+
+	//everything the real time path uses is mapped and locked up front
+	if (initializeArena(&data.arena, ARENA_SZ + TRACE_ARENA_SZ + EMGBufferSize(&EMGSetup) + gestureSize) != 1
+			|| configureEMG(&data.EMG, &EMGSetup, &data.arena) != 1) {
+		exit(1);
+	}
+	printEMGConfig(&data.EMG, stderr);
+
+	//EMG blocks still go through the driver's two read buffers, which only
+	//hold up if a block can't finish twice between two records
+	if (data.EMG.samplesPerRead * data.EMG.sampleTime * 1000000 < 2 * PRINT_PERIOD) {
+		fprintf(stderr, "ERROR: EMG blocks have to be at least two records (%i us) long.\n", 2 * PRINT_PERIOD);
+		exit(1);
+	}
+	if (data.classifying && initializeEMGFeatures(&data.EMGFeatures, &featureSetup, data.EMG.config.channels,
+			data.EMG.sampleTime, &data.arena) != 1) {
+		exit(1);
+	}
+	lockRegion(&data, sizeof(data));
+	prefaultStack(MAIN_STACK_SZ);
+
+	//falls back to a nominal calibration if the subject hasn't run calibrateCyGl
+	loadCyGlCalibration(&data.CyGlCal, CYGL_CALIBRATION_FILE);
 
 	fprintf(stderr, "Connecting to sensors.\n");
 
@@ -153,50 +437,132 @@ int main(void) {
 		startSensors();
 
 		sleep(2); //wait two seconds between start cycles
-	} while (digitalRead(SWITCH) == 0);
+	} while (readSessionSwitch(&data.sessionSwitch) == 0);
+
+	if (initializeFlightRecorder(&data.flightRecorder, &data.arena, FLIGHT_CAPACITY, FLIGHT_POST_EVENTS) != 1) {
+		exit(1);
+	}
+
+#ifdef ARMTRACK_TRACE
+	//compiled in, but only recorded when asked for
+	if (getenv("ARMTRACK_TRACE") != NULL && initializeTrace(&data.arena, TRACE_THREADS, TRACE_EVENTS) == 1) {
+		setTraceEnabled(1);
+		fprintf(stderr, "Tracing to %s.\n", TRACE_FILE);
+	}
+#endif
+
+	//opened before the print thread starts, it sets its text buffers up on them
+	data.outFile = arenaOpenFile(&data.arena, "/home/pi/Desktop/ArmTrack/ArmTrackData.txt", "w", ARENA_FILE_BUFFER_SZ);
+	data.EMGFile = arenaOpenFile(&data.arena, "/home/pi/Desktop/ArmTrack/ArmTrackEMGData.txt", "w", ARENA_FILE_BUFFER_SZ);
+	saveEMGCalibration(&data.EMG.calibration, "/home/pi/Desktop/ArmTrack/ArmTrackEMGCalibration.txt");
+	data.MyoFile = arenaOpenFile(&data.arena, "/home/pi/Desktop/ArmTrack/ArmTrackMyoData.txt", "w", ARENA_FILE_BUFFER_SZ);
+	if (data.classifying) {
+		data.gestureFile = arenaOpenFile(&data.arena, "/home/pi/Desktop/ArmTrack/ArmTrackGestures.txt", "w", ARENA_FILE_BUFFER_SZ);
+	}
 
 	//start data collection and print threads, initialize necessary mutex's
 	startThreads();
 
 	fprintf(stderr, "Collecting data.\n");
 
-	data.outFile = fopen("/home/pi/Desktop/ArmTrack/ArmTrackData.txt", "w");
-	data.EMGFile = fopen("/home/pi/Desktop/ArmTrack/ArmTrackEMGData.txt", "w");
 	data.errors = 0;
 	data.reads = 0;
 
-	struct timeval last;
-	struct timeval curr;
-	struct timeval temp;
+	if (SESSION_STORE) {
+		startSessionStore();
+	} else {
+		fprintf(stderr, "Session store off, only each sensor's newest read per record is saved.\n");
+	}
 
-	setPriority(90);
+	initializeOnlineStats(&data.IMUStats, "IMU", IMU_READ_SZ, -INFINITY, INFINITY);
+	initializeOnlineStats(&data.CyGlStats, "CyGl", CYGL_SENSORS, CYGL_CLIP_LOW, CYGL_CLIP_HIGH);
+	initializeOnlineStats(&data.ForceStats, "Force", FORCE_READ_SZ, -FORCE_CLIP, FORCE_CLIP);
+	//EMG stats run on counts, so the clip limits are converted to counts once here
+	initializeOnlineStats(&data.EMGStats, "EMG", data.EMG.config.channels, -INFINITY, INFINITY);
+	for (int i = 0; i < data.EMG.config.channels; i++) {
+		float low = voltsToCount(&data.EMG.calibration, i, -EMG_CLIP * EMGFullScale(&data.EMG, i));
+		float high = voltsToCount(&data.EMG.calibration, i, EMG_CLIP * EMGFullScale(&data.EMG, i));
+		data.EMGStats.clipLow[i] = low < high ? low : high;
+		data.EMGStats.clipHigh[i] = low < high ? high : low;
+	}
+	initializeOnlineStats(&data.MyoStats, "Myo", MYO_EMG_SZ, MYO_CLIP_LOW, MYO_CLIP_HIGH);
+
+	//stuck is a time, so each sensor's run is its own number of samples
+	data.IMUStats.stuckRun = STATS_STUCK_TIME * 1000000L / IMU_PERIOD;
+	data.CyGlStats.stuckRun = CYGL_STUCK_TIME * 1000000L / CYGL_PERIOD;
+	data.ForceStats.stuckRun = STATS_STUCK_TIME * 1000000L / FORCE_PERIOD;
+	data.EMGStats.stuckRun = lround(STATS_STUCK_TIME / data.EMG.sampleTime);
+	data.MyoStats.stuckRun = lround(STATS_STUCK_TIME / MYO_SAMPLE_TIME);
+
+	initializeFusion(&data.IMUFusion, FUSION_DEFAULT_GAIN);
+
+	Skeleton skeleton;
+	defaultSkeleton(&skeleton);
+	initializeKinematics(&data.armKinematics, &skeleton);
+	for (int i = 0; i < KIN_GLOVE_SENSORS; i++) {
+		data.gloveAngles[i] = 0;
+	}
 
-	gettimeofday(&curr, NULL); //update current time
+	struct timespec start;
+	struct timespec curr;
+	struct timespec due;
 
-	while(digitalRead(SWITCH) == 1) {
+	//LEDs are left to the indicator thread, started before this thread turns real time so it stays normal priority
+	pthread_attr_t indicatorAttributes;
+	if (arenaThreadAttributes(&data.arena, &indicatorAttributes, ARENA_STACK_SZ) != 1
+			|| startIndicator(&data.indicator, GREEN_LED, RED_LED, INDICATOR_CPUS, &indicatorAttributes) != 1) {
+		exit(1);
+	}
+	data.sensorsLost = 0;
+	setIndicatorStatus(&data.indicator, INDICATOR_RECORDING);
+
+	//same for the report thread, which writes out flight records and warnings, explicitly SCHED_OTHER
+	pthread_attr_t reportAttributes;
+	struct sched_param reportParam = {0};
+	data.statsPending = 0;
+	data.dumpPending = 0;
+	if (sem_init(&data.reportWake, 0, 0) != 0
+			|| arenaThreadAttributes(&data.arena, &reportAttributes, ARENA_STACK_SZ) != 1
+			|| pthread_attr_setinheritsched(&reportAttributes, PTHREAD_EXPLICIT_SCHED) != 0
+			|| pthread_attr_setschedpolicy(&reportAttributes, SCHED_OTHER) != 0
+			|| pthread_attr_setschedparam(&reportAttributes, &reportParam) != 0
+			|| pthread_create(&reporter, &reportAttributes, reportThread, NULL) != 0) {
+		fprintf(stderr, "ERROR: Couldn't start report thread.\n");
+		exit(1);
+	}
+	pthread_attr_destroy(&reportAttributes);
 
-		last.tv_sec = curr.tv_sec; last.tv_usec = curr.tv_usec; //update last time
-		gettimeofday(&curr, NULL); //update current time
-		data.time += (curr.tv_sec - last.tv_sec) + (curr.tv_usec - last.tv_usec) * .000001; //increment by difference between last and current time
+	takeRole(RELEASE_ROLE);
 
-		digitalWrite(GREEN_LED, 1); //turn on green LED while recording data
-		digitalWrite(RED_LED, 0);
+	markArenaStart(&data.arena); //page faults from here on show up in the session report
+	clock_gettime(CLOCK_MONOTONIC, &start);
 
-		getData();
+	while(readSessionSwitch(&data.sessionSwitch) == 1) {
 
-		//signal print thread
-		while (data.controlValues[4] != 2) {};
-		pthread_mutex_lock(&threadLocks[4]);
-		data.controlValues[4] = 1;
-		pthread_cond_signal(&threadSignals[4]);
-		pthread_mutex_unlock(&threadLocks[4]);
+		//sleep until the next release point, flipping the switch wakes it early
+		long long release = start.tv_nsec + nextSchedulerRelease(&data.schedule) * 1000LL;
+		due.tv_sec = start.tv_sec + release / 1000000000;
+		due.tv_nsec = release % 1000000000;
+		int woke;
+		while ((woke = waitForRelease(&data.sessionSwitch, &due)) == 0
+				&& readSessionSwitch(&data.sessionSwitch) == 1) {}
+		if (woke == 0) {
+			break; //switched off
+		}
+		if (woke == -1) {
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) != 0) {}
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &curr);
+		data.time = (curr.tv_sec - start.tv_sec) + (curr.tv_nsec - start.tv_nsec) * .000000001;
+		recordFlightEvent(&data.flightRecorder, FLIGHT_WAKEUP, RELEASE_ROLE,
+				(curr.tv_sec - due.tv_sec) * 1000000000 + (curr.tv_nsec - due.tv_nsec));
+
+		releaseTasks();
 
 		checkSensors();
 
-		//wait for 25ms cycle length
-		do {
-			gettimeofday(&temp, NULL);
-		} while ( (temp.tv_sec - curr.tv_sec) + (temp.tv_usec - curr.tv_usec) * .000001 < .024998);
+		checkStats();
 
 		//for testing and not locking up pi
 		if (data.time > 420) {
@@ -210,22 +576,36 @@ int main(void) {
 	return 1;
 }
 
-void setPriority(int priority) {
-	//should be careful with this!
-	//make data collection thread a time critical thread
-	struct sched_param param;
-	param.sched_priority = priority;
-	if (sched_setscheduler(0, SCHED_RR, &param) != 0) {
-		fprintf(stderr, "ERROR: Data Collection Thread Priority not set.\n");
-		fprintf(stderr, "*Remember to run as root.*\n");
+void takeRole(int role) {
+	//make this a time critical thread on its planned cores
+	if (applyThreadRole(&data.threadPlan, role) != 1) {
 		exit(1);
 	}
+	TRACE_THREAD(data.threadPlan.roles[role].name);
+}
 
-	//lock process in memory
-	if (mlockall(MCL_FUTURE) != 0) {
-		fprintf(stderr, "ERROR: Couldn't lock process in memory.\n");
+void planThreads() {
+
+	initializeThreadPlan(&data.threadPlan);
+	addThreadRole(&data.threadPlan, "IMU", IMU_CPUS, THREAD_POLICY, data.schedule.tasks[IMU_TASK].priority);
+	addThreadRole(&data.threadPlan, "CyGl", CYGL_CPUS, THREAD_POLICY, data.schedule.tasks[CYGL_TASK].priority);
+	addThreadRole(&data.threadPlan, "Force", FORCE_CPUS, THREAD_POLICY, data.schedule.tasks[FORCE_TASK].priority);
+	addThreadRole(&data.threadPlan, "EMG", EMG_CPUS, THREAD_POLICY, data.schedule.tasks[EMG_TASK].priority);
+	addThreadRole(&data.threadPlan, "Print", PRINT_CPUS, THREAD_POLICY, data.schedule.tasks[PRINT_TASK].priority);
+	addThreadRole(&data.threadPlan, "Myo", MYO_CPUS, THREAD_POLICY, data.schedule.tasks[MYO_TASK].priority);
+	addThreadRole(&data.threadPlan, "Release", RELEASE_CPUS, THREAD_POLICY, RELEASE_PRIORITY);
+
+	if (STEER_IRQS) {
+		addIRQSteering(&data.threadPlan, "dwc_otg", IRQ_CPUS); //USB (IMU, CyGl, Force adapters, EMG and Myo dongle)
+		addIRQSteering(&data.threadPlan, "xhci", IRQ_CPUS);
+		addIRQSteering(&data.threadPlan, "uart-pl011", IRQ_CPUS);
+	}
+
+	if (validateThreadPlan(&data.threadPlan) != 1) {
+		fprintf(stderr, "ERROR: Thread plan doesn't fit this Pi.\n");
 		exit(1);
 	}
+	steerIRQs(&data.threadPlan);
 }
 
 void startSensors() {
@@ -233,6 +613,7 @@ void startSensors() {
 	closeIMU(&data.IMU);
 	closeCyGl(&data.CyGl);
 	closeForce(&data.Force);
+	closeMyo(&data.Myo);
 
 	if (initializeIMU(&data.IMU) != -1) {
 		fprintf(stderr, "IMU initialized.\n");
@@ -297,127 +678,195 @@ void startSensors() {
 		digitalWrite(RED_LED, 0);
 		usleep(500000); //.5 sec
 	}
+
+	if (initializeMyo(&data.Myo) != -1) {
+		fprintf(stderr, "Myo initialized.\n");
+		//blink GREEN led if Myo did connect
+		digitalWrite(GREEN_LED, 1);
+		usleep(500000); //.5 sec
+		digitalWrite(GREEN_LED, 0);
+		usleep(500000); //.5 sec
+	} else {
+		fprintf(stderr, "Couldn't initialize Myo.\n");
+		//blink RED led if Myo didn't connect
+		digitalWrite(RED_LED, 1);
+		usleep(500000); //.5 sec
+		digitalWrite(RED_LED, 0);
+		usleep(500000); //.5 sec
+	}
 }
 
 void startThreads() {
 
-	for (int i = 0; i < 5; i++) {
-		data.controlValues[i] = 0;
+	for (int i = 0; i < 6; i++) {
+		data.controlValues[i].value = 0;
+		data.overwrittenReads[i] = 0;
+	}
+
+	//sensors read faster than they're recorded hand every read over in a ring
+	if (initializeSampleRing(&data.IMUReads, &data.arena, "IMU", IMU_READ_SZ, READ_RING_SZ) != 1
+			|| initializeSampleRing(&data.CyGlReads, &data.arena, "CyGl", WIRED_CYGL_READ_SZ, READ_RING_SZ) != 1
+			|| initializeSampleRing(&data.ForceReads, &data.arena, "Force", FORCE_READ_SZ, READ_RING_SZ) != 1) {
+		exit(1);
+	}
+
+	long EMGPeriod = lround(data.EMG.samplesPerRead * data.EMG.sampleTime * 1000000);
+
+	//each sensor runs at its own rate, refuse to record if the rates can't all be met on their cores
+	initializeScheduler(&data.schedule);
+	addSchedulerTask(&data.schedule, "IMU", IMU_PERIOD, IMU_PHASE, IMU_COST, IMU_CPUS);
+	addSchedulerTask(&data.schedule, "CyGl", CYGL_PERIOD, CYGL_PHASE, CYGL_COST, CYGL_CPUS);
+	addSchedulerTask(&data.schedule, "Force", FORCE_PERIOD, FORCE_PHASE, FORCE_COST, FORCE_CPUS);
+	addSchedulerTask(&data.schedule, "EMG", EMGPeriod, EMG_PHASE, EMG_COST, EMG_CPUS);
+	addSchedulerTask(&data.schedule, "Print", PRINT_PERIOD, PRINT_PHASE, PRINT_COST, PRINT_CPUS);
+	addSchedulerTask(&data.schedule, "Myo", MYO_PERIOD, MYO_PHASE, MYO_COST, MYO_CPUS);
+	if (configureScheduler(&data.schedule, TASK_LOW_PRIORITY, TASK_HIGH_PRIORITY) != 1) {
+		fprintf(stderr, "ERROR: Sensor rates overload the Pi.\n");
+		exit(1);
 	}
+	printSchedule(&data.schedule, stderr);
+
+	planThreads();
 
 	if (data.IMU.id != -1) {
 
 		pthread_mutex_init(&threadLocks[0], NULL);
 		pthread_cond_init(&threadSignals[0], NULL);
 
-		if (pthread_create(&threads[0], NULL, IMUThread, NULL) != 0) {
-			fprintf(stderr, "ERROR: Couldn't start IMU data collection thread.\n");
-			exit(1);
-		}
+		startThread(0, IMUThread, "ERROR: Couldn't start IMU data collection thread.");
 	}
 	if (data.CyGl.id != -1) {
 
 		pthread_mutex_init(&threadLocks[1], NULL);
 		pthread_cond_init(&threadSignals[1], NULL);
 
-		if (pthread_create(&threads[1], NULL, CyGlThread, NULL) != 0) {
-			fprintf(stderr, "ERROR: Couldn't start CyGl data collection thread.\n");
-			exit(1);
-		}
+		startThread(1, CyGlThread, "ERROR: Couldn't start CyGl data collection thread.");
 	}
 	if (data.Force.id != -1) {
 
 		pthread_mutex_init(&threadLocks[2], NULL);
 		pthread_cond_init(&threadSignals[2], NULL);
 
-		if (pthread_create(&threads[2], NULL, ForceThread, NULL) != 0) {
-			fprintf(stderr, "ERROR: Couldn't start Force data collection thread.\n");
-			exit(1);
-		}
+		startThread(2, ForceThread, "ERROR: Couldn't start Force data collection thread.");
 	}
 
-	data.controlValues[5] = 0; //stop EMG
+	data.controlValues[6].value = 0; //stop EMG
 
 	if (data.EMG.id != -1) {
 
 		pthread_mutex_init(&threadLocks[3], NULL);
 		pthread_cond_init(&threadSignals[3], NULL);
 
-		if (pthread_create(&threads[3], NULL, EMGThread, NULL) != 0) {
-			fprintf(stderr, "ERROR: Couldn't start EMG data collection thread.\n");
-			exit(1);
-		}
+		startThread(3, EMGThread, "ERROR: Couldn't start EMG data collection thread.");
+	}
+	if (data.Myo.id != -1) {
+
+		pthread_mutex_init(&threadLocks[5], NULL);
+		pthread_cond_init(&threadSignals[5], NULL);
+
+		startThread(5, MyoThread, "ERROR: Couldn't start Myo data collection thread.");
 	}
 
 	pthread_mutex_init(&threadLocks[4], NULL);
 	pthread_cond_init(&threadSignals[4], NULL);
-	if (pthread_create(&threads[4], NULL, printSaveDataThread, NULL) != 0) {
-		fprintf(stderr, "ERROR: Couldn't create print and save thread.\n");
-		exit(1);
-	}
+	startThread(4, printSaveDataThread, "ERROR: Couldn't create print and save thread.");
 
 	//ensure threads are ready
 	usleep(30000);
 
-	data.controlValues[5] = 1; //start EMG
+	data.controlValues[6].value = 1; //start EMG
 }
 
-void getData() {
+void startThread(int thread, void* (*run)(), const char* error) {
 
-	if (data.IMU.id != -1) {
+	//stack comes from the locked arena so the thread never faults one in
+	pthread_attr_t attributes;
+	if (arenaThreadAttributes(&data.arena, &attributes, ARENA_STACK_SZ) != 1
+			|| pthread_create(&threads[thread], &attributes, run, NULL) != 0) {
+		fprintf(stderr, "%s\n", error);
+		exit(1);
+	}
+	pthread_attr_destroy(&attributes);
+}
+
+void releaseTasks() {
+
+	TRACE_SCOPE("releaseTasks");
+
+	if (data.IMU.id != -1 && isTaskReleased(&data.schedule, IMU_TASK, data.controlValues[0].value == 2)) {
 		pthread_mutex_lock(&threadLocks[0]);
-		data.controlValues[0] = 1;
+		markThreadRelease(&data.threadPlan, IMU_TASK);
+		recordFlightEvent(&data.flightRecorder, FLIGHT_RELEASE, IMU_TASK, 0);
+		data.controlValues[0].value = 1;
 		pthread_cond_signal(&threadSignals[0]);
 		pthread_mutex_unlock(&threadLocks[0]);
 	}
 
-	if (data.CyGl.id != -1) {
+	if (data.CyGl.id != -1 && isTaskReleased(&data.schedule, CYGL_TASK, data.controlValues[1].value == 2)) {
 		pthread_mutex_lock(&threadLocks[1]);
-		data.controlValues[1] = 1;
+		markThreadRelease(&data.threadPlan, CYGL_TASK);
+		recordFlightEvent(&data.flightRecorder, FLIGHT_RELEASE, CYGL_TASK, 0);
+		data.controlValues[1].value = 1;
 		pthread_cond_signal(&threadSignals[1]);
 		pthread_mutex_unlock(&threadLocks[1]);
 	}
 
-	if (data.Force.id != -1) {
+	if (data.Force.id != -1 && isTaskReleased(&data.schedule, FORCE_TASK, data.controlValues[2].value == 2)) {
 		pthread_mutex_lock(&threadLocks[2]);
-		data.controlValues[2] = 1;
+		markThreadRelease(&data.threadPlan, FORCE_TASK);
+		recordFlightEvent(&data.flightRecorder, FLIGHT_RELEASE, FORCE_TASK, 0);
+		data.controlValues[2].value = 1;
 		pthread_cond_signal(&threadSignals[2]);
 		pthread_mutex_unlock(&threadLocks[2]);
 	}
 
-	//wait for data collection to be ready for another cycle
-	if (data.IMU.id != -1) {
-		while (data.controlValues[0] != 2) {}
+	//EMG is held while another sensor is reconnecting
+	if (data.EMG.id != -1 && data.controlValues[6].value == 1
+			&& isTaskReleased(&data.schedule, EMG_TASK, data.controlValues[3].value == 2)) {
+		pthread_mutex_lock(&threadLocks[3]);
+		markThreadRelease(&data.threadPlan, EMG_TASK);
+		recordFlightEvent(&data.flightRecorder, FLIGHT_RELEASE, EMG_TASK, 0);
+		data.controlValues[3].value = 1;
+		pthread_cond_signal(&threadSignals[3]);
+		pthread_mutex_unlock(&threadLocks[3]);
 	}
 
-	if (data.CyGl.id != -1) {
-		while (data.controlValues[1] != 2) {}
+	if (data.Myo.id != -1 && isTaskReleased(&data.schedule, MYO_TASK, data.controlValues[5].value == 2)) {
+		pthread_mutex_lock(&threadLocks[5]);
+		markThreadRelease(&data.threadPlan, MYO_TASK);
+		recordFlightEvent(&data.flightRecorder, FLIGHT_RELEASE, MYO_TASK, 0);
+		data.controlValues[5].value = 1;
+		pthread_cond_signal(&threadSignals[5]);
+		pthread_mutex_unlock(&threadLocks[5]);
 	}
 
-	if (data.Force.id != -1) {
-		while (data.controlValues[2] != 2) {}
-	}
-
-	data.readsSinceEMG++;
-	if (data.EMG.id != -1 && data.readsSinceEMG == 8) {
-		//once every 8 reads, it will wait for new EMG data
-		while (data.controlValues[3] != 2) {}
-		data.readsSinceEMG = 0;
+	if (isTaskReleased(&data.schedule, PRINT_TASK, data.controlValues[4].value == 2)) {
+		pthread_mutex_lock(&threadLocks[4]);
+		markThreadRelease(&data.threadPlan, PRINT_TASK);
+		recordFlightEvent(&data.flightRecorder, FLIGHT_RELEASE, PRINT_TASK, 0);
+		data.controlValues[4].value = 1;
+		pthread_cond_signal(&threadSignals[4]);
+		pthread_mutex_unlock(&threadLocks[4]);
 	}
-
 }
 
 void* IMUThread() {
 
 	//make data collection thread a time critical thread
-	setPriority(95);
+	takeRole(IMU_TASK);
 
 	while (1 == 1) {
 		pthread_mutex_lock(&threadLocks[0]);
-		data.controlValues[0] = 2; //signals ready to accept a collection request
+		data.controlValues[0].value = 2; //signals ready to accept a collection request
 		pthread_cond_wait(&threadSignals[0], &threadLocks[0]);
-		data.controlValues[0] = 0;
-		getIMUData(&data.IMU, data.time);
+		recordThreadWakeup(&data.threadPlan, IMU_TASK);
+		data.controlValues[0].value = 0;
+		recordFlightEvent(&data.flightRecorder, FLIGHT_REQUEST, IMU_TASK, 0);
+		recordFlightEvent(&data.flightRecorder, FLIGHT_RESPONSE, IMU_TASK, getIMUData(&data.IMU, data.time));
+		//this thread is the only one using the read buffers, every read goes on to the print thread
+		int result = updateIMURead(&data.IMU);
+		pushSample(&data.IMUReads, data.IMU.readTime, result, data.IMU.read);
+		completeSchedulerTask(&data.schedule, IMU_TASK);
 		pthread_mutex_unlock(&threadLocks[0]);
 	}
 }
@@ -425,14 +874,25 @@ void* IMUThread() {
 void* CyGlThread() {
 
 	//make data collection thread a time critical thread
-	setPriority(95);
+	takeRole(CYGL_TASK);
+
+	float gloveRead[WIRED_CYGL_READ_SZ];
 
 	while (1 == 1) {
 		pthread_mutex_lock(&threadLocks[1]);
-		data.controlValues[1] = 2; //signals ready to accept a collection request
+		data.controlValues[1].value = 2; //signals ready to accept a collection request
 		pthread_cond_wait(&threadSignals[1], &threadLocks[1]);
-		data.controlValues[1] = 0;
-		getCyGlData(&data.CyGl, data.time);
+		recordThreadWakeup(&data.threadPlan, CYGL_TASK);
+		data.controlValues[1].value = 0;
+		recordFlightEvent(&data.flightRecorder, FLIGHT_REQUEST, CYGL_TASK, 0);
+		recordFlightEvent(&data.flightRecorder, FLIGHT_RESPONSE, CYGL_TASK, getCyGlData(&data.CyGl, data.time));
+		//this thread is the only one using the read buffers, every read goes on to the print thread
+		int result = updateCyGlRead(&data.CyGl);
+		for (int i = 0; i < WIRED_CYGL_READ_SZ; i++) {
+			gloveRead[i] = data.CyGl.read[i];
+		}
+		pushSample(&data.CyGlReads, data.CyGl.readTime, result, gloveRead);
+		completeSchedulerTask(&data.schedule, CYGL_TASK);
 		pthread_mutex_unlock(&threadLocks[1]);
 	}
 }
@@ -440,14 +900,20 @@ void* CyGlThread() {
 void* ForceThread() {
 
 	//make data collection thread a time critical thread
-	setPriority(95);
+	takeRole(FORCE_TASK);
 
 	while (1 == 1) {
 		pthread_mutex_lock(&threadLocks[2]);
-		data.controlValues[2] = 2; //signals ready to accept a collection request
+		data.controlValues[2].value = 2; //signals ready to accept a collection request
 		pthread_cond_wait(&threadSignals[2], &threadLocks[2]);
-		data.controlValues[2] = 0;
-		getForceData(&data.Force, data.time);
+		recordThreadWakeup(&data.threadPlan, FORCE_TASK);
+		data.controlValues[2].value = 0;
+		recordFlightEvent(&data.flightRecorder, FLIGHT_REQUEST, FORCE_TASK, 0);
+		recordFlightEvent(&data.flightRecorder, FLIGHT_RESPONSE, FORCE_TASK, getForceData(&data.Force, data.time));
+		//this thread is the only one using the read buffers, every read goes on to the print thread
+		int result = updateForceRead(&data.Force);
+		pushSample(&data.ForceReads, data.Force.readTime, result, data.Force.read);
+		completeSchedulerTask(&data.schedule, FORCE_TASK);
 		pthread_mutex_unlock(&threadLocks[2]);
 	}
 }
@@ -455,30 +921,71 @@ void* ForceThread() {
 void* EMGThread() {
 
 	//make data collection thread a time critical thread
-	setPriority(95);
+	takeRole(EMG_TASK);
+
+	while (1 == 1) {
+		pthread_mutex_lock(&threadLocks[3]);
+		data.controlValues[3].value = 2; //signals ready to accept a collection request
+		pthread_cond_wait(&threadSignals[3], &threadLocks[3]);
+		recordThreadWakeup(&data.threadPlan, EMG_TASK);
+		data.controlValues[3].value = 0;
+		recordFlightEvent(&data.flightRecorder, FLIGHT_REQUEST, EMG_TASK, 0);
+		recordFlightEvent(&data.flightRecorder, FLIGHT_RESPONSE, EMG_TASK, getEMGData(&data.EMG, data.time));
+		completeSchedulerTask(&data.schedule, EMG_TASK);
+		pthread_mutex_unlock(&threadLocks[3]);
+	}
+}
+
+void* MyoThread() {
+
+	//make data collection thread a time critical thread
+	takeRole(MYO_TASK);
 
 	while (1 == 1) {
+		pthread_mutex_lock(&threadLocks[5]);
+		data.controlValues[5].value = 2; //signals ready to accept a collection request
+		pthread_cond_wait(&threadSignals[5], &threadLocks[5]);
+		recordThreadWakeup(&data.threadPlan, MYO_TASK);
+		data.controlValues[5].value = 0;
+		recordFlightEvent(&data.flightRecorder, FLIGHT_REQUEST, MYO_TASK, 0);
+		recordFlightEvent(&data.flightRecorder, FLIGHT_RESPONSE, MYO_TASK, getMyoData(&data.Myo, data.time));
+		completeSchedulerTask(&data.schedule, MYO_TASK);
+		pthread_mutex_unlock(&threadLocks[5]);
+	}
+}
 
-		if (data.controlValues == 1) {
-			//collect data
-			getEMGData(&data.EMG, data.time);
-			data.controlValues[3] = 2;
+/*
+ * Counts each task's releases in a row that it was still busy for. The
+ * release thread is the only one that counts overruns (isTaskReleased),
+ * so it keeps the runs too rather than adding them to the drivers' error
+ * counts, which the sensor threads write.
+ */
+void countOverruns() {
+
+	for (int i = 0; i < 6; i++) {
+		const SchedulerTask* task = &data.schedule.tasks[i];
+		if (task->overruns != data.overrunsSeen[i]) {
+			data.overrunRuns[i] += task->overruns - data.overrunsSeen[i];
+		} else if (task->releases != data.releasesSeen[i]) {
+			data.overrunRuns[i] = 0;
 		}
-
+		data.overrunsSeen[i] = task->overruns;
+		data.releasesSeen[i] = task->releases;
 	}
 }
 
 void checkSensors() {
 
-	if (data.IMU.id != -1 && data.IMU.consecutiveErrors > 20) {
+	countOverruns();
+
+	if (data.IMU.id != -1 && (data.IMU.consecutiveErrors > 20 || data.overrunRuns[IMU_TASK] > 20)) {
 		//.5 sec of missed data
 		//big error happening, try to reconnect to the IMU
 
-		data.controlValues[5] = 0; //stop EMG
+		data.controlValues[6].value = 0; //stop EMG
 
 		//turn on red LED
-		digitalWrite(GREEN_LED, 0);
-		digitalWrite(RED_LED, 1);
+		setIndicatorStatus(&data.indicator, INDICATOR_RECONNECTING);
 		fprintf(stderr, "ERROR: Too many consecutive missed reads.\n");
 		fprintf(stderr, "ERROR: Trying to reconnect to IMU.\n");
 
@@ -490,24 +997,26 @@ void checkSensors() {
 			pthread_mutex_destroy(&threadLocks[0]);
 			pthread_cond_destroy(&threadSignals[0]);
 			closeIMU(&data.IMU);
+			data.sensorsLost++;
 
 		} else {
 			fprintf(stderr, "ERROR: Successfully reconnected to IMU.\n");
 		}
+		data.overrunRuns[IMU_TASK] = 0; //its releases start over
 		fprintf(stderr, "ERROR: Continuing data recording.\n");
+		resumeIndicator();
 
-		data.controlValues[5] = 1; //resume EMG
+		data.controlValues[6].value = 1; //resume EMG
 	}
 
-	if (data.CyGl.id != -1 && data.CyGl.consecutiveErrors > 20) {
+	if (data.CyGl.id != -1 && (data.CyGl.consecutiveErrors > 20 || data.overrunRuns[CYGL_TASK] > 20)) {
 		//.5 sec of missed data
 		//big error happening, try to reconnect to the CyberGlove
 
-		data.controlValues[5] = 0; //stop EMG
+		data.controlValues[6].value = 0; //stop EMG
 
 		//turn on red LED
-		digitalWrite(GREEN_LED, 0);
-		digitalWrite(RED_LED, 1);
+		setIndicatorStatus(&data.indicator, INDICATOR_RECONNECTING);
 		fprintf(stderr, "ERROR: Too many consecutive missed reads.\n");
 		fprintf(stderr, "ERROR: Trying to reconnect to CyberGlove.\n");
 
@@ -520,24 +1029,26 @@ void checkSensors() {
 			pthread_cond_destroy(&threadSignals[1]);
 
 			closeCyGl(&data.CyGl);
+			data.sensorsLost++;
 
 		} else {
 			fprintf(stderr, "ERROR: Successfully reconnected to CyberGlove.\n");
 		}
+		data.overrunRuns[CYGL_TASK] = 0; //its releases start over
 		fprintf(stderr, "ERROR: Continuing data recording.\n");
+		resumeIndicator();
 
-		data.controlValues[5] = 1; //resume EMG
+		data.controlValues[6].value = 1; //resume EMG
 	}
 
-	if (data.Force.id != -1 && data.Force.consecutiveErrors > 20) {
+	if (data.Force.id != -1 && (data.Force.consecutiveErrors > 20 || data.overrunRuns[FORCE_TASK] > 20)) {
 		//.5 sec of missed data
 		//big error happening, try to reconnect to the Force sensors
 
-		data.controlValues[5] = 0; //stop EMG
+		data.controlValues[6].value = 0; //stop EMG
 
 		//turn on red LED
-		digitalWrite(GREEN_LED, 0);
-		digitalWrite(RED_LED, 1);
+		setIndicatorStatus(&data.indicator, INDICATOR_RECONNECTING);
 		fprintf(stderr, "ERROR: Too many consecutive missed reads.\n");
 		fprintf(stderr, "ERROR: Trying to reconnect to Force sensors.\n");
 
@@ -550,23 +1061,25 @@ void checkSensors() {
 			pthread_cond_destroy(&threadSignals[2]);
 
 			closeForce(&data.Force);
+			data.sensorsLost++;
 		} else {
 			fprintf(stderr, "ERROR: Successfully reconnected to Force sensors.\n");
 		}
+		data.overrunRuns[FORCE_TASK] = 0; //its releases start over
 		fprintf(stderr, "ERROR: Continuing data recording.\n");
+		resumeIndicator();
 
-		data.controlValues[5] = 1; //resume EMG
+		data.controlValues[6].value = 1; //resume EMG
 	}
 
-	if (data.EMG.id != -1 && data.EMG.consecutiveErrors > 20) {
+	if (data.EMG.id != -1 && (data.EMG.consecutiveErrors > 20 || data.overrunRuns[EMG_TASK] > 20)) {
 		//.5 sec of missed data
 		//big error happening, try to reconnect to the EMG
 
-		data.controlValues[5] = 0; //stop EMG
+		data.controlValues[6].value = 0; //stop EMG
 
 		//turn on red LED
-		digitalWrite(GREEN_LED, 0);
-		digitalWrite(RED_LED, 1);
+		setIndicatorStatus(&data.indicator, INDICATOR_RECONNECTING);
 		fprintf(stderr, "ERROR: Too many consecutive missed reads.\n");
 		fprintf(stderr, "ERROR: Trying to reconnect to EMG.\n");
 
@@ -579,27 +1092,89 @@ void checkSensors() {
 			pthread_cond_destroy(&threadSignals[3]);
 
 			closeEMG(&data.EMG);
+			data.sensorsLost++;
 		} else {
 			fprintf(stderr, "ERROR: Successfully reconnected to EMG.\n");
 
-			data.controlValues[5] = 1; //start EMG
+			data.controlValues[6].value = 1; //start EMG
+		}
+		data.overrunRuns[EMG_TASK] = 0; //its releases start over
+		fprintf(stderr, "ERROR: Continuing data recording.\n");
+		resumeIndicator();
+	}
+
+	if (data.Myo.id != -1 && (data.Myo.consecutiveErrors > 25 || data.overrunRuns[MYO_TASK] > 25)) {
+		//.5 sec of missed data
+		//big error happening, try to reconnect to the Myo
+
+		data.controlValues[6].value = 0; //stop EMG
+
+		//turn on red LED
+		setIndicatorStatus(&data.indicator, INDICATOR_RECONNECTING);
+		fprintf(stderr, "ERROR: Too many consecutive missed reads.\n");
+		fprintf(stderr, "ERROR: Trying to reconnect to Myo.\n");
+
+		if (restartMyo(&data.Myo) != 1) {
+			//couldn't reconnect, continue without Myo
+			fprintf(stderr, "ERROR: Couldn't reconnect to Myo.\n");
+
+			pthread_cancel(threads[5]);
+			pthread_mutex_destroy(&threadLocks[5]);
+			pthread_cond_destroy(&threadSignals[5]);
+
+			closeMyo(&data.Myo);
+			data.sensorsLost++;
+		} else {
+			fprintf(stderr, "ERROR: Successfully reconnected to Myo.\n");
 		}
+		data.overrunRuns[MYO_TASK] = 0; //its releases start over
 		fprintf(stderr, "ERROR: Continuing data recording.\n");
+		resumeIndicator();
+
+		data.controlValues[6].value = 1; //resume EMG
 	}
 }
 
+/*
+ * Back to recording after a reconnect, degraded if a sensor has been lost.
+ */
+void resumeIndicator() {
+	setIndicatorStatus(&data.indicator, data.sensorsLost > 0 ? INDICATOR_DEGRADED : INDICATOR_RECORDING);
+}
+
 void* printSaveDataThread() {
 
-	setPriority(80);
+	takeRole(PRINT_TASK);
+
+	int IMUError, CyGlError, ForceError, EMGError, MyoError;
+	int EMGUpdated;
+	MyoSample MyoSamples[MYO_POP_SZ];
+	uint32_t MyoSequence = 0; //expected sequence of the next Myo sample
+	int lastSave = 0; //minutes
 
-	int IMUError, CyGlError, ForceError, EMGError;
+	//text lines are built without printf (byte for byte what "%f" wrote) and written whole
+	char recordBytes[TEXT_LINE_SZ], EMGBytes[TEXT_LINE_SZ], MyoBytes[TEXT_LINE_SZ], gestureBytes[TEXT_LINE_SZ];
+	TextBuffer recordLine, EMGLines, MyoLines, gestureLines;
+	initializeTextBuffer(&recordLine, recordBytes, TEXT_LINE_SZ, data.outFile);
+	initializeTextBuffer(&EMGLines, EMGBytes, TEXT_LINE_SZ, data.EMGFile);
+	initializeTextBuffer(&MyoLines, MyoBytes, TEXT_LINE_SZ, data.MyoFile);
+	initializeTextBuffer(&gestureLines, gestureBytes, TEXT_LINE_SZ, data.gestureFile);
+	FeatureWindow gestureWindows[GESTURE_MAX_WINDOWS];
+
+	//EMG and Myo releases already read and overruns already reported, same order as controlValues
+	long consumed[6] = {0, 0, 0, 0, 0, 0};
+	long overruns[6] = {0, 0, 0, 0, 0, 0};
+	int erroring[6] = {0, 0, 0, 0, 0, 0}; //sensors already past FLIGHT_ERROR_THRESHOLD
 
 	while (1 == 1) {
 
 		pthread_mutex_lock(&threadLocks[4]);
-		data.controlValues[4] = 2; //signals ready to accept a print request
+		data.controlValues[4].value = 2; //signals ready to accept a print request
 		pthread_cond_wait(&threadSignals[4], &threadLocks[4]);
-		data.controlValues[4] = 0;
+		recordThreadWakeup(&data.threadPlan, PRINT_TASK);
+		recordFlightEvent(&data.flightRecorder, FLIGHT_HANDOFF, PRINT_TASK, 0);
+		data.controlValues[4].value = 0;
+		TRACE_BEGIN("record");
 
 		/* Prints:
 		 *
@@ -608,58 +1183,97 @@ void* printSaveDataThread() {
 		 * CyGl READ
 		 * Force READ
 		 * EMG READ
+		 * Myo READ
 		 *
 		 * ...
 		 */
 
 		data.reads++;
 
+		//sensors run at their own rates, every read since the last record is taken in and stored,
+		//a sensor with no finished read since the last record keeps its last read
+		IMUError = 1;
 		if (data.IMU.id != -1) {
-			IMUError = updateIMURead(&data.IMU);
-		} else {
-			IMUError = 1;
+			IMUError = drainReads(IMU_TASK, &data.IMUReads, &data.IMURecords);
+		}
+		if (data.IMU.id != -1 && overran(IMU_TASK, overruns)) {
+			IMUError = -1;
 		}
+
+		CyGlError = 1;
 		if (data.CyGl.id != -1) {
-			CyGlError = updateCyGlRead(&data.CyGl);
-		} else {
-			CyGlError = 1;
+			CyGlError = drainReads(CYGL_TASK, &data.CyGlReads, &data.CyGlRecords);
 		}
+		if (data.CyGl.id != -1 && overran(CYGL_TASK, overruns)) {
+			CyGlError = -1;
+		}
+
+		ForceError = 1;
 		if (data.Force.id != -1) {
-			ForceError = updateForceRead(&data.Force);
-		} else {
-			ForceError = 1;
+			ForceError = drainReads(FORCE_TASK, &data.ForceReads, &data.ForceRecords);
 		}
-		if (data.EMG.id != -1 && data.readsSinceEMG == 0) {
+		if (data.Force.id != -1 && overran(FORCE_TASK, overruns)) {
+			ForceError = -1;
+		}
+
+		EMGError = 1;
+		EMGUpdated = 0;
+		if (data.EMG.id != -1 && finishedReads(EMG_TASK, consumed, &data.EMG.bufferToUse)) {
 			EMGError = updateEMGRead(&data.EMG);
-		} else {
-			EMGError = 1;
+			EMGUpdated = 1;
+			if (EMGError == 1) {
+				updateOnlineStatsCounts(&data.EMGStats, data.EMG.read, data.EMG.samplesPerRead);
+			}
+		}
+		if (data.EMG.id != -1 && overran(EMG_TASK, overruns)) {
+			EMGError = -1;
 		}
 
-		if (IMUError == -1 || CyGlError == -1 || ForceError == -1 || EMGError == -1) {
+		MyoError = 1;
+		if (data.Myo.id != -1 && finishedReads(MYO_TASK, consumed, &data.Myo.bufferToUse)) {
+			MyoError = updateMyoRead(&data.Myo);
+		}
+		if (data.Myo.id != -1 && overran(MYO_TASK, overruns)) {
+			MyoError = -1;
+		}
+
+		//the last record ran past its deadline
+		overran(PRINT_TASK, overruns);
+
+		//a run of errors triggers a dump once, when it crosses the threshold
+		int consecutiveErrors[6] = {data.IMU.consecutiveErrors, data.CyGl.consecutiveErrors,
+				data.Force.consecutiveErrors, data.EMG.consecutiveErrors, 0, data.Myo.consecutiveErrors};
+		for (int i = 0; i < 6; i++) {
+			if (consecutiveErrors[i] >= FLIGHT_ERROR_THRESHOLD && !erroring[i]) {
+				triggerFlightRecorder(&data.flightRecorder, FLIGHT_ERRORS, i);
+			}
+			erroring[i] = consecutiveErrors[i] >= FLIGHT_ERROR_THRESHOLD;
+		}
+
+		updateKinematics(&data.armKinematics, data.IMUFusion.read, data.gloveAngles, data.time);
+
+		if (IMUError == -1 || CyGlError == -1 || ForceError == -1 || EMGError == -1 || MyoError == -1) {
 			//report missed read
-			digitalWrite(GREEN_LED, 0); //turn on red LED due to a missed read
-			digitalWrite(RED_LED, 1);
+			reportIndicatorMiss(&data.indicator); //flashes the red LED
 			data.errors++;
 			printf("*");
 		}
 
 		//write time from one of connected sensors if possible
+		double recordTime = data.time;
 		if (data.IMU.id != -1) {
-			printf("%5f\n", data.IMU.readTime);
-			fprintf(data.outFile, "%5f\t", data.IMU.readTime);
+			recordTime = data.IMUTime;
 		} else if (data.CyGl.id != -1) {
-			printf("%5f\n", data.CyGl.readTime);
-			fprintf(data.outFile, "%5f\t", data.CyGl.readTime);
+			recordTime = data.CyGlTime;
 		} else if (data.Force.id != -1) {
-			printf("%5f\n", data.Force.readTime);
-			fprintf(data.outFile, "%5f\t", data.Force.readTime);
+			recordTime = data.ForceTime;
 		} else if (data.EMG.id != -1) {
-			printf("%5f\n", data.EMG.readTime);
-			fprintf(data.outFile, "%5f\t", data.EMG.readTime);
-		} else {
-			printf("%5f\n", data.time);
-			fprintf(data.outFile, "%5f\t", data.time);
+			recordTime = data.EMG.readTime;
+		} else if (data.Myo.id != -1) {
+			recordTime = data.Myo.readTime;
 		}
+		printf("%5f\n", recordTime);
+		appendFixed(&recordLine, recordTime, '\t'); //"%5f", the width never matters
 
 		//IMU
 		//IMU missed read flag
@@ -669,8 +1283,8 @@ void* printSaveDataThread() {
 		}
 		//save IMU data
 		for (int i = 0; i < IMU_READ_SZ; i++) {
-			printf("%f\t", data.IMU.read[i]);
-			fprintf(data.outFile, "%f\t", data.IMU.read[i]);
+			printf("%f\t", data.IMURead[i]);
+			appendFixed(&recordLine, data.IMURead[i], '\t');
 		}
 		printf("\n");
 
@@ -681,8 +1295,8 @@ void* printSaveDataThread() {
 			printf("*");
 		}
 		for (int i = 0; i < WIRED_CYGL_READ_SZ; i++) {
-			printf("%i\t", (int) data.CyGl.read[i]);
-			fprintf(data.outFile, "%i\t", (int) data.CyGl.read[i]);
+			printf("%i\t", (int) data.CyGlRead[i]);
+			appendInt(&recordLine, (int) data.CyGlRead[i], '\t');
 		}
 		printf("\n");
 
@@ -694,39 +1308,126 @@ void* printSaveDataThread() {
 		}
 		//save force data
 		for (int i = 0; i < FORCE_READ_SZ; i++) {
-			printf("%f\t", data.Force.read[i]);
-			fprintf(data.outFile, "%f\t", data.Force.read[i]);
+			printf("%f\t", data.ForceRead[i]);
+			appendFixed(&recordLine, data.ForceRead[i], '\t');
+		}
+		printf("\n");
+
+		//IMU orientations go after the raw data so existing columns don't move
+		for (int i = 0; i < FUSION_READ_SZ; i++) {
+			printf("%f\t", data.IMUFusion.read[i]);
+			appendFixed(&recordLine, data.IMUFusion.read[i], '\t');
+		}
+		printf("\n");
+
+		//joint positions follow, only the arm joints go to the screen
+		for (int i = 0; i < KIN_READ_SZ; i++) {
+			if (i < KIN_FIRST_FINGER_JOINT * 3) {
+				printf("%f\t", data.armKinematics.read[i]);
+			}
+			appendFixed(&recordLine, data.armKinematics.read[i], '\t');
 		}
 		printf("\n");
 
-		if (data.EMG.id != -1 && data.readsSinceEMG == 0) {
+		//calibrated glove joint angles
+		for (int i = 0; i < KIN_GLOVE_SENSORS; i++) {
+			appendFixed(&recordLine, data.gloveAngles[i], '\t');
+		}
+
+		if (data.EMG.id != -1 && EMGUpdated) {
 			//EMG missed read flag
 			if (EMGError == -1) {
 				//this sensor had a missed read, mark it with an asterisk
 				printf("*");
 			}
-			for (int i = 0; i < EMG_READS_PER_CYCLE; i++) {
-				for (int j = 0; j < EMG_READ_SZ; j++) {
-					printf("%f\t", data.EMG.read[i * EMG_READ_SZ + j]);
-					fprintf(data.EMGFile, "%f\t", data.EMG.read[i * EMG_READ_SZ + j]);
+			int channels = data.EMG.config.channels;
+			for (int i = 0; i < data.EMG.samplesPerRead; i++) {
+				//a scan is built once in counts, the same text goes to the screen and the EMG file
+				reserveText(&EMGLines, channels * 22 + 1);
+				size_t scanStart = EMGLines.length;
+				for (int j = 0; j < channels; j++) {
+					appendInt(&EMGLines, data.EMG.read[i * channels + j], '\t');
 				}
-				printf("\n");
-				fprintf(data.EMGFile, "\n");
+				appendText(&EMGLines, "\n", 1);
+				fwrite(EMGLines.bytes + scanStart, 1, EMGLines.length - scanStart, stdout);
+			}
+			flushText(&EMGLines);
+
+			//every window the block closed is classified straight away
+			if (data.classifying) {
+				int closed = addEMGCounts(&data.EMGFeatures, &data.EMG.calibration, data.EMG.read, data.EMG.samplesPerRead,
+						data.EMG.readTime, gestureWindows, GESTURE_MAX_WINDOWS);
+				for (int w = 0; w < closed; w++) {
+					float score;
+					const char* gesture = data.gestureClassifier.names[classifyGesture(&data.gestureClassifier,
+							gestureWindows[w].features, &score)];
+					appendFixed(&gestureLines, gestureWindows[w].time, '\t');
+					appendText(&gestureLines, gesture, strlen(gesture));
+					appendText(&gestureLines, "\t", 1);
+					appendFixed(&gestureLines, score, '\n');
+					printf("Gesture: %s\n", gesture);
+				}
+				flushText(&gestureLines);
 			}
 		} else if (data.EMG.id == -1) {
 			printf("EMG UNUSED");
 		}
 		printf("\n");
-		fprintf(data.outFile, "\n");
+		appendText(&recordLine, "\n", 1);
+		flushText(&recordLine);
+
+		//Myo, every EMG sample since the last record: time, EMG channels, newest Myo IMU read
+		//a sample following lost ones is marked with an asterisk
+		if (data.Myo.id != -1) {
+			int popped;
+			while ((popped = popMyoSamples(&data.Myo, MyoSamples, MYO_POP_SZ)) > 0) {
+				for (int s = 0; s < popped; s++) {
+					const MyoSample* sample = &MyoSamples[s];
+					updateOnlineStats(&data.MyoStats, sample->EMG);
+
+					if (sample->sequence != MyoSequence) {
+						appendText(&MyoLines, "*", 1);
+					}
+					appendFixed(&MyoLines, sample->time, '\t');
+					MyoSequence = sample->sequence + 1;
+					for (int c = 0; c < MYO_EMG_SZ; c++) {
+						appendInt(&MyoLines, sample->EMG[c], '\t');
+					}
+					for (int i = 0; i < MYO_IMU_SZ; i++) {
+						appendFixed(&MyoLines, data.Myo.read[i], '\t');
+					}
+					appendText(&MyoLines, "\n", 1);
+				}
+			}
+			flushText(&MyoLines);
+		}
+
+		if (SESSION_STORE && data.EMG.id != -1 && EMGUpdated) {
+			storeEMGBlock(EMGError);
+		}
 
+		recordFlightEvent(&data.flightRecorder, FLIGHT_PERSIST, PRINT_TASK, data.reads);
+		TRACE_END("record");
 		pthread_mutex_unlock(&threadLocks[4]);
 
-		//save file every 60 seconds
-		if ((int) data.time % 60 == 0) {
-			fclose(data.outFile);
-			fclose(data.EMGFile);
-			data.outFile = fopen("/home/pi/Desktop/ArmTrack/ArmTrackData.txt", "a");
-			data.EMGFile = fopen("/home/pi/Desktop/ArmTrack/ArmTrackEMGData.txt", "a");
+		//a frozen flight record is thousands of lines, the report thread writes it out
+		if (isFlightRecorderFrozen(&data.flightRecorder) && !data.dumpPending) {
+			TRACE_INSTANT("flightDump");
+			data.dumpPending = 1;
+			sem_post(&data.reportWake);
+		}
+
+		//save file every 60 seconds, flushing keeps the arena buffers where reopening would allocate
+		if ((int) data.time / 60 != lastSave) {
+			lastSave = (int) data.time / 60;
+			TRACE_BEGIN("fflush");
+			fflush(data.outFile);
+			fflush(data.EMGFile);
+			fflush(data.MyoFile);
+			if (data.classifying) {
+				fflush(data.gestureFile);
+			}
+			TRACE_END("fflush");
 		}
 
 	}
@@ -734,32 +1435,293 @@ void* printSaveDataThread() {
 	pthread_exit(NULL);
 }
 
+/*
+ * Takes every read a sensor finished since the last record off its ring.
+ * Each one is counted in the sensor's statistics and stored as its own
+ * row, flagged if it failed (a failed row holds the last good read). The
+ * newest good read stays for the record. Returns the newest read's
+ * result, 1 if there was none.
+ */
+int drainReads(int task, SampleRing* ring, SessionTable* table) {
+
+	float values[WIRED_CYGL_READ_SZ]; //widest ring
+	float gloveValues[CYGL_SENSORS];
+	double time;
+	int result = 1;
+	int ok;
+
+	while (popSample(ring, &time, &ok, values) == 1) {
+		result = ok;
+
+		if (ok == 1) {
+			switch (task) {
+			case IMU_TASK:
+				memcpy(data.IMURead, values, sizeof(data.IMURead));
+				data.IMUTime = time;
+				updateFusion(&data.IMUFusion, data.IMURead, time);
+				updateOnlineStats(&data.IMUStats, data.IMURead);
+				break;
+			case CYGL_TASK:
+				for (int i = 0; i < WIRED_CYGL_READ_SZ; i++) {
+					data.CyGlRead[i] = (uint8_t) values[i];
+				}
+				data.CyGlTime = time;
+				calibrateCyGlRead(&data.CyGlCal, data.CyGlRead, data.gloveAngles);
+				for (int i = 0; i < CYGL_SENSORS; i++) {
+					gloveValues[i] = values[CYGL_FIRST_SENSOR + i];
+				}
+				updateOnlineStats(&data.CyGlStats, gloveValues);
+				break;
+			case FORCE_TASK:
+				memcpy(data.ForceRead, values, sizeof(data.ForceRead));
+				data.ForceTime = time;
+				updateOnlineStats(&data.ForceStats, data.ForceRead);
+				break;
+			}
+		}
+
+		if (SESSION_STORE) {
+			if (ok != 1) {
+				//keep the last good read, as the record does
+				switch (task) {
+				case IMU_TASK:
+					memcpy(values, data.IMURead, sizeof(data.IMURead));
+					break;
+				case CYGL_TASK:
+					for (int i = 0; i < WIRED_CYGL_READ_SZ; i++) {
+						values[i] = data.CyGlRead[i];
+					}
+					break;
+				case FORCE_TASK:
+					memcpy(values, data.ForceRead, sizeof(data.ForceRead));
+					break;
+				}
+			}
+			appendSessionRow(table, time, values, ok != 1);
+		}
+	}
+
+	return result;
+}
+
+/*
+ * For the sensors still handed over through their read buffers (EMG and
+ * Myo, slower than the records). Returns 1 if a sensor finished a read
+ * since the last record, 0 otherwise. If it finished more than one only the
+ * newest is kept: the older buffers are skipped so the next update*Read
+ * lands on the newest read, and the skipped reads are counted.
+ */
+int finishedReads(int task, long consumed[], int* bufferToUse) {
+
+	long done = data.schedule.tasks[task].completions;
+	long pending = done - consumed[task];
+	consumed[task] = done;
+
+	for (long i = 1; i < pending; i++) {
+		*bufferToUse = *bufferToUse == 1 ? 2 : 1;
+		data.overwrittenReads[task]++;
+	}
+
+	return pending > 0;
+}
+
+/*
+ * Returns 1 if a task missed a release since the last record because it
+ * was still busy with the one before, 0 otherwise. A miss triggers the
+ * flight recorder, unless a window is being written out: the dump's own
+ * I/O may be what made the task late, and it would only freeze the next
+ * window on itself.
+ */
+int overran(int task, long overruns[]) {
+
+	long missed = data.schedule.tasks[task].overruns;
+	if (missed != overruns[task]) {
+		overruns[task] = missed;
+		if (data.dumpPending) {
+			recordFlightEvent(&data.flightRecorder, FLIGHT_OVERRUN, task, 0);
+		} else {
+			triggerFlightRecorder(&data.flightRecorder, FLIGHT_OVERRUN, task);
+		}
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Every STATS_CHECK_PERIOD seconds takes a snapshot of each connected
+ * sensor's statistics (without holding up the print thread) and hands them
+ * to the report thread, which warns about channels that are clipping or
+ * stuck. Nothing is formatted or written here, this is the release thread.
+ * A check is skipped if the last one hasn't been printed yet.
+ */
+void checkStats() {
+
+	static int lastCheck = 0;
+
+	if ((int) data.time / STATS_CHECK_PERIOD == lastCheck || data.statsPending) {
+		return;
+	}
+	lastCheck = (int) data.time / STATS_CHECK_PERIOD;
+
+	int snapshots = 0;
+	if (data.IMU.id != -1) {
+		snapshotOnlineStats(&data.IMUStats, &data.statsSnapshots[snapshots++]);
+	}
+	if (data.CyGl.id != -1) {
+		snapshotOnlineStats(&data.CyGlStats, &data.statsSnapshots[snapshots++]);
+	}
+	if (data.Force.id != -1) {
+		snapshotOnlineStats(&data.ForceStats, &data.statsSnapshots[snapshots++]);
+	}
+	if (data.EMG.id != -1) {
+		snapshotOnlineStats(&data.EMGStats, &data.statsSnapshots[snapshots++]);
+	}
+	if (data.Myo.id != -1) {
+		snapshotOnlineStats(&data.MyoStats, &data.statsSnapshots[snapshots++]);
+	}
+	data.numStatsSnapshots = snapshots;
+
+	data.statsPending = 1;
+	sem_post(&data.reportWake);
+}
+
+/*
+ * Normal priority, formats and writes out what the real time threads hand
+ * it so they never block on stderr or the SD card.
+ */
+void* reportThread() {
+
+	while (1 == 1) {
+		while (sem_wait(&data.reportWake) != 0) {}
+
+		if (data.dumpPending) {
+			dumpFlightRecorder(&data.flightRecorder, FLIGHT_RECORD_PREFIX, flightSources, RELEASE_ROLE + 1);
+			__sync_synchronize(); //rearmed before the print thread can hand over the next window
+			data.dumpPending = 0;
+		}
+
+		if (data.statsPending) {
+			for (int i = 0; i < data.numStatsSnapshots; i++) {
+				printStatsWarnings(&data.statsSnapshots[i], STATS_CLIP_RATE, stderr);
+			}
+			__sync_synchronize(); //done with the snapshots before they can be retaken
+			data.statsPending = 0;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Sets up the session store tables, their chunks come from the arena.
+ * Exits if the arena is too small or a column file can't be created.
+ */
+void startSessionStore() {
+
+	for (int i = 0; i < data.EMG.config.channels; i++) {
+		EMGColumns[i] = EMGChannelNames[data.EMG.config.channel[i]];
+	}
+
+	if (initializeSessionTable(&data.IMURecords, &data.arena, "IMU", IMU_READ_SZ, IMUColumns,
+			STORE_CHUNK_ROWS, STORE_CHUNKS, "/home/pi/Desktop/ArmTrack/ArmTrackIMUData.columns") != 1
+			|| initializeSessionTable(&data.CyGlRecords, &data.arena, "CyGl", WIRED_CYGL_READ_SZ, CyGlColumns,
+			STORE_CHUNK_ROWS, STORE_CHUNKS, "/home/pi/Desktop/ArmTrack/ArmTrackCyGlData.columns") != 1
+			|| initializeSessionTable(&data.ForceRecords, &data.arena, "Force", FORCE_READ_SZ, ForceColumns,
+			STORE_CHUNK_ROWS, STORE_CHUNKS, "/home/pi/Desktop/ArmTrack/ArmTrackForceData.columns") != 1
+			|| initializeSessionCountTable(&data.EMGRecords, &data.arena, "EMG", data.EMG.config.channels, EMGColumns,
+			data.EMG.calibration.gain, data.EMG.calibration.offset,
+			EMG_STORE_CHUNK_ROWS, EMG_STORE_CHUNKS, "/home/pi/Desktop/ArmTrack/ArmTrackEMGData.columns") != 1) {
+		exit(1);
+	}
+	data.EMGRecords.reportRMSPerMinute = 1;
+}
+
+/*
+ * Adds the EMG block just written to the session store a sample per row,
+ * in counts, flagged if the block was missed.
+ */
+void storeEMGBlock(int EMGError) {
+
+	TRACE_SCOPE("storeEMGBlock");
+
+	for (int i = 0; i < data.EMG.samplesPerRead; i++) {
+		appendSessionCounts(&data.EMGRecords, data.EMG.readTime + i * data.EMG.sampleTime,
+				&data.EMG.read[i * data.EMG.config.channels], EMGError == -1);
+	}
+}
+
 void endSession() {
 
-	data.controlValues[5] = 0; //stop EMG data collection
-	while (data.controlValues[4] != 2) {}; //wait for print thread to be done
+	markArenaStop(&data.arena); //teardown's faults aren't recording's
+	data.controlValues[6].value = 0; //stop EMG data collection
+	while (data.controlValues[4].value != 2) {}; //wait for print thread to be done
 
-	for (int i = 0; i < 5; i++) {
+	for (int i = 0; i < 6; i++) {
 		pthread_cancel(threads[i]);
 		pthread_mutex_destroy(&threadLocks[i]);
 		pthread_cond_destroy(&threadSignals[i]);
 	}
+	pthread_cancel(reporter);
+
+#ifdef ARMTRACK_TRACE
+	if (traceEnabled) {
+		setTraceEnabled(0);
+		writeChromeTrace(TRACE_FILE);
+	}
+#endif
 
 	//close and save files
 	fclose(data.outFile);
 	fclose(data.EMGFile);
+	fclose(data.MyoFile);
+	if (data.classifying) {
+		fclose(data.gestureFile);
+	}
+
+	//summary goes next to the recording
+	if (SESSION_STORE) {
+		finishSessionTable(&data.IMURecords);
+		finishSessionTable(&data.CyGlRecords);
+		finishSessionTable(&data.ForceRecords);
+		finishSessionTable(&data.EMGRecords);
+
+		FILE* summary = fopen("/home/pi/Desktop/ArmTrack/ArmTrackSummary.txt", "w");
+		if (summary != NULL) {
+			writeSessionSummary(&data.IMURecords, summary);
+			fprintf(summary, "\n");
+			writeSessionSummary(&data.CyGlRecords, summary);
+			fprintf(summary, "\n");
+			writeSessionSummary(&data.ForceRecords, summary);
+			fprintf(summary, "\n");
+			writeSessionSummary(&data.EMGRecords, summary);
+			fclose(summary);
+		} else {
+			fprintf(stderr, "ERROR: Couldn't write session summary.\n");
+		}
+	}
 
 	//upload files to DropBox (hold green and red LED on during upload)
-	digitalWrite(GREEN_LED, 1); digitalWrite(RED_LED, 1);
+	setIndicatorStatus(&data.indicator, INDICATOR_UPLOADING);
 
 	//zip files
 	system("zip /home/pi/Desktop/ArmTrack/ArmTrackData.zip /home/pi/Desktop/ArmTrack/ArmTrackData.txt");
 	system("zip /home/pi/Desktop/ArmTrack/ArmTrackEMGData.zip /home/pi/Desktop/ArmTrack/ArmTrackEMGData.txt");
+	system("zip /home/pi/Desktop/ArmTrack/ArmTrackEMGData.zip /home/pi/Desktop/ArmTrack/ArmTrackEMGCalibration.txt");
+	if (data.Myo.id != -1) {
+		system("zip /home/pi/Desktop/ArmTrack/ArmTrackEMGData.zip /home/pi/Desktop/ArmTrack/ArmTrackMyoData.txt");
+	}
+	if (SESSION_STORE) {
+		system("zip /home/pi/Desktop/ArmTrack/ArmTrackData.zip /home/pi/Desktop/ArmTrack/ArmTrackSummary.txt");
+	}
+	if (data.flightRecorder.dumps > 0) {
+		system("zip /home/pi/Desktop/ArmTrack/ArmTrackData.zip " FLIGHT_RECORD_PREFIX "*.txt");
+	}
 
 	//upload zipped files
 	system("/home/pi/Dropbox-Uploader/dropbox_uploader.sh upload /home/pi/Desktop/ArmTrack/ArmTrackData.zip /");
 	system("/home/pi/Dropbox-Uploader/dropbox_uploader.sh upload /home/pi/Desktop/ArmTrack/ArmTrackEMGData.zip /");
-	digitalWrite(GREEN_LED, 0); digitalWrite(RED_LED, 0);
+	stopIndicator(&data.indicator); //LEDs off, the blinks below are written directly
+	closeSessionSwitch(&data.sessionSwitch);
 	sleep(1);
 
 	//report Error percentage
@@ -767,6 +1729,31 @@ void endSession() {
 
 	fprintf(stderr, "Elapsed Time (sec): %05.3f\tPercent Missed: %5.3f%%\n",
 			data.time, percentMissed);
+	printSchedule(&data.schedule, stderr);
+	printThreadPlan(&data.threadPlan, stderr);
+	printArenaReport(&data.arena, stderr);
+	fprintf(stderr, "Flight Recorder: %ld triggers, %i windows dumped\n",
+			data.flightRecorder.triggers, data.flightRecorder.dumps);
+	fprintf(stderr, "Reads: IMU %ld (%ld dropped), CyGl %ld (%ld dropped), Force %ld (%ld dropped), "
+			"EMG %ld overwritten, Myo %ld overwritten\n",
+			data.IMUReads.pushed, data.IMUReads.dropped, data.CyGlReads.pushed, data.CyGlReads.dropped,
+			data.ForceReads.pushed, data.ForceReads.dropped, data.overwrittenReads[EMG_TASK], data.overwrittenReads[MYO_TASK]);
+
+	StatsSnapshot snapshot;
+	snapshotOnlineStats(&data.IMUStats, &snapshot);
+	printStatsSnapshot(&snapshot, stderr);
+	snapshotOnlineStats(&data.CyGlStats, &snapshot);
+	printStatsSnapshot(&snapshot, stderr);
+	snapshotOnlineStats(&data.ForceStats, &snapshot);
+	printStatsSnapshot(&snapshot, stderr);
+	snapshotOnlineStats(&data.EMGStats, &snapshot);
+	printStatsSnapshot(&snapshot, stderr);
+	if (data.Myo.id != -1) {
+		snapshotOnlineStats(&data.MyoStats, &snapshot);
+		printStatsSnapshot(&snapshot, stderr);
+		fprintf(stderr, "Myo: %ld EMG packets, %ld IMU packets, %ld EMG packets lost, %ld samples dropped\n",
+				data.Myo.EMGPackets, data.Myo.IMUPackets, data.Myo.lostPackets, data.Myo.droppedSamples);
+	}
 
 	//blink green and red LED once
 	//then blink red once for each percent missed
@@ -796,6 +1783,7 @@ void endSession() {
 	closeCyGl(&data.CyGl);
 	closeForce(&data.Force);
 	closeEMG(&data.EMG);
+	closeMyo(&data.Myo);
 
 	fprintf(stderr, "Session Ended\n\n");
 
@@ -6,6 +6,12 @@
 #ifndef MYOHW_H
 #define MYOHW_H
 
+#include <stdint.h>
+
+#ifndef MYOHW_PACKED
+#define MYOHW_PACKED __attribute__((__packed__))
+#endif
+
 #define MYO_SERVICE_INFO_UUID { \
 		0x42, 0x48, 0x12, 0x4a,     \
 		0x7f, 0x2c, 0x48, 0x47,     \
@@ -8,8 +8,30 @@
 
 #include "quickDevice.h"
 
+static int quickDevices = 0; //configured so far, each gets its own draws
+
+int configureQuickDevice(QuickDevice* quickDevice, const char* spec) {
+
+	SimConfig config;
+	defaultSimConfig(&config, QUICKDEVICE_DELAY_US * .000001, 0);
+
+	if (spec == NULL) {
+		spec = getenv("QUICKDEVICE_SIM");
+	}
+	if (spec != NULL && parseSimConfig(&config, spec) != 1) {
+		return -1;
+	}
+
+	initializeDeviceSim(&quickDevice->sim, &config, quickDevices++);
+	return 1;
+}
+
 int initializeQuickDevice(QuickDevice* quickDevice) {
 
+	if (!quickDevice->sim.configured && configureQuickDevice(quickDevice, NULL) != 1) {
+		return -1;
+	}
+
 	quickDevice->id = 1;
 	quickDevice->hasNewRead1 = 0;
 	quickDevice->hasNewRead2 = 0;
@@ -32,6 +54,11 @@ int reconnectQuickDevice(QuickDevice* quickDevice) {
 	//first close the device
 	quickDevice->id = -1;
 
+	//a simulated disconnect can refuse to come back
+	if (simulateReconnect(&quickDevice->sim) != 1) {
+		return -1;
+	}
+
 	//then initialize the device
 	quickDevice->id = 1;
 	quickDevice->hasNewRead1 = 0;
@@ -90,24 +117,30 @@ int getQuickDeviceData(QuickDevice* quickDevice, double time) {
 	case 0:
 		//read into readBuffer1 on even reads
 		quickDevice->readBuffer1Time = time;
+		quickDevice->hasNewRead1 = 0; //not new until this read finishes
 		for (int i = 0; i < QUICKDEVICE_READ_SZ; i++) {
 			quickDevice->readBuffer1[i] = quickDevice->reads;
 		}
 
 //		printf("Here 6\n");
-		usleep(24000);
+		if (simulateRead(&quickDevice->sim) != 1) {
+			return -1;
+		}
 		quickDevice->hasNewRead1 = 1;
 //		return -1;
 		break;
 	case 1:
 		//read into readBuffer2 on odd reads
 		quickDevice->readBuffer2Time = time;
+		quickDevice->hasNewRead2 = 0;
 
 		for (int i = 0; i < QUICKDEVICE_READ_SZ; i++) {
 			quickDevice->readBuffer2[i] = quickDevice->reads;
 		}
 //		printf("Here 7\n");
-		usleep(24000);
+		if (simulateRead(&quickDevice->sim) != 1) {
+			return -1;
+		}
 		quickDevice->hasNewRead2 = 1;
 //		return -1;
 		break;
@@ -3,6 +3,10 @@
  * Author: Elijah Pivo
  *
  * Test interface for quick devices. (IMU, Force, CyberGlove)
+ *
+ * Reads take QUICKDEVICE_DELAY_US and never fail unless the device is given
+ * a DeviceSim spec (configureQuickDevice, or the QUICKDEVICE_SIM environment
+ * variable), e.g. QUICKDEVICE_SIM="dist=tail latency=.024 jitter=.001 fail=.01".
  */
 
 #ifndef QUICKDEVICE_H
@@ -13,27 +17,46 @@
 #include <unistd.h>
 #include <sys/time.h>
 
+#include "CacheLine.h"
+#include "DeviceSim.h"
+
 #define QUICKDEVICE_READ_SZ 1
+#ifndef QUICKDEVICE_DELAY_US
+#define QUICKDEVICE_DELAY_US 24000 //time a read takes, 0 to measure only memory effects
+#endif
 
 typedef struct {
 	int id;
 
-	int bufferToUse;
-	int hasNewRead1;
+	//each read buffer is filled by the collection thread on its own cache lines
+	int hasNewRead1 CACHE_ALIGNED;
 	int readBuffer1[QUICKDEVICE_READ_SZ];
 	double readBuffer1Time;
-	int hasNewRead2;
+	int hasNewRead2 CACHE_ALIGNED;
 	int readBuffer2[QUICKDEVICE_READ_SZ];
 	double readBuffer2Time;
 
+	//written by the thread calling updateQuickDeviceRead
+	int bufferToUse CACHE_ALIGNED;
 	int read[QUICKDEVICE_READ_SZ];
 	double readTime;
 
-	int reads;
 	int errors;
 	int consecutiveErrors;
+
+	int reads CACHE_ALIGNED; //counted by the collection thread
+	DeviceSim sim; //how reads behave, used by the collection thread
 } QuickDevice;
 
+/*
+ * Sets how the device's reads behave from a spec (see DeviceSim.h), NULL
+ * for QUICKDEVICE_SIM or, if that's unset, fixed QUICKDEVICE_DELAY_US reads.
+ * initializeQuickDevice configures a device that wasn't configured, call
+ * this first to give it a spec. Returns 1 if succeeded, -1 if the spec
+ * wasn't understood.
+ */
+int configureQuickDevice(QuickDevice* quickDevice, const char* spec);
+
 /*
  * Sets up a quick device.
  * Ensures its ready to collect data from.
@@ -7,7 +7,7 @@
  * 	This test uses a parallel background thread to print data.
  *
  * Usage:
- * 	Compile with: gcc -o quickDeviceRead quickDeviceRead.c quickDevice.c -std=gnu99 -Wall -Wextra -pthread
+ * 	Compile with: gcc -o quickDeviceRead quickDeviceRead.c quickDevice.c DeviceSim.c -std=gnu99 -Wall -Wextra -pthread -lm
  * 	Start with ./quickDeviceRead, end program with ctrl-d
  */
 
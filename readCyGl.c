@@ -7,7 +7,7 @@
  * 	prints it to the screen.
  *
  * Usage:
- * 	Compile with: gcc -o readCyGl readCyGl.c CyGl.c -std=gnu99 -Wall -Wextra -pthread
+ * 	Compile with: gcc -o readCyGl readCyGl.c CyGl.c Serial.c -std=gnu99 -Wall -Wextra -pthread
  * 	Start with ./readCyGl, end program with ctrl-d.
  */
 
@@ -8,10 +8,12 @@
  *
  * Usage:
  * 	Compile with:
- *		gcc -std=gnu99 -pthread -g -Wall -I. -o readEMG readEMG.c EMG.c -L. -lmccusb  -lm -L/usr/local/lib -lhidapi-libusb -lusb-1.0
+ *		gcc -std=gnu99 -pthread -g -Wall -I. -o readEMG readEMG.c EMG.c EMGCalibration.c Arena.c -L. -lmccusb  -lm -L/usr/local/lib -lhidapi-libusb -lusb-1.0
  *
  *
  * 	Start with ./readEMG, end program with ctrl-d
+ * 	Channels, ranges, scan rate and block time can be given as an EMG spec
+ * 	(see parseEMGConfig), e.g. ./readEMG "channels=0,1,2,3 rate=16000 block=.05"
  */
 
 #include <stdio.h>
@@ -51,10 +53,17 @@ pthread_t printThreadID;
 pthread_mutex_t printLock;
 pthread_cond_t printSignal;
 
-int main(void) {
+int main(int argc, char* argv[]) {
 
 	fprintf(stderr, "Reading EMG\n");
 
+	EMGConfig config;
+	defaultEMGConfig(&config);
+	if ((argc > 1 && parseEMGConfig(&config, argv[1]) != 1) || configureEMG(&data.EMG, &config, NULL) != 1) {
+		exit(1);
+	}
+	printEMGConfig(&data.EMG, stderr);
+
 	//make stdin non blocking
 	int flags = fcntl(fileno(stdin), F_GETFL, 0);
 	flags |= O_NONBLOCK;
@@ -117,7 +126,7 @@ int main(void) {
 
 		do {
 			gettimeofday(&temp, NULL);
-		} while ( (temp.tv_sec - curr.tv_sec) + (temp.tv_usec - curr.tv_usec) * .000001 < CYCLE_TIME);
+		} while ( (temp.tv_sec - curr.tv_sec) + (temp.tv_usec - curr.tv_usec) * .000001 < data.EMG.config.blockTime);
 
 	}
 
@@ -163,10 +172,10 @@ void* printThread() {
 		}
 
 		printf("%f\n", data.EMG.readTime);
-		for (int i = 0; i < EMG_READS_PER_CYCLE; i++) {
+		for (int i = 0; i < data.EMG.samplesPerRead; i++) {
 			printf("Read %i:   ", i + 1);
-			for (int j = 0; j < EMG_READ_SZ; j++) {
-				printf("%f\t", data.EMG.read[i * EMG_READ_SZ + j]);
+			for (int j = 0; j < data.EMG.config.channels; j++) {
+				printf("%f\t", EMGVolts(&data.EMG, j, data.EMG.read[i * data.EMG.config.channels + j]));
 			}
 			printf("\n");
 		}
@@ -1,59 +1,176 @@
 /*
-  Reads data from EMG through Myo.
-
-  Compile with: gcc -o readMyo readMyo.c -std=gnu99 -Wall -Wextra
-
-*/
+ * Name: readMyo.c
+ * Author: Elijah Pivo
+ *
+ * Description:
+ * 	Reads EMG and IMU data from a Myo and
+ * 	prints it to the screen.
+ *
+ * Usage:
+ * 	Compile with: gcc -o readMyo readMyo.c Myo.c MyoBluetooth.c Serial.c -std=gnu99 -Wall -Wextra -pthread
+ * 	Start with ./readMyo, end program with ctrl-d
+ */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+
+#include <sys/time.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/mman.h>
+
 #include "Myo.h"
 
-#define MYO_READ_SIZE 8
+typedef struct {
+	Myo Myo;
+	double time;
+
+	//controls printThread
+	int print;
+} Data;
 
-int MyoDataAvail (const int fd);
+void* printData();
+void endSession();
+
+Data data;
+
+pthread_t printThread;
+pthread_mutex_t printLock;
+pthread_cond_t printSignal;
 
 int main(void) {
-	const char device[] = "/dev/ttyACM0";
 
-	struct Myo Myo;
+	fprintf(stderr, "Reading Myo\n");
 
-	for (int i = 0; i < MYO_READ_SZ; i++) {
-		Myo.read[i] = 0;
+	//make stdin non blocking
+	int flags = fcntl(fileno(stdin), F_GETFL, 0);
+	flags |= O_NONBLOCK;
+	flags = fcntl(fileno(stdin), F_SETFL, flags);
+	char userInput;
+
+	if (startMyo(&data.Myo) != 1) {
+		fprintf(stderr, "readMyo Error: Couldn't start Myo.\n");
+		exit(1);
 	}
-	Myo.id = -1;
 
-	if ((Myo.id = open(device, O_RDWR)) == -1) {
-		fprintf(stderr, "Myo Error: Failed to connect.\n");
-		Myo.id = -1;
-		return -1;
+	pthread_mutex_init(&printLock, NULL);
+	pthread_cond_init(&printSignal, NULL);
+	data.print = 0;
+	if (pthread_create(&printThread, NULL, printData, NULL) != 0) {
+		fprintf(stderr, "Couldn't create print thread...\n");
+		exit(1);
 	}
 
-	//try to connect
-	fprintf(stderr, "Get list of devices.");
-	uint8_t writeBuf[5];
-	writeBuf[0] = 0x00;
-	writeBuf[1] = 0x01;
-	writeBuf[2] = 6;
-	writeBuf[3] = 2;
-	writeBuf[4] = 0x01;
-	write(Myo.id, &writeBuf, 5);
-
-	usleep(1000);
-
-	uint8_t readBuf;
-	while (MyoDataAvail(Myo.id) > 0) {
-		read(Myo.id, &readBuf, 1);
-		fprintf(stderr, "*%d*\n", (int) readBuf);
-		usleep(100);
+	struct timeval last;
+	struct timeval curr;
+	struct timeval temp;
+
+	gettimeofday(&curr, NULL); //update current time
+
+	while (read(fileno(stdin), &userInput, 1) < 0) {
+
+		last.tv_sec = curr.tv_sec; last.tv_usec = curr.tv_usec; //update last time
+		gettimeofday(&curr, NULL); //update current time
+		data.time += (curr.tv_sec - last.tv_sec) + (curr.tv_usec - last.tv_usec) * .000001; //increment by difference between last and current time
+
+		getMyoData(&data.Myo, data.time);
+
+		while (data.print != 2) {}; //wait for print thread to be ready
+		pthread_mutex_lock(&printLock);
+		data.print = 1;
+		pthread_cond_signal(&printSignal);
+		pthread_mutex_unlock(&printLock);
+
+		if (data.Myo.consecutiveErrors > 25) {
+			//.5 sec of missed data
+			//big error happening, try to reconnect to the Myo
+
+			fprintf(stderr, "ERROR: Too many consecutive missed reads.\n");
+			fprintf(stderr, "ERROR: Trying to reconnect to Myo.\n");
+
+			if (restartMyo(&data.Myo) != 1) {
+				//couldn't reconnect, just end the program here
+
+				fprintf(stderr, "ERROR: Couldn't reconnect to Myo.\n");
+				fprintf(stderr, "ERROR: Ending recording session.\n");
+
+				endSession();
+				return 0;
+			}
+
+			fprintf(stderr, "ERROR: Successfully reconnected to Myo.\n");
+			fprintf(stderr, "ERROR: Continuing data recording.\n");
+
+		}
+
+		do {
+			gettimeofday(&temp, NULL);
+		} while ( (temp.tv_sec - curr.tv_sec) + (temp.tv_usec - curr.tv_usec) * .000001 < .02);
 	}
+	endSession();
+	return 1;
 }
 
-int MyoDataAvail (const int fd) {
-	int result ;
+void endSession() {
+
+	while (data.print != 2) {}; //wait for print thread to be done
 
-	if (ioctl (fd, FIONREAD, &result) == -1)
-		return -1 ;
+	pthread_cancel(printThread);
+	pthread_mutex_destroy(&printLock);
+	pthread_cond_destroy(&printSignal);
 
-	return result ;
+	double percentMissed = (data.Myo.errors / (double) data.Myo.reads) * 100;
+
+	fprintf(stderr, "Elapsed Time (sec): %05.3f\tPercent Missed: %5.3f%%\n",
+			data.time, percentMissed);
+	fprintf(stderr, "EMG Packets: %ld\tIMU Packets: %ld\tLost EMG Packets: %ld\tDropped Samples: %ld\n",
+			data.Myo.EMGPackets, data.Myo.IMUPackets, data.Myo.lostPackets, data.Myo.droppedSamples);
+
+	closeMyo(&data.Myo);
+
+	fprintf(stderr, "Session Ended\n\n");
+}
+
+void* printData() {
+
+	MyoSample samples[MYO_RING_SZ];
+
+	while (1 == 1) {
+
+		pthread_mutex_lock(&printLock);
+		data.print = 2; //signals ready to accept a print request
+		pthread_cond_wait(&printSignal, &printLock);
+		data.print = 0;
+
+		/*
+		 * Format, one line per EMG sample:
+		 * 		Time1 -8 Channels of EMG- -Newest IMU Data-
+		 * 		Time2 -8 Channels of EMG- -Newest IMU Data-
+		 * 		...
+		 */
+
+		if (updateMyoRead(&data.Myo) == -1) {
+			printf("*\n");
+		}
+
+		int popped = popMyoSamples(&data.Myo, samples, MYO_RING_SZ);
+		for (int s = 0; s < popped; s++) {
+			printf("%f\t", samples[s].time);
+			for (int c = 0; c < MYO_EMG_SZ; c++) {
+				printf("%f\t", samples[s].EMG[c]);
+			}
+			for (int i = 0; i < MYO_IMU_SZ; i++) {
+				printf("%f\t", data.Myo.read[i]);
+			}
+			printf("\n");
+		}
+		pthread_mutex_unlock(&printLock);
+	}
+	pthread_exit(NULL);
 }
@@ -0,0 +1,156 @@
+/*
+ * Name: replaySession.c
+ * Author: Elijah Pivo
+ *
+ * Description:
+ * 	Drives a recorded session back through the processing and storage
+ * 	stages (fusion, glove calibration, kinematics, record writing) using
+ * 	the replay source in place of the sensor drivers. Reports how many
+ * 	times faster than real time the stages ran.
+ *
+ * Usage:
+ * 	Compile with: gcc -O2 -o replaySession replaySession.c Replay.c IMU.c CyGl.c Force.c Fusion.c Kinematics.c CyGlCalibration.c Serial.c -std=gnu99 -Wall -Wextra -lm
+ * 	Run with: ./replaySession <ArmTrackData.txt> <output file> [speed, 0 for as fast as possible] [CyGl calibration file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Replay.h"
+#include "Fusion.h"
+#include "Kinematics.h"
+#include "CyGlCalibration.h"
+
+typedef struct {
+	IMU IMU;
+	CyGl CyGl;
+	Force Force;
+
+	Fusion IMUFusion;
+	CyGlCalibration CyGlCal;
+	float gloveAngles[KIN_GLOVE_SENSORS];
+	Kinematics armKinematics;
+
+	int errors;
+	int reads;
+	FILE* outFile;
+} Data;
+
+Data data;
+
+int main(int argc, char* argv[]) {
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s <ArmTrackData.txt> <output file> [speed] [CyGl calibration file]\n", argv[0]);
+		exit(1);
+	}
+
+	double speed = REPLAY_AS_FAST_AS_POSSIBLE;
+	if (argc > 3) {
+		speed = atof(argv[3]);
+	}
+
+	if (argc > 4) {
+		loadCyGlCalibration(&data.CyGlCal, argv[4]);
+	} else {
+		defaultCyGlCalibration(&data.CyGlCal);
+	}
+
+	if (startReplay(argv[1], NULL, speed) != 1) {
+		exit(1);
+	}
+
+	if (initializeIMUReplay(&data.IMU) == -1 || initializeCyGlReplay(&data.CyGl) == -1
+			|| initializeForceReplay(&data.Force) == -1) {
+		exit(1);
+	}
+
+	if ((data.outFile = fopen(argv[2], "w")) == NULL) {
+		fprintf(stderr, "ERROR: Couldn't open %s.\n", argv[2]);
+		exit(1);
+	}
+
+	initializeFusion(&data.IMUFusion, FUSION_DEFAULT_GAIN);
+	Skeleton skeleton;
+	defaultSkeleton(&skeleton);
+	initializeKinematics(&data.armKinematics, &skeleton);
+	for (int i = 0; i < KIN_GLOVE_SENSORS; i++) {
+		data.gloveAngles[i] = 0;
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	double firstTime = -1;
+
+	while (1 == 1) {
+
+		if (getIMUReplayData(&data.IMU, 0) == -1 || getCyGlReplayData(&data.CyGl, 0) == -1
+				|| getForceReplayData(&data.Force, 0) == -1) {
+			break;
+		}
+
+		data.reads++;
+
+		int IMUError = updateIMURead(&data.IMU);
+		int CyGlError = updateCyGlRead(&data.CyGl);
+		int ForceError = updateForceRead(&data.Force);
+
+		if (IMUError == -1 || CyGlError == -1 || ForceError == -1) {
+			data.errors++;
+		}
+
+		if (IMUError == 1) {
+			updateFusion(&data.IMUFusion, data.IMU.read, data.IMU.readTime);
+		}
+		if (CyGlError == 1) {
+			calibrateCyGlRead(&data.CyGlCal, data.CyGl.read, data.gloveAngles);
+		}
+		updateKinematics(&data.armKinematics, data.IMUFusion.read, data.gloveAngles, data.IMU.readTime);
+
+		if (firstTime < 0) {
+			firstTime = data.IMU.readTime;
+		}
+
+		//same record layout as mobileArmTrackTest
+		fprintf(data.outFile, "%5f\t", data.IMU.readTime);
+		for (int i = 0; i < IMU_READ_SZ; i++) {
+			fprintf(data.outFile, "%f\t", data.IMU.read[i]);
+		}
+		for (int i = 0; i < WIRED_CYGL_READ_SZ; i++) {
+			fprintf(data.outFile, "%i\t", (int) data.CyGl.read[i]);
+		}
+		for (int i = 0; i < FORCE_READ_SZ; i++) {
+			fprintf(data.outFile, "%f\t", data.Force.read[i]);
+		}
+		for (int i = 0; i < FUSION_READ_SZ; i++) {
+			fprintf(data.outFile, "%f\t", data.IMUFusion.read[i]);
+		}
+		for (int i = 0; i < KIN_READ_SZ; i++) {
+			fprintf(data.outFile, "%f\t", data.armKinematics.read[i]);
+		}
+		for (int i = 0; i < KIN_GLOVE_SENSORS; i++) {
+			fprintf(data.outFile, "%f\t", data.gloveAngles[i]);
+		}
+		fprintf(data.outFile, "\n");
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	fclose(data.outFile);
+	closeIMUReplay(&data.IMU);
+	closeCyGlReplay(&data.CyGl);
+	closeForceReplay(&data.Force);
+	endReplay();
+
+	double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * .000000001;
+	double recorded = data.reads > 0 ? data.IMU.readTime - firstTime : 0;
+
+	fprintf(stderr, "Records: %i\tMissed: %i\n", data.reads, data.errors);
+	fprintf(stderr, "Recorded time (sec): %.3f\tReplay time (sec): %.3f\t(%.1fx real time)\n",
+			recorded, elapsed, elapsed > 0 ? recorded / elapsed : 0);
+	fprintf(stderr, "Per record: %.2f us\n", data.reads > 0 ? elapsed / data.reads * 1e6 : 0);
+
+	return 0;
+}
@@ -3,7 +3,7 @@
  * an IMU, Force, EMG, Wireless CyberGlove, Wired CyberGlove.
  *
  * Compile with:
- *		gcc -o responseTest responseTest.c IMU.c Force.c EMG.c CyGl.c -std=gnu99 -Wall -Wextra
+ *		gcc -o responseTest responseTest.c IMU.c Force.c EMG.c EMGCalibration.c Arena.c CyGl.c Serial.c -std=gnu99 -Wall -Wextra -pthread -L. -lmccusb -lm -L/usr/local/lib -lhidapi-libusb -lusb-1.0
  * Run with:
  *		./responseTest
  */
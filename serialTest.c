@@ -0,0 +1,155 @@
+/* Name: serialTest.c
+ * Author: Elijah Pivo
+ *
+ * Description:
+ * 	Round trip benchmark for a serial sensor. Sends a request and waits for
+ * 	the whole response, many times, under every combination of baud rate,
+ * 	low latency flag and read mode:
+ * 		poll:  non-blocking port, VMIN 0 VTIME 0, poll then read what's there
+ * 		vmin:  blocking port, VMIN = response length, VTIME 1 (.1s between bytes)
+ * 	and prints the median, 99th percentile and worst round trip with the
+ * 	number of failed trips, so the fastest setting the device's firmware
+ * 	answers reliably at can be put in its driver (IMU_BAUDS, CYGL_BAUDS).
+ *
+ * Usage:
+ * 	Compile with: gcc -O2 -o serialTest serialTest.c Serial.c -std=gnu99 -Wall -Wextra
+ * 	Run with: ./serialTest device request responseLength [trips]
+ * 		IMU chain:      ./serialTest /dev/ttyACM0 w 49
+ * 		Wired CyGl:     ./serialTest /dev/ttyUSB0 G 24
+ * 	A rate the device wasn't built for shows up as every trip failing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Serial.h"
+
+#define DEFAULT_TRIPS 1000
+#define TRIP_TIMEOUT 100000 //us before a trip counts as failed
+#define MAX_RESPONSE 256
+
+static const speed_t bauds[] = {B921600, B460800, B230400, B115200};
+
+int compareLongs(const void* a, const void* b);
+int roundTrip(int fd, const char* request, int requestLength, uint8_t* response, int responseLength, int blocking);
+
+int main(int argc, char* argv[]) {
+
+	if (argc < 4) {
+		fprintf(stderr, "Usage: %s device request responseLength [trips]\n", argv[0]);
+		return 1;
+	}
+
+	const char* device = argv[1];
+	const char* request = argv[2];
+	int requestLength = strlen(request);
+	int responseLength = atoi(argv[3]);
+	int trips = argc > 4 ? atoi(argv[4]) : DEFAULT_TRIPS;
+
+	if (responseLength <= 0 || responseLength > MAX_RESPONSE || trips <= 0) {
+		fprintf(stderr, "serialTest Error: Response length must be 1-%i and trips positive.\n", MAX_RESPONSE);
+		return 1;
+	}
+
+	SerialOptions options;
+	defaultSerialOptions(&options, bauds[0]);
+	int fd = openSerialPort(device, &options);
+	if (fd == -1) {
+		fprintf(stderr, "serialTest Error: Couldn't open %s.\n", device);
+		return 1;
+	}
+
+	long* times = malloc(trips * sizeof(long));
+	uint8_t response[MAX_RESPONSE];
+
+	printf("%s, %i byte request, %i byte response, %i trips\n", device, requestLength, responseLength, trips);
+	printf("%8s %12s %6s %10s %10s %10s %8s\n", "baud", "low latency", "mode", "median us", "p99 us", "max us", "failed");
+
+	for (int b = 0; b < (int) (sizeof(bauds) / sizeof(bauds[0])); b++) {
+		for (int lowLatency = 0; lowLatency < 2; lowLatency++) {
+			for (int blocking = 0; blocking < 2; blocking++) {
+
+				options.baud = bauds[b];
+				options.lowLatency = lowLatency;
+				options.blocking = blocking;
+				options.minBytes = blocking ? responseLength : 0;
+				options.interByteTimeout = blocking ? 1 : 0;
+				if (configureSerialPort(fd, &options) != 1) {
+					fprintf(stderr, "serialTest Error: Couldn't configure port.\n");
+					continue;
+				}
+				int lowLatencyTaken = setSerialLowLatency(fd, lowLatency) == 1;
+				usleep(10000); //10mS, let the line settle
+
+				int done = 0;
+				int failed = 0;
+				for (int t = 0; t < trips; t++) {
+					struct timespec start, end;
+					clock_gettime(CLOCK_MONOTONIC, &start);
+					if (roundTrip(fd, request, requestLength, response, responseLength, blocking) != 1) {
+						failed++;
+						tcflush(fd, TCIOFLUSH);
+						if (failed == 10 && done == 0) {
+							break; //device isn't answering at this setting
+						}
+						continue;
+					}
+					clock_gettime(CLOCK_MONOTONIC, &end);
+					times[done++] = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+				}
+
+				printf("%8ld %12s %6s ", serialBaudRate(bauds[b]),
+						lowLatency ? (lowLatencyTaken ? "on" : "unsupported") : "off", blocking ? "vmin" : "poll");
+				if (done > 0) {
+					qsort(times, done, sizeof(long), compareLongs);
+					printf("%10ld %10ld %10ld", times[done / 2], times[(long) done * 99 / 100], times[done - 1]);
+				} else {
+					printf("%10s %10s %10s", "-", "-", "-");
+				}
+				printf(" %8i\n", failed);
+			}
+		}
+	}
+
+	free(times);
+	close(fd);
+	return 0;
+}
+
+int compareLongs(const void* a, const void* b) {
+	long x = *(const long*) a;
+	long y = *(const long*) b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Sends request and waits for the whole response.
+ * Returns 1 if it arrived in time, -1 otherwise.
+ */
+int roundTrip(int fd, const char* request, int requestLength, uint8_t* response, int responseLength, int blocking) {
+
+	if (write(fd, request, requestLength) != requestLength) {
+		return -1;
+	}
+
+	if (!blocking) {
+		return readSerialFrame(fd, response, responseLength, TRIP_TIMEOUT) == responseLength ? 1 : -1;
+	}
+
+	//VMIN lets the kernel wake us once for the whole response, poll only guards a silent device
+	struct pollfd waitFor = {fd, POLLIN, 0};
+	if (poll(&waitFor, 1, TRIP_TIMEOUT / 1000) != 1) {
+		return -1;
+	}
+	int have = 0;
+	while (have < responseLength) {
+		ssize_t got = read(fd, response + have, responseLength - have);
+		if (got <= 0) {
+			return -1; //VTIME ran out between bytes
+		}
+		have += got;
+	}
+	return 1;
+}
@@ -0,0 +1,266 @@
+/* Name: sharingTest.c
+ * Author: Elijah Pivo
+ *
+ * Description:
+ * 	Measures what sharing cache lines between the data collection threads
+ * 	costs. Four quickDevice collection threads, a print thread and the main
+ * 	(release) thread hand reads around the way mobileArmTrackTest does, each
+ * 	pinned to its own core where there are enough, but the quick devices
+ * 	don't sleep so a cycle is nothing but hand-offs and cache traffic.
+ * 	Build it twice, with and without -DCACHE_PACKED (the old packed layout),
+ * 	and compare cycle times and cache misses.
+ *
+ * Usage:
+ * 	Compile with:
+ * 		gcc -O2 -o sharingTest sharingTest.c quickDevice.c DeviceSim.c -pthread -std=gnu99 -Wall -Wextra -DQUICKDEVICE_DELAY_US=0 -lm
+ * 		gcc -O2 -o sharingTestPacked sharingTest.c quickDevice.c DeviceSim.c -pthread -std=gnu99 -Wall -Wextra -DQUICKDEVICE_DELAY_US=0 -DCACHE_PACKED -lm
+ *
+ * 	Run with: ./sharingTest [cycles]
+ * 	Cache misses need perf events (run as root or lower kernel.perf_event_paranoid).
+ */
+
+#define _GNU_SOURCE //pthread_setaffinity_np
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "quickDevice.h"
+#include "CacheLine.h"
+
+#define DEVICES 4 //IMU, CyGl, Force, EMG
+#define PRINT 4   //print thread's control slot
+#define DEFAULT_CYCLES 200000
+
+typedef struct {
+	QuickDevice devices[DEVICES];
+
+	//written by the print thread
+	long sum CACHE_ALIGNED;
+	int errors;
+	int reads;
+
+	//written by the main thread
+	double time CACHE_ALIGNED;
+	volatile int stop;
+
+	/*
+	 * Same meanings as mobileArmTrackTest:
+	 * 0: Handling a read or print request.
+	 * 1: Get a read or trigger print.
+	 * 2: Ready to accept a read or print request.
+	 */
+	ControlSlot controlValues[DEVICES + 1];
+} Data;
+
+Data data;
+
+pthread_t threads[DEVICES + 1];
+int cores;
+
+void pin(int core);
+void waitFor(int slot, int value);
+void* deviceThread(void* device);
+void* printThread();
+int openCounter(uint32_t type, uint64_t config);
+long long readCounter(int fd);
+
+int main(int argc, char* argv[]) {
+
+	long cycles = argc > 1 ? atol(argv[1]) : DEFAULT_CYCLES;
+	cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+#ifdef CACHE_PACKED
+	fprintf(stderr, "Layout: packed\t");
+#else
+	fprintf(stderr, "Layout: cache line padded\t");
+#endif
+	fprintf(stderr, "Data: %zu bytes\tQuickDevice: %zu bytes\tCores: %i\n",
+			sizeof(Data), sizeof(QuickDevice), cores);
+
+	for (int i = 0; i < DEVICES; i++) {
+		initializeQuickDevice(&data.devices[i]);
+	}
+	for (int i = 0; i <= DEVICES; i++) {
+		data.controlValues[i].value = 0;
+	}
+
+	//counters are opened before the threads so they inherit them
+	int cacheMisses = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	int L1Misses = openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+			| (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+
+	pin(0);
+	for (int i = 0; i < DEVICES; i++) {
+		if (pthread_create(&threads[i], NULL, deviceThread, &data.devices[i]) != 0) {
+			fprintf(stderr, "ERROR: Couldn't start device thread.\n");
+			exit(1);
+		}
+	}
+	if (pthread_create(&threads[PRINT], NULL, printThread, NULL) != 0) {
+		fprintf(stderr, "ERROR: Couldn't start print thread.\n");
+		exit(1);
+	}
+
+	//wait for every thread to be ready
+	for (int i = 0; i <= DEVICES; i++) {
+		waitFor(i, 2);
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (long c = 0; c < cycles; c++) {
+
+		data.time += .025;
+
+		for (int i = 0; i < DEVICES; i++) {
+			data.controlValues[i].value = 1;
+		}
+		for (int i = 0; i < DEVICES; i++) {
+			waitFor(i, 2);
+		}
+
+		//print runs alongside the next cycle's reads, like the real program
+		waitFor(PRINT, 2);
+		data.controlValues[PRINT].value = 1;
+	}
+	waitFor(PRINT, 2);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	data.stop = 1;
+	for (int i = 0; i <= DEVICES; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * .000000001;
+
+	fprintf(stderr, "Cycles: %ld\tRecords: %i\tMissed: %i\n", cycles, data.reads, data.errors);
+	fprintf(stderr, "Cycle time: %.1f ns\n", elapsed / cycles * 1e9);
+
+	long long misses = readCounter(cacheMisses);
+	long long L1 = readCounter(L1Misses);
+	if (misses >= 0) {
+		fprintf(stderr, "Cache misses per cycle: %.2f\n", misses / (double) cycles);
+	} else {
+		fprintf(stderr, "Cache misses per cycle: unavailable\n");
+	}
+	if (L1 >= 0) {
+		fprintf(stderr, "L1 data read misses per cycle: %.2f\n", L1 / (double) cycles);
+	} else {
+		fprintf(stderr, "L1 data read misses per cycle: unavailable\n");
+	}
+
+	return 0;
+}
+
+/*
+ * Pins the calling thread to a core, if the machine has it.
+ */
+void pin(int core) {
+
+	if (core >= cores) {
+		return; //share what there is
+	}
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/*
+ * Spins until a control slot holds value, the way the real program does.
+ */
+void waitFor(int slot, int value) {
+	while (data.controlValues[slot].value != value && !data.stop) {
+		if (cores < DEVICES + 2) {
+			sched_yield(); //not a core per thread, let the others run
+		}
+	}
+}
+
+void* deviceThread(void* device) {
+
+	QuickDevice* quickDevice = device;
+	int slot = quickDevice - data.devices;
+
+	pin(slot + 1);
+
+	while (!data.stop) {
+		data.controlValues[slot].value = 2; //signals ready to accept a collection request
+		waitFor(slot, 1);
+		data.controlValues[slot].value = 0;
+		getQuickDeviceData(quickDevice, data.time);
+	}
+
+	return NULL;
+}
+
+void* printThread() {
+
+	pin(DEVICES + 1);
+
+	while (!data.stop) {
+		data.controlValues[PRINT].value = 2; //signals ready to accept a print request
+		waitFor(PRINT, 1);
+		if (data.stop) {
+			break;
+		}
+		data.controlValues[PRINT].value = 0;
+
+		int error = 0;
+		for (int i = 0; i < DEVICES; i++) {
+			if (updateQuickDeviceRead(&data.devices[i]) == -1) {
+				error = 1;
+			}
+			data.sum += data.devices[i].read[0];
+		}
+		data.errors += error;
+		data.reads++;
+	}
+
+	data.controlValues[PRINT].value = 2;
+	return NULL;
+}
+
+/*
+ * Opens a hardware counter for this thread and every thread it starts.
+ * Returns the counter's file, -1 if the counter isn't available.
+ */
+int openCounter(uint32_t type, uint64_t config) {
+
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.inherit = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * Returns a counter's count (including threads that have exited), -1 if
+ * it isn't available.
+ */
+long long readCounter(int fd) {
+
+	long long count;
+	if (fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count)) {
+		return -1;
+	}
+	close(fd);
+	return count;
+}
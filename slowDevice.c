@@ -12,8 +12,31 @@
 
 #include <stdio.h>
 
+static int slowDevices = 0; //configured so far, each gets its own draws
+
+int configureSlowDevice(SlowDevice* slowDevice, const char* spec) {
+
+	//busy waits like the EMG driver does
+	SimConfig config;
+	defaultSimConfig(&config, SLOWDEVICE_READ_TIME, 1);
+
+	if (spec == NULL) {
+		spec = getenv("SLOWDEVICE_SIM");
+	}
+	if (spec != NULL && parseSimConfig(&config, spec) != 1) {
+		return -1;
+	}
+
+	initializeDeviceSim(&slowDevice->sim, &config, slowDevices++);
+	return 1;
+}
+
 int initializeSlowDevice(SlowDevice* slowDevice) {
 
+	if (!slowDevice->sim.configured && configureSlowDevice(slowDevice, NULL) != 1) {
+		return -1;
+	}
+
 	slowDevice->id = 1;
 	slowDevice->hasNewRead1 = 0;
 	slowDevice->hasNewRead2 = 0;
@@ -36,6 +59,11 @@ int reconnectSlowDevice(SlowDevice* slowDevice) {
 	//first close the device
 	slowDevice->id = -1;
 
+	//a simulated disconnect can refuse to come back
+	if (simulateReconnect(&slowDevice->sim) != 1) {
+		return -1;
+	}
+
 	//then initialize the device
 	slowDevice->id = 1;
 	slowDevice->hasNewRead1 = 0;
@@ -80,8 +108,6 @@ int restartSlowDevice(SlowDevice* slowDevice) {
 }
 
 int getSlowDeviceData(SlowDevice* slowDevice, double time) {
-		struct timeval start, end;
-		gettimeofday(&start, NULL);
 
 		slowDevice->reads++;
 
@@ -89,31 +115,33 @@ int getSlowDeviceData(SlowDevice* slowDevice, double time) {
 		case 0:
 			//read into readBuffer1 on even reads
 			slowDevice->readBuffer1Time = time;
+			slowDevice->hasNewRead1 = 0; //not new until this read finishes
 			for (int i = 0; i < SLOWDEVICE_READ_SZ * SLOWDEVICE_READS_PER_CYCLE; i++) {
 				slowDevice->readBuffer1[i] = slowDevice->reads;
 			}
 
+			//the read takes its simulated time, a failed one brings no data
+			if (simulateRead(&slowDevice->sim) != 1) {
+				return -1;
+			}
 			slowDevice->hasNewRead1 = 1;
 			break;
 		case 1:
 			//read into readBuffer2 on odd reads
 			slowDevice->readBuffer2Time = time;
+			slowDevice->hasNewRead2 = 0;
 
 			for (int i = 0; i < SLOWDEVICE_READ_SZ * SLOWDEVICE_READS_PER_CYCLE; i++) {
 				slowDevice->readBuffer2[i] = slowDevice->reads;
 			}
 
+			if (simulateRead(&slowDevice->sim) != 1) {
+				return -1;
+			}
 			slowDevice->hasNewRead2 = 1;
 			break;
 		}
 
-		//this part is proving to be inconsistently timed...
-		//allows manipulation of time process takes
-		do {
-			gettimeofday(&end, NULL);
-		} while ((end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) * .000001 < .202);
-
-
 		return 1;
 }
 
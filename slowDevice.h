@@ -4,6 +4,9 @@
  *
  * Slow Device Test interface, mimics behavior of EMG data collection.
  *
+ * Reads busy wait SLOWDEVICE_READ_TIME and never fail unless the device is
+ * given a DeviceSim spec (configureSlowDevice, or the SLOWDEVICE_SIM
+ * environment variable), e.g. SLOWDEVICE_SIM="dist=bimodal slow=.4 slowp=.02".
  */
 
 #ifndef SLOWDEVICE_H
@@ -13,8 +16,11 @@
 #include <unistd.h>
 #include <sys/time.h>
 
+#include "DeviceSim.h"
+
 #define SLOWDEVICE_READ_SZ 1
 #define SLOWDEVICE_READS_PER_CYCLE 1
+#define SLOWDEVICE_READ_TIME .202 //s a read takes, an EMG block and the driver's overhead
 
 typedef struct {
 	int id;
@@ -33,8 +39,19 @@ typedef struct {
 	int reads;
 	int errors;
 	int consecutiveErrors;
+
+	DeviceSim sim; //how reads behave, used by the collection thread
 } SlowDevice;
 
+/*
+ * Sets how the device's reads behave from a spec (see DeviceSim.h), NULL
+ * for SLOWDEVICE_SIM or, if that's unset, fixed SLOWDEVICE_READ_TIME reads.
+ * initializeSlowDevice configures a device that wasn't configured, call
+ * this first to give it a spec. Returns 1 if succeeded, -1 if the spec
+ * wasn't understood.
+ */
+int configureSlowDevice(SlowDevice* slowDevice, const char* spec);
+
 /*
  * Sets up a slow device.
  * Ensures its ready to collect data from.
@@ -7,7 +7,7 @@
  * 	This test uses a parallel background thread to print data.
  *
  * Usage:
- * 	Compile with: gcc -o slowDeviceRead slowDeviceRead.c slowDevice.c -std=gnu99 -Wall -Wextra -pthread
+ * 	Compile with: gcc -o slowDeviceRead slowDeviceRead.c slowDevice.c DeviceSim.c -std=gnu99 -Wall -Wextra -pthread -lm
  * 	Start with ./slowDeviceRead, end program with ctrl-d
  */
 
@@ -0,0 +1,695 @@
+/*
+ * Name: storageTest.c
+ * Author: Elijah Pivo
+ *
+ * Description:
+ * 	Benchmarks ways of writing a session to storage (the Pi's SD card, a USB
+ * 	stick, ...) under the recorder's write pattern. Records the size of the
+ * 	ones mobileArmTrackTest writes (time, IMU, CyGl, Force, orientations,
+ * 	joint positions and glove angles) go to a data file every record
+ * 	period, EMG blocks (8 channels at 1kHz, 200ms blocks by default) to an
+ * 	EMG file every block time, and both files are synced every sync period.
+ * 	Each back end writes the same bytes at the same times:
+ * 		stdio	fwrite through a 1MB stdio buffer (the recorder today)
+ * 		write	a write call per record
+ * 		writev	WRITEV_BATCH records gathered into a writev call
+ * 		pwrite	pwrite into a file preallocated with posix_fallocate
+ * 		mmap	memcpy into a preallocated mapping, msync to sync
+ * 		direct	O_DIRECT writes of DIRECT_CHUNK aligned chunks
+ * 	For each it reports throughput, the latency of the write calls (p50,
+ * 	p99, max), the cost of a sync and the CPU time per MB written.
+ *
+ * Usage:
+ * 	Compile with: gcc -O2 -o storageTest storageTest.c -std=gnu99 -Wall -Wextra -lm
+ * 	Run with: ./storageTest [options] <directory on the device to test>
+ * 		-d seconds  length of the modelled session, 60 by default
+ * 		-r ms  record period, 25 by default (mobileArmTrackTest records every 10)
+ * 		-e channels:rate:block  EMG channels, S/s over all channels and s a block, 8:8000:.2 by default
+ * 		-s seconds  sync period, 10 by default
+ * 		-b  write binary records (double time, float values, raw EMG counts) instead of text
+ * 		-f  write as fast as possible instead of in real time
+ * 		-t stdio,write,...  back ends to run, all by default
+ * 		-k  keep the files written
+ */
+
+#define _GNU_SOURCE //O_DIRECT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "IMU.h"
+#include "CyGl.h"
+#include "Force.h"
+#include "Kinematics.h"
+
+#define RECORD_VALUES (IMU_READ_SZ + WIRED_CYGL_READ_SZ + FORCE_READ_SZ + FUSION_READ_SZ + KIN_READ_SZ + KIN_GLOVE_SENSORS)
+#define POOL_SZ 64 //distinct records and EMG blocks cycled through
+#define STDIO_BUFFER_SZ (1024 * 1024)
+#define WRITEV_BATCH 16 //records a writev call gathers
+#define DIRECT_ALIGNMENT 4096
+#define DIRECT_CHUNK (64 * 1024)
+
+typedef enum {
+	STORAGE_STDIO,
+	STORAGE_WRITE,
+	STORAGE_WRITEV,
+	STORAGE_PWRITE,
+	STORAGE_MMAP,
+	STORAGE_DIRECT,
+	STORAGE_BACKENDS
+} StorageBackend;
+
+static const char* backendNames[STORAGE_BACKENDS] = {"stdio", "write", "writev", "pwrite", "mmap", "direct"};
+
+typedef struct {
+	StorageBackend backend;
+	int fd;
+	FILE* file;
+	size_t length; //bytes written
+
+	//writev, records waiting for the next call
+	struct iovec iov[WRITEV_BATCH];
+	int iovs;
+
+	//mmap
+	char* map;
+	size_t mapSize;
+
+	//O_DIRECT, the chunk being filled and where it goes
+	char* chunk;
+	size_t chunkLength;
+	size_t chunkOffset;
+} StorageFile;
+
+typedef struct {
+	char* bytes;
+	size_t length;
+} Block;
+
+typedef struct {
+	double seconds; //length of the session
+	long recordPeriod; //ns
+	int EMGChannels;
+	double EMGScanRate;
+	double EMGBlockTime;
+	double syncPeriod;
+	int binary;
+	int fast;
+	int keep;
+} StorageOptions;
+
+typedef struct {
+	size_t bytes;
+	double wallTime;
+	double cpuTime;
+	double* latencies; //s, every write call
+	long numLatencies;
+	double syncTime;
+	double maxSync;
+	long syncs;
+} StorageResult;
+
+static Block records[POOL_SZ];
+static Block EMGBlocks[POOL_SZ];
+
+static double seconds(void) {
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec * .000000001;
+}
+
+static double cpuSeconds(void) {
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * .000001;
+}
+
+static float randomValue(float low, float high) {
+	return low + (high - low) * (rand() / (float) RAND_MAX);
+}
+
+static void appendValue(char* buffer, size_t* length, size_t capacity, const char* format, double value) {
+	*length += snprintf(buffer + *length, capacity - *length, format, value);
+}
+
+/*
+ * Builds the records and EMG blocks written, laid out like the recorder's
+ * so their sizes match. Values are random within each sensor's range.
+ */
+static int buildPool(const StorageOptions* options) {
+
+	int samplesPerRead = options->EMGScanRate * options->EMGBlockTime / options->EMGChannels + .5;
+	size_t EMGValues = (size_t) samplesPerRead * options->EMGChannels;
+	size_t recordCapacity = 16 + RECORD_VALUES * 16;
+	size_t EMGCapacity = EMGValues * 16 + samplesPerRead;
+
+	for (int i = 0; i < POOL_SZ; i++) {
+		records[i].bytes = malloc(recordCapacity);
+		EMGBlocks[i].bytes = malloc(EMGCapacity);
+		if (records[i].bytes == NULL || EMGBlocks[i].bytes == NULL) {
+			return -1;
+		}
+
+		if (options->binary) {
+			double time = i * options->recordPeriod * .000000001;
+			float* values = (float*) (records[i].bytes + sizeof(double));
+			memcpy(records[i].bytes, &time, sizeof(double));
+			for (int v = 0; v < RECORD_VALUES; v++) {
+				values[v] = randomValue(-500, 500);
+			}
+			records[i].length = sizeof(double) + RECORD_VALUES * sizeof(float);
+
+			signed short* counts = (signed short*) EMGBlocks[i].bytes;
+			for (size_t v = 0; v < EMGValues; v++) {
+				counts[v] = rand() % 16384 - 8192;
+			}
+			EMGBlocks[i].length = EMGValues * sizeof(signed short);
+			continue;
+		}
+
+		char* line = records[i].bytes;
+		size_t length = 0;
+		appendValue(line, &length, recordCapacity, "%5f\t", 1000 + i * options->recordPeriod * .000000001);
+		for (int v = 0; v < IMU_READ_SZ; v++) {
+			appendValue(line, &length, recordCapacity, "%f\t", randomValue(-2000, 2000));
+		}
+		for (int v = 0; v < WIRED_CYGL_READ_SZ; v++) {
+			length += snprintf(line + length, recordCapacity - length, "%i\t", rand() % 256);
+		}
+		for (int v = 0; v < FORCE_READ_SZ; v++) {
+			appendValue(line, &length, recordCapacity, "%f\t", randomValue(0, 1000));
+		}
+		for (int v = 0; v < FUSION_READ_SZ; v++) {
+			appendValue(line, &length, recordCapacity, "%f\t", randomValue(-1, 1));
+		}
+		for (int v = 0; v < KIN_READ_SZ; v++) {
+			appendValue(line, &length, recordCapacity, "%f\t", randomValue(-.8, .8));
+		}
+		for (int v = 0; v < KIN_GLOVE_SENSORS; v++) {
+			appendValue(line, &length, recordCapacity, "%f\t", randomValue(-90, 90));
+		}
+		line[length++] = '\n';
+		records[i].length = length;
+
+		char* block = EMGBlocks[i].bytes;
+		length = 0;
+		for (int s = 0; s < samplesPerRead; s++) {
+			for (int c = 0; c < options->EMGChannels; c++) {
+				appendValue(block, &length, EMGCapacity, "%f\t", randomValue(-10, 10));
+			}
+			block[length++] = '\n';
+		}
+		EMGBlocks[i].length = length;
+	}
+
+	return 1;
+}
+
+static int writeAll(int fd, const char* bytes, size_t size, off_t offset, int positioned) {
+
+	while (size > 0) {
+		ssize_t written = positioned ? pwrite(fd, bytes, size, offset) : write(fd, bytes, size);
+		if (written <= 0) {
+			if (written == -1 && errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		bytes += written;
+		size -= written;
+		offset += written;
+	}
+	return 1;
+}
+
+/*
+ * Writes the O_DIRECT chunk, padded out to a whole number of blocks. A
+ * chunk that isn't full stays buffered and is rewritten once it fills.
+ */
+static int writeDirectChunk(StorageFile* file) {
+
+	size_t padded = (file->chunkLength + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+	memset(file->chunk + file->chunkLength, 0, padded - file->chunkLength);
+	if (writeAll(file->fd, file->chunk, padded, file->chunkOffset, 1) != 1) {
+		return -1;
+	}
+	if (file->chunkLength == DIRECT_CHUNK) {
+		file->chunkOffset += DIRECT_CHUNK;
+		file->chunkLength = 0;
+	}
+	return 1;
+}
+
+static int flushWritev(StorageFile* file) {
+
+	int first = 0;
+	while (first < file->iovs) {
+		ssize_t written = writev(file->fd, &file->iov[first], file->iovs - first);
+		if (written <= 0) {
+			if (written == -1 && errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		//a short write leaves the rest of the batch for another call
+		while (first < file->iovs && (size_t) written >= file->iov[first].iov_len) {
+			written -= file->iov[first++].iov_len;
+		}
+		if (written > 0) {
+			file->iov[first].iov_base = (char*) file->iov[first].iov_base + written;
+			file->iov[first].iov_len -= written;
+		}
+	}
+	file->iovs = 0;
+	return 1;
+}
+
+/*
+ * Opens a file for a back end. size is what will be written, the back
+ * ends that preallocate take it up front.
+ * Returns 1 if opened, -1 otherwise.
+ */
+static int openStorageFile(StorageFile* file, const char* path, StorageBackend backend, size_t size) {
+
+	memset(file, 0, sizeof(StorageFile));
+	file->backend = backend;
+
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+	if (backend == STORAGE_MMAP) {
+		flags = O_RDWR | O_CREAT | O_TRUNC; //a shared mapping needs read access
+	} else if (backend == STORAGE_DIRECT) {
+		flags |= O_DIRECT;
+	}
+	file->fd = open(path, flags, 0644);
+	if (file->fd == -1) {
+		fprintf(stderr, "storageTest ERROR: Couldn't open %s for %s: %s.\n", path, backendNames[backend], strerror(errno));
+		return -1;
+	}
+
+	switch (backend) {
+	case STORAGE_STDIO:
+		if ((file->file = fdopen(file->fd, "w")) == NULL || setvbuf(file->file, NULL, _IOFBF, STDIO_BUFFER_SZ) != 0) {
+			return -1;
+		}
+		break;
+	case STORAGE_PWRITE:
+		if (posix_fallocate(file->fd, 0, size) != 0) {
+			fprintf(stderr, "storageTest ERROR: Couldn't preallocate %s.\n", path);
+			return -1;
+		}
+		break;
+	case STORAGE_MMAP:
+		file->mapSize = size > 0 ? size : 1;
+		if (posix_fallocate(file->fd, 0, file->mapSize) != 0) {
+			fprintf(stderr, "storageTest ERROR: Couldn't preallocate %s.\n", path);
+			return -1;
+		}
+		file->map = mmap(NULL, file->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+		if (file->map == MAP_FAILED) {
+			file->map = NULL;
+			return -1;
+		}
+		break;
+	case STORAGE_DIRECT:
+		if (posix_memalign((void**) &file->chunk, DIRECT_ALIGNMENT, DIRECT_CHUNK) != 0) {
+			file->chunk = NULL;
+			return -1;
+		}
+		break;
+	default:
+		break;
+	}
+
+	return 1;
+}
+
+/*
+ * Hands bytes to the back end. They have to stay put until the file is
+ * synced, writev only keeps a pointer to them.
+ * Returns 1 if written, -1 otherwise.
+ */
+static int storageWrite(StorageFile* file, const char* bytes, size_t length) {
+
+	int result = 1;
+
+	switch (file->backend) {
+	case STORAGE_STDIO:
+		result = fwrite(bytes, 1, length, file->file) == length ? 1 : -1;
+		break;
+	case STORAGE_WRITE:
+		result = writeAll(file->fd, bytes, length, 0, 0);
+		break;
+	case STORAGE_WRITEV:
+		file->iov[file->iovs].iov_base = (void*) bytes;
+		file->iov[file->iovs].iov_len = length;
+		if (++file->iovs == WRITEV_BATCH) {
+			result = flushWritev(file);
+		}
+		break;
+	case STORAGE_PWRITE:
+		result = writeAll(file->fd, bytes, length, file->length, 1);
+		break;
+	case STORAGE_MMAP:
+		if (file->length + length > file->mapSize) {
+			return -1;
+		}
+		memcpy(file->map + file->length, bytes, length);
+		break;
+	case STORAGE_DIRECT:
+		for (size_t done = 0; done < length && result == 1;) {
+			size_t part = DIRECT_CHUNK - file->chunkLength;
+			if (part > length - done) {
+				part = length - done;
+			}
+			memcpy(file->chunk + file->chunkLength, bytes + done, part);
+			file->chunkLength += part;
+			done += part;
+			if (file->chunkLength == DIRECT_CHUNK) {
+				result = writeDirectChunk(file);
+			}
+		}
+		break;
+	default:
+		break;
+	}
+
+	file->length += length;
+	return result;
+}
+
+/*
+ * Gets everything written so far onto the device.
+ * Returns 1 if synced, -1 otherwise.
+ */
+static int storageSync(StorageFile* file) {
+
+	switch (file->backend) {
+	case STORAGE_STDIO:
+		if (fflush(file->file) != 0) {
+			return -1;
+		}
+		break;
+	case STORAGE_WRITEV:
+		if (flushWritev(file) != 1) {
+			return -1;
+		}
+		break;
+	case STORAGE_MMAP:
+		return msync(file->map, file->mapSize, MS_SYNC) == 0 ? 1 : -1;
+	case STORAGE_DIRECT:
+		if (file->chunkLength > 0 && writeDirectChunk(file) != 1) {
+			return -1;
+		}
+		break;
+	default:
+		break;
+	}
+
+	return fdatasync(file->fd) == 0 ? 1 : -1;
+}
+
+/*
+ * Syncs and closes a file, trimming any preallocation or padding.
+ * Returns 1 if closed cleanly, -1 otherwise.
+ */
+static int closeStorageFile(StorageFile* file) {
+
+	int result = 1;
+
+	if (file->fd != -1 && storageSync(file) != 1) {
+		result = -1;
+	}
+	if (file->map != NULL) {
+		munmap(file->map, file->mapSize);
+	}
+	free(file->chunk);
+	if ((file->backend == STORAGE_PWRITE || file->backend == STORAGE_MMAP || file->backend == STORAGE_DIRECT)
+			&& file->fd != -1 && ftruncate(file->fd, file->length) != 0) {
+		result = -1;
+	}
+	if (file->file != NULL) {
+		if (fclose(file->file) != 0) {
+			result = -1;
+		}
+	} else if (file->fd != -1 && close(file->fd) != 0) {
+		result = -1;
+	}
+	file->fd = -1;
+	return result;
+}
+
+static int compareDoubles(const void* a, const void* b) {
+	double x = *(const double*) a;
+	double y = *(const double*) b;
+	return x < y ? -1 : x > y;
+}
+
+static void sleepUntil(double time) {
+
+	struct timespec due;
+	due.tv_sec = (time_t) time;
+	due.tv_nsec = (time - due.tv_sec) * 1000000000;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR) {
+	}
+}
+
+static void timeWrite(StorageResult* result, StorageFile* file, const Block* block, int* failed) {
+
+	double start = seconds();
+	if (storageWrite(file, block->bytes, block->length) != 1) {
+		*failed = 1;
+	}
+	result->latencies[result->numLatencies++] = seconds() - start;
+	result->bytes += block->length;
+}
+
+/*
+ * Runs a session through one back end.
+ * Returns 1 if it ran, -1 if the back end failed.
+ */
+static int runBackend(StorageBackend backend, const char* directory, const StorageOptions* options, StorageResult* result) {
+
+	char dataPath[512];
+	char EMGPath[512];
+	snprintf(dataPath, sizeof(dataPath), "%s/storageTest.%s.data", directory, backendNames[backend]);
+	snprintf(EMGPath, sizeof(EMGPath), "%s/storageTest.%s.emg", directory, backendNames[backend]);
+
+	//the session is fixed, so is what gets written
+	long numRecords = options->seconds * 1000000000 / options->recordPeriod;
+	long numBlocks = options->seconds / options->EMGBlockTime;
+	size_t dataSize = 0;
+	size_t EMGSize = 0;
+	for (long i = 0; i < numRecords; i++) {
+		dataSize += records[i % POOL_SZ].length;
+	}
+	for (long i = 0; i < numBlocks; i++) {
+		EMGSize += EMGBlocks[i % POOL_SZ].length;
+	}
+
+	memset(result, 0, sizeof(StorageResult));
+	result->latencies = malloc((numRecords + numBlocks) * sizeof(double));
+	if (result->latencies == NULL) {
+		return -1;
+	}
+
+	StorageFile data;
+	StorageFile EMG;
+	EMG.fd = -1;
+	EMG.map = NULL;
+	EMG.chunk = NULL;
+	EMG.file = NULL;
+	if (openStorageFile(&data, dataPath, backend, dataSize) != 1 || openStorageFile(&EMG, EMGPath, backend, EMGSize) != 1) {
+		closeStorageFile(&data);
+		closeStorageFile(&EMG);
+		unlink(dataPath);
+		unlink(EMGPath);
+		return -1;
+	}
+
+	int failed = 0;
+	long record = 0;
+	long block = 0;
+	long syncs = 0;
+	double cpuStart = cpuSeconds();
+	double start = seconds();
+	while ((record < numRecords || block < numBlocks) && !failed) {
+
+		//whichever stream is due next, records win ties
+		double recordDue = record < numRecords ? record * options->recordPeriod * .000000001 : options->seconds;
+		double blockDue = block < numBlocks ? (block + 1) * options->EMGBlockTime : options->seconds;
+		double due = recordDue <= blockDue ? recordDue : blockDue;
+		if (!options->fast) {
+			sleepUntil(start + due);
+		}
+
+		if (record < numRecords && (recordDue <= blockDue || block == numBlocks)) {
+			timeWrite(result, &data, &records[record++ % POOL_SZ], &failed);
+		} else {
+			timeWrite(result, &EMG, &EMGBlocks[block++ % POOL_SZ], &failed);
+		}
+
+		if (due >= (syncs + 1) * options->syncPeriod) {
+			syncs++;
+			double syncStart = seconds();
+			if (storageSync(&data) != 1 || storageSync(&EMG) != 1) {
+				failed = 1;
+			}
+			double syncTime = seconds() - syncStart;
+			result->syncTime += syncTime;
+			result->maxSync = syncTime > result->maxSync ? syncTime : result->maxSync;
+			result->syncs++;
+		}
+	}
+
+	//the final sync is part of the session
+	if (closeStorageFile(&data) != 1 || closeStorageFile(&EMG) != 1) {
+		failed = 1;
+	}
+	result->wallTime = seconds() - start;
+	result->cpuTime = cpuSeconds() - cpuStart;
+
+	if (!options->keep) {
+		unlink(dataPath);
+		unlink(EMGPath);
+	}
+
+	if (failed) {
+		fprintf(stderr, "storageTest ERROR: %s failed: %s.\n", backendNames[backend], strerror(errno));
+		return -1;
+	}
+	return 1;
+}
+
+static void printResult(StorageBackend backend, StorageResult* result, const StorageOptions* options) {
+
+	double MB = result->bytes / 1e6;
+	if (result->numLatencies == 0) {
+		printf("%-8s nothing written, the session is shorter than a record period\n", backendNames[backend]);
+		return;
+	}
+	qsort(result->latencies, result->numLatencies, sizeof(double), compareDoubles);
+	double p50 = result->latencies[result->numLatencies / 2];
+	double p99 = result->latencies[(long) (result->numLatencies * .99)];
+	double max = result->latencies[result->numLatencies - 1];
+
+	double writing = 0;
+	for (long i = 0; i < result->numLatencies; i++) {
+		writing += result->latencies[i];
+	}
+
+	printf("%-8s %10.2f %10.2f %10.1f %10.1f %10.1f %10.2f %10.2f %10.3f\n", backendNames[backend],
+			MB / (options->fast ? result->wallTime : writing + result->syncTime),
+			MB / result->wallTime,
+			p50 * 1e6, p99 * 1e6, max * 1e6,
+			result->syncs > 0 ? result->syncTime / result->syncs * 1e3 : 0, result->maxSync * 1e3,
+			MB > 0 ? result->cpuTime / MB : 0);
+}
+
+static void usage(const char* program) {
+	fprintf(stderr, "Usage: %s [-d seconds] [-r ms] [-e channels:rate:block] [-s seconds] [-b] [-f] [-t backends] [-k] <directory>\n", program);
+	exit(1);
+}
+
+int main(int argc, char* argv[]) {
+
+	StorageOptions options = {60, 25000000, 8, 8000, .2, 10, 0, 0, 0};
+	int run[STORAGE_BACKENDS] = {1, 1, 1, 1, 1, 1};
+
+	int option;
+	while ((option = getopt(argc, argv, "d:r:e:s:bft:k")) != -1) {
+		switch (option) {
+		case 'd':
+			options.seconds = atof(optarg);
+			break;
+		case 'r':
+			options.recordPeriod = atof(optarg) * 1000000;
+			break;
+		case 'e':
+			if (sscanf(optarg, "%d:%lf:%lf", &options.EMGChannels, &options.EMGScanRate, &options.EMGBlockTime) != 3) {
+				usage(argv[0]);
+			}
+			break;
+		case 's':
+			options.syncPeriod = atof(optarg);
+			break;
+		case 'b':
+			options.binary = 1;
+			break;
+		case 'f':
+			options.fast = 1;
+			break;
+		case 't':
+			memset(run, 0, sizeof(run));
+			for (char* name = strtok(optarg, ","); name != NULL; name = strtok(NULL, ",")) {
+				int b = 0;
+				while (b < STORAGE_BACKENDS && strcmp(name, backendNames[b]) != 0) {
+					b++;
+				}
+				if (b == STORAGE_BACKENDS) {
+					fprintf(stderr, "storageTest ERROR: No back end %s.\n", name);
+					exit(1);
+				}
+				run[b] = 1;
+			}
+			break;
+		case 'k':
+			options.keep = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (argc - optind != 1 || options.seconds <= 0 || options.recordPeriod <= 0 || options.syncPeriod <= 0
+			|| options.EMGChannels < 1 || options.EMGScanRate <= 0 || options.EMGBlockTime <= 0) {
+		usage(argv[0]);
+	}
+
+	srand(1);
+	if (buildPool(&options) != 1) {
+		fprintf(stderr, "storageTest ERROR: Out of memory.\n");
+		exit(1);
+	}
+
+	printf("%s: %.0f s session, %s records of %zu bytes every %.1f ms, EMG blocks of %zu bytes every %.0f ms, sync every %.0f s%s\n",
+			argv[optind], options.seconds, options.binary ? "binary" : "text", records[0].length,
+			options.recordPeriod / 1e6, EMGBlocks[0].length, options.EMGBlockTime * 1e3, options.syncPeriod,
+			options.fast ? ", as fast as possible" : "");
+	printf("%-8s %10s %10s %10s %10s %10s %10s %10s %10s\n", "backend", "MB/s busy", "MB/s wall",
+			"p50 us", "p99 us", "max us", "sync ms", "max sync", "CPU s/MB");
+
+	int result = 0;
+	for (int b = 0; b < STORAGE_BACKENDS; b++) {
+		if (!run[b]) {
+			continue;
+		}
+		StorageResult backendResult;
+		if (runBackend(b, argv[optind], &options, &backendResult) == 1) {
+			printResult(b, &backendResult, &options);
+		} else {
+			printf("%-8s failed\n", backendNames[b]);
+			result = 1;
+		}
+		free(backendResult.latencies);
+		fflush(stdout);
+	}
+
+	for (int i = 0; i < POOL_SZ; i++) {
+		free(records[i].bytes);
+		free(EMGBlocks[i].bytes);
+	}
+	return result;
+}
@@ -6,9 +6,13 @@
  * 	requirements. Also designed to return EMG information every 200ms.
  *
  * Usage:
- * 	Compile with: gcc -o structureTestSR structureTestSR.c quickDevice.c slowDevice.c -pthread -std=gnu99 -Wall -Wextra
+ * 	Compile with: gcc -o structureTestSR structureTestSR.c quickDevice.c slowDevice.c DeviceSim.c -pthread -std=gnu99 -Wall -Wextra -lm
  *
  *  Start recording with sudo ./structureTest, stop with ctrl-d.
+ *
+ *  The simulated devices' timing and faults come from QUICKDEVICE_SIM and
+ *  SLOWDEVICE_SIM (see DeviceSim.h), e.g. to make the recovery paths run:
+ *  	sudo QUICKDEVICE_SIM="dist=tail jitter=.002 timeout=.05 fail=.02 disconnect=.001 down=1 seed=7" ./structureTest
  */
 
 #include <stdio.h>
@@ -627,6 +631,12 @@ void endSession() {
 	fprintf(stderr, "Elapsed Time (sec): %05.3f\tPercent Missed: %5.3f%%\n",
 			data.time, percentMissed);
 
+	//how the simulated devices behaved
+	printDeviceSim(&data.IMU.sim, "IMU", stderr);
+	printDeviceSim(&data.CyGl.sim, "CyGl", stderr);
+	printDeviceSim(&data.Force.sim, "Force", stderr);
+	printDeviceSim(&data.EMG.sim, "EMG", stderr);
+
 	//close all sensors
 	closeQuickDevice(&data.IMU);
 	closeQuickDevice(&data.CyGl);
@@ -0,0 +1,231 @@
+/*
+ * Name: timingBenchmark.c
+ * Author: Elijah Pivo
+ *
+ * Description:
+ * 	Runs every timing strategy of the Engine (see Engine.h) against the
+ * 	same simulated devices, an IMU, CyberGlove and Force sensor read once
+ * 	a cycle (quickDevice) and an EMG read in blocks (slowDevice), and
+ * 	prints their cycle jitter, miss rate, CPU use and end to end latency
+ * 	in one table.
+ *
+ * 	Each run starts the devices over with the same seeds, so every
+ * 	strategy sees the same delays and faults. Every cycle the reads are
+ * 	saved as text, like the recording programs do, to /dev/null unless an
+ * 	output file is given.
+ *
+ * Usage:
+ * 	Compile with: gcc -o timingBenchmark timingBenchmark.c Engine.c TimingStrategies.c WorkerPool.c ThreadPlan.c quickDevice.c slowDevice.c DeviceSim.c -pthread -std=gnu99 -Wall -Wextra -lm
+ *
+ * 	./timingBenchmark [-s seconds] [-d deadline_us] [-o outFile] [strategy ...]
+ * 		-s seconds each strategy runs (10)
+ * 		-d how long after a release the pool waits for reads, the period
+ * 		less SAVE_US like mobileArmTrack (23000)
+ * 		-o where the reads are saved (/dev/null)
+ * 		strategies to run, all of them if none are given
+ *
+ * 	The devices' timing and faults come from QUICKDEVICE_SIM and
+ * 	SLOWDEVICE_SIM (see DeviceSim.h), e.g. to compare the strategies under
+ * 	a long tail:
+ * 		QUICKDEVICE_SIM="dist=tail latency=.012 jitter=.001 timeout=.06 seed=3" ./timingBenchmark
+ *
+ * 	Without SLOWDEVICE_SIM the EMG sleeps out its blocks rather than
+ * 	spinning, so the CPU column is the strategies' own and not a core
+ * 	burnt by the simulator. Give SLOWDEVICE_SIM (with wait=spin) to
+ * 	measure against a spinning EMG.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Engine.h"
+#include "quickDevice.h"
+#include "slowDevice.h"
+
+#define PERIOD_US 25000
+#define SAVE_US 2000 //left at the end of a cycle to save, as in mobileArmTrack
+#define NUM_QUICK_DEVICES 3
+
+typedef struct {
+	QuickDevice quickDevices[NUM_QUICK_DEVICES]; //IMU, CyGl, Force
+	SlowDevice slowDevice; //EMG
+	SimConfig quickConfig;
+	SimConfig slowConfig;
+
+	FILE* outFile;
+} Devices;
+
+int startDevices(Devices* devices);
+void closeDevices(Devices* devices);
+int readQuickDevice(void* quickDevice, double time);
+int updateQuickDevice(void* quickDevice);
+int readSlowDevice(void* slowDevice, double time);
+int updateSlowDevice(void* slowDevice);
+void saveReads(void* arg, const Engine* engine, double time, unsigned fresh);
+
+static const char* const QuickDeviceNames[NUM_QUICK_DEVICES] = {"IMU", "CyGl", "Force"};
+
+int main(int argc, char* argv[]) {
+
+	double seconds = 10;
+	long deadline = PERIOD_US - SAVE_US;
+	const char* outName = "/dev/null";
+
+	int option;
+	while ((option = getopt(argc, argv, "s:d:o:")) != -1) {
+		switch (option) {
+		case 's':
+			seconds = atof(optarg);
+			break;
+		case 'd':
+			deadline = atol(optarg);
+			break;
+		case 'o':
+			outName = optarg;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-s seconds] [-d deadline_us] [-o outFile] [strategy ...]\n", argv[0]);
+			exit(1);
+		}
+	}
+	if (seconds <= 0 || deadline <= 0) {
+		fprintf(stderr, "ERROR: Seconds and deadline have to be positive.\n");
+		exit(1);
+	}
+
+	//check the strategies asked for before running any
+	for (int i = optind; i < argc; i++) {
+		if (findTimingStrategy(argv[i]) == NULL) {
+			fprintf(stderr, "ERROR: No strategy \"%s\", there's", argv[i]);
+			for (int s = 0; timingStrategy(s) != NULL; s++) {
+				fprintf(stderr, " %s", timingStrategy(s)->name);
+			}
+			fprintf(stderr, ".\n");
+			exit(1);
+		}
+	}
+
+	static Devices devices;
+	devices.outFile = fopen(outName, "w");
+	if (devices.outFile == NULL) {
+		fprintf(stderr, "ERROR: Couldn't open %s.\n", outName);
+		exit(1);
+	}
+
+	//the devices' specs are read once, each run starts them over from them
+	if (configureQuickDevice(&devices.quickDevices[0], NULL) != 1
+			|| configureSlowDevice(&devices.slowDevice, NULL) != 1) {
+		exit(1);
+	}
+	devices.quickConfig = devices.quickDevices[0].sim.config;
+	devices.slowConfig = devices.slowDevice.sim.config;
+	if (getenv("SLOWDEVICE_SIM") == NULL) {
+		devices.slowConfig.spin = 0; //a spinning EMG would count as every strategy's CPU
+	}
+
+	static Engine engine;
+	initializeEngine(&engine, PERIOD_US);
+	engine.deadline = deadline;
+	for (int i = 0; i < NUM_QUICK_DEVICES; i++) {
+		addEngineDevice(&engine, QuickDeviceNames[i], &devices.quickDevices[i], readQuickDevice, updateQuickDevice, 0);
+	}
+	addEngineDevice(&engine, "EMG", &devices.slowDevice, readSlowDevice, updateSlowDevice, 1);
+
+	fprintf(stderr, "Running each strategy for %.1f s, %i ms cycles.\n\n", seconds, PERIOD_US / 1000);
+	printEngineHeader(stdout);
+
+	int strategies = optind < argc ? argc - optind : 0;
+	for (int i = 0; strategies > 0 ? i < strategies : timingStrategy(i) != NULL; i++) {
+		const TimingStrategy* strategy = strategies > 0 ? findTimingStrategy(argv[optind + i]) : timingStrategy(i);
+
+		if (startDevices(&devices) != 1) {
+			fprintf(stderr, "ERROR: Couldn't start the devices.\n");
+			exit(1);
+		}
+		if (runEngine(&engine, strategy, seconds, saveReads, &devices) == 1) {
+			printEngineResults(&engine, stdout);
+			fflush(stdout);
+		}
+		closeDevices(&devices);
+	}
+
+	fclose(devices.outFile);
+
+	return 0;
+}
+
+/*
+ * Starts the devices over from their specs, same seeds every time.
+ */
+int startDevices(Devices* devices) {
+
+	for (int i = 0; i < NUM_QUICK_DEVICES; i++) {
+		initializeDeviceSim(&devices->quickDevices[i].sim, &devices->quickConfig, i);
+		if (initializeQuickDevice(&devices->quickDevices[i]) == -1) {
+			return -1;
+		}
+	}
+	initializeDeviceSim(&devices->slowDevice.sim, &devices->slowConfig, NUM_QUICK_DEVICES);
+	if (initializeSlowDevice(&devices->slowDevice) == -1) {
+		return -1;
+	}
+
+	return 1;
+}
+
+void closeDevices(Devices* devices) {
+
+	for (int i = 0; i < NUM_QUICK_DEVICES; i++) {
+		closeQuickDevice(&devices->quickDevices[i]);
+	}
+	closeSlowDevice(&devices->slowDevice);
+}
+
+int readQuickDevice(void* quickDevice, double time) {
+	return getQuickDeviceData(quickDevice, time);
+}
+
+int updateQuickDevice(void* quickDevice) {
+	return updateQuickDeviceRead(quickDevice);
+}
+
+int readSlowDevice(void* slowDevice, double time) {
+	return getSlowDeviceData(slowDevice, time);
+}
+
+int updateSlowDevice(void* slowDevice) {
+	return updateSlowDeviceRead(slowDevice);
+}
+
+void saveReads(void* arg, const Engine* engine, double time, unsigned fresh) {
+
+	Devices* devices = arg;
+
+	/* Prints:
+	 *
+	 * TIME
+	 * IMU, CyGl, Force READS, * if not new
+	 * EMG READ if new
+	 */
+
+	fprintf(devices->outFile, "%05.3f\n", time);
+
+	for (int i = 0; i < NUM_QUICK_DEVICES; i++) {
+		if (!(fresh & 1u << i)) {
+			fprintf(devices->outFile, "*");
+		}
+		for (int j = 0; j < QUICKDEVICE_READ_SZ; j++) {
+			fprintf(devices->outFile, "%i\t", devices->quickDevices[i].read[j]);
+		}
+	}
+	fprintf(devices->outFile, "\n");
+
+	if (fresh & 1u << (engine->numDevices - 1)) {
+		for (int j = 0; j < SLOWDEVICE_READ_SZ * SLOWDEVICE_READS_PER_CYCLE; j++) {
+			fprintf(devices->outFile, "%i\t", devices->slowDevice.read[j]);
+		}
+	}
+	fprintf(devices->outFile, "\n");
+}